@@ -11,6 +11,7 @@
 #include <unistd.h>
 #include <cstring>
 #include <string>
+#include <algorithm>
 
 using namespace http;
 using namespace std::chrono;
@@ -63,12 +64,18 @@ private:
     uint16_t port_;
 };
 
-void RunBenchmark(const std::string& name, int num_requests, int num_threads) {
+// With keep_alive each client thread reuses one connection for all of its
+// requests; otherwise every request pays for a new connection
+void RunBenchmark(const std::string& name, int num_requests, int num_threads,
+                  const std::string& backend = "auto", size_t reactors = 1, bool keep_alive = false) {
     Config config;
     config.port = 8888;
     config.thread_pool_size = 4;
+    config.event_loop_backend = backend;
+    config.reactor_count = reactors;
     
     Server server(config);
+    const std::string backend_name = server.EventLoopBackend();
     
     server.Get("/bench", [](const HttpRequest& req) {
         return JsonResponse(R"({"status": "ok", "message": "benchmark response"})");
@@ -93,6 +100,28 @@ void RunBenchmark(const std::string& name, int num_requests, int num_threads) {
         client_threads.emplace_back([&, t]() {
             int requests_per_thread = num_requests / num_threads;
             
+            if (keep_alive) {
+                BenchmarkClient client("127.0.0.1", 8888);
+                if (!client.Connect()) {
+                    failure_count += requests_per_thread;
+                    return;
+                }
+                
+                const std::string request =
+                    "GET /bench HTTP/1.1\r\n"
+                    "Host: localhost:8888\r\n"
+                    "\r\n";
+                for (int i = 0; i < requests_per_thread; ++i) {
+                    if (client.SendRequest(request) &&
+                        client.ReceiveResponse().find("200 OK") != std::string::npos) {
+                        success_count++;
+                    } else {
+                        failure_count++;
+                    }
+                }
+                return;
+            }
+            
             for (int i = 0; i < requests_per_thread; ++i) {
                 BenchmarkClient client("127.0.0.1", 8888);
                 
@@ -100,6 +129,7 @@ void RunBenchmark(const std::string& name, int num_requests, int num_threads) {
                     std::string request = 
                         "GET /bench HTTP/1.1\r\n"
                         "Host: localhost:8888\r\n"
+                        "Connection: close\r\n"
                         "\r\n";
                     
                     if (client.SendRequest(request)) {
@@ -133,7 +163,8 @@ void RunBenchmark(const std::string& name, int num_requests, int num_threads) {
     
     double requests_per_sec = (success_count.load() * 1000.0) / duration;
     
-    std::cout << "\n=== " << name << " ===\n";
+    std::cout << "\n=== " << name << " [" << backend_name << ", " << reactors << " reactor"
+              << (reactors == 1 ? "" : "s") << (keep_alive ? ", keep-alive" : "") << "] ===\n";
     std::cout << "Total requests: " << num_requests << "\n";
     std::cout << "Successful: " << success_count.load() << "\n";
     std::cout << "Failed: " << failure_count.load() << "\n";
@@ -142,25 +173,46 @@ void RunBenchmark(const std::string& name, int num_requests, int num_threads) {
     std::cout << "Average latency: " << (duration * 1.0 / num_requests) << " ms\n";
 }
 
-int main() {
+// Usage: benchmarks [backend...]   (default: auto io_uring)
+int main(int argc, char* argv[]) {
+    std::vector<std::string> backends;
+    for (int i = 1; i < argc; ++i) {
+        backends.push_back(argv[i]);
+    }
+    if (backends.empty()) {
+        backends = {"auto", "io_uring"};
+    }
+    
     std::cout << "Running HTTP Server Benchmarks\n";
     std::cout << "==============================\n\n";
     
-    // Warm-up
-    std::cout << "Warming up...\n";
-    RunBenchmark("Warm-up", 100, 1);
-    std::this_thread::sleep_for(std::chrono::seconds(1));
-    
-    // Single-threaded benchmark
-    RunBenchmark("Single-threaded (1000 requests)", 1000, 1);
-    std::this_thread::sleep_for(std::chrono::seconds(1));
-    
-    // Multi-threaded benchmark
-    RunBenchmark("Multi-threaded (1000 requests, 10 threads)", 1000, 10);
-    std::this_thread::sleep_for(std::chrono::seconds(1));
-    
-    // High-load benchmark
-    RunBenchmark("High-load (5000 requests, 20 threads)", 5000, 20);
+    for (const auto& backend : backends) {
+        // Warm-up
+        std::cout << "Warming up (" << backend << ")...\n";
+        RunBenchmark("Warm-up", 100, 1, backend);
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        
+        // Single-threaded benchmark
+        RunBenchmark("Single-threaded (1000 requests)", 1000, 1, backend);
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        
+        // Multi-threaded benchmark
+        RunBenchmark("Multi-threaded (1000 requests, 10 threads)", 1000, 10, backend);
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        
+        // High-load benchmark
+        RunBenchmark("High-load (5000 requests, 20 threads)", 5000, 20, backend);
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        
+        // Same load with one reactor per core (SO_REUSEPORT listeners)
+        size_t cores = std::max(1u, std::thread::hardware_concurrency());
+        RunBenchmark("High-load, multi-reactor (5000 requests, 20 threads)", 5000, 20, backend, cores);
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        
+        // Same load over persistent connections: no connect() per request
+        RunBenchmark("High-load, keep-alive (5000 requests, 20 threads)", 5000, 20, backend, 1, true);
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
     
     return 0;
 }
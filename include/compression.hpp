@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "http_response.hpp"
+
+namespace http {
+
+enum class ContentCoding {
+    Identity,
+    Gzip,
+    Deflate     // zlib format, as HTTP defines "deflate"
+};
+
+// Coding to answer an Accept-Encoding header with: gzip or deflate by
+// q-value (gzip on ties, "*" standing in for either), Identity when the
+// header is empty or accepts neither
+ContentCoding NegotiateCoding(const std::string& accept_encoding);
+
+// "gzip", "deflate" or "identity"
+const char* CodingName(ContentCoding coding);
+
+// Compresses data with zlib at level (1-9). Throws std::runtime_error when
+// zlib fails.
+std::string Compress(const std::string& data, ContentCoding coding, int level);
+
+// Text-like types worth compressing (text/*, JSON, JavaScript, XML, SVG)
+bool IsCompressibleType(const std::string& content_type);
+
+// Compresses response bodies for clients that accept it. Bodies shared
+// between responses (GetSharedBody: cached static assets, pages built once)
+// are immutable, so their encoded forms are kept in a bounded cache and
+// each is compressed once; other bodies are compressed per response. Safe
+// to use from any thread.
+class ResponseCompressor {
+public:
+    struct Stats {
+        uint64_t compressed = 0;        // Responses sent encoded
+        uint64_t cache_hits = 0;        // ... of which from the cache
+        uint64_t bytes_in = 0;          // Body bytes before and after encoding
+        uint64_t bytes_out = 0;
+    };
+
+    // level 1-9; bodies below min_size are left alone; cache_bytes bounds
+    // the encoded shared bodies kept (0 = compress every time). Throws
+    // std::invalid_argument for a level out of range.
+    ResponseCompressor(int level, size_t min_size, size_t cache_bytes);
+
+    // Encodes response in place when it has a compressible body of at
+    // least min_size and accept_encoding allows gzip or deflate, and only
+    // if that makes it smaller. Such responses carry
+    // "Vary: Accept-Encoding" either way. Responses streamed from a file,
+    // already encoded, or without a body (204, 304) are left alone.
+    void Apply(const std::string& accept_encoding, HttpResponse& response);
+
+    Stats GetStats() const;
+    size_t CachedBytes() const;
+
+private:
+    struct CachedBody {
+        std::weak_ptr<const std::string> source;    // Expired once no response holds the body
+        std::shared_ptr<const std::string> encoded[2];     // Gzip, Deflate; empty when not smaller
+        bool tried[2] = {false, false};
+    };
+
+    std::shared_ptr<const std::string> EncodeShared(const std::shared_ptr<const std::string>& body,
+                                                    ContentCoding coding);
+    // Caller holds mutex_
+    void DropExpired();
+
+    int level_;
+    size_t min_size_;
+    size_t cache_bytes_;
+
+    mutable std::mutex mutex_;
+    // Keyed by the shared body's address; the weak pointer tells a reused
+    // address from the body it was cached for
+    std::unordered_map<const std::string*, CachedBody> cache_;
+    size_t cached_bytes_ = 0;
+
+    std::atomic<uint64_t> compressed_{0};
+    std::atomic<uint64_t> cache_hits_{0};
+    std::atomic<uint64_t> bytes_in_{0};
+    std::atomic<uint64_t> bytes_out_{0};
+};
+
+} // namespace http
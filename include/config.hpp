@@ -8,13 +8,49 @@ namespace http {
 struct Config {
     std::string host = "0.0.0.0";
     uint16_t port = 8080;
+    std::string listen = "";                  // Comma-separated endpoints (0.0.0.0:8080, [::]:8080, unix:/path); empty = host:port
+    size_t listen_backlog = 1024;
+    bool tcp_nodelay = true;
+    size_t tcp_defer_accept_seconds = 0;      // Accept only once the client has sent data (Linux; 0 = off)
+    size_t tcp_fastopen_queue = 0;            // TCP Fast Open pending-request queue (0 = off)
     size_t thread_pool_size = 4;
-    size_t max_connections = 1000;
-    size_t read_buffer_size = 8192;
+    std::string thread_pool_scheduling = "shared"; // shared (one locked queue) or work_stealing
+    std::string thread_pool_queue = "locked";  // Shared queue: locked (unbounded) or ring (bounded, lock-free)
+    size_t thread_pool_queue_capacity = 4096; // Ring slots; requests that find it full get 503
+    size_t thread_pool_critical_threads = 1;  // Workers reserved for Critical routes (0 = they share the pool)
+    size_t thread_pool_bulk_threads = 2;      // The only workers running Bulk routes (0 = they share the pool)
+    size_t thread_pool_lane_capacity = 1024;  // Requests each of those lanes queues; more get 503
+    size_t thread_pool_max_size = 0;          // Elastic: grow toward this many workers under queue delay (0 = fixed)
+    size_t thread_pool_grow_after_ms = 10;    // ... when a task waited longer than this
+    size_t thread_pool_idle_timeout_ms = 30000; // ... and retire added workers idle this long
+    size_t max_connections = 1000;            // Open HTTP connections; more are refused with 503 at accept
+    size_t max_request_size = 1024 * 1024;    // Larger requests get 413 and are closed
+    size_t send_high_water_mark = 1024 * 1024; // Unsent bytes per connection before sends are refused (0 = unlimited)
     size_t request_timeout_seconds = 30;
+    size_t keep_alive_timeout_seconds = 5;    // Idle time allowed between requests (0 = close after each)
+    size_t max_requests_per_connection = 1000; // Close a kept-alive connection after this many (0 = unlimited)
+    size_t queue_delay_target_ms = 50;        // Shed requests (503) while worker queue waits stay above this (0 = never)
+    size_t queue_delay_interval_ms = 500;     // ... for at least this long
+    size_t retry_after_seconds = 1;           // Retry-After sent with shed requests
+    bool http2 = true;                        // Accept h2c (prior knowledge and Upgrade: h2c)
+    size_t http2_max_concurrent_streams = 100; // Streams one HTTP/2 connection may have open
+    size_t http2_max_resets = 1000;           // Stream resets one HTTP/2 connection may send before GOAWAY
     std::string log_file = "";
     bool enable_logging = true;
     std::string static_directory = "";
+    size_t static_cache_bytes = 32 * 1024 * 1024; // In-memory static assets (0 = always read from disk)
+    int compression_level = 6;                // gzip/deflate level, 1-9 (0 = never compress)
+    size_t compression_min_size = 1024;       // Smaller bodies are sent as they are
+    size_t compression_cache_bytes = 8 * 1024 * 1024; // Compressed forms of shared bodies (dashboard, static assets)
+    std::string event_loop_backend = "auto";  // auto, kqueue, epoll, io_uring
+    size_t reactor_count = 1;                 // Event loops, each with its own listener (0 = one per core)
+    bool pin_reactors = false;                // Pin each reactor to a CPU of reactor_cpus
+    bool pin_workers = false;                 // Pin each thread pool worker (lanes and elastic ones too) to a CPU of worker_cpus
+    std::string reactor_cpus = "";            // CPU list ("0-3,8") for pinned reactors; empty = all online (or numa_node's)
+    std::string worker_cpus = "";             // ... for pinned workers; sharing the reactors' set, they start after them
+    int numa_node = -1;                       // Default CPU sets come from this NUMA node (-1 = all nodes)
+    std::string thread_name_prefix = "monitord"; // Threads are named <prefix>-io-N, <prefix>-wk-N (empty = unnamed)
+    size_t busy_poll_us = 0;                  // Spin this long before blocking in each loop (0 = off)
 
     // Load from environment variables or file
     static Config FromEnv();
@@ -3,12 +3,27 @@
 #include <string>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <cstdint>
 #include <unistd.h>
 #include <fcntl.h>
 #include <arpa/inet.h>
 
 namespace http {
 
+// Remote address of a socket, captured once (at accept) so requests can be
+// logged without a getpeername each
+struct PeerAddress {
+    struct sockaddr_storage storage{};
+    socklen_t length = 0;   // 0 when unknown
+
+    // Reads it back with getpeername
+    static PeerAddress Of(int fd);
+
+    bool Known() const { return length > 0; }
+    std::string Host() const;   // "unknown" when not known
+    uint16_t Port() const;
+};
+
 class Connection {
 public:
     explicit Connection(int fd);
@@ -31,13 +46,15 @@ public:
     void Close();
     bool IsOpen() const { return fd_ >= 0; }
 
+    // Give up ownership without closing; returns the fd
+    int Release();
+
     void SetNonBlocking(bool non_blocking);
     void SetKeepAlive(bool keep_alive);
 
 private:
     int fd_;
-    struct sockaddr_in addr_;
-    bool addr_initialized_;
+    PeerAddress peer_;
 };
 
 } // namespace http
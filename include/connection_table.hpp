@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include "connection.hpp"
+
+namespace http {
+
+// Names one connection for its whole life: a table slot plus that slot's
+// generation, so an id kept past close (e.g. by a worker still computing a
+// response) never matches the connection that reuses the slot or the fd.
+// Zero is never a valid id.
+using ConnectionId = uint64_t;
+
+// Slab of open connections, each with its fd, the peer address captured at
+// accept and per-connection State. Not thread-safe: a table belongs to the
+// event loop that owns its connections, and other threads pass ids back to
+// that loop (RunInLoop) instead of touching fds.
+template <typename State>
+class ConnectionTable {
+public:
+    struct Entry {
+        int fd = -1;
+        PeerAddress peer;
+        State state{};
+    };
+
+    ConnectionId Open(int fd, const PeerAddress& peer) {
+        uint32_t index;
+        if (!free_.empty()) {
+            index = free_.back();
+            free_.pop_back();
+        } else {
+            index = static_cast<uint32_t>(slots_.size());
+            slots_.emplace_back();
+        }
+
+        Slot& slot = slots_[index];
+        slot.entry.fd = fd;
+        slot.entry.peer = peer;
+        slot.open = true;
+        ++open_;
+        return (static_cast<ConnectionId>(slot.generation) << 32) | index;
+    }
+
+    // nullptr once id has been closed
+    Entry* Find(ConnectionId id) {
+        uint32_t index = static_cast<uint32_t>(id);
+        if (index >= slots_.size()) {
+            return nullptr;
+        }
+        Slot& slot = slots_[index];
+        if (!slot.open || slot.generation != static_cast<uint32_t>(id >> 32)) {
+            return nullptr;
+        }
+        return &slot.entry;
+    }
+
+    // Frees the slot (the caller closes the fd); false if already closed
+    bool Close(ConnectionId id) {
+        if (!Find(id)) {
+            return false;
+        }
+        uint32_t index = static_cast<uint32_t>(id);
+        Slot& slot = slots_[index];
+        slot.open = false;
+        slot.entry = Entry{};
+        // Generation 0 is skipped so ids stay non-zero
+        if (++slot.generation == 0) {
+            slot.generation = 1;
+        }
+        free_.push_back(index);
+        --open_;
+        return true;
+    }
+
+    // Open connections
+    size_t Size() const { return open_; }
+
+    // Calls fn(id, entry) for every open connection
+    template <typename Fn>
+    void ForEach(Fn fn) {
+        for (size_t i = 0; i < slots_.size(); ++i) {
+            Slot& slot = slots_[i];
+            if (slot.open) {
+                fn((static_cast<ConnectionId>(slot.generation) << 32) | i, slot.entry);
+            }
+        }
+    }
+
+private:
+    struct Slot {
+        Entry entry;
+        uint32_t generation = 1;
+        bool open = false;
+    };
+
+    std::deque<Slot> slots_;        // Stable addresses as the table grows
+    std::vector<uint32_t> free_;
+    size_t open_ = 0;
+};
+
+} // namespace http
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace http {
+
+struct CpuInfo {
+    unsigned id = 0;
+    unsigned core = 0;      // core_id, shared by hyperthread siblings
+    unsigned package = 0;   // Socket
+    unsigned node = 0;      // NUMA node
+};
+
+// Online CPUs and where they sit: package, core and NUMA node
+class CpuTopology {
+public:
+    // Reads Linux sysfs under sysfs_root. Where that cannot be read (other
+    // systems), every CPU of hardware_concurrency is its own core on node 0.
+    static CpuTopology Discover(const std::string& sysfs_root = "/sys/devices/system/cpu");
+
+    explicit CpuTopology(std::vector<CpuInfo> cpus);
+
+    const std::vector<CpuInfo>& Cpus() const { return cpus_; }
+    size_t NodeCount() const;
+    std::vector<unsigned> NodeCpus(unsigned node) const;
+
+    // The online CPUs among allowed (all when empty) in the order threads
+    // should take them: node by node, so consecutive threads share a node's
+    // caches and memory, and within a node one hyperthread per physical
+    // core before any core's second.
+    std::vector<unsigned> PlacementOrder(const std::vector<unsigned>& allowed = {}) const;
+
+private:
+    std::vector<CpuInfo> cpus_;     // By id
+};
+
+// Parses a CPU list as sysfs and taskset write them ("0-3,8,10-11").
+// Throws std::invalid_argument when malformed.
+std::vector<unsigned> ParseCpuList(const std::string& list);
+
+// Restricts the calling thread to cpus. Linux binds it; macOS only takes
+// an affinity hint (threads sharing a tag share a cache), from the first
+// CPU. Returns false when the system refused or cannot pin.
+bool PinCurrentThread(const std::vector<unsigned>& cpus);
+
+// Names the calling thread for top -H, ps and debuggers; Linux keeps the
+// first 15 characters
+void SetCurrentThreadName(const std::string& name);
+
+} // namespace http
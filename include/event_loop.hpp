@@ -3,26 +3,90 @@
 #include <functional>
 #include <memory>
 #include <vector>
+#include <deque>
+#include <string>
+#include <atomic>
 #include <unordered_map>
-#include <sys/event.h>
+#include <chrono>
+#include <thread>
+#include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include "timer_wheel.hpp"
+#include "mpsc_queue.hpp"
+#include "file_body.hpp"
+#include "connection.hpp"
 
 namespace http {
 
+class Poller;
+struct PollEvent;
+
 enum class EventType {
     Read,
     Write,
     Error
 };
 
+// Level-triggered fires while the fd stays ready; edge-triggered fires once
+// per readiness change and the callback must drain the fd (read/accept until
+// EAGAIN). One-shot fires once and then leaves the fd registered but
+// disarmed until Rearm(); unregistering a fired one-shot fd needs no
+// syscall. The mode applies to every registration on the fd.
+enum class TriggerMode {
+    Level,
+    Edge,
+    OneShot
+};
+
+// Kernel interface behind the loop. Default is the readiness backend picked
+// by CMake; IoUring falls back to it at runtime when io_uring is unavailable.
+enum class EventBackend {
+    Default,
+    Kqueue,
+    Epoll,
+    IoUring
+};
+
+// Accepts "auto", "kqueue", "epoll" and "io_uring"
+EventBackend ParseEventBackend(const std::string& name);
+
 using EventCallback = std::function<void(int fd, EventType type)>;
+// peer is the address the connection came from (unknown if it could not
+// be read)
+using AcceptCallback = std::function<void(int client_fd, const PeerAddress& peer)>;
+// size > 0: data received, 0: peer closed, < 0: -errno. Nothing more is
+// received after 0 or an error.
+using ReceiveCallback = std::function<void(int fd, const char* data, ssize_t size)>;
+// result: bytes sent, or -errno
+using SendCallback = std::function<void(int fd, ssize_t result)>;
+using Task = std::function<void()>;
+
+// Snapshot of an event loop's counters; safe to read from any thread
+struct EventLoopStats {
+    uint64_t iterations = 0;
+    uint64_t events = 0;            // Readiness and completion events dispatched
+    uint64_t spin_polls = 0;        // Waits that spun before blocking (busy-poll mode)
+    uint64_t spin_hits = 0;         // ... and found events while spinning
+    uint64_t blocking_waits = 0;
+    uint64_t spin_ns = 0;
+    uint64_t blocked_ns = 0;
+    size_t batch_size = 0;          // Current events-per-wait capacity
+
+    double SpinHitRatio() const {
+        return spin_polls ? static_cast<double>(spin_hits) / static_cast<double>(spin_polls) : 0.0;
+    }
+};
 
 class EventLoop {
 public:
-    EventLoop();
+    explicit EventLoop(EventBackend backend = EventBackend::Default);
+    // Drives the given backend instead of creating one (tests use this to
+    // script what the kernel reports)
+    explicit EventLoop(std::unique_ptr<Poller> poller);
     ~EventLoop();
 
     // Non-copyable, movable
@@ -32,9 +96,62 @@ public:
     EventLoop& operator=(EventLoop&&) noexcept;
 
     // Register file descriptor for events
-    void RegisterRead(int fd, EventCallback callback);
-    void RegisterWrite(int fd, EventCallback callback);
+    void RegisterRead(int fd, EventCallback callback, TriggerMode mode = TriggerMode::Level);
+    void RegisterWrite(int fd, EventCallback callback, TriggerMode mode = TriggerMode::Level);
     void Unregister(int fd);
+    // Re-enable a fired one-shot registration with the same callbacks;
+    // does nothing if fd is not a disarmed one-shot registration
+    void Rearm(int fd);
+
+    // Completion-style I/O. On io_uring these are multishot accept,
+    // multishot recv into provided buffers and linked send chains; the
+    // readiness backends emulate them with accept/read/write on readiness.
+    // An fd uses either these or RegisterRead/RegisterWrite, not both.
+    // Unregister cancels them and must be called before closing the fd.
+    void Accept(int listen_fd, AcceptCallback callback);
+    void Receive(int fd, ReceiveCallback callback);
+    void Send(int fd, std::string data, SendCallback callback = nullptr);
+    // Gather form: head and body leave in one writev/sendmsg (or one linked
+    // io_uring chain) without being joined, and the callback gets their
+    // combined size. Pass more when another Send is about to follow (e.g. a
+    // pipelined response): the tail then goes out with MSG_MORE so partial
+    // segments are coalesced with it instead of being pushed on their own.
+    void Send(int fd, std::string head, std::string body, SendCallback callback, bool more = false);
+    // Gather form with a body shared with others (e.g. a cached static
+    // asset), held until the send completes instead of being copied
+    void Send(int fd, std::string head, std::shared_ptr<const std::string> body, SendCallback callback,
+              bool more = false);
+    // Like the gather form with a file range as the body, streamed with
+    // sendfile (no user-space copy) once head is out. The loop holds file
+    // until the send completes or fails.
+    void SendFile(int fd, std::string head, std::shared_ptr<FileBody> file, SendCallback callback,
+                  bool more = false);
+
+    // Output backpressure: once an fd has this many bytes queued but not yet
+    // accepted by the kernel, further Sends fail with -ENOBUFS instead of
+    // growing the queue (a single write larger than the mark is still taken
+    // when the queue is below it). Zero (the default) means unlimited.
+    void SetSendHighWaterMark(size_t bytes) { send_high_water_mark_ = bytes; }
+    size_t SendHighWaterMark() const { return send_high_water_mark_; }
+    // Bytes queued on fd that the kernel has not yet accepted
+    size_t PendingSendBytes(int fd) const;
+
+    // Timers fire on the loop thread, at millisecond resolution, and bound
+    // the poll timeout. Like the registrations above they must be managed
+    // from the loop thread (or before Run()); use RunInLoop from elsewhere.
+    TimerId RunAfter(std::chrono::milliseconds delay, TimerCallback callback);
+    TimerId RunEvery(std::chrono::milliseconds interval, TimerCallback callback);
+    bool CancelTimer(TimerId id);
+    size_t TimerCount() const { return timers_.Size(); }
+
+    // Cross-thread hand-off: Post queues the task on a lock-free inbox and
+    // wakes the loop, which runs tasks in FIFO order after dispatching the
+    // current batch of events. RunInLoop runs the task inline when already
+    // on the loop thread. Tasks still queued when the loop is destroyed are
+    // dropped without running.
+    void Post(Task task);
+    void RunInLoop(Task task);
+    bool IsInLoopThread() const;
 
     // Run the event loop
     void Run();
@@ -42,12 +159,136 @@ public:
 
     bool IsRunning() const { return running_; }
 
+    // Busy-poll mode: before blocking, spin on non-blocking waits for up to
+    // spin (bounded by the next timer), trading a core for wakeup latency.
+    // Accepted sockets also get SO_BUSY_POLL / SO_PREFER_BUSY_POLL where the
+    // platform has them. Zero (the default) disables it. Call before Run().
+    void SetBusyPoll(std::chrono::microseconds spin);
+    std::chrono::microseconds BusyPoll() const { return busy_poll_; }
+
+    EventLoopStats Stats() const;
+
+    // Name of the active backend ("kqueue", "epoll" or "io_uring")
+    const char* BackendName() const;
+    bool UsesCompletionIo() const;
+
 private:
+    // Events per wait adapt between these: a full batch doubles it, and a
+    // run of mostly empty batches halves it
+    static constexpr size_t kInitialBatch = 64;
+    static constexpr size_t kMinBatch = 16;
+    static constexpr size_t kMaxBatch = 1024;
+    static constexpr uint32_t kShrinkAfter = 64;
+    // Tasks run per iteration, so a task that keeps posting cannot starve I/O
+    static constexpr size_t kMaxTasksPerIteration = 1024;
+    static constexpr size_t kReceiveBufferSize = 64 * 1024;
+    static constexpr int kMaxSendChain = 16;
+
+    struct PendingSend {
+        std::string head;
+        std::string body;
+        std::shared_ptr<FileBody> file;   // Sent after head (body is then empty)
+        size_t offset;                    // Into head, then body, then file
+        SendCallback callback;
+        bool more;
+        std::shared_ptr<const std::string> shared_body;   // Used instead of body when set
+
+        const std::string& Body() const { return shared_body ? *shared_body : body; }
+        size_t MemorySize() const { return head.size() + Body().size(); }
+        size_t Size() const { return MemorySize() + (file ? file->Length() : 0); }
+        // Memory parts are out; the rest goes with sendfile
+        bool AtFile() const { return file && offset >= MemorySize(); }
+    };
+
+    struct SendQueue {
+        std::deque<PendingSend> pending;
+        size_t in_flight = 0;   // Chunks submitted to the kernel (io_uring)
+        size_t queued_bytes = 0;
+        bool failed = false;
+    };
+
+    // Everything the loop knows about one registered fd. The readiness
+    // backends carry the record pointer as kernel udata, so dispatch is a
+    // dereference rather than a lookup. Unregister retires the record until
+    // the current batch is dispatched (a callback may be unregistering
+    // itself, and the kernel may still report the old registration), and
+    // until the poller holds no undelivered events naming it; then it is
+    // recycled, so registering a new connection does not allocate.
+    struct FdRecord {
+        int fd = -1;
+        uint32_t interest = 0;      // kPoll* bits registered with the poller
+        uint32_t rearm = 0;         // Interest to restore after a one-shot fires
+        EventCallback read;
+        EventCallback write;
+
+        // Completion-style operations; tag is 0 while none are registered
+        uint32_t tag = 0;
+        AcceptCallback accept;
+        ReceiveCallback receive;
+        std::unique_ptr<SendQueue> sends;
+    };
+
+    // Written by the loop thread only; relaxed atomics so Stats() can read
+    struct Counters {
+        std::atomic<uint64_t> iterations{0};
+        std::atomic<uint64_t> events{0};
+        std::atomic<uint64_t> spin_polls{0};
+        std::atomic<uint64_t> spin_hits{0};
+        std::atomic<uint64_t> blocking_waits{0};
+        std::atomic<uint64_t> spin_ns{0};
+        std::atomic<uint64_t> blocked_ns{0};
+        std::atomic<size_t> batch_size{0};
+    };
+
     void ProcessEvents();
-    int kqueue_fd_;
-    bool running_;
-    std::unordered_map<int, EventCallback> read_callbacks_;
-    std::unordered_map<int, EventCallback> write_callbacks_;
+    int WaitForEvents(int timeout_ms);
+    void AdaptBatchSize(int num_events);
+    void ConfigureAccepted(int client_fd);
+    void RunPendingTasks();
+    uint64_t NowMs() const;
+    FdRecord* Find(int fd) const;
+    FdRecord& RecordFor(int fd);
+    void UpdateInterest(FdRecord& record, uint32_t interest);
+    FdRecord& OpsFor(int fd);
+
+    void DispatchCompletion(const PollEvent& event);
+    void OnSendCompleted(int fd, uint32_t tag, ssize_t result);
+    void Enqueue(int fd, PendingSend send);
+    // Fills up to kMaxSendChain chunks with the unsent parts of the queue,
+    // stopping at a file body; more is set when anything is known to follow
+    // the last chunk
+    static int GatherSends(const SendQueue& queue, struct iovec* chunks, bool& more);
+    void SubmitSends(int fd, FdRecord& record);
+    void FlushSends(int fd);
+    void StopWatchingWritable(FdRecord& record);
+    void FailSends(int fd, SendQueue& queue, ssize_t error);
+    void AcceptReady(int listen_fd);
+    void ReceiveReady(int fd);
+
+    std::unique_ptr<Poller> poller_;
+    std::atomic<bool> running_;
+    std::vector<PollEvent> events_;
+    // Indexed by fd (null when unregistered); grows to the highest fd seen
+    std::vector<std::unique_ptr<FdRecord>> records_;
+    std::vector<std::unique_ptr<FdRecord>> retired_records_;
+    std::vector<std::unique_ptr<FdRecord>> free_records_;
+    // Callbacks dropped from a live record, e.g. the write handler once the
+    // send queue drains; released with the retired records
+    std::vector<EventCallback> retired_callbacks_;
+    // Send chains still owned by the kernel after their fd was unregistered
+    std::unordered_map<uint64_t, std::unique_ptr<SendQueue>> retired_sends_;
+    std::vector<char> receive_buffer_;
+    uint32_t next_tag_;
+    std::chrono::steady_clock::time_point epoch_;
+    TimerWheel timers_;
+    std::unique_ptr<MpscQueue<Task>> inbox_;
+    // Set by the producer that owes the loop a wakeup; cleared before draining
+    std::atomic<bool> wake_pending_;
+    std::atomic<std::thread::id> loop_thread_;
+    std::chrono::microseconds busy_poll_;
+    size_t send_high_water_mark_;
+    uint32_t sparse_batches_;
+    std::unique_ptr<Counters> counters_;
 };
 
 } // namespace http
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <sys/types.h>
+
+namespace http {
+
+// A read-only range of an open file, used as a response body that the event
+// loop streams with sendfile instead of reading into memory. Closes the fd
+// when the last reference goes away.
+class FileBody {
+public:
+    // Opens the whole regular file at path; throws std::runtime_error
+    static std::shared_ptr<FileBody> Open(const std::string& path);
+
+    ~FileBody();
+
+    // Non-copyable, non-movable (shared by reference)
+    FileBody(const FileBody&) = delete;
+    FileBody& operator=(const FileBody&) = delete;
+
+    int Fd() const { return fd_; }
+    off_t Offset() const { return offset_; }
+    size_t Length() const { return length_; }
+
+    // Copies the range into memory, for callers that need the bytes
+    std::string ReadAll() const;
+
+private:
+    FileBody(int fd, off_t offset, size_t length);
+
+    int fd_;
+    off_t offset_;
+    size_t length_;
+};
+
+} // namespace http
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace http {
+
+// Header field as HPACK carries it: lowercase name (pseudo-headers such as
+// ":path" included) and value
+using HeaderField = std::pair<std::string, std::string>;
+using HeaderList = std::vector<HeaderField>;
+
+// HPACK (RFC 7541) dynamic table. Newest entry first; each entry costs its
+// name and value plus 32 bytes, and the oldest are evicted to stay within
+// the maximum size.
+class HpackTable {
+public:
+    explicit HpackTable(size_t max_size = 4096);
+
+    void Insert(std::string name, std::string value);
+    void SetMaxSize(size_t max_size);
+
+    size_t MaxSize() const { return max_size_; }
+    size_t Size() const { return size_; }
+    size_t Count() const { return entries_.size(); }
+    // 0 is the newest entry
+    const HeaderField& At(size_t index) const { return entries_[index]; }
+
+private:
+    void EvictTo(size_t limit);
+
+    std::deque<HeaderField> entries_;
+    size_t size_ = 0;
+    size_t max_size_;
+};
+
+// The static Huffman code of RFC 7541 Appendix B (a canonical code, so it is
+// rebuilt from the code lengths alone)
+class HpackHuffman {
+public:
+    static size_t EncodedLength(const std::string& input);
+    static void Encode(const std::string& input, std::string& out);
+    // Throws std::invalid_argument on an invalid code, EOS or bad padding
+    static std::string Decode(const char* data, size_t size);
+};
+
+// Decodes header blocks from one peer. Decoding updates the dynamic table,
+// so every block on the connection must pass through in order.
+class HpackDecoder {
+public:
+    // max_table_size: the SETTINGS_HEADER_TABLE_SIZE we advertised;
+    // max_header_list_size: the SETTINGS_MAX_HEADER_LIST_SIZE, counted as
+    // name and value plus 32 bytes per field
+    explicit HpackDecoder(size_t max_table_size = 4096,
+                          size_t max_header_list_size = std::numeric_limits<size_t>::max());
+
+    // One complete header block; throws std::invalid_argument when it is
+    // malformed or decodes to more than max_header_list_size (a few bytes
+    // of indexed references can name kilobytes each). The table is out of
+    // sync after that: a connection error.
+    HeaderList Decode(const char* data, size_t size);
+    HeaderList Decode(const std::string& block) { return Decode(block.data(), block.size()); }
+
+    const HpackTable& Table() const { return table_; }
+
+private:
+    const HeaderField& Lookup(uint64_t index) const;
+
+    size_t max_table_size_;
+    size_t max_header_list_size_;
+    HpackTable table_;
+};
+
+// Encodes header blocks for one peer. Fields seen before are sent as a
+// one- or two-byte table index; values that change on every message
+// (content-length, date, etag...) are sent literally without being indexed,
+// so they do not churn the table.
+class HpackEncoder {
+public:
+    explicit HpackEncoder(size_t max_table_size = 4096);
+
+    // The peer's SETTINGS_HEADER_TABLE_SIZE; the table never grows past
+    // the size it started with, and a change is signalled in the next block
+    void SetMaxTableSize(size_t max_size);
+
+    // Appends the block for headers (names already lowercase) to out
+    void Encode(const HeaderList& headers, std::string& out);
+
+    const HpackTable& Table() const { return table_; }
+
+    // Integer with an N-bit prefix; first holds the bits above the prefix
+    static void EncodeInteger(uint64_t value, int prefix_bits, uint8_t first, std::string& out);
+
+private:
+    void EncodeString(const std::string& value, std::string& out) const;
+
+    size_t limit_;
+    HpackTable table_;
+    bool size_update_pending_ = false;
+    size_t smallest_update_ = 0;
+};
+
+} // namespace http
@@ -0,0 +1,186 @@
+#pragma once
+
+#include "hpack.hpp"
+#include "http_parser.hpp"
+#include "http_response.hpp"
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace http {
+
+// RFC 9113 error codes, sent in RST_STREAM and GOAWAY
+enum class Http2Error : uint32_t {
+    NO_ERROR = 0x0,
+    PROTOCOL_ERROR = 0x1,
+    INTERNAL_ERROR = 0x2,
+    FLOW_CONTROL_ERROR = 0x3,
+    STREAM_CLOSED = 0x5,
+    FRAME_SIZE_ERROR = 0x6,
+    REFUSED_STREAM = 0x7,
+    CANCEL = 0x8,
+    COMPRESSION_ERROR = 0x9,
+    ENHANCE_YOUR_CALM = 0xb
+};
+
+// What the server advertises in its SETTINGS frame, and the limits it
+// enforces without advertising them
+struct Http2Settings {
+    uint32_t header_table_size = 4096;
+    uint32_t max_concurrent_streams = 100;
+    uint32_t initial_window_size = 65535;
+    uint32_t max_frame_size = 16384;
+    uint32_t max_header_list_size = 65536;  // Decoded request headers, name + value + 32 per field
+    uint32_t max_resets = 1000;     // RST_STREAMs a connection may send before GOAWAY(ENHANCE_YOUR_CALM)
+    uint32_t max_output = 1 << 20;  // Unwritten output bytes before GOAWAY(ENHANCE_YOUR_CALM)
+};
+
+// A request that arrived whole (headers and body) on a stream
+struct Http2Request {
+    uint32_t stream_id;
+    HttpRequest request;
+};
+
+// Server side of one HTTP/2 cleartext (h2c) connection, without the socket:
+// the caller feeds it the bytes it reads, gets back the requests that have
+// completed, hands it each stream's response and writes out whatever it
+// produces. Streams are multiplexed onto one connection, header blocks are
+// HPACK-compressed, and response bodies go out as DATA frames within the
+// peer's connection and per-stream flow-control windows, taking turns
+// between streams. Not thread-safe: one event loop thread drives it.
+class Http2Session {
+public:
+    // "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n", sent first by every client
+    static const std::string kPreface;
+
+    Http2Session(const Http2Settings& settings, size_t max_request_size);
+
+    // Whether data starts with the client preface, or with as much of it as
+    // has arrived so far
+    static bool MayBePreface(const std::string& data);
+    // HTTP/1.1 request asking to switch: "Upgrade: h2c" and HTTP2-Settings
+    static bool IsUpgradeRequest(const HttpRequest& request);
+
+    // Connection opened with the preface ("prior knowledge"): queues the
+    // server preface
+    void Start();
+    // Connection switching from HTTP/1.1 with request: applies its
+    // HTTP2-Settings and queues the server preface (to go out after the 101
+    // response). The request itself becomes stream 1, whose response is
+    // passed to Respond like any other. Throws std::invalid_argument when
+    // HTTP2-Settings is malformed (the request is then served as HTTP/1.1).
+    void StartUpgrade(const HttpRequest& request);
+
+    // Consumes the whole frames at the front of input and returns the
+    // requests they completed. A protocol violation queues GOAWAY and makes
+    // the session Finished once that is written. So does a peer that keeps
+    // sending frames that need an answer (PING, SETTINGS) while not reading
+    // them: past max_output unwritten bytes, the backlog is dropped for
+    // GOAWAY(ENHANCE_YOUR_CALM) (CVE-2019-9512, CVE-2019-9515).
+    std::vector<Http2Request> Receive(std::string& input);
+
+    // Response for a stream Receive returned; dropped if the peer has reset
+    // the stream since. Every stream Receive returns must get one: until
+    // then it counts against max_concurrent_streams, reset or not, so
+    // resetting streams cannot start more work than the limit allows. A
+    // file body is read into memory here.
+    void Respond(uint32_t stream_id, HttpResponse response);
+
+    // Frames to write next: all pending control and HEADERS frames, then
+    // DATA frames (as far as flow control allows) until about budget bytes
+    std::string TakeOutput(size_t budget);
+
+    // Streams whose response has not been fully sent
+    size_t ActiveStreams() const { return streams_.size(); }
+    // GOAWAY has been sent or received and nothing is left to write
+    bool Finished() const;
+
+    // Queue GOAWAY: streams already started are finished, new ones refused
+    void Shutdown(Http2Error error = Http2Error::NO_ERROR, const std::string& reason = "");
+
+    // Bytes of header blocks sent, for comparing against HTTP/1.1
+    uint64_t HeaderBytesSent() const { return header_bytes_sent_; }
+
+private:
+    // Connection error: GOAWAY with code
+    struct ConnectionError : std::runtime_error {
+        ConnectionError(Http2Error error, const std::string& reason)
+            : std::runtime_error(reason), code(error) {}
+        Http2Error code;
+    };
+
+    struct Stream {
+        HttpRequest request;
+        bool remote_closed = false;     // END_STREAM received
+        bool dispatched = false;        // Returned by Receive: awaiting Respond
+        bool responded = false;         // HEADERS queued
+        int64_t send_window = 0;
+        uint32_t recv_unacked = 0;      // DATA received since our last WINDOW_UPDATE
+        std::shared_ptr<const std::string> body;
+        size_t body_sent = 0;
+        bool reset_after_body = false;  // Answered early: RST_STREAM(NO_ERROR) follows
+    };
+
+    void ProcessFrame(uint8_t type, uint8_t flags, uint32_t stream_id, const char* payload, size_t length,
+                      std::vector<Http2Request>& completed);
+    void OnData(uint8_t flags, uint32_t stream_id, const char* payload, size_t length,
+                std::vector<Http2Request>& completed);
+    void OnHeaders(uint8_t flags, uint32_t stream_id, const char* payload, size_t length,
+                   std::vector<Http2Request>& completed);
+    void OnHeaderBlock(uint32_t stream_id, bool end_stream, std::vector<Http2Request>& completed);
+    void OnSettings(uint8_t flags, const char* payload, size_t length);
+    void ApplySettings(const char* payload, size_t length);
+    void OnWindowUpdate(uint32_t stream_id, const char* payload, size_t length);
+    void CompleteRequest(uint32_t stream_id, Stream& stream, std::vector<Http2Request>& completed);
+    void RespondEarly(uint32_t stream_id, HttpResponse response);
+    void ResetStream(uint32_t stream_id, Http2Error error);
+    // Forget a stream; one still awaiting Respond is remembered as abandoned
+    void CloseStream(std::unordered_map<uint32_t, Stream>::iterator it);
+    void Fail(Http2Error error, const std::string& reason);
+
+    void QueueFrame(uint8_t type, uint8_t flags, uint32_t stream_id, const char* payload, size_t length);
+    void QueueWindowUpdate(uint32_t stream_id, uint32_t increment);
+    void QueueSettings();
+    // One DATA frame for each stream with body left, in turn, until budget
+    // or the windows run out
+    void WriteData(std::string& out, size_t budget);
+
+    Http2Settings settings_;
+    size_t max_request_size_;
+    HpackDecoder decoder_;
+    HpackEncoder encoder_;
+
+    std::string output_;
+    std::unordered_map<uint32_t, Stream> streams_;
+    std::deque<uint32_t> sending_;          // Streams with body left, in turn order
+    std::unordered_set<uint32_t> abandoned_; // Closed while awaiting Respond; still count as open
+    uint32_t last_stream_id_ = 0;           // Highest stream the peer opened
+    uint32_t resets_received_ = 0;
+
+    bool preface_received_ = false;
+    bool settings_received_ = false;
+    bool settings_acked_ = false;       // Until then the peer may use the default stream window
+    bool going_away_ = false;           // GOAWAY sent or received: no new streams
+    bool goaway_sent_ = false;
+    bool failed_ = false;
+
+    // Header block spread over HEADERS and CONTINUATION frames
+    uint32_t continuation_stream_ = 0;
+    bool continuation_end_stream_ = false;
+    std::string header_block_;
+
+    // The peer's settings and our view of its windows
+    int64_t peer_initial_window_ = 65535;
+    size_t peer_max_frame_size_ = 16384;
+    int64_t connection_send_window_ = 65535;
+    uint32_t connection_recv_unacked_ = 0;
+
+    uint64_t header_bytes_sent_ = 0;
+};
+
+} // namespace http
@@ -6,6 +6,7 @@
 #include <sstream>
 #include <algorithm>
 #include <cctype>
+#include <stdexcept>
 
 namespace http {
 
@@ -34,6 +35,14 @@ struct HttpRequest {
     }
 };
 
+// A request whose end cannot be found safely: answer status (400 or 501)
+// and close the connection, since where the next request starts is unknown
+struct RequestFramingError : std::invalid_argument {
+    RequestFramingError(int status_code, const std::string& reason)
+        : std::invalid_argument(reason), status(status_code) {}
+    int status;
+};
+
 class HttpParser {
 public:
     static HttpRequest Parse(const std::string& raw_request);
@@ -41,6 +50,24 @@ public:
     static std::string MethodToString(HttpMethod method);
     static void ParseQueryParams(const std::string& query_string, HttpRequest& request);
 
+    // Length of the first complete request in data (headers plus any
+    // Content-Length body), or 0 if more bytes are needed. Throws
+    // RequestFramingError with 400 for a malformed Content-Length or
+    // repeats that disagree, and for any Transfer-Encoding, which is not
+    // supported: 501, or 400 alongside Content-Length (a smuggling attempt).
+    static size_t FindRequestEnd(const std::string& data);
+
+    // Method and path (query string stripped) from the request line at the
+    // start of data, without parsing the rest; false if the line is
+    // incomplete or malformed. Lets the event loop route a request before
+    // deciding where to run it.
+    static bool PeekRequestLine(const std::string& data, HttpMethod& method, std::string& path);
+
+    // Whether the client wants the connection kept open after this request:
+    // HTTP/1.1 unless it sent "Connection: close", HTTP/1.0 only with
+    // "Connection: keep-alive"
+    static bool KeepAlive(const HttpRequest& request);
+
 private:
     static std::string Trim(const std::string& str);
     static std::string ToLower(const std::string& str);
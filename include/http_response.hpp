@@ -6,6 +6,8 @@
 #include <sstream>
 #include <fstream>
 #include <filesystem>
+#include <memory>
+#include "file_body.hpp"
 
 namespace http {
 
@@ -14,11 +16,13 @@ enum class HttpStatus {
     CREATED = 201,
     NO_CONTENT = 204,
     SWITCHING_PROTOCOLS = 101,
+    NOT_MODIFIED = 304,
     BAD_REQUEST = 400,
     UNAUTHORIZED = 401,
     FORBIDDEN = 403,
     NOT_FOUND = 404,
     METHOD_NOT_ALLOWED = 405,
+    PAYLOAD_TOO_LARGE = 413,
     INTERNAL_SERVER_ERROR = 500,
     NOT_IMPLEMENTED = 501,
     SERVICE_UNAVAILABLE = 503
@@ -42,17 +46,61 @@ public:
     HttpResponse& SetBody(const std::string& body);
     HttpResponse& SetBody(const std::vector<char>& body);
 
+    // Body shared with other responses and never modified (e.g. a page
+    // built once at startup), so it is sent without copying and its
+    // compressed forms can be cached
+    HttpResponse& SetSharedBody(std::shared_ptr<const std::string> body);
+
+    // Replaces the body with an encoded form of it ("gzip", "deflate"),
+    // updating Content-Length and Content-Encoding. Rendered headers become
+    // ordinary ones, and an ETag becomes weak: the bytes differ from the
+    // resource's, though it is the same resource.
+    HttpResponse& SetEncodedBody(std::shared_ptr<const std::string> body, const std::string& coding);
+
     // JSON response
     HttpResponse& Json(const std::string& json);
 
-    // Static file response
+    // File body: sent straight from the open file (sendfile) rather than
+    // held in memory; GetBody() stays empty
+    HttpResponse& SetFileBody(std::shared_ptr<FileBody> file);
+    const std::shared_ptr<FileBody>& GetFileBody() const { return file_body_; }
+
+    // Response that shares its status line and headers (rendered ahead of
+    // time, through Content-Length but without Connection or the blank line)
+    // and its body with others, e.g. a cached static asset. Headers set
+    // afterwards are appended to the rendered ones.
+    static HttpResponse Rendered(HttpStatus status, std::shared_ptr<const std::string> headers,
+                                 std::shared_ptr<const std::string> body);
+    bool IsRendered() const { return rendered_headers_ != nullptr; }
+    const std::shared_ptr<const std::string>& GetSharedBody() const { return shared_body_; }
+
+    // Static file response (with a file body)
     static HttpResponse FromFile(const std::string& file_path);
 
+    // MIME type for a file name, by extension (application/octet-stream
+    // when unknown)
+    static const std::string& ContentTypeFor(const std::string& file_path);
+
     // Build HTTP response string
     std::string ToString() const;
 
+    // Status line and headers through the blank line, for sending the body
+    // as a separate segment
+    std::string SerializeHeaders() const;
+    // Moves the body out (headers, including Content-Length, are kept); a
+    // shared body stays in GetSharedBody()
+    std::string ReleaseBody() { return std::move(body_); }
+
+    // Header fields, rendered ones included, for framings other than
+    // HTTP/1.1 (HTTP/2 sends them HPACK-encoded)
+    std::vector<std::pair<std::string, std::string>> HeaderFields() const;
+
+    // Header value by case-insensitive name, rendered ones included ("" when
+    // absent)
+    std::string GetHeader(const std::string& name) const;
+
     HttpStatus GetStatus() const { return status_; }
-    const std::string& GetBody() const { return body_; }
+    const std::string& GetBody() const { return shared_body_ ? *shared_body_ : body_; }
 
 private:
     std::string StatusToString(HttpStatus status) const;
@@ -61,6 +109,9 @@ private:
     HttpStatus status_;
     std::unordered_map<std::string, std::string> headers_;
     std::string body_;
+    std::shared_ptr<FileBody> file_body_;
+    std::shared_ptr<const std::string> rendered_headers_;
+    std::shared_ptr<const std::string> shared_body_;
 };
 
 // Helper functions for common responses
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace http {
+
+// Move-only void() callable, like a std::function that need not be
+// copyable, with kCapacity bytes of inline storage: a callable that fits
+// (and moves without throwing) is stored in place, so wrapping it
+// allocates nothing. Larger ones go to the heap. A moved-from task is
+// empty.
+class InlineTask {
+public:
+    static constexpr size_t kCapacity = 256;
+
+    InlineTask() = default;
+
+    template <typename F, typename = std::enable_if_t<!std::is_same<std::decay_t<F>, InlineTask>::value>>
+    InlineTask(F&& f) {
+        using Callable = std::decay_t<F>;
+        static_assert(std::is_invocable<Callable&>::value, "InlineTask holds callables taking no arguments");
+        if constexpr (FitsInline<Callable>()) {
+            new (storage_) Callable(std::forward<F>(f));
+            ops_ = &kInlineOps<Callable>;
+        } else {
+            *reinterpret_cast<Callable**>(storage_) = new Callable(std::forward<F>(f));
+            ops_ = &kHeapOps<Callable>;
+        }
+    }
+
+    InlineTask(InlineTask&& other) noexcept { MoveFrom(other); }
+
+    InlineTask& operator=(InlineTask&& other) noexcept {
+        if (this != &other) {
+            Reset();
+            MoveFrom(other);
+        }
+        return *this;
+    }
+
+    ~InlineTask() { Reset(); }
+
+    InlineTask(const InlineTask&) = delete;
+    InlineTask& operator=(const InlineTask&) = delete;
+
+    // Must not be empty
+    void operator()() { ops_->invoke(storage_); }
+
+    explicit operator bool() const { return ops_ != nullptr; }
+    bool StoredInline() const { return ops_ != nullptr && ops_->inline_storage; }
+
+    void Reset() {
+        if (ops_) {
+            ops_->destroy(storage_);
+            ops_ = nullptr;
+        }
+    }
+
+private:
+    struct Ops {
+        void (*invoke)(void* storage);
+        void (*move)(void* from, void* to);     // Leaves from destroyed
+        void (*destroy)(void* storage);
+        bool inline_storage;
+    };
+
+    template <typename Callable>
+    static constexpr bool FitsInline() {
+        return sizeof(Callable) <= kCapacity && alignof(Callable) <= alignof(std::max_align_t) &&
+               std::is_nothrow_move_constructible<Callable>::value;
+    }
+
+    template <typename Callable>
+    static constexpr Ops kInlineOps = {
+        [](void* storage) { (*static_cast<Callable*>(storage))(); },
+        [](void* from, void* to) {
+            Callable* source = static_cast<Callable*>(from);
+            new (to) Callable(std::move(*source));
+            source->~Callable();
+        },
+        [](void* storage) { static_cast<Callable*>(storage)->~Callable(); },
+        true,
+    };
+
+    template <typename Callable>
+    static constexpr Ops kHeapOps = {
+        [](void* storage) { (**static_cast<Callable**>(storage))(); },
+        [](void* from, void* to) { *static_cast<Callable**>(to) = *static_cast<Callable**>(from); },
+        [](void* storage) { delete *static_cast<Callable**>(storage); },
+        false,
+    };
+
+    void MoveFrom(InlineTask& other) noexcept {
+        if (other.ops_) {
+            other.ops_->move(other.storage_, storage_);
+            ops_ = other.ops_;
+            other.ops_ = nullptr;
+        }
+    }
+
+    alignas(std::max_align_t) unsigned char storage_[kCapacity];
+    const Ops* ops_ = nullptr;
+};
+
+} // namespace http
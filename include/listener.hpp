@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace http {
+
+// One address to accept connections on: "0.0.0.0:8080", "[::]:8080" or
+// "unix:/run/monitord.sock" (local agents and sidecars skip TCP entirely).
+struct ListenEndpoint {
+    enum class Family { IPv4, IPv6, Unix };
+
+    Family family = Family::IPv4;
+    std::string address;    // Numeric host, or the socket path
+    uint16_t port = 0;      // 0 binds an ephemeral port (TCP only)
+
+    // Throws std::invalid_argument on a malformed endpoint
+    static ListenEndpoint Parse(const std::string& spec);
+    // host:port, as Config carries them (IPv6 when host has a colon)
+    static ListenEndpoint FromHostPort(const std::string& host, uint16_t port);
+
+    bool IsTcp() const { return family != Family::Unix; }
+    std::string ToString() const;
+};
+
+// Comma-separated endpoints; throws std::invalid_argument
+std::vector<ListenEndpoint> ParseListenEndpoints(const std::string& list);
+
+struct ListenOptions {
+    int backlog = 1024;
+    bool reuse_port = false;            // SO_REUSEPORT (SO_REUSEPORT_LB on FreeBSD)
+    bool tcp_nodelay = true;            // Inherited by accepted sockets
+    int defer_accept_seconds = 0;       // TCP_DEFER_ACCEPT: wake only once data arrives (Linux)
+    int fastopen_queue = 0;             // TCP_FASTOPEN pending-request queue (0 = off)
+};
+
+// Bound, listening, non-blocking, close-on-exec socket for endpoint. A
+// stale Unix socket file at the path is replaced. TCP options the platform
+// lacks are skipped. Throws std::runtime_error.
+int OpenListener(const ListenEndpoint& endpoint, const ListenOptions& options);
+
+// Port a TCP listener is bound to (resolves port 0), or 0
+uint16_t LocalPort(int fd);
+
+} // namespace http
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace http {
+
+// CoDel-style overload detector for the worker queue. Workers report how
+// long each task waited; once every task dequeued for a whole interval has
+// waited longer than target (a standing queue rather than a burst that
+// drains), the detector reports overload until a task waits less than
+// target again or the queue runs empty. Report must be called by one
+// thread at a time (ThreadPool calls it under its queue lock); Overloaded
+// may be read from any thread.
+class LoadShedder {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // A zero target disables shedding
+    LoadShedder(std::chrono::milliseconds target, std::chrono::milliseconds interval);
+
+    void Report(std::chrono::nanoseconds wait, bool queue_empty, Clock::time_point now = Clock::now());
+
+    bool Overloaded() const { return overloaded_.load(std::memory_order_relaxed); }
+
+    // Wait of the most recently dequeued task
+    std::chrono::microseconds LastWait() const {
+        return std::chrono::microseconds(last_wait_us_.load(std::memory_order_relaxed));
+    }
+
+private:
+    std::chrono::nanoseconds target_;
+    std::chrono::nanoseconds interval_;
+    Clock::time_point first_above_{};   // End of the grace interval; unset while below target
+    std::atomic<bool> overloaded_{false};
+    std::atomic<int64_t> last_wait_us_{0};
+};
+
+} // namespace http
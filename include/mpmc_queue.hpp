@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace http {
+
+// Bounded multi-producer multi-consumer ring (Vyukov's array queue). Each
+// cell carries a sequence number that tells producers and consumers whose
+// turn it is, so TryPush and TryPop need one compare-and-swap each and no
+// lock; nothing is allocated after construction. Cells and the two
+// positions sit on cache lines of their own. T must be default
+// constructible and move assignable.
+template <typename T>
+class BoundedMpmcQueue {
+public:
+    // capacity is rounded up to a power of two (at least 2)
+    explicit BoundedMpmcQueue(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        mask_ = size - 1;
+        cells_.reset(new Cell[size]);
+        for (size_t i = 0; i < size; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // Non-copyable, non-movable (producers and consumers hold references)
+    BoundedMpmcQueue(const BoundedMpmcQueue&) = delete;
+    BoundedMpmcQueue& operator=(const BoundedMpmcQueue&) = delete;
+
+    // Returns false, leaving value untouched, when the ring is full
+    bool TryPush(T&& value) {
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells_[pos & mask_];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Returns false when empty, or when the next element's producer is
+    // midway through TryPush; it becomes visible once that returns
+    bool TryPop(T& out) {
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells_[pos & mask_];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        out = std::move(cell->value);
+        cell->value = T();      // Release what the moved-from value may still hold
+        cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate when other threads are active
+    size_t Size() const {
+        size_t enqueued = enqueue_pos_.load(std::memory_order_relaxed);
+        size_t dequeued = dequeue_pos_.load(std::memory_order_relaxed);
+        return enqueued > dequeued ? enqueued - dequeued : 0;
+    }
+
+    size_t Capacity() const { return mask_ + 1; }
+
+private:
+    struct alignas(64) Cell {
+        std::atomic<size_t> sequence{0};
+        T value{};
+    };
+
+    size_t mask_ = 0;
+    std::unique_ptr<Cell[]> cells_;
+    // Producers write one, consumers the other
+    alignas(64) std::atomic<size_t> enqueue_pos_{0};
+    alignas(64) std::atomic<size_t> dequeue_pos_{0};
+};
+
+} // namespace http
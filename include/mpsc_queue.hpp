@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+namespace http {
+
+// Unbounded multi-producer single-consumer queue (Vyukov's intrusive node
+// queue). Push is wait-free and may be called from any thread; TryPop must
+// only be called from the single consumer. Each element costs one node
+// allocation.
+template <typename T>
+class MpscQueue {
+public:
+    MpscQueue() : head_(&stub_), tail_(&stub_) {}
+
+    ~MpscQueue() {
+        T value;
+        while (TryPop(value)) {
+        }
+    }
+
+    // Non-copyable, non-movable (producers hold references)
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    void Push(T value) {
+        Link(new Node(std::move(value)));
+    }
+
+    // Returns false when empty, or when a producer is midway through a Push;
+    // that element becomes visible once its Push returns.
+    bool TryPop(T& out) {
+        Node* tail = tail_;
+        Node* next = tail->next.load(std::memory_order_acquire);
+
+        if (tail == &stub_) {
+            if (next == nullptr) {
+                return false;
+            }
+            tail_ = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+
+        if (next == nullptr) {
+            if (tail != head_.load(std::memory_order_acquire)) {
+                return false;
+            }
+            // tail is the last node: re-insert the stub behind it so it can
+            // be detached without racing producers
+            Link(&stub_);
+            next = tail->next.load(std::memory_order_acquire);
+            if (next == nullptr) {
+                return false;
+            }
+        }
+
+        tail_ = next;
+        out = std::move(tail->value);
+        delete tail;
+        return true;
+    }
+
+    // Approximate when producers are active
+    bool Empty() const {
+        return tail_ == &stub_ && stub_.next.load(std::memory_order_acquire) == nullptr;
+    }
+
+private:
+    struct Node {
+        Node() = default;
+        explicit Node(T v) : value(std::move(v)) {}
+
+        std::atomic<Node*> next{nullptr};
+        T value{};
+    };
+
+    void Link(Node* node) {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    Node stub_;
+    std::atomic<Node*> head_;   // Most recently pushed (producers)
+    Node* tail_;                // Next to pop (consumer)
+};
+
+} // namespace http
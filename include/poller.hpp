@@ -0,0 +1,241 @@
+#pragma once
+
+#include "event_loop.hpp"
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <sys/uio.h>
+
+#if defined(HTTP_POLLER_KQUEUE)
+#include <sys/event.h>
+#elif defined(HTTP_POLLER_EPOLL)
+#include <sys/epoll.h>
+#else
+#error "No event loop backend selected (define HTTP_POLLER_KQUEUE or HTTP_POLLER_EPOLL)"
+#endif
+
+#if defined(HTTP_HAVE_IO_URING)
+#include <linux/io_uring.h>
+#endif
+
+namespace http {
+
+// Interest / readiness bits shared by all poller backends
+enum PollFlags : uint32_t {
+    kPollReadable   = 1u << 0,
+    kPollWritable   = 1u << 1,
+    kPollEdge       = 1u << 2,  // Edge-triggered (EV_CLEAR / EPOLLET)
+    kPollHangup     = 1u << 3,  // Peer closed (EV_EOF / EPOLLHUP / EPOLLRDHUP)
+    kPollError      = 1u << 4,
+    kPollCompletion = 1u << 5,  // Result of an Accept/Receive/Send operation
+    // Disarmed by the kernel after one event (EV_ONESHOT / EPOLLONESHOT).
+    // Once fired, the caller passes kPollOneShot alone as the old interest:
+    // the fd may still be known to the kernel, and kqueue leaves the filter
+    // that did not fire armed (see PlanFilterChanges).
+    kPollOneShot    = 1u << 6
+};
+
+enum class IoOp : uint8_t {
+    Accept,
+    Receive,
+    Send
+};
+
+struct PollEvent {
+    int fd;               // Completion events only; epoll reports -1 for readiness
+    uint32_t events;
+    void* udata;          // Readiness events: the pointer passed to Update()
+
+    // Only set for kPollCompletion events
+    IoOp op;
+    uint32_t tag;         // Tag passed to Start*()
+    int32_t result;       // Accepted fd, byte count, or -errno
+    const char* data;     // Received bytes, valid until the next Poll()
+    bool more;            // Multishot operation is still armed
+};
+
+// Filters a backend with one kernel registration per direction (kqueue)
+// must add, or re-add with new flags, and delete to move an fd from
+// old_interest to new_interest. Such a kernel disarms only the filter that
+// fired, so after a one-shot event (old_interest of kPollOneShot alone) the
+// other may still be registered: every filter not wanted is deleted, and
+// deleting the one already gone fails harmlessly.
+struct FilterChanges {
+    uint32_t add = 0;       // kPollReadable / kPollWritable bits
+    uint32_t remove = 0;
+};
+FilterChanges PlanFilterChanges(uint32_t old_interest, uint32_t new_interest);
+
+// Kernel interface used by EventLoop. The readiness backend (kqueue or
+// epoll) is chosen by CMake (EVENT_LOOP_BACKEND); io_uring can be picked at
+// runtime on Linux builds with HTTP_HAVE_IO_URING.
+class Poller {
+public:
+    virtual ~Poller() = default;
+
+    // Move fd from old_interest to new_interest (0 means not registered).
+    // udata is handed back with every readiness event for fd and must stay
+    // the same for as long as fd is registered. Backends may defer the
+    // change to the next Poll() call so that it costs no syscall of its own;
+    // a registration that fails there is reported as a kPollError event.
+    virtual void Update(int fd, uint32_t old_interest, uint32_t new_interest, void* udata) = 0;
+
+    // Wait for events; timeout_ms < 0 blocks indefinitely.
+    // Returns the number of events written to out, or -1 on EINTR.
+    virtual int Poll(PollEvent* out, int max_events, int timeout_ms) = 0;
+
+    virtual const char* Name() const = 0;
+
+    // Makes a blocked (or the next) Poll() return early. Safe to call from
+    // any thread; the wakeup itself is not reported as an event.
+    virtual void Wakeup() = 0;
+
+    // Whether Poll() is holding events it has not returned yet (more were
+    // ready than max_events). Their udata was captured when the kernel
+    // reported them, so it must stay valid until they are delivered.
+    virtual bool HasPendingEvents() const { return false; }
+
+    // Completion-based I/O. Only io_uring implements these; EventLoop
+    // emulates Accept/Receive/Send on top of readiness for other backends.
+    virtual bool SupportsCompletionIo() const { return false; }
+    virtual void StartAccept(int /*fd*/, uint32_t /*tag*/) {}
+    virtual void StartReceive(int /*fd*/, uint32_t /*tag*/) {}
+    // Submits the chunks as one linked chain; one completion per chunk.
+    // Every chunk but the last is sent with MSG_MORE, and the last too when
+    // more is set, so the chain fills whole segments.
+    virtual void StartSend(int /*fd*/, uint32_t /*tag*/, const struct iovec* /*chunks*/, int /*count*/,
+                           bool /*more*/) {}
+    // Cancels every in-flight operation on fd before the caller closes it
+    virtual void Cancel(int /*fd*/) {}
+
+    // Falls back to the compiled-in readiness backend when the requested
+    // one is unavailable
+    static std::unique_ptr<Poller> Create(EventBackend backend = EventBackend::Default);
+};
+
+#if defined(HTTP_POLLER_KQUEUE)
+
+class KqueuePoller final : public Poller {
+public:
+    KqueuePoller();
+    ~KqueuePoller() override;
+
+    void Update(int fd, uint32_t old_interest, uint32_t new_interest, void* udata) override;
+    int Poll(PollEvent* out, int max_events, int timeout_ms) override;
+    const char* Name() const override { return "kqueue"; }
+    void Wakeup() override;
+    bool HasPendingEvents() const override { return overflow_pos_ < overflow_.size(); }
+
+private:
+    int kqueue_fd_;
+    // Submitted as the changelist of the next kevent() wait
+    std::vector<struct kevent> changes_;
+    std::vector<struct kevent> native_events_;
+    // Events beyond max_events, returned by the next Poll()
+    std::vector<PollEvent> overflow_;
+    size_t overflow_pos_ = 0;
+};
+
+#elif defined(HTTP_POLLER_EPOLL)
+
+class EpollPoller final : public Poller {
+public:
+    EpollPoller();
+    ~EpollPoller() override;
+
+    void Update(int fd, uint32_t old_interest, uint32_t new_interest, void* udata) override;
+    int Poll(PollEvent* out, int max_events, int timeout_ms) override;
+    const char* Name() const override { return "epoll"; }
+    void Wakeup() override;
+
+private:
+    int epoll_fd_;
+    int wake_fd_;   // eventfd
+    std::vector<struct epoll_event> native_events_;
+};
+
+#endif
+
+#if defined(HTTP_HAVE_IO_URING)
+
+// io_uring driven through the raw kernel ABI (no liburing dependency).
+// Readiness registrations become POLL_ADD requests; Accept and Receive use
+// multishot requests, with received data landing in a provided buffer ring.
+class UringPoller final : public Poller {
+public:
+    // Returns nullptr if the kernel lacks io_uring or a required feature
+    static std::unique_ptr<UringPoller> TryCreate();
+    ~UringPoller() override;
+
+    void Update(int fd, uint32_t old_interest, uint32_t new_interest, void* udata) override;
+    int Poll(PollEvent* out, int max_events, int timeout_ms) override;
+    const char* Name() const override { return "io_uring"; }
+    void Wakeup() override;
+
+    bool SupportsCompletionIo() const override { return true; }
+    void StartAccept(int fd, uint32_t tag) override;
+    void StartReceive(int fd, uint32_t tag) override;
+    void StartSend(int fd, uint32_t tag, const struct iovec* chunks, int count, bool more) override;
+    void Cancel(int fd) override;
+
+private:
+    static constexpr unsigned kRingEntries = 256;
+    static constexpr unsigned kBufferCount = 256;     // Power of two
+    static constexpr unsigned kBufferSize = 16 * 1024;
+    static constexpr uint16_t kBufferGroup = 0;
+
+    // Indexed by fd; interest 0 means not registered
+    struct PollState {
+        uint32_t interest = 0;
+        uint32_t generation = 0;
+        bool armed = false;
+        void* udata = nullptr;
+    };
+
+    UringPoller() = default;
+    bool Setup();
+    struct io_uring_sqe* NextSqe();
+    int Enter(unsigned min_complete, int timeout_ms);
+    void Flush();
+    void ArmPoll(int fd, PollState& state);
+    void RecycleBuffers();
+    void ArmWakeup();
+
+    int ring_fd_ = -1;
+    int wake_fd_ = -1;          // eventfd watched by a multishot poll
+    bool wake_armed_ = false;
+
+    // Submission/completion rings (single mmap, IORING_FEAT_SINGLE_MMAP)
+    void* ring_ = nullptr;
+    size_t ring_size_ = 0;
+    struct io_uring_sqe* sqes_ = nullptr;
+    size_t sqes_size_ = 0;
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned sq_entries_ = 0;
+    unsigned sq_local_tail_ = 0;
+    unsigned sq_pending_ = 0;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    struct io_uring_cqe* cqes_ = nullptr;
+
+    // Provided buffer ring for multishot recv
+    struct io_uring_buf_ring* buf_ring_ = nullptr;
+    size_t buf_ring_size_ = 0;
+    std::vector<char> buffers_;
+    uint16_t buf_tail_ = 0;
+    std::vector<uint16_t> buffers_to_recycle_;
+    std::vector<std::pair<int, uint32_t>> receives_to_restart_;
+
+    PollState* FindPoll(int fd);
+
+    std::vector<PollState> polls_;
+    std::vector<int> polls_to_rearm_;
+    uint32_t next_poll_generation_ = 1;
+};
+
+#endif
+
+} // namespace http
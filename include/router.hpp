@@ -2,6 +2,7 @@
 
 #include "http_request.hpp"
 #include "http_response.hpp"
+#include "thread_pool.hpp"
 #include <functional>
 #include <string>
 #include <unordered_map>
@@ -12,12 +13,21 @@ namespace http {
 
 using RouteHandler = std::function<HttpResponse(const HttpRequest&)>;
 
+enum class RouteMode {
+    Pool,       // Handler runs on a worker thread
+    Inline      // Handler runs on the event loop thread, so it must not block
+};
+
 struct Route {
     HttpMethod method;
     std::string pattern;
     std::regex regex_pattern;
     RouteHandler handler;
     std::vector<std::string> param_names;
+    RouteMode mode = RouteMode::Pool;
+    TaskPriority priority = TaskPriority::Normal;   // The worker lane a Pool route runs in
+    bool literal = false;           // No parameters or wildcard: matched by string compare
+    std::string literal_path;
 };
 
 class Router {
@@ -25,11 +35,20 @@ public:
     Router();
 
     // Register routes
-    void Register(HttpMethod method, const std::string& path, RouteHandler handler);
+    void Register(HttpMethod method, const std::string& path, RouteHandler handler,
+                  RouteMode mode = RouteMode::Pool, TaskPriority priority = TaskPriority::Normal);
 
     // Find and execute route handler
     HttpResponse HandleRequest(const HttpRequest& request) const;
 
+    // First route matching method and path, or nullptr
+    const Route* Match(HttpMethod method, const std::string& path) const;
+    // Execute route's handler (request must match it)
+    HttpResponse Invoke(const Route& route, const HttpRequest& request) const;
+
+    bool HasInlineRoutes() const { return has_inline_routes_; }
+    bool HasPriorityRoutes() const { return has_priority_routes_; }
+
     // Check if route exists
     bool HasRoute(HttpMethod method, const std::string& path) const;
 
@@ -41,6 +60,8 @@ private:
     ) const;
 
     std::vector<Route> routes_;
+    bool has_inline_routes_ = false;
+    bool has_priority_routes_ = false;  // Some Pool route is not Normal
 };
 
 } // namespace http
@@ -5,16 +5,34 @@
 #include <functional>
 #include <unordered_map>
 #include "event_loop.hpp"
+#include "connection_table.hpp"
 #include "thread_pool.hpp"
+#include "load_shedder.hpp"
 #include "router.hpp"
 #include "logger.hpp"
 #include "config.hpp"
 #include "websocket.hpp"
+#include "static_cache.hpp"
+#include "compression.hpp"
+#include "http2.hpp"
 #include <unordered_map>
 #include <atomic>
+#include <vector>
+#include <mutex>
+#include <chrono>
 
 namespace http {
 
+struct AdmissionStats {
+    size_t open_connections = 0;
+    uint64_t rejected_connections = 0;      // Refused at accept (max_connections reached)
+    uint64_t shed_requests = 0;             // Answered 503 while the worker queue or a lane was overloaded or full
+    bool overloaded = false;                // Shedding right now
+    bool bulk_overloaded = false;           // Shedding Bulk requests right now (their lane's queue)
+    std::chrono::microseconds queue_wait{0}; // Wait of the last task taken from the worker queue
+    size_t workers = 0;                     // Normal workers running (elastic pools grow and shrink)
+};
+
 class Server {
 public:
     explicit Server(const Config& config = Config{});
@@ -26,12 +44,21 @@ public:
     Server(Server&&) noexcept = delete;
     Server& operator=(Server&&) noexcept = delete;
 
-    // Route registration
-    void Get(const std::string& path, RouteHandler handler);
-    void Post(const std::string& path, RouteHandler handler);
-    void Put(const std::string& path, RouteHandler handler);
-    void Delete(const std::string& path, RouteHandler handler);
-    void Patch(const std::string& path, RouteHandler handler);
+    // Route registration. RouteMode::Inline runs the handler on the event
+    // loop thread that read the request, skipping the worker queue (and
+    // load shedding); only for handlers that never block, like /health.
+    // A Pool route's priority picks its worker lane: Critical runs on the
+    // reserved workers and is never shed, Bulk on workers of its own.
+    void Get(const std::string& path, RouteHandler handler, RouteMode mode = RouteMode::Pool,
+             TaskPriority priority = TaskPriority::Normal);
+    void Post(const std::string& path, RouteHandler handler, RouteMode mode = RouteMode::Pool,
+              TaskPriority priority = TaskPriority::Normal);
+    void Put(const std::string& path, RouteHandler handler, RouteMode mode = RouteMode::Pool,
+             TaskPriority priority = TaskPriority::Normal);
+    void Delete(const std::string& path, RouteHandler handler, RouteMode mode = RouteMode::Pool,
+                TaskPriority priority = TaskPriority::Normal);
+    void Patch(const std::string& path, RouteHandler handler, RouteMode mode = RouteMode::Pool,
+               TaskPriority priority = TaskPriority::Normal);
 
     // Static file serving
     void ServeStatic(const std::string& path, const std::string& directory);
@@ -43,26 +70,139 @@ public:
     // Check if server is running
     bool IsRunning() const { return running_; }
 
+    // Active event loop backend ("kqueue", "epoll" or "io_uring")
+    const char* EventLoopBackend() const { return reactors_.front().loop->BackendName(); }
+
+    // Number of event loops accepting connections
+    size_t ReactorCount() const { return reactors_.size(); }
+
+    // Port of the first TCP endpoint (resolves port 0 once Start() has bound
+    // the listeners)
+    uint16_t Port() const { return bound_port_; }
+
+    // Event loop counters summed over all reactors (batch_size is the largest)
+    EventLoopStats LoopStats() const;
+
+    // Admission control counters
+    AdmissionStats Admission() const;
+
     // WebSocket support
     void HandleWebSocket(int client_fd, const std::string& request);
     void RegisterWebSocketHandler(const std::string& path, std::function<void(int, const std::string&)> handler);
 
+    // Send producer()'s text to every client on path each interval, from an
+    // event loop timer (an empty string skips the tick). Call before Start().
+    void PushWebSocketEvery(const std::string& path, std::chrono::milliseconds interval,
+                            std::function<std::string()> producer);
+
 private:
-    // WebSocket connections
-    std::unordered_map<int, bool> websocket_connections_;
+    // Loop-thread state of one HTTP connection. HTTP/1.1 requests are
+    // handled one at a time; pipelined ones wait in input until the previous
+    // response has been written. An HTTP/2 connection has a session instead,
+    // and any number of its streams may be with workers at once.
+    struct ConnectionState {
+        std::string input;          // Received bytes not yet handed to a worker
+        TimerId deadline = 0;       // Request timeout, then keep-alive idle timeout
+        size_t requests = 0;        // Requests dispatched so far
+        bool busy = false;          // A request is with a worker or its response is being written (HTTP/2: a write is in flight)
+        bool read_closed = false;   // Peer sent EOF (or the read failed)
+        bool closing = false;       // Close once the current response is written
+        bool dispatching = false;   // DispatchRequest or FlushHttp2 is looping; completions leave the next step to it
+        std::unique_ptr<Http2Session> h2;   // Set once the connection speaks HTTP/2
+    };
+    using ClientEntry = ConnectionTable<ConnectionState>::Entry;
+
+    // An event loop with its own listening socket and the connections it
+    // accepted. Connections stay on the reactor that accepted them; only its
+    // loop thread touches the table.
+    struct Reactor {
+        std::unique_ptr<EventLoop> loop;
+        std::vector<int> listen_fds;    // One per listen endpoint
+        ConnectionTable<ConnectionState> connections;
+    };
+
+    struct WebSocketPush {
+        std::string path;
+        std::chrono::milliseconds interval;
+        std::function<std::string()> producer;
+    };
+
+    // WebSocket connections (fd -> path), shared by workers and loop timers
+    std::unordered_map<int, std::string> websocket_connections_;
+    std::mutex websocket_mutex_;
     std::unordered_map<std::string, std::function<void(int, const std::string&)>> websocket_handlers_;
-    void HandleConnection(int client_fd);
-    void ProcessRequest(int client_fd, const std::string& request_data);
-    std::string ReadRequest(int client_fd);
-    void SendResponse(int client_fd, const HttpResponse& response);
+    std::vector<WebSocketPush> websocket_pushes_;
+    bool IsWebSocketConnection(int client_fd);
+    void PushWebSocketFrames(const WebSocketPush& push);
+    // Loop thread: buffer what a connection sends and dispatch whole requests
+    void OnRequestData(Reactor* reactor, ConnectionId id, const char* data, ssize_t size);
+    void DispatchRequest(Reactor* reactor, ConnectionId id);
+    void OnResponseSent(Reactor* reactor, ConnectionId id);
+    void RejectRequest(Reactor* reactor, ConnectionId id, HttpResponse response);
+    void ShedRequest(Reactor* reactor, ConnectionId id);
+    void ExpireClient(Reactor* reactor, ConnectionId id);
+    void CloseClient(Reactor* reactor, ConnectionId id);
+    void CloseClients();
+    // Worker side: connections are named by id, never by fd
+    void HandleConnection(Reactor* reactor, ConnectionId id, std::string request_data,
+                          const PeerAddress& peer, bool last_request, TaskPriority priority);
+    // False, leaving client_fd untouched, when the task queue is full
+    bool HandleWebSocketUpgrade(int client_fd, std::string request_data);
+    // Worker thread, or the loop thread for an inline route (passed as route)
+    void ProcessRequest(Reactor* reactor, ConnectionId id, const std::string& request_data,
+                        const PeerAddress& peer, bool last_request, const Route* route = nullptr);
+    // Hand the response to the loop that owns the connection; with
+    // keep_alive it then waits for (or serves) its next request
+    void SendResponse(Reactor* reactor, ConnectionId id, HttpResponse response, bool keep_alive = false);
+    void CloseConnection(Reactor* reactor, ConnectionId id);
+    // Whether a Pool request of this priority should get a 503 now: judged
+    // by the waits of the lane it would queue in, and never for Critical
+    // requests with workers of their own
+    bool ShouldShed(TaskPriority priority) const;
+    // HTTP/2 (h2c): the session parses frames on the loop thread, and each
+    // stream is routed like an HTTP/1.1 request (inline or on a worker).
+    // StartHttp2 returns false when an Upgrade request's settings are
+    // malformed, leaving the request to HTTP/1.1.
+    bool StartHttp2(Reactor* reactor, ConnectionId id, const HttpRequest* upgrade);
+    void ReceiveHttp2(Reactor* reactor, ConnectionId id);
+    void DispatchStream(Reactor* reactor, ConnectionId id, uint32_t stream_id, HttpRequest request);
+    HttpResponse RouteStream(const HttpRequest& request, const PeerAddress& peer, const Route* route);
+    void RespondStream(Reactor* reactor, ConnectionId id, uint32_t stream_id, HttpResponse response);
+    void FlushHttp2(Reactor* reactor, ConnectionId id);
+    void OpenListeners();
+    void CloseListeners();
+
+    // The CPU each reactor and each pool thread (Normal, lane and elastic
+    // workers) is pinned to, in the order the topology places threads; empty for threads that float. Throws
+    // std::invalid_argument when a configured CPU set or NUMA node has no
+    // online CPUs.
+    struct CpuPlan {
+        std::vector<unsigned> reactors;
+        std::vector<unsigned> workers;
+    };
+    static CpuPlan PlanCpus(const Config& config);
 
     Config config_;
-    std::unique_ptr<EventLoop> event_loop_;
+    std::vector<Reactor> reactors_;
+    LoadShedder load_shedder_;              // Outlives the pool that reports to it
+    LoadShedder bulk_shedder_;              // The Bulk lane's waits, when it has workers
+    CpuPlan cpu_plan_;
     std::unique_ptr<ThreadPool> thread_pool_;
     Router router_;
+    std::vector<std::shared_ptr<StaticFileCache>> static_caches_;
+    std::unique_ptr<ResponseCompressor> compressor_;    // Null when compression is off
     Logger logger_;
-    bool running_;
-    int server_fd_;
+    std::atomic<bool> running_;
+    std::atomic<uint16_t> bound_port_;
+    std::string listen_descriptions_;
+    std::vector<std::string> unix_socket_paths_;    // Removed again on shutdown
+
+    // Admission control: the 503 sent to refused connections and shed
+    // requests is rendered once and shared by every send
+    std::shared_ptr<const std::string> overload_response_;
+    std::atomic<size_t> open_connections_{0};
+    std::atomic<uint64_t> rejected_connections_{0};
+    std::atomic<uint64_t> shed_requests_{0};
 };
 
 } // namespace http
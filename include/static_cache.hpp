@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "http_response.hpp"
+
+namespace http {
+
+// Bounded LRU cache of the files under one static directory, keyed by the
+// path they were requested by. An entry holds the file's bytes, its status
+// line and headers rendered ahead of time, an ETag and the canonical path,
+// so a hit costs one hash lookup and no filesystem calls. On Linux an
+// inotify watch on the directory tree drops entries whose file changes;
+// without inotify a hit re-checks the file with one stat instead. Files
+// larger than an eighth of the capacity are not cached and are streamed
+// with sendfile. Safe to use from any thread.
+class StaticFileCache {
+public:
+    // directory must exist; capacity_bytes of 0 disables caching
+    StaticFileCache(const std::string& directory, size_t capacity_bytes);
+    ~StaticFileCache();
+
+    // Non-copyable, non-movable (the watch is registered by address)
+    StaticFileCache(const StaticFileCache&) = delete;
+    StaticFileCache& operator=(const StaticFileCache&) = delete;
+
+    // Response for relative_path (e.g. "css/site.css"): 304 when
+    // if_none_match names the current ETag, 404/403 for missing files and
+    // paths that leave the directory
+    HttpResponse Serve(const std::string& relative_path, const std::string& if_none_match = "");
+
+    // inotify descriptor to watch for readability, or -1 when there is none.
+    // Call OnWatchEvents when it becomes readable.
+    int WatchFd() const { return watch_fd_; }
+    void OnWatchEvents();
+
+    size_t Entries() const;
+    size_t CachedBytes() const;
+    void Clear();
+
+private:
+    struct Entry {
+        std::string key;                    // Request path
+        std::string canonical_path;
+        std::string request_file;           // directory/key, before resolving links
+        std::shared_ptr<const std::string> headers;
+        std::shared_ptr<const std::string> body;
+        std::string etag;
+        size_t size = 0;                    // For the stat check without inotify
+        int64_t mtime_ns = 0;
+    };
+    using EntryList = std::list<Entry>;
+
+    HttpResponse Load(const std::string& relative_path, const std::string& if_none_match);
+    bool StillCurrent(const Entry& entry) const;
+    void Insert(Entry entry, uint64_t generation);
+    void Erase(std::unordered_map<std::string, EntryList::iterator>::iterator it);
+    // Drops entries for path, or everything under it when it is a directory
+    void Invalidate(const std::string& path, bool directory);
+    bool WatchTree(const std::string& directory);
+    void CloseWatch();
+
+    std::filesystem::path directory_;       // Canonical
+    std::string directory_prefix_;          // directory_ with a trailing slash
+    size_t capacity_bytes_;
+    size_t max_entry_bytes_;
+
+    mutable std::mutex mutex_;
+    EntryList lru_;                          // Most recently used first
+    std::unordered_map<std::string, EntryList::iterator> entries_;
+    size_t cached_bytes_ = 0;
+    // Bumped on every invalidation, so a load that raced one is not cached
+    uint64_t generation_ = 0;
+
+    int watch_fd_ = -1;
+    std::unordered_map<int, std::string> watched_dirs_;   // Watch descriptor -> directory
+};
+
+} // namespace http
@@ -2,18 +2,72 @@
 
 #include <vector>
 #include <thread>
-#include <queue>
 #include <mutex>
 #include <condition_variable>
 #include <functional>
 #include <atomic>
 #include <future>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <string>
+#include "inline_task.hpp"
+#include "mpmc_queue.hpp"
+#include "work_stealing_deque.hpp"
 
 namespace http {
 
+// How queued tasks reach the workers
+enum class Scheduling {
+    SharedQueue,    // One FIFO queue under one lock
+    WorkStealing    // Per-worker deques fed in batches from a shared injector; idle workers steal
+};
+
+// "shared" or "work_stealing"; throws std::invalid_argument otherwise
+Scheduling ParseScheduling(const std::string& name);
+
+// What holds the shared queue's tasks
+enum class TaskQueue {
+    Locked,     // A growable array under the pool's mutex; unbounded
+    Ring        // Lock-free bounded MPMC ring; when full, TryEnqueue fails and Enqueue waits
+};
+
+// "locked" or "ring"; throws std::invalid_argument otherwise
+TaskQueue ParseTaskQueue(const std::string& name);
+
+// Which lane a posted task waits in
+enum class TaskPriority {
+    Critical,   // Latency-critical: workers reserved for it, never queued behind other tasks
+    Normal,     // The pool's own workers
+    Bulk        // Expensive: workers of its own, so it cannot occupy the others
+};
+
+struct ThreadPoolOptions {
+    Scheduling scheduling = Scheduling::SharedQueue;
+    TaskQueue queue = TaskQueue::Locked;    // Shared queue scheduling only
+    size_t queue_capacity = 4096;           // Ring slots, rounded up to a power of two
+    std::string thread_name{};              // Workers are named "<thread_name>-<i>" when set
+    // Thread i is pinned to cpus[i % size], best effort. Threads are counted
+    // the Normal workers first, then the Critical and the Bulk lane's, then
+    // elastic workers, so a plan of that many CPUs gives each its own.
+    std::vector<unsigned> cpus{};
+    size_t critical_threads = 0;            // Reserved for Critical tasks (0 = they run as Normal)
+    size_t bulk_threads = 0;                // The only workers running Bulk tasks (0 = they run as Normal)
+    size_t lane_capacity = 1024;            // Tasks each lane queues; beyond it TryPost fails and Post waits
+    // Elastic sizing, shared queue scheduling only: while tasks wait longer
+    // than grow_after, add workers up to max_threads; added workers exit
+    // after idling for idle_timeout (0 = a fixed pool)
+    size_t max_threads = 0;
+    std::chrono::milliseconds grow_after{10};
+    std::chrono::milliseconds idle_timeout{30000};
+};
+
 class ThreadPool {
 public:
-    explicit ThreadPool(size_t num_threads = std::thread::hardware_concurrency());
+    // Throws std::invalid_argument for a ring or elastic sizing with work
+    // stealing, whose workers queue on their own deques
+    explicit ThreadPool(size_t num_threads = std::thread::hardware_concurrency(),
+                        const ThreadPoolOptions& options = {});
     ~ThreadPool();
 
     // Non-copyable, non-movable (mutex is not movable)
@@ -22,21 +76,156 @@ public:
     ThreadPool(ThreadPool&&) noexcept = delete;
     ThreadPool& operator=(ThreadPool&&) noexcept = delete;
 
-    // Enqueue a task
+    // Enqueue a task. With a ring that is full this waits for a slot by
+    // spinning on std::this_thread::yield() (a full lane blocks instead),
+    // so do not call it from an event loop, which would stall every
+    // connection it serves, or from a task that the ring's backlog depends
+    // on; use TryEnqueue there.
     template<typename F, typename... Args>
     auto Enqueue(F&& f, Args&&... args) -> std::future<typename std::invoke_result<F, Args...>::type>;
 
-    size_t Size() const { return threads_.size(); }
+    // Like Enqueue, but returns nullopt at once, without running the task,
+    // when the ring is full. Never fails for the other queues.
+    template<typename F, typename... Args>
+    auto TryEnqueue(F&& f, Args&&... args) -> std::optional<std::future<typename std::invoke_result<F, Args...>::type>>;
+
+    // Fire and forget: runs f() on a worker with no future or shared state.
+    // f may be move-only; one of up to InlineTask::kCapacity bytes is
+    // queued without allocating. f must not throw, as nothing would catch
+    // it. Spins for a slot when the ring is full, like Enqueue. Critical
+    // and Bulk tasks go to their lane's workers when it has any.
+    template<typename F>
+    void Post(F&& f, TaskPriority priority = TaskPriority::Normal);
+
+    // Like Post, but returns false at once, dropping f, when the ring or
+    // the task's lane is full
+    template<typename F>
+    bool TryPost(F&& f, TaskPriority priority = TaskPriority::Normal);
+
+    // Normal workers running now, elastic ones included
+    size_t Size() const { return threads_.size() + added_workers_.load(std::memory_order_relaxed); }
+    // Tasks waiting for a worker, in every lane (with work stealing or a
+    // ring, an atomic count that is approximate while tasks move)
     size_t PendingTasks() const;
+    // Whether priority's tasks have workers of their own (Normal always does)
+    bool HasLane(TaskPriority priority) const;
+    Scheduling GetScheduling() const { return scheduling_; }
+    TaskQueue GetTaskQueue() const { return ring_ ? TaskQueue::Ring : TaskQueue::Locked; }
+
+    // Called as each Normal task is dequeued with how long it waited and
+    // whether the queue is now empty, one call at a time (keep it cheap):
+    // under the queue lock, or with work stealing or a ring under a flag,
+    // skipping reports that would overlap unless they are the one saying the
+    // queue is empty. Set before enqueueing work. With a Critical or Bulk
+    // lane, observes that lane's tasks instead (under its lock); ignored
+    // when the lane has no workers, as its tasks are then Normal ones.
+    using QueueDelayObserver = std::function<void(std::chrono::nanoseconds wait, bool queue_empty)>;
+    void SetQueueDelayObserver(QueueDelayObserver observer, TaskPriority lane = TaskPriority::Normal);
 
 private:
-    void WorkerThread();
+    struct QueuedTask {
+        InlineTask run;
+        std::chrono::steady_clock::time_point enqueued;
+    };
+
+    // FIFO in a circular array that doubles when full and never shrinks,
+    // so a steady load queues without allocating
+    class TaskBuffer {
+    public:
+        bool Empty() const { return count_ == 0; }
+        size_t Size() const { return count_; }
+        void Push(QueuedTask task);
+        QueuedTask Pop();       // Not empty
+
+    private:
+        std::vector<QueuedTask> slots_;
+        size_t head_ = 0;
+        size_t count_ = 0;
+    };
+
+    // Queues task in its priority's lane, else on the shared queue or ring,
+    // or with work stealing on the calling worker's deque or the injector.
+    // Returns false when the ring is full and wait_for_space is not set.
+    // Throws std::runtime_error once the pool is stopping.
+    bool Submit(QueuedTask task, bool wait_for_space, TaskPriority priority = TaskPriority::Normal);
+    // Names a thread "<thread_name>-<suffix>" and pins it to cpu_index as
+    // the options ask, on its own thread
+    void PrepareThread(const std::string& suffix, size_t cpu_index);
+    // With elastic set (an added worker), return after idling for
+    // idle_timeout_
+    void WorkerThread(bool elastic = false);
+    void RingWorkerThread(bool elastic = false);
+    // Parks an idle lock-free worker until pending_ says there is a task;
+    // false once the pool is stopping with none left, or an elastic worker
+    // has idled
+    bool WaitForTasks(bool elastic);
+
+    // A priority lane: a queue and workers of its own, so its tasks never
+    // wait behind another lane's
+    struct Lane {
+        TaskBuffer tasks;
+        size_t capacity = 1;
+        mutable std::mutex mutex;
+        std::condition_variable ready;      // A task was queued
+        std::condition_variable space;      // A task was taken from a full lane
+        std::vector<std::thread> threads;
+        QueueDelayObserver delay_observer;
+    };
+    // Its workers pin from cpu index first_cpu on
+    void StartLane(std::unique_ptr<Lane>& lane, size_t threads, size_t capacity, const std::string& tag,
+                   size_t first_cpu);
+    Lane* LaneFor(TaskPriority priority) const;
+    void LaneWorkerThread(Lane& lane);
+
+    // Elastic sizing: a worker that took a task older than grow_after_
+    // adds one (under queue_mutex_) while the pool is below max_threads_
+    bool ShouldGrow(std::chrono::steady_clock::duration wait) const;
+    void AddWorker();
 
+    // Work stealing. Deques hold tasks in nodes, which each worker recycles
+    // through a free list of its own, trading surplus with a shared one.
+    struct Worker {
+        WorkStealingDeque<QueuedTask*> deque;
+        uint64_t rng;       // Picks the first victim to steal from
+        std::vector<std::unique_ptr<QueuedTask>> free_nodes;
+    };
+    void StealingWorkerThread(size_t index);
+    // The worker's own newest task, else a batch from the injector, else
+    // one stolen from another worker; false when none was found
+    bool FindTask(size_t index, QueuedTask& out);
+    QueuedTask* AcquireNode(Worker& worker);
+    void ReleaseNode(Worker& worker, QueuedTask* node);
+    void ReportDelay(const QueuedTask& task, bool queue_empty);
+
+    Scheduling scheduling_;
+    std::string thread_name_;
+    std::vector<unsigned> cpus_;
     std::vector<std::thread> threads_;
-    std::queue<std::function<void()>> tasks_;
-    mutable std::mutex queue_mutex_;
+    TaskBuffer tasks_;
+    std::unique_ptr<BoundedMpmcQueue<QueuedTask>> ring_;   // Replaces tasks_ when set
+    QueueDelayObserver delay_observer_;
+    mutable std::mutex queue_mutex_;        // Also guards the injector and parks idle stealing workers
     std::condition_variable condition_;
     std::atomic<bool> stop_;
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    TaskBuffer injector_;                   // Submissions from outside the pool
+    std::vector<std::unique_ptr<QueuedTask>> free_nodes_;  // Shared spare nodes
+    std::atomic<size_t> injector_size_{0};  // Checked before taking the lock
+    std::atomic<int64_t> pending_{0};       // Queued anywhere, not yet taken (work stealing, ring)
+    std::atomic<size_t> sleepers_{0};       // Workers parked on condition_
+    std::atomic_flag reporting_ = ATOMIC_FLAG_INIT;
+
+    std::unique_ptr<Lane> critical_lane_;   // Null when Critical tasks run as Normal
+    std::unique_ptr<Lane> bulk_lane_;       // Null when Bulk tasks run as Normal
+    size_t lane_threads_ = 0;               // Both lanes' workers; elastic workers pin after them
+
+    size_t max_threads_;
+    std::chrono::steady_clock::duration grow_after_;
+    std::chrono::steady_clock::duration idle_timeout_;
+    std::vector<std::thread> added_threads_;    // Elastic workers by slot (under queue_mutex_)
+    std::vector<size_t> retired_slots_;         // Slots whose worker has exited, to join and reuse
+    std::atomic<size_t> added_workers_{0};      // Elastic workers running
 };
 
 template<typename F, typename... Args>
@@ -48,15 +237,34 @@ auto ThreadPool::Enqueue(F&& f, Args&&... args) -> std::future<typename std::inv
     );
 
     std::future<return_type> result = task->get_future();
-    {
-        std::unique_lock<std::mutex> lock(queue_mutex_);
-        if (stop_) {
-            throw std::runtime_error("Enqueue on stopped ThreadPool");
-        }
-        tasks_.emplace([task](){ (*task)(); });
+    Submit(QueuedTask{[task](){ (*task)(); }, std::chrono::steady_clock::now()}, true);
+    return result;
+}
+
+template<typename F, typename... Args>
+auto ThreadPool::TryEnqueue(F&& f, Args&&... args)
+    -> std::optional<std::future<typename std::invoke_result<F, Args...>::type>> {
+    using return_type = typename std::invoke_result<F, Args...>::type;
+
+    auto task = std::make_shared<std::packaged_task<return_type()>>(
+        std::bind(std::forward<F>(f), std::forward<Args>(args)...)
+    );
+
+    std::future<return_type> result = task->get_future();
+    if (!Submit(QueuedTask{[task](){ (*task)(); }, std::chrono::steady_clock::now()}, false)) {
+        return std::nullopt;
     }
-    condition_.notify_one();
     return result;
 }
 
+template<typename F>
+void ThreadPool::Post(F&& f, TaskPriority priority) {
+    Submit(QueuedTask{InlineTask(std::forward<F>(f)), std::chrono::steady_clock::now()}, true, priority);
+}
+
+template<typename F>
+bool ThreadPool::TryPost(F&& f, TaskPriority priority) {
+    return Submit(QueuedTask{InlineTask(std::forward<F>(f)), std::chrono::steady_clock::now()}, false, priority);
+}
+
 } // namespace http
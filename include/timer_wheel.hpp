@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace http {
+
+// 0 is never a valid id
+using TimerId = uint64_t;
+using TimerCallback = std::function<void()>;
+
+// Hierarchical timing wheel with 1 ms ticks: four levels of 256 slots cover
+// 2^32 ms, and later timers are parked in the top level until they come
+// into range. Timer records live in a slab indexed by the id and are linked
+// into slots through intrusive lists, so Schedule and Cancel are O(1) and
+// only allocate when the slab grows. Not thread-safe.
+class TimerWheel {
+public:
+    explicit TimerWheel(uint64_t now_ms = 0);
+
+    // Timers are non-copyable (callbacks are owned by the slab)
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+    TimerWheel(TimerWheel&&) noexcept = default;
+    TimerWheel& operator=(TimerWheel&&) noexcept = default;
+
+    // Fire at expires_ms (absolute, same clock as Advance), then every
+    // interval_ms if non-zero. Times already passed fire on the next Advance.
+    TimerId Schedule(uint64_t expires_ms, uint64_t interval_ms, TimerCallback callback);
+
+    // Returns false if the timer already fired (one-shot) or was cancelled.
+    // A timer may cancel itself from its own callback.
+    bool Cancel(TimerId id);
+
+    // Run every timer due at or before now_ms; returns how many fired
+    size_t Advance(uint64_t now_ms);
+
+    // Milliseconds until the next timer may be due, or -1 if none are
+    // scheduled. Timers in the upper levels report their cascade point.
+    int64_t NextTimeoutMs(uint64_t now_ms) const;
+
+    size_t Size() const { return size_; }
+    uint64_t Now() const { return now_; }
+
+private:
+    static constexpr int kLevels = 4;
+    static constexpr int kSlotBits = 8;
+    static constexpr uint32_t kSlots = 1u << kSlotBits;
+    static constexpr uint32_t kSlotMask = kSlots - 1;
+    static constexpr uint32_t kNone = UINT32_MAX;
+    // Bucket values for records that are not linked into a slot
+    static constexpr uint16_t kFree = UINT16_MAX;
+    static constexpr uint16_t kFiring = UINT16_MAX - 1;
+
+    struct Timer {
+        uint64_t expires = 0;
+        uint64_t interval = 0;
+        TimerCallback callback;
+        uint32_t prev = kNone;
+        uint32_t next = kNone;
+        uint32_t generation = 0;
+        uint16_t bucket = kFree;   // level * kSlots + slot while linked
+        bool cancelled = false;    // Cancelled while its callback runs
+    };
+
+    uint32_t Allocate();
+    void Release(uint32_t index);
+    void Link(uint32_t index);
+    void Unlink(uint32_t index);
+    void Cascade(int level);
+    size_t FireSlot(uint32_t slot);
+
+    std::vector<Timer> timers_;
+    std::vector<uint32_t> heads_;              // kLevels * kSlots list heads
+    uint32_t free_head_;
+    uint64_t now_;                              // Last processed tick
+    size_t size_;
+    size_t level_counts_[kLevels];
+};
+
+} // namespace http
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace http {
+
+// Chase-Lev work-stealing deque (the C11 formulation of Lê et al., "Correct
+// and Efficient Work-Stealing for Weak Memory Models", 2013). One owner
+// thread pushes and pops at the bottom, LIFO; any thread may steal from the
+// top, FIFO. Push and Pop are wait-free except when the array grows; Steal
+// is lock-free. T must be trivially copyable (a pointer, typically) since
+// slots are read and written as atomics. Arrays outgrown by a resize stay
+// allocated until the deque is destroyed, as thieves may still be reading
+// them.
+template <typename T>
+class WorkStealingDeque {
+    static_assert(std::is_trivially_copyable<T>::value, "WorkStealingDeque holds trivially copyable values");
+
+public:
+    // capacity is rounded up to a power of two
+    explicit WorkStealingDeque(size_t capacity = 256) {
+        size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        arrays_.push_back(std::make_unique<Array>(size));
+        array_.store(arrays_.back().get(), std::memory_order_relaxed);
+    }
+
+    // Non-copyable, non-movable (thieves hold references)
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    // Owner only
+    void Push(T value) {
+        int64_t bottom = bottom_.load(std::memory_order_relaxed);
+        int64_t top = top_.load(std::memory_order_acquire);
+        Array* array = array_.load(std::memory_order_relaxed);
+        if (bottom - top > static_cast<int64_t>(array->mask)) {
+            array = Grow(array, top, bottom);
+        }
+        array->Put(bottom, value);
+        // Publishes the slot to thieves that acquire bottom_
+        bottom_.store(bottom + 1, std::memory_order_release);
+    }
+
+    // Owner only: the most recently pushed value, or false when empty
+    bool Pop(T& out) {
+        int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+        Array* array = array_.load(std::memory_order_relaxed);
+        bottom_.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t top = top_.load(std::memory_order_relaxed);
+
+        if (top > bottom) {
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+            return false;
+        }
+        out = array->Get(bottom);
+        if (top == bottom) {
+            // Last element: race the thieves for it
+            bool won = top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                                    std::memory_order_relaxed);
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    // Any thread: the oldest value, or false when empty or when another
+    // thread took it first (a retry may then succeed)
+    bool Steal(T& out) {
+        int64_t top = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t bottom = bottom_.load(std::memory_order_acquire);
+        if (top >= bottom) {
+            return false;
+        }
+        Array* array = array_.load(std::memory_order_acquire);
+        T value = array->Get(top);
+        if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return false;
+        }
+        out = value;
+        return true;
+    }
+
+    // Approximate when other threads are active
+    size_t Size() const {
+        int64_t bottom = bottom_.load(std::memory_order_relaxed);
+        int64_t top = top_.load(std::memory_order_relaxed);
+        return bottom > top ? static_cast<size_t>(bottom - top) : 0;
+    }
+
+    size_t Capacity() const { return array_.load(std::memory_order_relaxed)->mask + 1; }
+
+private:
+    struct Array {
+        explicit Array(size_t size) : mask(size - 1), slots(new std::atomic<T>[size]) {}
+
+        void Put(int64_t index, T value) {
+            slots[static_cast<size_t>(index) & mask].store(value, std::memory_order_relaxed);
+        }
+        T Get(int64_t index) const {
+            return slots[static_cast<size_t>(index) & mask].load(std::memory_order_relaxed);
+        }
+
+        size_t mask;
+        std::unique_ptr<std::atomic<T>[]> slots;
+    };
+
+    Array* Grow(Array* array, int64_t top, int64_t bottom) {
+        arrays_.push_back(std::make_unique<Array>((array->mask + 1) * 2));
+        Array* grown = arrays_.back().get();
+        for (int64_t i = top; i < bottom; ++i) {
+            grown->Put(i, array->Get(i));
+        }
+        array_.store(grown, std::memory_order_release);
+        return grown;
+    }
+
+    // Top and bottom on separate cache lines: thieves write one, the owner
+    // the other
+    alignas(64) std::atomic<int64_t> top_{0};
+    alignas(64) std::atomic<int64_t> bottom_{0};
+    alignas(64) std::atomic<Array*> array_{nullptr};
+    std::vector<std::unique_ptr<Array>> arrays_;    // Owner only; the last is current
+};
+
+} // namespace http
@@ -0,0 +1,268 @@
+#include "compression.hpp"
+#include <zlib.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace http {
+
+namespace {
+
+std::string Lowercase(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return text;
+}
+
+std::string Trim(const std::string& text, size_t begin, size_t end) {
+    while (begin < end && (text[begin] == ' ' || text[begin] == '\t')) {
+        ++begin;
+    }
+    while (end > begin && (text[end - 1] == ' ' || text[end - 1] == '\t')) {
+        --end;
+    }
+    return text.substr(begin, end - begin);
+}
+
+// q parameter of one Accept-Encoding element ("gzip;q=0.5"); 1 when absent
+double QValue(const std::string& params) {
+    size_t q = params.find("q=");
+    if (q == std::string::npos) {
+        return 1.0;
+    }
+    return std::strtod(params.c_str() + q + 2, nullptr);
+}
+
+// Charged per cache entry on top of the encoded bytes, so entries for
+// bodies that did not shrink count against the bound too
+constexpr size_t kEntryOverhead = 64;
+
+size_t Slot(ContentCoding coding) {
+    return coding == ContentCoding::Gzip ? 0 : 1;
+}
+
+} // namespace
+
+ContentCoding NegotiateCoding(const std::string& accept_encoding) {
+    // -1: not mentioned
+    double gzip = -1;
+    double deflate = -1;
+    double any = -1;
+
+    size_t pos = 0;
+    while (pos < accept_encoding.size()) {
+        size_t end = accept_encoding.find(',', pos);
+        if (end == std::string::npos) {
+            end = accept_encoding.size();
+        }
+        size_t semicolon = accept_encoding.find(';', pos);
+        size_t name_end = semicolon < end ? semicolon : end;
+        std::string name = Lowercase(Trim(accept_encoding, pos, name_end));
+        double q = semicolon < end ? QValue(Lowercase(accept_encoding.substr(semicolon + 1, end - semicolon - 1)))
+                                   : 1.0;
+        if (name == "gzip" || name == "x-gzip") {
+            gzip = q;
+        } else if (name == "deflate") {
+            deflate = q;
+        } else if (name == "*") {
+            any = q;
+        }
+        pos = end + 1;
+    }
+
+    if (gzip < 0) {
+        gzip = any;
+    }
+    if (deflate < 0) {
+        deflate = any;
+    }
+    if (gzip <= 0 && deflate <= 0) {
+        return ContentCoding::Identity;
+    }
+    return gzip >= deflate ? ContentCoding::Gzip : ContentCoding::Deflate;
+}
+
+const char* CodingName(ContentCoding coding) {
+    switch (coding) {
+        case ContentCoding::Gzip: return "gzip";
+        case ContentCoding::Deflate: return "deflate";
+        default: return "identity";
+    }
+}
+
+std::string Compress(const std::string& data, ContentCoding coding, int level) {
+    if (coding == ContentCoding::Identity) {
+        return data;
+    }
+
+    // windowBits 15 is the zlib wrapper; +16 asks for a gzip header instead
+    z_stream stream{};
+    int window_bits = coding == ContentCoding::Gzip ? 15 + 16 : 15;
+    if (deflateInit2(&stream, level, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        throw std::runtime_error("deflateInit2 failed");
+    }
+
+    // deflateBound covers the whole output, so one Z_FINISH call does it
+    std::string out(deflateBound(&stream, static_cast<uLong>(data.size())) + 32, '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    stream.avail_out = static_cast<uInt>(out.size());
+    int result = deflate(&stream, Z_FINISH);
+    size_t written = out.size() - stream.avail_out;
+    deflateEnd(&stream);
+    if (result != Z_STREAM_END) {
+        throw std::runtime_error("deflate failed");
+    }
+    out.resize(written);
+    return out;
+}
+
+bool IsCompressibleType(const std::string& content_type) {
+    std::string type = Lowercase(content_type.substr(0, content_type.find(';')));
+    type = Trim(type, 0, type.size());
+    auto ends_with = [&type](const std::string& suffix) {
+        return type.size() >= suffix.size() && type.compare(type.size() - suffix.size(), suffix.size(), suffix) == 0;
+    };
+    return type.compare(0, 5, "text/") == 0 ||
+           type == "application/json" || type == "application/javascript" ||
+           type == "application/xml" || type == "image/svg+xml" ||
+           ends_with("+json") || ends_with("+xml");
+}
+
+ResponseCompressor::ResponseCompressor(int level, size_t min_size, size_t cache_bytes)
+    : level_(level), min_size_(min_size), cache_bytes_(cache_bytes) {
+    if (level < 1 || level > 9) {
+        throw std::invalid_argument("Compression level must be between 1 and 9");
+    }
+}
+
+void ResponseCompressor::Apply(const std::string& accept_encoding, HttpResponse& response) {
+    HttpStatus status = response.GetStatus();
+    if (status == HttpStatus::NO_CONTENT || status == HttpStatus::NOT_MODIFIED ||
+        status == HttpStatus::SWITCHING_PROTOCOLS || response.GetFileBody()) {
+        return;
+    }
+    const std::string& body = response.GetBody();
+    if (body.size() < min_size_ || !IsCompressibleType(response.GetHeader("Content-Type")) ||
+        !response.GetHeader("Content-Encoding").empty()) {
+        return;
+    }
+
+    // The representation depends on the request's Accept-Encoding, for
+    // whichever cache sits in between
+    response.SetHeader("Vary", "Accept-Encoding");
+    ContentCoding coding = NegotiateCoding(accept_encoding);
+    if (coding == ContentCoding::Identity) {
+        return;
+    }
+
+    std::shared_ptr<const std::string> encoded;
+    if (const std::shared_ptr<const std::string>& shared = response.GetSharedBody()) {
+        encoded = EncodeShared(shared, coding);
+    } else {
+        std::string compressed = Compress(body, coding, level_);
+        if (compressed.size() < body.size()) {
+            encoded = std::make_shared<const std::string>(std::move(compressed));
+        }
+    }
+    if (!encoded) {
+        return;
+    }
+
+    compressed_.fetch_add(1, std::memory_order_relaxed);
+    bytes_in_.fetch_add(body.size(), std::memory_order_relaxed);
+    bytes_out_.fetch_add(encoded->size(), std::memory_order_relaxed);
+    response.SetEncodedBody(std::move(encoded), CodingName(coding));
+}
+
+std::shared_ptr<const std::string> ResponseCompressor::EncodeShared(const std::shared_ptr<const std::string>& body,
+                                                                    ContentCoding coding) {
+    const size_t slot = Slot(coding);
+    auto compress = [this, &body, coding]() -> std::shared_ptr<const std::string> {
+        std::string compressed = Compress(*body, coding, level_);
+        if (compressed.size() >= body->size()) {
+            return nullptr;
+        }
+        return std::make_shared<const std::string>(std::move(compressed));
+    };
+    if (cache_bytes_ == 0) {
+        return compress();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = cache_.find(body.get());
+        if (it != cache_.end() && !it->second.source.expired() && it->second.tried[slot]) {
+            if (it->second.encoded[slot]) {
+                cache_hits_.fetch_add(1, std::memory_order_relaxed);
+            }
+            return it->second.encoded[slot];
+        }
+    }
+
+    // Compressed outside the lock; two threads racing on a new body both
+    // compress it, and the first to finish is kept
+    std::shared_ptr<const std::string> encoded = compress();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t size = (encoded ? encoded->size() : 0) + kEntryOverhead;
+    if (cached_bytes_ + size > cache_bytes_) {
+        DropExpired();
+        if (cached_bytes_ + size > cache_bytes_) {
+            return encoded;
+        }
+    }
+
+    auto [it, inserted] = cache_.try_emplace(body.get());
+    CachedBody& entry = it->second;
+    if (inserted) {
+        cached_bytes_ += kEntryOverhead;
+    }
+    if (entry.source.expired()) {
+        // New, or left behind by a body since freed at the same address
+        for (auto& stale : entry.encoded) {
+            cached_bytes_ -= stale ? stale->size() : 0;
+            stale.reset();
+        }
+        entry.tried[0] = entry.tried[1] = false;
+        entry.source = body;
+    }
+    if (!entry.tried[slot]) {
+        entry.tried[slot] = true;
+        entry.encoded[slot] = encoded;
+        cached_bytes_ += encoded ? encoded->size() : 0;
+    }
+    return entry.encoded[slot];
+}
+
+void ResponseCompressor::DropExpired() {
+    for (auto it = cache_.begin(); it != cache_.end();) {
+        if (it->second.source.expired()) {
+            for (const auto& encoded : it->second.encoded) {
+                cached_bytes_ -= encoded ? encoded->size() : 0;
+            }
+            cached_bytes_ -= kEntryOverhead;
+            it = cache_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+ResponseCompressor::Stats ResponseCompressor::GetStats() const {
+    Stats stats;
+    stats.compressed = compressed_.load(std::memory_order_relaxed);
+    stats.cache_hits = cache_hits_.load(std::memory_order_relaxed);
+    stats.bytes_in = bytes_in_.load(std::memory_order_relaxed);
+    stats.bytes_out = bytes_out_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+size_t ResponseCompressor::CachedBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return cached_bytes_;
+}
+
+} // namespace http
@@ -14,18 +14,132 @@ Config Config::FromEnv() {
     const char* port = std::getenv("SERVER_PORT");
     if (port) config.port = static_cast<uint16_t>(std::stoi(port));
     
+    const char* listen = std::getenv("LISTEN");
+    if (listen) config.listen = listen;
+    
+    const char* backlog = std::getenv("LISTEN_BACKLOG");
+    if (backlog) config.listen_backlog = std::stoul(backlog);
+    
+    const char* nodelay = std::getenv("TCP_NODELAY");
+    if (nodelay) config.tcp_nodelay = std::string(nodelay) == "1" || std::string(nodelay) == "true";
+    
+    const char* defer_accept = std::getenv("TCP_DEFER_ACCEPT_SECONDS");
+    if (defer_accept) config.tcp_defer_accept_seconds = std::stoul(defer_accept);
+    
+    const char* fastopen = std::getenv("TCP_FASTOPEN_QUEUE");
+    if (fastopen) config.tcp_fastopen_queue = std::stoul(fastopen);
+    
     const char* threads = std::getenv("THREAD_POOL_SIZE");
     if (threads) config.thread_pool_size = std::stoul(threads);
     
+    const char* scheduling = std::getenv("THREAD_POOL_SCHEDULING");
+    if (scheduling) config.thread_pool_scheduling = scheduling;
+    
+    const char* queue = std::getenv("THREAD_POOL_QUEUE");
+    if (queue) config.thread_pool_queue = queue;
+    
+    const char* queue_capacity = std::getenv("THREAD_POOL_QUEUE_CAPACITY");
+    if (queue_capacity) config.thread_pool_queue_capacity = std::stoul(queue_capacity);
+    
+    const char* critical_threads = std::getenv("THREAD_POOL_CRITICAL_THREADS");
+    if (critical_threads) config.thread_pool_critical_threads = std::stoul(critical_threads);
+    
+    const char* bulk_threads = std::getenv("THREAD_POOL_BULK_THREADS");
+    if (bulk_threads) config.thread_pool_bulk_threads = std::stoul(bulk_threads);
+    
+    const char* lane_capacity = std::getenv("THREAD_POOL_LANE_CAPACITY");
+    if (lane_capacity) config.thread_pool_lane_capacity = std::stoul(lane_capacity);
+    
+    const char* max_size = std::getenv("THREAD_POOL_MAX_SIZE");
+    if (max_size) config.thread_pool_max_size = std::stoul(max_size);
+    
+    const char* grow_after = std::getenv("THREAD_POOL_GROW_AFTER_MS");
+    if (grow_after) config.thread_pool_grow_after_ms = std::stoul(grow_after);
+    
+    const char* idle_timeout = std::getenv("THREAD_POOL_IDLE_TIMEOUT_MS");
+    if (idle_timeout) config.thread_pool_idle_timeout_ms = std::stoul(idle_timeout);
+    
     const char* max_conn = std::getenv("MAX_CONNECTIONS");
     if (max_conn) config.max_connections = std::stoul(max_conn);
     
+    const char* max_request = std::getenv("MAX_REQUEST_SIZE");
+    if (max_request) config.max_request_size = std::stoul(max_request);
+    
+    const char* high_water = std::getenv("SEND_HIGH_WATER_MARK");
+    if (high_water) config.send_high_water_mark = std::stoul(high_water);
+    
+    const char* request_timeout = std::getenv("REQUEST_TIMEOUT_SECONDS");
+    if (request_timeout) config.request_timeout_seconds = std::stoul(request_timeout);
+    
+    const char* keep_alive = std::getenv("KEEP_ALIVE_TIMEOUT_SECONDS");
+    if (keep_alive) config.keep_alive_timeout_seconds = std::stoul(keep_alive);
+    
+    const char* max_requests = std::getenv("MAX_REQUESTS_PER_CONNECTION");
+    if (max_requests) config.max_requests_per_connection = std::stoul(max_requests);
+    
+    const char* delay_target = std::getenv("QUEUE_DELAY_TARGET_MS");
+    if (delay_target) config.queue_delay_target_ms = std::stoul(delay_target);
+    
+    const char* delay_interval = std::getenv("QUEUE_DELAY_INTERVAL_MS");
+    if (delay_interval) config.queue_delay_interval_ms = std::stoul(delay_interval);
+    
+    const char* retry_after = std::getenv("RETRY_AFTER_SECONDS");
+    if (retry_after) config.retry_after_seconds = std::stoul(retry_after);
+    
+    const char* http2 = std::getenv("HTTP2");
+    if (http2) config.http2 = std::string(http2) == "1" || std::string(http2) == "true";
+    
+    const char* max_streams = std::getenv("HTTP2_MAX_CONCURRENT_STREAMS");
+    if (max_streams) config.http2_max_concurrent_streams = std::stoul(max_streams);
+    
+    const char* max_resets = std::getenv("HTTP2_MAX_RESETS");
+    if (max_resets) config.http2_max_resets = std::stoul(max_resets);
+    
     const char* log_file = std::getenv("LOG_FILE");
     if (log_file) config.log_file = log_file;
     
     const char* static_dir = std::getenv("STATIC_DIRECTORY");
     if (static_dir) config.static_directory = static_dir;
     
+    const char* static_cache = std::getenv("STATIC_CACHE_BYTES");
+    if (static_cache) config.static_cache_bytes = std::stoul(static_cache);
+    
+    const char* compression_level = std::getenv("COMPRESSION_LEVEL");
+    if (compression_level) config.compression_level = std::stoi(compression_level);
+    
+    const char* compression_min_size = std::getenv("COMPRESSION_MIN_SIZE");
+    if (compression_min_size) config.compression_min_size = std::stoul(compression_min_size);
+    
+    const char* compression_cache = std::getenv("COMPRESSION_CACHE_BYTES");
+    if (compression_cache) config.compression_cache_bytes = std::stoul(compression_cache);
+    
+    const char* backend = std::getenv("EVENT_LOOP_BACKEND");
+    if (backend) config.event_loop_backend = backend;
+    
+    const char* reactors = std::getenv("REACTOR_COUNT");
+    if (reactors) config.reactor_count = std::stoul(reactors);
+    
+    const char* pin = std::getenv("PIN_REACTORS");
+    if (pin) config.pin_reactors = std::string(pin) == "1" || std::string(pin) == "true";
+    
+    const char* pin_workers = std::getenv("PIN_WORKERS");
+    if (pin_workers) config.pin_workers = std::string(pin_workers) == "1" || std::string(pin_workers) == "true";
+    
+    const char* reactor_cpus = std::getenv("REACTOR_CPUS");
+    if (reactor_cpus) config.reactor_cpus = reactor_cpus;
+    
+    const char* worker_cpus = std::getenv("WORKER_CPUS");
+    if (worker_cpus) config.worker_cpus = worker_cpus;
+    
+    const char* numa_node = std::getenv("NUMA_NODE");
+    if (numa_node) config.numa_node = std::stoi(numa_node);
+    
+    const char* thread_name_prefix = std::getenv("THREAD_NAME_PREFIX");
+    if (thread_name_prefix) config.thread_name_prefix = thread_name_prefix;
+    
+    const char* busy_poll = std::getenv("BUSY_POLL_US");
+    if (busy_poll) config.busy_poll_us = std::stoul(busy_poll);
+    
     return config;
 }
 
@@ -53,10 +167,48 @@ Config Config::FromFile(const std::string& file_path) {
             
             if (key == "host") config.host = value;
             else if (key == "port") config.port = static_cast<uint16_t>(std::stoi(value));
+            else if (key == "listen") config.listen = value;
+            else if (key == "listen_backlog") config.listen_backlog = std::stoul(value);
+            else if (key == "tcp_nodelay") config.tcp_nodelay = (value == "1" || value == "true");
+            else if (key == "tcp_defer_accept_seconds") config.tcp_defer_accept_seconds = std::stoul(value);
+            else if (key == "tcp_fastopen_queue") config.tcp_fastopen_queue = std::stoul(value);
             else if (key == "thread_pool_size") config.thread_pool_size = std::stoul(value);
+            else if (key == "thread_pool_scheduling") config.thread_pool_scheduling = value;
+            else if (key == "thread_pool_queue") config.thread_pool_queue = value;
+            else if (key == "thread_pool_queue_capacity") config.thread_pool_queue_capacity = std::stoul(value);
+            else if (key == "thread_pool_critical_threads") config.thread_pool_critical_threads = std::stoul(value);
+            else if (key == "thread_pool_bulk_threads") config.thread_pool_bulk_threads = std::stoul(value);
+            else if (key == "thread_pool_lane_capacity") config.thread_pool_lane_capacity = std::stoul(value);
+            else if (key == "thread_pool_max_size") config.thread_pool_max_size = std::stoul(value);
+            else if (key == "thread_pool_grow_after_ms") config.thread_pool_grow_after_ms = std::stoul(value);
+            else if (key == "thread_pool_idle_timeout_ms") config.thread_pool_idle_timeout_ms = std::stoul(value);
             else if (key == "max_connections") config.max_connections = std::stoul(value);
+            else if (key == "max_request_size") config.max_request_size = std::stoul(value);
+            else if (key == "send_high_water_mark") config.send_high_water_mark = std::stoul(value);
+            else if (key == "request_timeout_seconds") config.request_timeout_seconds = std::stoul(value);
+            else if (key == "keep_alive_timeout_seconds") config.keep_alive_timeout_seconds = std::stoul(value);
+            else if (key == "max_requests_per_connection") config.max_requests_per_connection = std::stoul(value);
+            else if (key == "queue_delay_target_ms") config.queue_delay_target_ms = std::stoul(value);
+            else if (key == "queue_delay_interval_ms") config.queue_delay_interval_ms = std::stoul(value);
+            else if (key == "retry_after_seconds") config.retry_after_seconds = std::stoul(value);
+            else if (key == "http2") config.http2 = (value == "1" || value == "true");
+            else if (key == "http2_max_concurrent_streams") config.http2_max_concurrent_streams = std::stoul(value);
+            else if (key == "http2_max_resets") config.http2_max_resets = std::stoul(value);
             else if (key == "log_file") config.log_file = value;
             else if (key == "static_directory") config.static_directory = value;
+            else if (key == "static_cache_bytes") config.static_cache_bytes = std::stoul(value);
+            else if (key == "compression_level") config.compression_level = std::stoi(value);
+            else if (key == "compression_min_size") config.compression_min_size = std::stoul(value);
+            else if (key == "compression_cache_bytes") config.compression_cache_bytes = std::stoul(value);
+            else if (key == "event_loop_backend") config.event_loop_backend = value;
+            else if (key == "reactor_count") config.reactor_count = std::stoul(value);
+            else if (key == "pin_reactors") config.pin_reactors = (value == "1" || value == "true");
+            else if (key == "pin_workers") config.pin_workers = (value == "1" || value == "true");
+            else if (key == "reactor_cpus") config.reactor_cpus = value;
+            else if (key == "worker_cpus") config.worker_cpus = value;
+            else if (key == "numa_node") config.numa_node = std::stoi(value);
+            else if (key == "thread_name_prefix") config.thread_name_prefix = value;
+            else if (key == "busy_poll_us") config.busy_poll_us = std::stoul(value);
         }
     }
     
@@ -6,15 +6,49 @@
 
 namespace http {
 
-Connection::Connection(int fd) : fd_(fd), addr_initialized_(false) {
+PeerAddress PeerAddress::Of(int fd) {
+    PeerAddress peer;
+    peer.length = sizeof(peer.storage);
+    if (getpeername(fd, reinterpret_cast<struct sockaddr*>(&peer.storage), &peer.length) != 0) {
+        peer.length = 0;
+    }
+    return peer;
+}
+
+std::string PeerAddress::Host() const {
+    char host[INET6_ADDRSTRLEN];
+    if (length > 0 && storage.ss_family == AF_INET) {
+        const auto* addr = reinterpret_cast<const struct sockaddr_in*>(&storage);
+        if (inet_ntop(AF_INET, &addr->sin_addr, host, sizeof(host))) {
+            return host;
+        }
+    } else if (length > 0 && storage.ss_family == AF_INET6) {
+        const auto* addr = reinterpret_cast<const struct sockaddr_in6*>(&storage);
+        if (inet_ntop(AF_INET6, &addr->sin6_addr, host, sizeof(host))) {
+            return host;
+        }
+    } else if (length > 0 && storage.ss_family == AF_UNIX) {
+        return "unix";
+    }
+    return "unknown";
+}
+
+uint16_t PeerAddress::Port() const {
+    if (length > 0 && storage.ss_family == AF_INET) {
+        return ntohs(reinterpret_cast<const struct sockaddr_in*>(&storage)->sin_port);
+    }
+    if (length > 0 && storage.ss_family == AF_INET6) {
+        return ntohs(reinterpret_cast<const struct sockaddr_in6*>(&storage)->sin6_port);
+    }
+    return 0;
+}
+
+Connection::Connection(int fd) : fd_(fd) {
     if (fd_ < 0) {
         throw std::invalid_argument("Invalid file descriptor");
     }
     
-    socklen_t addr_len = sizeof(addr_);
-    if (getpeername(fd_, reinterpret_cast<struct sockaddr*>(&addr_), &addr_len) == 0) {
-        addr_initialized_ = true;
-    }
+    peer_ = PeerAddress::Of(fd_);
 }
 
 Connection::~Connection() {
@@ -23,36 +57,28 @@ Connection::~Connection() {
 
 Connection::Connection(Connection&& other) noexcept
     : fd_(other.fd_),
-      addr_(other.addr_),
-      addr_initialized_(other.addr_initialized_) {
+      peer_(other.peer_) {
     other.fd_ = -1;
-    other.addr_initialized_ = false;
+    other.peer_ = PeerAddress{};
 }
 
 Connection& Connection::operator=(Connection&& other) noexcept {
     if (this != &other) {
         Close();
         fd_ = other.fd_;
-        addr_ = other.addr_;
-        addr_initialized_ = other.addr_initialized_;
+        peer_ = other.peer_;
         other.fd_ = -1;
-        other.addr_initialized_ = false;
+        other.peer_ = PeerAddress{};
     }
     return *this;
 }
 
 std::string Connection::GetRemoteAddress() const {
-    if (!addr_initialized_) {
-        return "unknown";
-    }
-    return inet_ntoa(addr_.sin_addr);
+    return peer_.Host();
 }
 
 uint16_t Connection::GetRemotePort() const {
-    if (!addr_initialized_) {
-        return 0;
-    }
-    return ntohs(addr_.sin_port);
+    return peer_.Port();
 }
 
 ssize_t Connection::Read(char* buffer, size_t size) {
@@ -74,6 +100,12 @@ void Connection::Close() {
     }
 }
 
+int Connection::Release() {
+    int fd = fd_;
+    fd_ = -1;
+    return fd;
+}
+
 void Connection::SetNonBlocking(bool non_blocking) {
     int flags = fcntl(fd_, F_GETFL, 0);
     if (flags == -1) {
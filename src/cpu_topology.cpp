@@ -0,0 +1,216 @@
+#include "cpu_topology.hpp"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <pthread.h>
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#include <mach/thread_policy.h>
+#elif defined(__linux__)
+#include <sched.h>
+#endif
+
+namespace http {
+
+namespace {
+
+// Linux refuses longer names rather than truncating them
+constexpr size_t kMaxThreadName = 15;
+
+bool ReadUnsigned(const std::filesystem::path& path, unsigned& value) {
+    std::ifstream file(path);
+    return static_cast<bool>(file >> value);
+}
+
+unsigned ParseNumber(const std::string& list, size_t begin, size_t end) {
+    if (begin == end) {
+        throw std::invalid_argument("Malformed CPU list: " + list);
+    }
+    unsigned value = 0;
+    for (size_t i = begin; i < end; ++i) {
+        if (!std::isdigit(static_cast<unsigned char>(list[i]))) {
+            throw std::invalid_argument("Malformed CPU list: " + list);
+        }
+        value = value * 10 + static_cast<unsigned>(list[i] - '0');
+    }
+    return value;
+}
+
+// The NUMA node a sysfs CPU directory links to (a "nodeN" entry), or 0
+unsigned NodeOf(const std::filesystem::path& cpu_dir) {
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(cpu_dir, error)) {
+        const std::string name = entry.path().filename().string();
+        if (name.size() > 4 && name.compare(0, 4, "node") == 0 &&
+            std::all_of(name.begin() + 4, name.end(), [](unsigned char c) { return std::isdigit(c); })) {
+            return static_cast<unsigned>(std::stoul(name.substr(4)));
+        }
+    }
+    return 0;
+}
+
+} // namespace
+
+std::vector<unsigned> ParseCpuList(const std::string& list) {
+    std::set<unsigned> cpus;
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+        size_t begin = pos;
+        size_t stop = end;
+        while (begin < stop && std::isspace(static_cast<unsigned char>(list[begin]))) {
+            ++begin;
+        }
+        while (stop > begin && std::isspace(static_cast<unsigned char>(list[stop - 1]))) {
+            --stop;
+        }
+        if (begin < stop) {
+            size_t dash = list.find('-', begin);
+            if (dash < stop) {
+                unsigned first = ParseNumber(list, begin, dash);
+                unsigned last = ParseNumber(list, dash + 1, stop);
+                if (last < first) {
+                    throw std::invalid_argument("Malformed CPU list: " + list);
+                }
+                for (unsigned cpu = first; cpu <= last; ++cpu) {
+                    cpus.insert(cpu);
+                }
+            } else {
+                cpus.insert(ParseNumber(list, begin, stop));
+            }
+        } else if (end < list.size()) {
+            throw std::invalid_argument("Malformed CPU list: " + list);
+        }
+        pos = end + 1;
+    }
+    return std::vector<unsigned>(cpus.begin(), cpus.end());
+}
+
+CpuTopology CpuTopology::Discover(const std::string& sysfs_root) {
+    const std::filesystem::path root(sysfs_root);
+    std::vector<unsigned> online;
+    std::ifstream online_file(root / "online");
+    std::string line;
+    if (online_file && std::getline(online_file, line)) {
+        try {
+            online = ParseCpuList(line);
+        } catch (const std::invalid_argument&) {
+            online.clear();
+        }
+    }
+
+    std::vector<CpuInfo> cpus;
+    for (unsigned id : online) {
+        const std::filesystem::path dir = root / ("cpu" + std::to_string(id));
+        CpuInfo cpu;
+        cpu.id = id;
+        if (!ReadUnsigned(dir / "topology" / "core_id", cpu.core)) {
+            cpu.core = id;
+        }
+        if (!ReadUnsigned(dir / "topology" / "physical_package_id", cpu.package)) {
+            cpu.package = 0;
+        }
+        cpu.node = NodeOf(dir);
+        cpus.push_back(cpu);
+    }
+
+    if (cpus.empty()) {
+        unsigned count = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned id = 0; id < count; ++id) {
+            CpuInfo cpu;
+            cpu.id = id;
+            cpu.core = id;
+            cpus.push_back(cpu);
+        }
+    }
+    return CpuTopology(std::move(cpus));
+}
+
+CpuTopology::CpuTopology(std::vector<CpuInfo> cpus) : cpus_(std::move(cpus)) {
+    std::sort(cpus_.begin(), cpus_.end(), [](const CpuInfo& a, const CpuInfo& b) { return a.id < b.id; });
+}
+
+size_t CpuTopology::NodeCount() const {
+    std::set<unsigned> nodes;
+    for (const CpuInfo& cpu : cpus_) {
+        nodes.insert(cpu.node);
+    }
+    return nodes.size();
+}
+
+std::vector<unsigned> CpuTopology::NodeCpus(unsigned node) const {
+    std::vector<unsigned> ids;
+    for (const CpuInfo& cpu : cpus_) {
+        if (cpu.node == node) {
+            ids.push_back(cpu.id);
+        }
+    }
+    return ids;
+}
+
+std::vector<unsigned> CpuTopology::PlacementOrder(const std::vector<unsigned>& allowed) const {
+    // A CPU's rank among its core's hyperthreads: 0 for the lowest id
+    std::map<std::pair<unsigned, unsigned>, unsigned> siblings;
+    std::vector<std::tuple<unsigned, unsigned, unsigned, unsigned, unsigned>> order;
+    for (const CpuInfo& cpu : cpus_) {
+        unsigned rank = siblings[{cpu.package, cpu.core}]++;
+        if (allowed.empty() || std::find(allowed.begin(), allowed.end(), cpu.id) != allowed.end()) {
+            order.emplace_back(cpu.node, rank, cpu.package, cpu.core, cpu.id);
+        }
+    }
+    std::sort(order.begin(), order.end());
+
+    std::vector<unsigned> ids;
+    for (const auto& entry : order) {
+        ids.push_back(std::get<4>(entry));
+    }
+    return ids;
+}
+
+bool PinCurrentThread(const std::vector<unsigned>& cpus) {
+    if (cpus.empty()) {
+        return false;
+    }
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (unsigned cpu : cpus) {
+        if (cpu >= CPU_SETSIZE) {
+            return false;
+        }
+        CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#elif defined(__APPLE__)
+    thread_affinity_policy_data_t policy = { static_cast<integer_t>(cpus.front() + 1) };
+    mach_port_t thread = pthread_mach_thread_np(pthread_self());
+    return thread_policy_set(thread, THREAD_AFFINITY_POLICY,
+                             reinterpret_cast<thread_policy_t>(&policy),
+                             THREAD_AFFINITY_POLICY_COUNT) == KERN_SUCCESS;
+#else
+    return false;
+#endif
+}
+
+void SetCurrentThreadName(const std::string& name) {
+    const std::string truncated = name.substr(0, kMaxThreadName);
+#if defined(__APPLE__)
+    pthread_setname_np(truncated.c_str());
+#elif defined(__linux__)
+    pthread_setname_np(pthread_self(), truncated.c_str());
+#else
+    (void)truncated;
+#endif
+}
+
+} // namespace http
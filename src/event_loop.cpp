@@ -1,123 +1,980 @@
 #include "event_loop.hpp"
+#include "poller.hpp"
 #include <stdexcept>
 #include <iostream>
 #include <unordered_map>
+#include <algorithm>
 #include <errno.h>
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#endif
 
 namespace http {
 
-EventLoop::EventLoop() : running_(false) {
-    kqueue_fd_ = kqueue();
-    if (kqueue_fd_ == -1) {
-        throw std::runtime_error("Failed to create kqueue");
+namespace {
+
+// Operation tags travel in 24 bits of io_uring user_data
+constexpr uint32_t kTagMask = 0xFFFFFF;
+
+constexpr uint32_t kIoMask = kPollReadable | kPollWritable;
+
+uint32_t ModeBits(TriggerMode mode) {
+    switch (mode) {
+        case TriggerMode::Edge: return kPollEdge;
+        case TriggerMode::OneShot: return kPollOneShot;
+        default: return 0;
     }
 }
 
-EventLoop::~EventLoop() {
-    if (kqueue_fd_ >= 0) {
-        close(kqueue_fd_);
+#if defined(MSG_NOSIGNAL)
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = 0;
+#endif
+
+// Per-call cork: Linux holds a partial segment until a send without it
+#if defined(MSG_MORE)
+constexpr int kMoreFlag = MSG_MORE;
+#else
+constexpr int kMoreFlag = 0;
+#endif
+
+// Sends up to length bytes of file_fd from offset on a non-blocking socket;
+// returns the bytes sent, or -1 with errno set
+ssize_t SendFileRange(int socket_fd, int file_fd, off_t offset, size_t length) {
+#if defined(__linux__)
+    return sendfile(socket_fd, file_fd, &offset, length);
+#elif defined(__APPLE__)
+    off_t sent = static_cast<off_t>(length);
+    if (sendfile(file_fd, socket_fd, offset, &sent, nullptr, 0) == -1 && sent == 0) {
+        return -1;
     }
+    return static_cast<ssize_t>(sent);
+#elif defined(__FreeBSD__)
+    off_t sent = 0;
+    if (sendfile(file_fd, socket_fd, offset, length, nullptr, &sent, 0) == -1 && sent == 0) {
+        return -1;
+    }
+    return static_cast<ssize_t>(sent);
+#else
+    char buffer[64 * 1024];
+    ssize_t count = pread(file_fd, buffer, std::min(length, sizeof(buffer)), offset);
+    if (count <= 0) {
+        return count;
+    }
+    return send(socket_fd, buffer, static_cast<size_t>(count), kSendFlags);
+#endif
+}
+
+// Single-writer counters: a plain load/store avoids a locked add
+void Bump(std::atomic<uint64_t>& counter, uint64_t amount = 1) {
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+uint64_t ElapsedNs(std::chrono::steady_clock::time_point since,
+                   std::chrono::steady_clock::time_point until) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(until - since).count());
+}
+
+uint64_t SendKey(int fd, uint32_t tag) {
+    return (static_cast<uint64_t>(tag) << 32) | static_cast<uint32_t>(fd);
+}
+
+} // namespace
+
+EventBackend ParseEventBackend(const std::string& name) {
+    if (name.empty() || name == "auto") return EventBackend::Default;
+    if (name == "kqueue") return EventBackend::Kqueue;
+    if (name == "epoll") return EventBackend::Epoll;
+    if (name == "io_uring" || name == "uring") return EventBackend::IoUring;
+    throw std::invalid_argument("Unknown event loop backend: " + name);
+}
+
+EventLoop::EventLoop(EventBackend backend)
+    : EventLoop(Poller::Create(backend)) {
 }
 
+EventLoop::EventLoop(std::unique_ptr<Poller> poller)
+    : poller_(std::move(poller)),
+      running_(false),
+      events_(kInitialBatch),
+      next_tag_(0),
+      epoch_(std::chrono::steady_clock::now()),
+      timers_(0),
+      inbox_(std::make_unique<MpscQueue<Task>>()),
+      wake_pending_(false),
+      busy_poll_(0),
+      send_high_water_mark_(0),
+      sparse_batches_(0),
+      counters_(std::make_unique<Counters>()) {
+    counters_->batch_size.store(events_.size(), std::memory_order_relaxed);
+}
+
+EventLoop::~EventLoop() = default;
+
 EventLoop::EventLoop(EventLoop&& other) noexcept
-    : kqueue_fd_(other.kqueue_fd_),
-      running_(other.running_),
-      read_callbacks_(std::move(other.read_callbacks_)),
-      write_callbacks_(std::move(other.write_callbacks_)) {
-    other.kqueue_fd_ = -1;
+    : poller_(std::move(other.poller_)),
+      running_(other.running_.load()),
+      events_(std::move(other.events_)),
+      records_(std::move(other.records_)),
+      retired_records_(std::move(other.retired_records_)),
+      free_records_(std::move(other.free_records_)),
+      retired_callbacks_(std::move(other.retired_callbacks_)),
+      retired_sends_(std::move(other.retired_sends_)),
+      receive_buffer_(std::move(other.receive_buffer_)),
+      next_tag_(other.next_tag_),
+      epoch_(other.epoch_),
+      timers_(std::move(other.timers_)),
+      inbox_(std::move(other.inbox_)),
+      wake_pending_(other.wake_pending_.load()),
+      loop_thread_(other.loop_thread_.load()),
+      busy_poll_(other.busy_poll_),
+      send_high_water_mark_(other.send_high_water_mark_),
+      sparse_batches_(other.sparse_batches_),
+      counters_(std::move(other.counters_)) {
     other.running_ = false;
 }
 
 EventLoop& EventLoop::operator=(EventLoop&& other) noexcept {
     if (this != &other) {
-        if (kqueue_fd_ >= 0) {
-            close(kqueue_fd_);
-        }
-        kqueue_fd_ = other.kqueue_fd_;
-        running_ = other.running_;
-        read_callbacks_ = std::move(other.read_callbacks_);
-        write_callbacks_ = std::move(other.write_callbacks_);
-        other.kqueue_fd_ = -1;
+        poller_ = std::move(other.poller_);
+        running_ = other.running_.load();
+        events_ = std::move(other.events_);
+        records_ = std::move(other.records_);
+        retired_records_ = std::move(other.retired_records_);
+        free_records_ = std::move(other.free_records_);
+        retired_callbacks_ = std::move(other.retired_callbacks_);
+        retired_sends_ = std::move(other.retired_sends_);
+        receive_buffer_ = std::move(other.receive_buffer_);
+        next_tag_ = other.next_tag_;
+        epoch_ = other.epoch_;
+        timers_ = std::move(other.timers_);
+        inbox_ = std::move(other.inbox_);
+        wake_pending_ = other.wake_pending_.load();
+        loop_thread_ = other.loop_thread_.load();
+        busy_poll_ = other.busy_poll_;
+        send_high_water_mark_ = other.send_high_water_mark_;
+        sparse_batches_ = other.sparse_batches_;
+        counters_ = std::move(other.counters_);
         other.running_ = false;
     }
     return *this;
 }
 
-void EventLoop::RegisterRead(int fd, EventCallback callback) {
-    struct kevent change_event;
-    EV_SET(&change_event, fd, EVFILT_READ, EV_ADD | EV_ENABLE, 0, 0, nullptr);
-    
-    if (kevent(kqueue_fd_, &change_event, 1, nullptr, 0, nullptr) == -1) {
-        throw std::runtime_error("Failed to register read event");
+EventLoop::FdRecord* EventLoop::Find(int fd) const {
+    if (fd < 0 || static_cast<size_t>(fd) >= records_.size()) {
+        return nullptr;
     }
-    
-    read_callbacks_[fd] = std::move(callback);
+    return records_[fd].get();
 }
 
-void EventLoop::RegisterWrite(int fd, EventCallback callback) {
-    struct kevent change_event;
-    EV_SET(&change_event, fd, EVFILT_WRITE, EV_ADD | EV_ENABLE, 0, 0, nullptr);
-    
-    if (kevent(kqueue_fd_, &change_event, 1, nullptr, 0, nullptr) == -1) {
-        throw std::runtime_error("Failed to register write event");
+EventLoop::FdRecord& EventLoop::RecordFor(int fd) {
+    if (fd < 0) {
+        throw std::invalid_argument("Invalid file descriptor");
     }
-    
-    write_callbacks_[fd] = std::move(callback);
+    if (static_cast<size_t>(fd) >= records_.size()) {
+        records_.resize(std::max(static_cast<size_t>(fd) + 1, records_.size() * 2));
+    }
+    auto& record = records_[fd];
+    if (!record) {
+        if (!free_records_.empty()) {
+            record = std::move(free_records_.back());
+            free_records_.pop_back();
+        } else {
+            record = std::make_unique<FdRecord>();
+        }
+        record->fd = fd;
+    }
+    return *record;
+}
+
+void EventLoop::UpdateInterest(FdRecord& record, uint32_t interest) {
+    poller_->Update(record.fd, record.interest, interest, &record);
+    record.interest = interest;
+}
+
+void EventLoop::RegisterRead(int fd, EventCallback callback, TriggerMode mode) {
+    FdRecord& record = RecordFor(fd);
+    // A fired one-shot registration keeps nothing armed
+    uint32_t armed = record.interest & kIoMask;
+    uint32_t interest = armed | kPollReadable | ModeBits(mode);
+
+    UpdateInterest(record, interest);
+    record.read = std::move(callback);
+}
+
+void EventLoop::RegisterWrite(int fd, EventCallback callback, TriggerMode mode) {
+    FdRecord& record = RecordFor(fd);
+    // A fired one-shot registration keeps nothing armed
+    uint32_t armed = record.interest & kIoMask;
+    uint32_t interest = armed | kPollWritable | ModeBits(mode);
+
+    UpdateInterest(record, interest);
+    record.write = std::move(callback);
 }
 
 void EventLoop::Unregister(int fd) {
-    struct kevent change_event;
-    EV_SET(&change_event, fd, EVFILT_READ, EV_DELETE, 0, 0, nullptr);
-    kevent(kqueue_fd_, &change_event, 1, nullptr, 0, nullptr);
-    
-    EV_SET(&change_event, fd, EVFILT_WRITE, EV_DELETE, 0, 0, nullptr);
-    kevent(kqueue_fd_, &change_event, 1, nullptr, 0, nullptr);
-    
-    read_callbacks_.erase(fd);
-    write_callbacks_.erase(fd);
+    FdRecord* record = Find(fd);
+    if (!record) {
+        return;
+    }
+
+    if (record->tag != 0 && poller_->SupportsCompletionIo()) {
+        poller_->Cancel(fd);
+        SendQueue* sends = record->sends.get();
+        if (sends && sends->in_flight > 0) {
+            // The kernel may read these buffers until the chain completes
+            retired_sends_[SendKey(fd, record->tag)] = std::move(record->sends);
+        }
+    }
+
+    if (record->interest != 0) {
+        UpdateInterest(*record, 0);
+    }
+
+    // Callers holding the record across a callback compare tags to notice
+    record->tag = 0;
+    retired_records_.push_back(std::move(records_[fd]));
+}
+
+void EventLoop::Rearm(int fd) {
+    FdRecord* record = Find(fd);
+    if (record && record->interest == kPollOneShot && record->rearm != 0) {
+        UpdateInterest(*record, record->rearm);
+    }
+}
+
+EventLoop::FdRecord& EventLoop::OpsFor(int fd) {
+    FdRecord& record = RecordFor(fd);
+    if (record.tag == 0) {
+        next_tag_ = (next_tag_ + 1) & kTagMask;
+        if (next_tag_ == 0) {
+            next_tag_ = 1;
+        }
+        record.tag = next_tag_;
+    }
+    return record;
+}
+
+void EventLoop::Accept(int listen_fd, AcceptCallback callback) {
+    FdRecord& ops = OpsFor(listen_fd);
+    bool armed = static_cast<bool>(ops.accept);
+    ops.accept = std::move(callback);
+    if (armed) {
+        return;
+    }
+
+    if (poller_->SupportsCompletionIo()) {
+        poller_->StartAccept(listen_fd, ops.tag);
+    } else {
+        RegisterRead(listen_fd, [this](int fd, EventType /*type*/) {
+            AcceptReady(fd);
+        });
+    }
+}
+
+void EventLoop::Receive(int fd, ReceiveCallback callback) {
+    FdRecord& ops = OpsFor(fd);
+    bool armed = static_cast<bool>(ops.receive);
+    ops.receive = std::move(callback);
+    if (armed) {
+        return;
+    }
+
+    if (poller_->SupportsCompletionIo()) {
+        poller_->StartReceive(fd, ops.tag);
+    } else {
+        RegisterRead(fd, [this](int fd, EventType /*type*/) {
+            ReceiveReady(fd);
+        });
+    }
+}
+
+void EventLoop::Send(int fd, std::string data, SendCallback callback) {
+    Send(fd, std::move(data), std::string(), std::move(callback));
+}
+
+void EventLoop::Send(int fd, std::string head, std::string body, SendCallback callback, bool more) {
+    Enqueue(fd, PendingSend{std::move(head), std::move(body), nullptr, 0, std::move(callback), more, nullptr});
+}
+
+void EventLoop::Send(int fd, std::string head, std::shared_ptr<const std::string> body, SendCallback callback,
+                     bool more) {
+    Enqueue(fd, PendingSend{std::move(head), std::string(), nullptr, 0, std::move(callback), more, std::move(body)});
+}
+
+void EventLoop::SendFile(int fd, std::string head, std::shared_ptr<FileBody> file, SendCallback callback,
+                         bool more) {
+    Enqueue(fd, PendingSend{std::move(head), std::string(), std::move(file), 0, std::move(callback), more, nullptr});
+}
+
+void EventLoop::Enqueue(int fd, PendingSend send) {
+    FdRecord& ops = OpsFor(fd);
+    if (!ops.sends) {
+        ops.sends = std::make_unique<SendQueue>();
+    }
+
+    SendQueue& queue = *ops.sends;
+    if (queue.failed) {
+        if (send.callback) {
+            send.callback(fd, -EPIPE);
+        }
+        return;
+    }
+
+    // Refuse to buffer more for a peer that is not reading
+    if (send_high_water_mark_ > 0 && queue.queued_bytes >= send_high_water_mark_) {
+        if (send.callback) {
+            send.callback(fd, -ENOBUFS);
+        }
+        return;
+    }
+
+    queue.queued_bytes += send.Size();
+    queue.pending.push_back(std::move(send));
+
+    if (poller_->SupportsCompletionIo()) {
+        if (queue.in_flight == 0) {
+            SubmitSends(fd, ops);
+        }
+    } else if (queue.pending.size() == 1) {
+        // Anything already queued is waiting for writability
+        FlushSends(fd);
+    }
+}
+
+size_t EventLoop::PendingSendBytes(int fd) const {
+    FdRecord* record = Find(fd);
+    if (!record || !record->sends) {
+        return 0;
+    }
+    return record->sends->queued_bytes;
+}
+
+void EventLoop::AcceptReady(int listen_fd) {
+    FdRecord* record = Find(listen_fd);
+    if (!record) {
+        return;
+    }
+    uint32_t tag = record->tag;
+
+    while (true) {
+        if (record->tag != tag || !record->accept) {
+            return;
+        }
+
+        PeerAddress peer;
+        peer.length = sizeof(peer.storage);
+        auto* peer_addr = reinterpret_cast<struct sockaddr*>(&peer.storage);
+        // accept4 (Linux and the BSDs) sets both flags in the same call
+#if defined(SOCK_NONBLOCK) && defined(SOCK_CLOEXEC)
+        int client_fd = accept4(listen_fd, peer_addr, &peer.length, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+        int client_fd = accept(listen_fd, peer_addr, &peer.length);
+        if (client_fd >= 0) {
+            int flags = fcntl(client_fd, F_GETFL, 0);
+            fcntl(client_fd, F_SETFL, flags | O_NONBLOCK);
+            fcntl(client_fd, F_SETFD, FD_CLOEXEC);
+        }
+#endif
+        if (client_fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // EAGAIN: backlog drained; anything else is retried on the next event
+            return;
+        }
+
+        ConfigureAccepted(client_fd);
+        record->accept(client_fd, peer);
+    }
+}
+
+void EventLoop::ReceiveReady(int fd) {
+    if (receive_buffer_.empty()) {
+        receive_buffer_.resize(kReceiveBufferSize);
+    }
+
+    FdRecord* record = Find(fd);
+    if (!record || !record->receive) {
+        return;
+    }
+    uint32_t tag = record->tag;
+
+    while (true) {
+        ssize_t received = read(fd, receive_buffer_.data(), receive_buffer_.size());
+        if (received < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            received = -errno;
+        }
+
+        if (received <= 0) {
+            // Stop polling a half-closed or failed socket, which would stay
+            // readable; pending sends still complete (or fail on their own)
+            UpdateInterest(*record, record->interest & ~kPollReadable);
+            if (record->read) {
+                retired_callbacks_.push_back(std::move(record->read));
+                record->read = nullptr;
+            }
+        }
+
+        record->receive(fd, receive_buffer_.data(), received);
+
+        if (received <= 0 || static_cast<size_t>(received) < receive_buffer_.size()) {
+            return;
+        }
+
+        // The callback may have unregistered (and the fd been reused)
+        if (record->tag != tag || !record->receive) {
+            return;
+        }
+    }
+}
+
+void EventLoop::FlushSends(int fd) {
+    FdRecord* record = Find(fd);
+    if (!record || !record->sends) {
+        return;
+    }
+    SendQueue& queue = *record->sends;
+    uint32_t tag = record->tag;
+
+    while (!queue.pending.empty()) {
+        PendingSend& front = queue.pending.front();
+        ssize_t sent = 0;
+
+        if (front.AtFile()) {
+            size_t file_done = front.offset - front.MemorySize();
+            sent = SendFileRange(fd, front.file->Fd(), front.file->Offset() + static_cast<off_t>(file_done),
+                                 front.file->Length() - file_done);
+            if (sent == 0) {
+                // The file shrank under us
+                errno = EIO;
+                sent = -1;
+            }
+        } else if (poller_->SupportsCompletionIo()) {
+            // io_uring only comes here for file bodies; memory parts go back
+            // to linked sends
+            StopWatchingWritable(*record);
+            SubmitSends(fd, *record);
+            return;
+        } else {
+            // One sendmsg covers as many queued sends (and their head/body
+            // parts) as fit, so pipelined responses share segments
+            struct iovec chunks[kMaxSendChain];
+            bool more = false;
+            int count = GatherSends(queue, chunks, more);
+
+            if (count > 0) {
+                struct msghdr message{};
+                message.msg_iov = chunks;
+                message.msg_iovlen = static_cast<decltype(message.msg_iovlen)>(count);
+                sent = sendmsg(fd, &message, kSendFlags | (more ? kMoreFlag : 0));
+            }
+        }
+
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // Finish once the socket drains
+                if (!(record->interest & kPollWritable)) {
+                    UpdateInterest(*record, record->interest | kPollWritable);
+                    record->write = [this](int fd, EventType /*type*/) {
+                        FlushSends(fd);
+                    };
+                }
+                return;
+            }
+            FailSends(fd, queue, -errno);
+            return;
+        }
+        queue.queued_bytes -= static_cast<size_t>(sent);
+
+        // Complete every send the write covered; a partial one keeps its offset
+        size_t written = static_cast<size_t>(sent);
+        while (!queue.pending.empty()) {
+            PendingSend& done = queue.pending.front();
+            size_t remaining = done.Size() - done.offset;
+            if (written < remaining) {
+                done.offset += written;
+                break;
+            }
+            written -= remaining;
+
+            SendCallback callback = std::move(done.callback);
+            size_t size = done.Size();
+            queue.pending.pop_front();
+
+            if (callback) {
+                callback(fd, static_cast<ssize_t>(size));
+                if (record->tag != tag) {
+                    return;
+                }
+            }
+        }
+    }
+
+    // Drained: stop watching for writability
+    StopWatchingWritable(*record);
+}
+
+void EventLoop::StopWatchingWritable(FdRecord& record) {
+    if (record.interest & kPollWritable) {
+        UpdateInterest(record, record.interest & ~kPollWritable);
+        retired_callbacks_.push_back(std::move(record.write));
+        record.write = nullptr;
+    }
+}
+
+void EventLoop::FailSends(int fd, SendQueue& queue, ssize_t error) {
+    queue.failed = true;
+
+    std::vector<SendCallback> callbacks;
+    for (auto& send : queue.pending) {
+        if (send.callback) {
+            callbacks.push_back(std::move(send.callback));
+            send.callback = nullptr;
+        }
+    }
+
+    // Chunks the kernel still references are released once their chain ends
+    if (queue.in_flight == 0) {
+        queue.pending.clear();
+    }
+
+    for (auto& callback : callbacks) {
+        callback(fd, error);
+    }
+}
+
+int EventLoop::GatherSends(const SendQueue& queue, struct iovec* chunks, bool& more) {
+    int count = 0;
+    more = false;
+    for (size_t i = 0; i < queue.pending.size(); ++i) {
+        const PendingSend& send = queue.pending[i];
+        size_t head_offset = std::min(send.offset, send.head.size());
+        size_t body_offset = send.offset - head_offset;
+        size_t head_left = send.head.size() - head_offset;
+        const std::string& body = send.Body();
+        size_t body_left = body.size() - body_offset;
+
+        int needed = (head_left > 0 && body_left > 0) ? 2 : 1;
+        if (count + needed > kMaxSendChain) {
+            more = true;
+            return count;
+        }
+
+        if (send.file) {
+            // Only the head fits in a chunk; sendfile takes over after it
+            if (head_left > 0) {
+                chunks[count].iov_base = const_cast<char*>(send.head.data()) + head_offset;
+                chunks[count].iov_len = head_left;
+                ++count;
+            }
+            more = true;
+            return count;
+        }
+
+        if (head_left > 0 || body_left == 0) {
+            chunks[count].iov_base = const_cast<char*>(send.head.data()) + head_offset;
+            chunks[count].iov_len = head_left;
+            ++count;
+        }
+        if (body_left > 0) {
+            chunks[count].iov_base = const_cast<char*>(body.data()) + body_offset;
+            chunks[count].iov_len = body_left;
+            ++count;
+        }
+        more = send.more;
+    }
+    return count;
+}
+
+void EventLoop::SubmitSends(int fd, FdRecord& ops) {
+    SendQueue& queue = *ops.sends;
+
+    // There is no io_uring sendfile; file bodies go out with sendfile on
+    // writability, unless that is already under way
+    if (!queue.pending.empty() && queue.pending.front().AtFile()) {
+        if (!(ops.interest & kPollWritable)) {
+            FlushSends(fd);
+        }
+        return;
+    }
+
+    struct iovec chunks[kMaxSendChain];
+    bool more = false;
+    int count = GatherSends(queue, chunks, more);
+
+    if (count == 0) {
+        return;
+    }
+
+    queue.in_flight = static_cast<size_t>(count);
+    poller_->StartSend(fd, ops.tag, chunks, count, more);
+}
+
+void EventLoop::OnSendCompleted(int fd, uint32_t tag, ssize_t result) {
+    SendQueue* queue = nullptr;
+    bool retired = false;
+
+    FdRecord* record = Find(fd);
+    if (record && record->tag == tag && record->sends) {
+        queue = record->sends.get();
+    } else {
+        auto retired_it = retired_sends_.find(SendKey(fd, tag));
+        if (retired_it == retired_sends_.end()) {
+            return;
+        }
+        queue = retired_it->second.get();
+        retired = true;
+    }
+
+    if (queue->in_flight > 0) {
+        --queue->in_flight;
+    }
+
+    if (!retired && !queue->failed && !queue->pending.empty()) {
+        PendingSend& front = queue->pending.front();
+        size_t remaining = front.Size() - front.offset;
+
+        if (result > 0 || (result == 0 && remaining == 0)) {
+            // A short send breaks the link chain; the rest come back as
+            // -ECANCELED and are resubmitted from the new offset
+            front.offset += static_cast<size_t>(result);
+            queue->queued_bytes -= static_cast<size_t>(result);
+            if (front.offset >= front.Size()) {
+                SendCallback callback = std::move(front.callback);
+                size_t size = front.Size();
+                queue->pending.pop_front();
+                if (callback) {
+                    callback(fd, static_cast<ssize_t>(size));
+                }
+            }
+        } else if (result != -ECANCELED) {
+            FailSends(fd, *queue, result < 0 ? result : -EPIPE);
+        }
+    }
+
+    if (queue->in_flight > 0) {
+        return;
+    }
+
+    // Chain finished: resubmit what is left, or release a retired queue
+    if (record && record->tag == tag && record->sends.get() == queue) {
+        if (queue->failed) {
+            queue->pending.clear();
+        } else if (!queue->pending.empty()) {
+            SubmitSends(fd, *record);
+        }
+    } else {
+        retired_sends_.erase(SendKey(fd, tag));
+    }
+}
+
+void EventLoop::DispatchCompletion(const PollEvent& event) {
+    int fd = event.fd;
+
+    if (event.op == IoOp::Send) {
+        OnSendCompleted(fd, event.tag, event.result);
+        return;
+    }
+
+    FdRecord* record = Find(fd);
+    bool current = record && record->tag == event.tag;
+
+    if (event.op == IoOp::Accept) {
+        if (!current || !record->accept) {
+            // Raced with Unregister; don't leak the connection
+            if (event.result >= 0) {
+                close(event.result);
+            }
+            return;
+        }
+
+        // Transient accept errors (EMFILE, ECONNABORTED) are dropped
+        // Multishot accept completions would all share one address buffer,
+        // so the peer is read back once per connection instead
+        if (event.result >= 0) {
+            ConfigureAccepted(event.result);
+            record->accept(event.result, PeerAddress::Of(event.result));
+        }
+
+        if (!event.more && event.result != -ECANCELED &&
+            record->tag == event.tag && record->accept) {
+            poller_->StartAccept(fd, event.tag);
+        }
+        return;
+    }
+
+    if (!current || !record->receive || event.result == -ECANCELED) {
+        return;
+    }
+
+    record->receive(fd, event.data, event.result);
+
+    // Multishot recv can end early (e.g. on buffer pressure); re-arm it
+    if (!event.more && event.result > 0 && record->tag == event.tag && record->receive) {
+        poller_->StartReceive(fd, event.tag);
+    }
+}
+
+uint64_t EventLoop::NowMs() const {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - epoch_).count());
+}
+
+TimerId EventLoop::RunAfter(std::chrono::milliseconds delay, TimerCallback callback) {
+    uint64_t delay_ms = delay.count() > 0 ? static_cast<uint64_t>(delay.count()) : 0;
+    return timers_.Schedule(NowMs() + delay_ms, 0, std::move(callback));
+}
+
+TimerId EventLoop::RunEvery(std::chrono::milliseconds interval, TimerCallback callback) {
+    if (interval.count() <= 0) {
+        throw std::invalid_argument("Timer interval must be positive");
+    }
+    uint64_t interval_ms = static_cast<uint64_t>(interval.count());
+    return timers_.Schedule(NowMs() + interval_ms, interval_ms, std::move(callback));
+}
+
+bool EventLoop::CancelTimer(TimerId id) {
+    return timers_.Cancel(id);
+}
+
+void EventLoop::SetBusyPoll(std::chrono::microseconds spin) {
+    busy_poll_ = spin.count() > 0 ? spin : std::chrono::microseconds(0);
+}
+
+void EventLoop::ConfigureAccepted(int client_fd) {
+    if (busy_poll_.count() == 0) {
+        return;
+    }
+    // Best effort: values above net.core.busy_read need CAP_NET_ADMIN
+#if defined(SO_BUSY_POLL)
+    int spin_us = static_cast<int>(std::min<int64_t>(busy_poll_.count(), INT32_MAX));
+    setsockopt(client_fd, SOL_SOCKET, SO_BUSY_POLL, &spin_us, sizeof(spin_us));
+#endif
+#if defined(SO_PREFER_BUSY_POLL)
+    int prefer = 1;
+    setsockopt(client_fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &prefer, sizeof(prefer));
+#endif
+    (void)client_fd;
+}
+
+EventLoopStats EventLoop::Stats() const {
+    EventLoopStats stats;
+    if (!counters_) {
+        return stats;
+    }
+    stats.iterations = counters_->iterations.load(std::memory_order_relaxed);
+    stats.events = counters_->events.load(std::memory_order_relaxed);
+    stats.spin_polls = counters_->spin_polls.load(std::memory_order_relaxed);
+    stats.spin_hits = counters_->spin_hits.load(std::memory_order_relaxed);
+    stats.blocking_waits = counters_->blocking_waits.load(std::memory_order_relaxed);
+    stats.spin_ns = counters_->spin_ns.load(std::memory_order_relaxed);
+    stats.blocked_ns = counters_->blocked_ns.load(std::memory_order_relaxed);
+    stats.batch_size = counters_->batch_size.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void EventLoop::Post(Task task) {
+    inbox_->Push(std::move(task));
+
+    // The loop checks its inbox before sleeping, so only other threads need
+    // to wake it, and only the first of them since the last drain
+    if (!IsInLoopThread() && !wake_pending_.exchange(true)) {
+        poller_->Wakeup();
+    }
+}
+
+void EventLoop::RunInLoop(Task task) {
+    if (IsInLoopThread()) {
+        task();
+    } else {
+        Post(std::move(task));
+    }
+}
+
+bool EventLoop::IsInLoopThread() const {
+    return loop_thread_.load(std::memory_order_relaxed) == std::this_thread::get_id();
+}
+
+void EventLoop::RunPendingTasks() {
+    // Clear first: a Post racing with the drain then issues a fresh wakeup
+    wake_pending_.store(false);
+
+    Task task;
+    for (size_t i = 0; i < kMaxTasksPerIteration && inbox_->TryPop(task); ++i) {
+        task();
+        task = nullptr;
+    }
 }
 
 void EventLoop::Run() {
+    loop_thread_ = std::this_thread::get_id();
     running_ = true;
     while (running_) {
         ProcessEvents();
     }
+    loop_thread_ = std::thread::id();
 }
 
 void EventLoop::Stop() {
     running_ = false;
+    if (poller_) {
+        poller_->Wakeup();
+    }
 }
 
-void EventLoop::ProcessEvents() {
-    struct kevent events[64];
-    int num_events = kevent(kqueue_fd_, nullptr, 0, events, 64, nullptr);
-    
-    if (num_events == -1) {
-        if (errno != EINTR) {
-            throw std::runtime_error("kevent failed");
+const char* EventLoop::BackendName() const {
+    return poller_->Name();
+}
+
+bool EventLoop::UsesCompletionIo() const {
+    return poller_->SupportsCompletionIo();
+}
+
+int EventLoop::WaitForEvents(int timeout_ms) {
+    const int capacity = static_cast<int>(events_.size());
+    if (timeout_ms == 0) {
+        return poller_->Poll(events_.data(), capacity, 0);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto now = start;
+
+    if (busy_poll_.count() > 0) {
+        auto spin_until = start + busy_poll_;
+        if (timeout_ms > 0) {
+            spin_until = std::min(spin_until, start + std::chrono::milliseconds(timeout_ms));
         }
-        return;
+
+        Bump(counters_->spin_polls);
+        int num_events = 0;
+        do {
+            num_events = poller_->Poll(events_.data(), capacity, 0);
+            now = std::chrono::steady_clock::now();
+            // Posted tasks and Stop() need the loop too, not just I/O
+        } while (num_events == 0 && now < spin_until && running_ && inbox_->Empty());
+        Bump(counters_->spin_ns, ElapsedNs(start, now));
+
+        if (num_events != 0 || !running_ || !inbox_->Empty()) {
+            if (num_events > 0) {
+                Bump(counters_->spin_hits);
+            }
+            return num_events;
+        }
+
+        if (timeout_ms > 0) {
+            auto spent_ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count();
+            timeout_ms = static_cast<int>(std::max<int64_t>(0, timeout_ms - spent_ms));
+        }
+    }
+
+    Bump(counters_->blocking_waits);
+    int num_events = poller_->Poll(events_.data(), capacity, timeout_ms);
+    Bump(counters_->blocked_ns, ElapsedNs(now, std::chrono::steady_clock::now()));
+    return num_events;
+}
+
+void EventLoop::AdaptBatchSize(int num_events) {
+    size_t size = events_.size();
+    if (num_events >= 0 && static_cast<size_t>(num_events) == size && size < kMaxBatch) {
+        events_.resize(size * 2);
+        sparse_batches_ = 0;
+    } else if (num_events >= 0 && static_cast<size_t>(num_events) < size / 4 && size > kMinBatch) {
+        // Only idle-ish loops shrink; waits that return nothing don't count
+        if (num_events > 0 && ++sparse_batches_ >= kShrinkAfter) {
+            events_.resize(size / 2);
+            sparse_batches_ = 0;
+        }
+    } else {
+        sparse_batches_ = 0;
+    }
+    counters_->batch_size.store(events_.size(), std::memory_order_relaxed);
+}
+
+void EventLoop::ProcessEvents() {
+    // Sleep no longer than the next timer allows; Post() and Stop() from
+    // other threads wake the poller
+    int timeout_ms = -1;
+    int64_t next_timer_ms = timers_.NextTimeoutMs(NowMs());
+    if (next_timer_ms >= 0) {
+        timeout_ms = static_cast<int>(std::min<int64_t>(next_timer_ms, INT32_MAX));
+    }
+    if (!inbox_->Empty()) {
+        timeout_ms = 0;
+    }
+
+    int num_events = WaitForEvents(timeout_ms);
+    Bump(counters_->iterations);
+    if (num_events > 0) {
+        Bump(counters_->events, static_cast<uint64_t>(num_events));
     }
-    
+
     for (int i = 0; i < num_events; ++i) {
-        int fd = static_cast<int>(events[i].ident);
-        
-        if (events[i].filter == EVFILT_READ) {
-            auto it = read_callbacks_.find(fd);
-            if (it != read_callbacks_.end()) {
-                it->second(fd, EventType::Read);
-            }
-        } else if (events[i].filter == EVFILT_WRITE) {
-            auto it = write_callbacks_.find(fd);
-            if (it != write_callbacks_.end()) {
-                it->second(fd, EventType::Write);
-            }
+        const PollEvent& event = events_[i];
+        uint32_t events = event.events;
+
+        if (events & kPollCompletion) {
+            DispatchCompletion(event);
+            continue;
+        }
+
+        // Readiness events carry their record; one unregistered earlier in
+        // this batch is retired and no longer registered with the poller
+        FdRecord* record = static_cast<FdRecord*>(event.udata);
+        int fd = record->fd;
+
+        if (!(record->interest & kIoMask)) {
+            continue;
+        }
+        if (record->interest & kPollOneShot) {
+            // The kernel disarmed the fd when it reported this event
+            record->rearm = record->interest;
+            record->interest = kPollOneShot;
+        }
+
+        // Hangups and errors go to the reader so it observes EOF / the error
+        if ((events & (kPollReadable | kPollHangup | kPollError)) && record->read) {
+            bool error_only = (events & kPollError) && !(events & kPollReadable);
+            record->read(fd, error_only ? EventType::Error : EventType::Read);
+        }
+
+        if ((events & kPollWritable) && record->write) {
+            record->write(fd, EventType::Write);
         }
-        
-        if (events[i].flags & EV_EOF) {
+
+        // Completion-style fds see EOF through Receive and may still be
+        // flushing sends, so they are left for the owner to unregister
+        if ((events & kPollHangup) && record->tag == 0 && record->interest != 0) {
             Unregister(fd);
         }
     }
+
+    timers_.Advance(NowMs());
+    RunPendingTasks();
+    AdaptBatchSize(num_events);
+
+    retired_callbacks_.clear();
+    // Events the poller held back (kqueue beyond max_events) may name a
+    // record retired above; reusing it for another fd before they are
+    // delivered would hand them to the wrong connection
+    if (poller_->HasPendingEvents()) {
+        return;
+    }
+    for (auto& record : retired_records_) {
+        *record = FdRecord();
+        free_records_.push_back(std::move(record));
+    }
+    retired_records_.clear();
 }
 
 } // namespace http
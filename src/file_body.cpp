@@ -0,0 +1,52 @@
+#include "file_body.hpp"
+#include <stdexcept>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace http {
+
+std::shared_ptr<FileBody> FileBody::Open(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open " + path + ": " + std::string(strerror(errno)));
+    }
+
+    struct stat info{};
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        close(fd);
+        throw std::runtime_error("Not a regular file: " + path);
+    }
+
+    return std::shared_ptr<FileBody>(new FileBody(fd, 0, static_cast<size_t>(info.st_size)));
+}
+
+FileBody::FileBody(int fd, off_t offset, size_t length)
+    : fd_(fd), offset_(offset), length_(length) {
+}
+
+FileBody::~FileBody() {
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+std::string FileBody::ReadAll() const {
+    std::string data(length_, '\0');
+    size_t done = 0;
+    while (done < length_) {
+        ssize_t n = pread(fd_, &data[done], length_ - done, offset_ + static_cast<off_t>(done));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            throw std::runtime_error("Failed to read file body");
+        }
+        done += static_cast<size_t>(n);
+    }
+    return data;
+}
+
+} // namespace http
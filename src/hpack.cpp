@@ -0,0 +1,415 @@
+#include "hpack.hpp"
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace http {
+
+namespace {
+
+constexpr size_t kEntryOverhead = 32;
+
+// RFC 7541 Appendix A
+const std::array<HeaderField, 61> kStaticTable = {{
+    {":authority", ""}, {":method", "GET"}, {":method", "POST"}, {":path", "/"},
+    {":path", "/index.html"}, {":scheme", "http"}, {":scheme", "https"}, {":status", "200"},
+    {":status", "204"}, {":status", "206"}, {":status", "304"}, {":status", "400"},
+    {":status", "404"}, {":status", "500"}, {"accept-charset", ""}, {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""}, {"accept-ranges", ""}, {"accept", ""}, {"access-control-allow-origin", ""},
+    {"age", ""}, {"allow", ""}, {"authorization", ""}, {"cache-control", ""},
+    {"content-disposition", ""}, {"content-encoding", ""}, {"content-language", ""}, {"content-length", ""},
+    {"content-location", ""}, {"content-range", ""}, {"content-type", ""}, {"cookie", ""},
+    {"date", ""}, {"etag", ""}, {"expect", ""}, {"expires", ""},
+    {"from", ""}, {"host", ""}, {"if-match", ""}, {"if-modified-since", ""},
+    {"if-none-match", ""}, {"if-range", ""}, {"if-unmodified-since", ""}, {"last-modified", ""},
+    {"link", ""}, {"location", ""}, {"max-forwards", ""}, {"proxy-authenticate", ""},
+    {"proxy-authorization", ""}, {"range", ""}, {"referer", ""}, {"refresh", ""},
+    {"retry-after", ""}, {"server", ""}, {"set-cookie", ""}, {"strict-transport-security", ""},
+    {"transfer-encoding", ""}, {"user-agent", ""}, {"vary", ""}, {"via", ""},
+    {"www-authenticate", ""},
+}};
+
+// Code length of each symbol (256 = EOS), RFC 7541 Appendix B
+const uint8_t kHuffmanLengths[257] = {
+    13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+    28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+    6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+    5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+    13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+    15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+    6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+    20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+    24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+    22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+    21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+    26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+    19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+    20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+    26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+    30,
+};
+
+constexpr int kMaxCodeLength = 30;
+constexpr uint16_t kEos = 256;
+
+// Canonical code: within one length, codes are consecutive in symbol order,
+// and each length starts where the previous one ended, shifted left
+struct HuffmanCode {
+    uint32_t codes[257];
+    uint32_t first[kMaxCodeLength + 1] = {};    // First code of each length
+    uint16_t count[kMaxCodeLength + 1] = {};    // Codes of each length
+    uint16_t offset[kMaxCodeLength + 1] = {};   // Index of that first code in symbols
+    uint16_t symbols[257];                      // Ordered by (length, symbol)
+
+    HuffmanCode() {
+        for (uint16_t symbol = 0; symbol < 257; ++symbol) {
+            ++count[kHuffmanLengths[symbol]];
+        }
+        uint32_t code = 0;
+        uint16_t index = 0;
+        for (int length = 1; length <= kMaxCodeLength; ++length) {
+            code <<= 1;
+            first[length] = code;
+            offset[length] = index;
+            code += count[length];
+            index += count[length];
+        }
+
+        uint32_t next[kMaxCodeLength + 1];
+        uint16_t slot[kMaxCodeLength + 1];
+        std::copy(std::begin(first), std::end(first), next);
+        std::copy(std::begin(offset), std::end(offset), slot);
+        for (uint16_t symbol = 0; symbol < 257; ++symbol) {
+            int length = kHuffmanLengths[symbol];
+            codes[symbol] = next[length]++;
+            symbols[slot[length]++] = symbol;
+        }
+    }
+};
+
+const HuffmanCode& Huffman() {
+    static const HuffmanCode code;
+    return code;
+}
+
+// Static table index per name (first match), and per name and value
+const std::unordered_map<std::string, size_t>& StaticNames() {
+    static const std::unordered_map<std::string, size_t> names = [] {
+        std::unordered_map<std::string, size_t> map;
+        for (size_t i = kStaticTable.size(); i-- > 0;) {
+            map[kStaticTable[i].first] = i + 1;
+        }
+        return map;
+    }();
+    return names;
+}
+
+size_t StaticFieldIndex(const std::string& name, const std::string& value) {
+    auto it = StaticNames().find(name);
+    if (it == StaticNames().end()) {
+        return 0;
+    }
+    for (size_t i = it->second - 1; i < kStaticTable.size() && kStaticTable[i].first == name; ++i) {
+        if (kStaticTable[i].second == value) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+// Fields whose values differ from one message to the next
+bool NeverWorthIndexing(const std::string& name) {
+    return name == "content-length" || name == "date" || name == "etag" ||
+           name == "last-modified" || name == ":path" || name == "set-cookie";
+}
+
+bool Sensitive(const std::string& name) {
+    return name == "authorization" || name == "proxy-authorization" || name == "cookie";
+}
+
+uint64_t DecodeInteger(const uint8_t*& pos, const uint8_t* end, int prefix_bits) {
+    const uint64_t max_prefix = (1u << prefix_bits) - 1;
+    uint64_t value = *pos++ & max_prefix;
+    if (value < max_prefix) {
+        return value;
+    }
+    for (int shift = 0; ; shift += 7) {
+        if (pos == end || shift > 56) {
+            throw std::invalid_argument("Truncated or oversized HPACK integer");
+        }
+        uint8_t byte = *pos++;
+        value += static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+}
+
+std::string DecodeString(const uint8_t*& pos, const uint8_t* end) {
+    if (pos == end) {
+        throw std::invalid_argument("Truncated HPACK string");
+    }
+    bool huffman = (*pos & 0x80) != 0;
+    uint64_t length = DecodeInteger(pos, end, 7);
+    if (length > static_cast<uint64_t>(end - pos)) {
+        throw std::invalid_argument("Truncated HPACK string");
+    }
+    const char* data = reinterpret_cast<const char*>(pos);
+    pos += length;
+    return huffman ? HpackHuffman::Decode(data, length) : std::string(data, length);
+}
+
+} // namespace
+
+HpackTable::HpackTable(size_t max_size) : max_size_(max_size) {
+}
+
+void HpackTable::Insert(std::string name, std::string value) {
+    size_t entry_size = name.size() + value.size() + kEntryOverhead;
+    if (entry_size > max_size_) {
+        // Too big for any table: inserting it just empties the table
+        EvictTo(0);
+        return;
+    }
+    EvictTo(max_size_ - entry_size);
+    size_ += entry_size;
+    entries_.emplace_front(std::move(name), std::move(value));
+}
+
+void HpackTable::SetMaxSize(size_t max_size) {
+    max_size_ = max_size;
+    EvictTo(max_size_);
+}
+
+void HpackTable::EvictTo(size_t limit) {
+    while (size_ > limit && !entries_.empty()) {
+        size_ -= entries_.back().first.size() + entries_.back().second.size() + kEntryOverhead;
+        entries_.pop_back();
+    }
+}
+
+size_t HpackHuffman::EncodedLength(const std::string& input) {
+    size_t bits = 0;
+    for (unsigned char c : input) {
+        bits += kHuffmanLengths[c];
+    }
+    return (bits + 7) / 8;
+}
+
+void HpackHuffman::Encode(const std::string& input, std::string& out) {
+    const HuffmanCode& huffman = Huffman();
+    uint64_t buffer = 0;
+    int bits = 0;
+    for (unsigned char c : input) {
+        buffer = (buffer << kHuffmanLengths[c]) | huffman.codes[c];
+        bits += kHuffmanLengths[c];
+        while (bits >= 8) {
+            bits -= 8;
+            out.push_back(static_cast<char>(buffer >> bits));
+        }
+    }
+    if (bits > 0) {
+        // Pad with the most significant bits of EOS (all ones)
+        out.push_back(static_cast<char>((buffer << (8 - bits)) | (0xff >> bits)));
+    }
+}
+
+std::string HpackHuffman::Decode(const char* data, size_t size) {
+    const HuffmanCode& huffman = Huffman();
+    std::string out;
+    out.reserve(size + size / 2);
+
+    uint32_t code = 0;
+    int length = 0;
+    bool all_ones = true;
+    for (size_t i = 0; i < size; ++i) {
+        uint8_t byte = static_cast<uint8_t>(data[i]);
+        for (int bit = 7; bit >= 0; --bit) {
+            uint32_t b = (byte >> bit) & 1;
+            code = (code << 1) | b;
+            all_ones = all_ones && b;
+            ++length;
+            if (code - huffman.first[length] < huffman.count[length]) {
+                uint16_t symbol = huffman.symbols[huffman.offset[length] + code - huffman.first[length]];
+                if (symbol == kEos) {
+                    throw std::invalid_argument("EOS in Huffman-encoded string");
+                }
+                out.push_back(static_cast<char>(symbol));
+                code = 0;
+                length = 0;
+                all_ones = true;
+            } else if (length == kMaxCodeLength) {
+                throw std::invalid_argument("Invalid Huffman code");
+            }
+        }
+    }
+
+    // Padding: fewer than 8 bits, all of them ones
+    if (length > 7 || !all_ones) {
+        throw std::invalid_argument("Invalid Huffman padding");
+    }
+    return out;
+}
+
+HpackDecoder::HpackDecoder(size_t max_table_size, size_t max_header_list_size)
+    : max_table_size_(max_table_size), max_header_list_size_(max_header_list_size), table_(max_table_size) {
+}
+
+const HeaderField& HpackDecoder::Lookup(uint64_t index) const {
+    if (index == 0) {
+        throw std::invalid_argument("HPACK index 0");
+    }
+    if (index <= kStaticTable.size()) {
+        return kStaticTable[index - 1];
+    }
+    index -= kStaticTable.size() + 1;
+    if (index >= table_.Count()) {
+        throw std::invalid_argument("HPACK index out of range");
+    }
+    return table_.At(index);
+}
+
+HeaderList HpackDecoder::Decode(const char* data, size_t size) {
+    const uint8_t* pos = reinterpret_cast<const uint8_t*>(data);
+    const uint8_t* end = pos + size;
+    HeaderList headers;
+    bool fields_seen = false;
+    size_t list_size = 0;
+    auto count = [this, &list_size](const HeaderField& field) {
+        list_size += field.first.size() + field.second.size() + 32;
+        if (list_size > max_header_list_size_) {
+            throw std::invalid_argument("HPACK header list too large");
+        }
+    };
+
+    while (pos < end) {
+        uint8_t first = *pos;
+
+        if (first & 0x80) {
+            // Indexed field, counted before it is copied
+            const HeaderField& field = Lookup(DecodeInteger(pos, end, 7));
+            count(field);
+            headers.push_back(field);
+            fields_seen = true;
+            continue;
+        }
+
+        if ((first & 0xe0) == 0x20) {
+            // Dynamic table size update, only at the start of a block
+            uint64_t new_size = DecodeInteger(pos, end, 5);
+            if (fields_seen || new_size > max_table_size_) {
+                throw std::invalid_argument("Invalid HPACK table size update");
+            }
+            table_.SetMaxSize(new_size);
+            continue;
+        }
+
+        // Literal: with incremental indexing (01), without (0000) or never
+        // indexed (0001)
+        bool indexing = (first & 0xc0) == 0x40;
+        uint64_t name_index = DecodeInteger(pos, end, indexing ? 6 : 4);
+        std::string name = name_index ? Lookup(name_index).first : DecodeString(pos, end);
+        std::string value = DecodeString(pos, end);
+        HeaderField field(std::move(name), std::move(value));
+        count(field);
+        if (indexing) {
+            table_.Insert(field.first, field.second);
+        }
+        headers.push_back(std::move(field));
+        fields_seen = true;
+    }
+    return headers;
+}
+
+HpackEncoder::HpackEncoder(size_t max_table_size)
+    : limit_(max_table_size), table_(max_table_size) {
+}
+
+void HpackEncoder::SetMaxTableSize(size_t max_size) {
+    max_size = std::min(max_size, limit_);
+    smallest_update_ = size_update_pending_ ? std::min(smallest_update_, max_size) : max_size;
+    size_update_pending_ = true;
+    table_.SetMaxSize(max_size);
+}
+
+void HpackEncoder::EncodeInteger(uint64_t value, int prefix_bits, uint8_t first, std::string& out) {
+    const uint64_t max_prefix = (1u << prefix_bits) - 1;
+    if (value < max_prefix) {
+        out.push_back(static_cast<char>(first | value));
+        return;
+    }
+    out.push_back(static_cast<char>(first | max_prefix));
+    value -= max_prefix;
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+void HpackEncoder::EncodeString(const std::string& value, std::string& out) const {
+    size_t huffman_length = HpackHuffman::EncodedLength(value);
+    if (huffman_length < value.size()) {
+        EncodeInteger(huffman_length, 7, 0x80, out);
+        HpackHuffman::Encode(value, out);
+    } else {
+        EncodeInteger(value.size(), 7, 0, out);
+        out.append(value);
+    }
+}
+
+void HpackEncoder::Encode(const HeaderList& headers, std::string& out) {
+    if (size_update_pending_) {
+        if (smallest_update_ < table_.MaxSize()) {
+            EncodeInteger(smallest_update_, 5, 0x20, out);
+        }
+        EncodeInteger(table_.MaxSize(), 5, 0x20, out);
+        size_update_pending_ = false;
+    }
+
+    for (const auto& [name, value] : headers) {
+        size_t index = StaticFieldIndex(name, value);
+        size_t name_index = 0;
+        if (index == 0) {
+            auto it = StaticNames().find(name);
+            if (it != StaticNames().end()) {
+                name_index = it->second;
+            }
+            for (size_t i = 0; i < table_.Count(); ++i) {
+                const HeaderField& entry = table_.At(i);
+                if (entry.first == name) {
+                    if (entry.second == value) {
+                        index = kStaticTable.size() + 1 + i;
+                        break;
+                    }
+                    if (name_index == 0) {
+                        name_index = kStaticTable.size() + 1 + i;
+                    }
+                }
+            }
+        }
+
+        if (index != 0) {
+            EncodeInteger(index, 7, 0x80, out);
+            continue;
+        }
+
+        bool indexing = !NeverWorthIndexing(name) && !Sensitive(name);
+        if (indexing) {
+            EncodeInteger(name_index, 6, 0x40, out);
+        } else {
+            EncodeInteger(name_index, 4, Sensitive(name) ? 0x10 : 0x00, out);
+        }
+        if (name_index == 0) {
+            EncodeString(name, out);
+        }
+        EncodeString(value, out);
+        if (indexing) {
+            table_.Insert(name, value);
+        }
+    }
+}
+
+} // namespace http
@@ -0,0 +1,808 @@
+#include "http2.hpp"
+#include <algorithm>
+#include <cctype>
+
+namespace http {
+
+namespace {
+
+// Frame types
+constexpr uint8_t kData = 0x0;
+constexpr uint8_t kHeaders = 0x1;
+constexpr uint8_t kPriority = 0x2;
+constexpr uint8_t kRstStream = 0x3;
+constexpr uint8_t kSettings = 0x4;
+constexpr uint8_t kPushPromise = 0x5;
+constexpr uint8_t kPing = 0x6;
+constexpr uint8_t kGoAway = 0x7;
+constexpr uint8_t kWindowUpdate = 0x8;
+constexpr uint8_t kContinuation = 0x9;
+
+// Flags
+constexpr uint8_t kEndStream = 0x1;
+constexpr uint8_t kAck = 0x1;
+constexpr uint8_t kEndHeaders = 0x4;
+constexpr uint8_t kPadded = 0x8;
+constexpr uint8_t kPriorityFlag = 0x20;
+
+// Settings identifiers
+constexpr uint16_t kHeaderTableSize = 0x1;
+constexpr uint16_t kEnablePush = 0x2;
+constexpr uint16_t kMaxConcurrentStreams = 0x3;
+constexpr uint16_t kInitialWindowSize = 0x4;
+constexpr uint16_t kMaxFrameSize = 0x5;
+constexpr uint16_t kMaxHeaderListSize = 0x6;
+
+constexpr size_t kFrameHeaderSize = 9;
+constexpr int64_t kDefaultWindow = 65535;
+constexpr int64_t kMaxWindow = 0x7fffffff;
+
+uint32_t ReadUint32(const char* data) {
+    const auto* bytes = reinterpret_cast<const uint8_t*>(data);
+    return (static_cast<uint32_t>(bytes[0]) << 24) | (static_cast<uint32_t>(bytes[1]) << 16) |
+           (static_cast<uint32_t>(bytes[2]) << 8) | bytes[3];
+}
+
+void AppendUint32(std::string& out, uint32_t value) {
+    out.push_back(static_cast<char>(value >> 24));
+    out.push_back(static_cast<char>(value >> 16));
+    out.push_back(static_cast<char>(value >> 8));
+    out.push_back(static_cast<char>(value));
+}
+
+void AppendFrame(std::string& out, uint8_t type, uint8_t flags, uint32_t stream_id,
+                 const char* payload, size_t length) {
+    out.push_back(static_cast<char>(length >> 16));
+    out.push_back(static_cast<char>(length >> 8));
+    out.push_back(static_cast<char>(length));
+    out.push_back(static_cast<char>(type));
+    out.push_back(static_cast<char>(flags));
+    AppendUint32(out, stream_id & 0x7fffffff);
+    out.append(payload, length);
+}
+
+std::string ToLower(std::string value) {
+    std::transform(value.begin(), value.end(), value.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return value;
+}
+
+// HTTP2-Settings is base64url without padding; plain base64 is accepted too
+std::string Base64UrlDecode(const std::string& input) {
+    std::string out;
+    uint32_t buffer = 0;
+    int bits = 0;
+    for (char c : input) {
+        int value;
+        if (c >= 'A' && c <= 'Z') value = c - 'A';
+        else if (c >= 'a' && c <= 'z') value = c - 'a' + 26;
+        else if (c >= '0' && c <= '9') value = c - '0' + 52;
+        else if (c == '-' || c == '+') value = 62;
+        else if (c == '_' || c == '/') value = 63;
+        else if (c == '=') break;
+        else throw std::invalid_argument("Invalid HTTP2-Settings encoding");
+
+        buffer = (buffer << 6) | static_cast<uint32_t>(value);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out.push_back(static_cast<char>(buffer >> bits));
+        }
+    }
+    return out;
+}
+
+// Hop-by-hop fields that HTTP/2 does not carry
+bool ConnectionSpecific(const std::string& name) {
+    return name == "connection" || name == "keep-alive" || name == "proxy-connection" ||
+           name == "transfer-encoding" || name == "upgrade";
+}
+
+} // namespace
+
+const std::string Http2Session::kPreface("PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n");
+
+Http2Session::Http2Session(const Http2Settings& settings, size_t max_request_size)
+    : settings_(settings),
+      max_request_size_(max_request_size),
+      decoder_(settings.header_table_size, settings.max_header_list_size) {
+}
+
+bool Http2Session::MayBePreface(const std::string& data) {
+    size_t length = std::min(data.size(), kPreface.size());
+    return length > 0 && data.compare(0, length, kPreface, 0, length) == 0;
+}
+
+bool Http2Session::IsUpgradeRequest(const HttpRequest& request) {
+    if (request.version != "HTTP/1.1" || request.headers.count("http2-settings") == 0) {
+        return false;
+    }
+    std::string upgrade = ToLower(request.GetHeader("upgrade"));
+    size_t pos = 0;
+    while (pos <= upgrade.size()) {
+        size_t end = upgrade.find(',', pos);
+        if (end == std::string::npos) {
+            end = upgrade.size();
+        }
+        size_t first = upgrade.find_first_not_of(" \t", pos);
+        if (first != std::string::npos && first < end) {
+            size_t last = upgrade.find_last_not_of(" \t", end - 1);
+            if (upgrade.compare(first, last + 1 - first, "h2c") == 0) {
+                return true;
+            }
+        }
+        pos = end + 1;
+    }
+    return false;
+}
+
+void Http2Session::Start() {
+    QueueSettings();
+}
+
+void Http2Session::StartUpgrade(const HttpRequest& request) {
+    std::string payload = Base64UrlDecode(request.GetHeader("http2-settings"));
+    try {
+        ApplySettings(payload.data(), payload.size());
+    } catch (const ConnectionError& e) {
+        throw std::invalid_argument(std::string("Invalid HTTP2-Settings: ") + e.what());
+    }
+
+    QueueSettings();
+
+    Stream stream;
+    stream.request = request;
+    stream.remote_closed = true;
+    stream.dispatched = true;
+    stream.send_window = peer_initial_window_;
+    streams_.emplace(1, std::move(stream));
+    last_stream_id_ = 1;
+}
+
+std::vector<Http2Request> Http2Session::Receive(std::string& input) {
+    std::vector<Http2Request> completed;
+    if (failed_) {
+        input.clear();
+        return completed;
+    }
+
+    size_t pos = 0;
+    try {
+        if (!preface_received_) {
+            if (!MayBePreface(input)) {
+                throw ConnectionError(Http2Error::PROTOCOL_ERROR, "Invalid connection preface");
+            }
+            if (input.size() < kPreface.size()) {
+                return completed;
+            }
+            pos = kPreface.size();
+            preface_received_ = true;
+        }
+
+        while (input.size() - pos >= kFrameHeaderSize) {
+            const auto* header = reinterpret_cast<const uint8_t*>(input.data() + pos);
+            size_t length = (static_cast<size_t>(header[0]) << 16) | (static_cast<size_t>(header[1]) << 8) | header[2];
+            uint8_t type = header[3];
+            uint8_t flags = header[4];
+            uint32_t stream_id = ReadUint32(input.data() + pos + 5) & 0x7fffffff;
+
+            if (length > settings_.max_frame_size) {
+                throw ConnectionError(Http2Error::FRAME_SIZE_ERROR, "Frame exceeds SETTINGS_MAX_FRAME_SIZE");
+            }
+            if (input.size() - pos - kFrameHeaderSize < length) {
+                break;
+            }
+            // The client preface ends with a SETTINGS frame
+            if (!settings_received_ && type != kSettings) {
+                throw ConnectionError(Http2Error::PROTOCOL_ERROR, "Expected SETTINGS after the preface");
+            }
+
+            // Whatever is still unwritten will not be read either
+            if (output_.size() > settings_.max_output) {
+                output_.clear();
+                throw ConnectionError(Http2Error::ENHANCE_YOUR_CALM, "Output not being read");
+            }
+
+            ProcessFrame(type, flags, stream_id, input.data() + pos + kFrameHeaderSize, length, completed);
+            pos += kFrameHeaderSize + length;
+        }
+    } catch (const ConnectionError& e) {
+        Fail(e.code, e.what());
+        input.clear();
+        return {};
+    }
+
+    input.erase(0, pos);
+    return completed;
+}
+
+void Http2Session::ProcessFrame(uint8_t type, uint8_t flags, uint32_t stream_id, const char* payload,
+                                size_t length, std::vector<Http2Request>& completed) {
+    // A header block must arrive uninterrupted
+    if (continuation_stream_ != 0 && (type != kContinuation || stream_id != continuation_stream_)) {
+        throw ConnectionError(Http2Error::PROTOCOL_ERROR, "Expected CONTINUATION");
+    }
+
+    switch (type) {
+        case kData:
+            OnData(flags, stream_id, payload, length, completed);
+            break;
+
+        case kHeaders:
+            OnHeaders(flags, stream_id, payload, length, completed);
+            break;
+
+        case kPriority:
+            // Advisory; responses are sent in turn regardless
+            if (stream_id == 0) {
+                throw ConnectionError(Http2Error::PROTOCOL_ERROR, "PRIORITY on stream 0");
+            }
+            if (length != 5) {
+                ResetStream(stream_id, Http2Error::FRAME_SIZE_ERROR);
+            }
+            break;
+
+        case kRstStream:
+            if (stream_id == 0 || stream_id > last_stream_id_) {
+                throw ConnectionError(Http2Error::PROTOCOL_ERROR, "RST_STREAM on an idle stream");
+            }
+            if (length != 4) {
+                throw ConnectionError(Http2Error::FRAME_SIZE_ERROR, "RST_STREAM of the wrong size");
+            }
+            // A peer resetting streams as fast as it opens them keeps the
+            // workers busy with responses nobody reads (CVE-2023-44487)
+            if (++resets_received_ > settings_.max_resets) {
+                throw ConnectionError(Http2Error::ENHANCE_YOUR_CALM, "Too many stream resets");
+            }
+            // Its response, whenever it is ready, is dropped
+            if (auto it = streams_.find(stream_id); it != streams_.end()) {
+                CloseStream(it);
+            }
+            break;
+
+        case kSettings:
+            if (stream_id != 0) {
+                throw ConnectionError(Http2Error::PROTOCOL_ERROR, "SETTINGS on a stream");
+            }
+            OnSettings(flags, payload, length);
+            break;
+
+        case kPushPromise:
+            throw ConnectionError(Http2Error::PROTOCOL_ERROR, "Clients cannot push");
+
+        case kPing:
+            if (stream_id != 0) {
+                throw ConnectionError(Http2Error::PROTOCOL_ERROR, "PING on a stream");
+            }
+            if (length != 8) {
+                throw ConnectionError(Http2Error::FRAME_SIZE_ERROR, "PING of the wrong size");
+            }
+            if (!(flags & kAck)) {
+                QueueFrame(kPing, kAck, 0, payload, length);
+            }
+            break;
+
+        case kGoAway:
+            if (stream_id != 0) {
+                throw ConnectionError(Http2Error::PROTOCOL_ERROR, "GOAWAY on a stream");
+            }
+            // Streams already open are still answered
+            going_away_ = true;
+            break;
+
+        case kWindowUpdate:
+            OnWindowUpdate(stream_id, payload, length);
+            break;
+
+        case kContinuation:
+            if (continuation_stream_ == 0) {
+                throw ConnectionError(Http2Error::PROTOCOL_ERROR, "Unexpected CONTINUATION");
+            }
+            header_block_.append(payload, length);
+            if (header_block_.size() > max_request_size_) {
+                throw ConnectionError(Http2Error::PROTOCOL_ERROR, "Header block too large");
+            }
+            if (flags & kEndHeaders) {
+                uint32_t id = continuation_stream_;
+                continuation_stream_ = 0;
+                OnHeaderBlock(id, continuation_end_stream_, completed);
+            }
+            break;
+
+        default:
+            // Unknown frame types are ignored
+            break;
+    }
+}
+
+void Http2Session::OnData(uint8_t flags, uint32_t stream_id, const char* payload, size_t length,
+                          std::vector<Http2Request>& completed) {
+    if (stream_id == 0) {
+        throw ConnectionError(Http2Error::PROTOCOL_ERROR, "DATA on stream 0");
+    }
+    size_t offset = 0;
+    size_t padding = 0;
+    if (flags & kPadded) {
+        if (length < 1) {
+            throw ConnectionError(Http2Error::PROTOCOL_ERROR, "Missing pad length");
+        }
+        padding = static_cast<uint8_t>(payload[0]);
+        offset = 1;
+    }
+    if (offset + padding > length) {
+        throw ConnectionError(Http2Error::PROTOCOL_ERROR, "Padding exceeds the frame");
+    }
+
+    // Flow control counts the whole payload, padding included. Windows are
+    // reopened as soon as half is used, since the body is consumed right away.
+    if (connection_recv_unacked_ + length > static_cast<uint64_t>(kDefaultWindow)) {
+        throw ConnectionError(Http2Error::FLOW_CONTROL_ERROR, "DATA exceeds the connection window");
+    }
+    connection_recv_unacked_ += static_cast<uint32_t>(length);
+    if (connection_recv_unacked_ >= kDefaultWindow / 2) {
+        QueueWindowUpdate(0, connection_recv_unacked_);
+        connection_recv_unacked_ = 0;
+    }
+
+    auto it = streams_.find(stream_id);
+    if (it == streams_.end() || it->second.remote_closed) {
+        if (stream_id > last_stream_id_) {
+            throw ConnectionError(Http2Error::PROTOCOL_ERROR, "DATA on an idle stream");
+        }
+        // A stream answered early may still have data in flight; one that
+        // is fully closed (reset, or done recently) is ignored
+        if (it != streams_.end() && !it->second.reset_after_body) {
+            ResetStream(stream_id, Http2Error::STREAM_CLOSED);
+        }
+        return;
+    }
+
+    Stream& stream = it->second;
+    const uint64_t stream_window = settings_acked_
+        ? settings_.initial_window_size
+        : std::max<uint64_t>(settings_.initial_window_size, kDefaultWindow);
+    if (stream.recv_unacked + length > stream_window) {
+        ResetStream(stream_id, Http2Error::FLOW_CONTROL_ERROR);
+        return;
+    }
+    stream.request.body.append(payload + offset, length - offset - padding);
+    if (stream.request.body.size() > max_request_size_) {
+        RespondEarly(stream_id, HttpResponse(HttpStatus::PAYLOAD_TOO_LARGE, "Payload Too Large"));
+        return;
+    }
+
+    if (flags & kEndStream) {
+        CompleteRequest(stream_id, stream, completed);
+        return;
+    }
+
+    stream.recv_unacked += static_cast<uint32_t>(length);
+    if (stream.recv_unacked >= settings_.initial_window_size / 2) {
+        QueueWindowUpdate(stream_id, stream.recv_unacked);
+        stream.recv_unacked = 0;
+    }
+}
+
+void Http2Session::OnHeaders(uint8_t flags, uint32_t stream_id, const char* payload, size_t length,
+                             std::vector<Http2Request>& completed) {
+    if (stream_id == 0) {
+        throw ConnectionError(Http2Error::PROTOCOL_ERROR, "HEADERS on stream 0");
+    }
+    size_t offset = 0;
+    size_t padding = 0;
+    if (flags & kPadded) {
+        if (length < 1) {
+            throw ConnectionError(Http2Error::PROTOCOL_ERROR, "Missing pad length");
+        }
+        padding = static_cast<uint8_t>(payload[0]);
+        offset = 1;
+    }
+    if (flags & kPriorityFlag) {
+        offset += 5;
+    }
+    if (offset + padding > length) {
+        throw ConnectionError(Http2Error::PROTOCOL_ERROR, "Padding exceeds the frame");
+    }
+
+    header_block_.assign(payload + offset, length - offset - padding);
+    bool end_stream = (flags & kEndStream) != 0;
+    if (flags & kEndHeaders) {
+        OnHeaderBlock(stream_id, end_stream, completed);
+    } else {
+        continuation_stream_ = stream_id;
+        continuation_end_stream_ = end_stream;
+    }
+}
+
+void Http2Session::OnHeaderBlock(uint32_t stream_id, bool end_stream, std::vector<Http2Request>& completed) {
+    // Every block is decoded, even for streams about to be refused, to keep
+    // the decoder's table in step with the peer's encoder
+    HeaderList fields;
+    try {
+        fields = decoder_.Decode(header_block_);
+    } catch (const std::invalid_argument& e) {
+        throw ConnectionError(Http2Error::COMPRESSION_ERROR, e.what());
+    }
+    header_block_.clear();
+
+    auto it = streams_.find(stream_id);
+    if (it != streams_.end()) {
+        // Trailers: they end the request and are otherwise ignored
+        Stream& stream = it->second;
+        if (stream.remote_closed) {
+            if (!stream.reset_after_body) {
+                ResetStream(stream_id, Http2Error::STREAM_CLOSED);
+            }
+        } else if (!end_stream) {
+            ResetStream(stream_id, Http2Error::PROTOCOL_ERROR);
+        } else {
+            CompleteRequest(stream_id, stream, completed);
+        }
+        return;
+    }
+
+    if (stream_id <= last_stream_id_) {
+        throw ConnectionError(Http2Error::STREAM_CLOSED, "HEADERS on a closed stream");
+    }
+    if ((stream_id & 1) == 0) {
+        throw ConnectionError(Http2Error::PROTOCOL_ERROR, "Client stream ids must be odd");
+    }
+    last_stream_id_ = stream_id;
+
+    if (going_away_) {
+        return;
+    }
+    if (streams_.size() + abandoned_.size() >= settings_.max_concurrent_streams) {
+        ResetStream(stream_id, Http2Error::REFUSED_STREAM);
+        return;
+    }
+
+    Stream stream;
+    stream.send_window = peer_initial_window_;
+    HttpRequest& request = stream.request;
+    request.method = HttpMethod::UNKNOWN;
+    request.version = "HTTP/2.0";
+
+    bool has_method = false;
+    bool has_path = false;
+    bool regular_seen = false;
+    bool malformed = false;
+    for (auto& [name, value] : fields) {
+        if (!name.empty() && name[0] == ':') {
+            // Pseudo-headers come first
+            if (regular_seen) {
+                malformed = true;
+            } else if (name == ":method") {
+                request.method = HttpParser::ParseMethod(value);
+                has_method = true;
+            } else if (name == ":path") {
+                size_t query = value.find('?');
+                request.path = value.substr(0, query);
+                if (query != std::string::npos) {
+                    HttpParser::ParseQueryParams(value.substr(query + 1), request);
+                }
+                has_path = !request.path.empty();
+            } else if (name == ":authority") {
+                request.headers["host"] = value;
+            } else if (name != ":scheme") {
+                malformed = true;
+            }
+            continue;
+        }
+
+        regular_seen = true;
+        if (ConnectionSpecific(name) ||
+            std::any_of(name.begin(), name.end(), [](unsigned char c) { return std::isupper(c); })) {
+            malformed = true;
+            continue;
+        }
+        auto existing = request.headers.find(name);
+        if (existing == request.headers.end()) {
+            request.headers.emplace(std::move(name), std::move(value));
+        } else {
+            existing->second += (name == "cookie" ? "; " : ", ") + value;
+        }
+    }
+
+    if (malformed || !has_method || !has_path) {
+        ResetStream(stream_id, Http2Error::PROTOCOL_ERROR);
+        return;
+    }
+
+    auto inserted = streams_.emplace(stream_id, std::move(stream)).first;
+    if (end_stream) {
+        CompleteRequest(stream_id, inserted->second, completed);
+    }
+}
+
+void Http2Session::OnSettings(uint8_t flags, const char* payload, size_t length) {
+    if (flags & kAck) {
+        if (length != 0) {
+            throw ConnectionError(Http2Error::FRAME_SIZE_ERROR, "SETTINGS ACK with a payload");
+        }
+        settings_acked_ = true;
+        return;
+    }
+    ApplySettings(payload, length);
+    settings_received_ = true;
+    QueueFrame(kSettings, kAck, 0, nullptr, 0);
+}
+
+void Http2Session::ApplySettings(const char* payload, size_t length) {
+    if (length % 6 != 0) {
+        throw ConnectionError(Http2Error::FRAME_SIZE_ERROR, "SETTINGS of the wrong size");
+    }
+    for (size_t pos = 0; pos < length; pos += 6) {
+        const auto* bytes = reinterpret_cast<const uint8_t*>(payload + pos);
+        uint16_t id = static_cast<uint16_t>((bytes[0] << 8) | bytes[1]);
+        uint32_t value = ReadUint32(payload + pos + 2);
+
+        switch (id) {
+            case kHeaderTableSize:
+                encoder_.SetMaxTableSize(value);
+                break;
+            case kEnablePush:
+                if (value > 1) {
+                    throw ConnectionError(Http2Error::PROTOCOL_ERROR, "Invalid SETTINGS_ENABLE_PUSH");
+                }
+                break;
+            case kInitialWindowSize: {
+                if (value > kMaxWindow) {
+                    throw ConnectionError(Http2Error::FLOW_CONTROL_ERROR, "Invalid SETTINGS_INITIAL_WINDOW_SIZE");
+                }
+                // Applies to every stream's window, retroactively
+                int64_t delta = static_cast<int64_t>(value) - peer_initial_window_;
+                for (auto& [id_, stream] : streams_) {
+                    stream.send_window += delta;
+                    if (stream.send_window > kMaxWindow) {
+                        throw ConnectionError(Http2Error::FLOW_CONTROL_ERROR, "Stream window overflow");
+                    }
+                }
+                peer_initial_window_ = value;
+                break;
+            }
+            case kMaxFrameSize:
+                if (value < 16384 || value > 16777215) {
+                    throw ConnectionError(Http2Error::PROTOCOL_ERROR, "Invalid SETTINGS_MAX_FRAME_SIZE");
+                }
+                peer_max_frame_size_ = value;
+                break;
+            default:
+                // Includes MAX_CONCURRENT_STREAMS, which limits pushes only
+                break;
+        }
+    }
+}
+
+void Http2Session::OnWindowUpdate(uint32_t stream_id, const char* payload, size_t length) {
+    if (length != 4) {
+        throw ConnectionError(Http2Error::FRAME_SIZE_ERROR, "WINDOW_UPDATE of the wrong size");
+    }
+    int64_t increment = ReadUint32(payload) & 0x7fffffff;
+
+    if (stream_id == 0) {
+        if (increment == 0) {
+            throw ConnectionError(Http2Error::PROTOCOL_ERROR, "Zero WINDOW_UPDATE increment");
+        }
+        connection_send_window_ += increment;
+        if (connection_send_window_ > kMaxWindow) {
+            throw ConnectionError(Http2Error::FLOW_CONTROL_ERROR, "Connection window overflow");
+        }
+        return;
+    }
+
+    auto it = streams_.find(stream_id);
+    if (it == streams_.end()) {
+        if (stream_id > last_stream_id_) {
+            throw ConnectionError(Http2Error::PROTOCOL_ERROR, "WINDOW_UPDATE on an idle stream");
+        }
+        return;
+    }
+    if (increment == 0) {
+        ResetStream(stream_id, Http2Error::PROTOCOL_ERROR);
+        return;
+    }
+    it->second.send_window += increment;
+    if (it->second.send_window > kMaxWindow) {
+        ResetStream(stream_id, Http2Error::FLOW_CONTROL_ERROR);
+    }
+}
+
+void Http2Session::CompleteRequest(uint32_t stream_id, Stream& stream, std::vector<Http2Request>& completed) {
+    stream.remote_closed = true;
+    stream.dispatched = true;
+    completed.push_back(Http2Request{stream_id, std::move(stream.request)});
+}
+
+void Http2Session::RespondEarly(uint32_t stream_id, HttpResponse response) {
+    Stream& stream = streams_.at(stream_id);
+    stream.remote_closed = true;
+    stream.reset_after_body = true;
+    stream.request = HttpRequest{};
+    Respond(stream_id, std::move(response));
+}
+
+void Http2Session::Respond(uint32_t stream_id, HttpResponse response) {
+    auto it = streams_.find(stream_id);
+    if (it == streams_.end()) {
+        abandoned_.erase(stream_id);
+        return;
+    }
+    if (failed_ || it->second.responded) {
+        return;
+    }
+    Stream& stream = it->second;
+    stream.responded = true;
+
+    std::shared_ptr<const std::string> body;
+    if (response.GetFileBody()) {
+        body = std::make_shared<const std::string>(response.GetFileBody()->ReadAll());
+    } else if (response.GetSharedBody()) {
+        body = response.GetSharedBody();
+    } else {
+        body = std::make_shared<const std::string>(response.ReleaseBody());
+    }
+
+    int status = static_cast<int>(response.GetStatus());
+    HeaderList headers;
+    headers.emplace_back(":status", std::to_string(status));
+    for (auto& [name, value] : response.HeaderFields()) {
+        std::string lower = ToLower(name);
+        if (!ConnectionSpecific(lower) && lower != "content-length") {
+            headers.emplace_back(std::move(lower), std::move(value));
+        }
+    }
+    if (status != 204 && status != 304) {
+        headers.emplace_back("content-length", std::to_string(body->size()));
+    }
+
+    std::string block;
+    encoder_.Encode(headers, block);
+    header_bytes_sent_ += block.size();
+
+    // HEADERS, then CONTINUATION for whatever exceeds the peer's frame size
+    bool end_stream = body->empty();
+    size_t offset = 0;
+    do {
+        size_t chunk = std::min(block.size() - offset, peer_max_frame_size_);
+        bool first = offset == 0;
+        bool last = offset + chunk == block.size();
+        uint8_t flags = static_cast<uint8_t>((last ? kEndHeaders : 0) | (first && end_stream ? kEndStream : 0));
+        QueueFrame(first ? kHeaders : kContinuation, flags, stream_id, block.data() + offset, chunk);
+        offset += chunk;
+    } while (offset < block.size());
+
+    if (!end_stream) {
+        stream.body = std::move(body);
+        sending_.push_back(stream_id);
+        return;
+    }
+    if (stream.reset_after_body) {
+        ResetStream(stream_id, Http2Error::NO_ERROR);
+    } else {
+        streams_.erase(it);
+    }
+}
+
+void Http2Session::ResetStream(uint32_t stream_id, Http2Error error) {
+    std::string payload;
+    AppendUint32(payload, static_cast<uint32_t>(error));
+    QueueFrame(kRstStream, 0, stream_id, payload.data(), payload.size());
+    if (auto it = streams_.find(stream_id); it != streams_.end()) {
+        CloseStream(it);
+    }
+}
+
+void Http2Session::CloseStream(std::unordered_map<uint32_t, Stream>::iterator it) {
+    if (it->second.dispatched && !it->second.responded) {
+        abandoned_.insert(it->first);
+    }
+    streams_.erase(it);
+}
+
+void Http2Session::Shutdown(Http2Error error, const std::string& reason) {
+    going_away_ = true;
+    if (goaway_sent_) {
+        return;
+    }
+    goaway_sent_ = true;
+    std::string payload;
+    AppendUint32(payload, last_stream_id_);
+    AppendUint32(payload, static_cast<uint32_t>(error));
+    payload += reason;
+    QueueFrame(kGoAway, 0, 0, payload.data(), payload.size());
+}
+
+void Http2Session::Fail(Http2Error error, const std::string& reason) {
+    failed_ = true;
+    streams_.clear();
+    sending_.clear();
+    abandoned_.clear();
+    Shutdown(error, reason);
+}
+
+bool Http2Session::Finished() const {
+    return going_away_ && streams_.empty() && output_.empty();
+}
+
+std::string Http2Session::TakeOutput(size_t budget) {
+    std::string out;
+    out.swap(output_);
+    WriteData(out, budget);
+    return out;
+}
+
+void Http2Session::WriteData(std::string& out, size_t budget) {
+    bool progress = true;
+    while (progress && out.size() < budget && connection_send_window_ > 0 && !sending_.empty()) {
+        // One round: a frame from each stream that has window left
+        progress = false;
+        for (size_t turns = sending_.size(); turns > 0 && out.size() < budget && connection_send_window_ > 0; --turns) {
+            uint32_t stream_id = sending_.front();
+            sending_.pop_front();
+            auto it = streams_.find(stream_id);
+            if (it == streams_.end()) {
+                continue;   // Reset while waiting
+            }
+            Stream& stream = it->second;
+            int64_t window = std::min(stream.send_window, connection_send_window_);
+            if (window <= 0) {
+                sending_.push_back(stream_id);
+                continue;
+            }
+
+            size_t remaining = stream.body->size() - stream.body_sent;
+            size_t chunk = std::min({remaining, static_cast<size_t>(window), peer_max_frame_size_});
+            bool last = chunk == remaining;
+            AppendFrame(out, kData, last ? kEndStream : 0, stream_id, stream.body->data() + stream.body_sent, chunk);
+            stream.body_sent += chunk;
+            stream.send_window -= static_cast<int64_t>(chunk);
+            connection_send_window_ -= static_cast<int64_t>(chunk);
+            progress = true;
+
+            if (!last) {
+                sending_.push_back(stream_id);
+            } else if (stream.reset_after_body) {
+                std::string payload;
+                AppendUint32(payload, static_cast<uint32_t>(Http2Error::NO_ERROR));
+                AppendFrame(out, kRstStream, 0, stream_id, payload.data(), payload.size());
+                streams_.erase(it);
+            } else {
+                streams_.erase(it);
+            }
+        }
+    }
+}
+
+void Http2Session::QueueFrame(uint8_t type, uint8_t flags, uint32_t stream_id, const char* payload, size_t length) {
+    AppendFrame(output_, type, flags, stream_id, payload, length);
+}
+
+void Http2Session::QueueWindowUpdate(uint32_t stream_id, uint32_t increment) {
+    std::string payload;
+    AppendUint32(payload, increment);
+    QueueFrame(kWindowUpdate, 0, stream_id, payload.data(), payload.size());
+}
+
+void Http2Session::QueueSettings() {
+    std::string payload;
+    auto add = [&payload](uint16_t id, uint32_t value) {
+        payload.push_back(static_cast<char>(id >> 8));
+        payload.push_back(static_cast<char>(id));
+        AppendUint32(payload, value);
+    };
+    add(kMaxConcurrentStreams, settings_.max_concurrent_streams);
+    if (settings_.header_table_size != 4096) {
+        add(kHeaderTableSize, settings_.header_table_size);
+    }
+    if (settings_.initial_window_size != kDefaultWindow) {
+        add(kInitialWindowSize, settings_.initial_window_size);
+    }
+    if (settings_.max_frame_size != 16384) {
+        add(kMaxFrameSize, settings_.max_frame_size);
+    }
+    add(kMaxHeaderListSize, settings_.max_header_list_size);
+    QueueFrame(kSettings, 0, 0, payload.data(), payload.size());
+}
+
+} // namespace http
@@ -4,6 +4,7 @@
 #include <cctype>
 #include <cstring>
 #include <vector>
+#include <stdexcept>
 
 namespace http {
 
@@ -67,6 +68,113 @@ HttpRequest HttpParser::Parse(const std::string& raw_request) {
     return request;
 }
 
+size_t HttpParser::FindRequestEnd(const std::string& data) {
+    size_t headers_end = data.find("\r\n\r\n");
+    if (headers_end == std::string::npos) {
+        return 0;
+    }
+    size_t body_start = headers_end + 4;
+    
+    // Look for Content-Length and Transfer-Encoding among the header lines
+    // (skip the request line)
+    auto is_name = [&data](size_t start, size_t colon_pos, const char* name) {
+        const size_t length = std::strlen(name);
+        if (colon_pos - start != length) {
+            return false;
+        }
+        for (size_t i = 0; i < length; ++i) {
+            if (std::tolower(static_cast<unsigned char>(data[start + i])) != name[i]) {
+                return false;
+            }
+        }
+        return true;
+    };
+    size_t content_length = 0;
+    bool has_content_length = false;
+    bool has_transfer_encoding = false;
+    size_t line_start = data.find("\r\n") + 2;
+    while (line_start < headers_end) {
+        size_t line_end = data.find("\r\n", line_start);
+        size_t colon_pos = data.find(':', line_start);
+        
+        if (colon_pos < line_end) {
+            if (is_name(line_start, colon_pos, "transfer-encoding")) {
+                has_transfer_encoding = true;
+            } else if (is_name(line_start, colon_pos, "content-length")) {
+                std::string value = Trim(data.substr(colon_pos + 1, line_end - colon_pos - 1));
+                if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos ||
+                    value.size() > 18) {
+                    throw RequestFramingError(400, "Invalid Content-Length: " + value);
+                }
+                // Repeats must agree (RFC 9112 6.3), or the body's end is
+                // ambiguous
+                size_t length = std::stoull(value);
+                if (has_content_length && length != content_length) {
+                    throw RequestFramingError(400, "Conflicting Content-Length");
+                }
+                content_length = length;
+                has_content_length = true;
+            }
+        }
+        
+        line_start = line_end + 2;
+    }
+    
+    // Chunked bodies are not read, so the body's end is unknown
+    if (has_transfer_encoding) {
+        if (has_content_length) {
+            throw RequestFramingError(400, "Transfer-Encoding with Content-Length");
+        }
+        throw RequestFramingError(501, "Transfer-Encoding not supported");
+    }
+    
+    if (data.size() - body_start < content_length) {
+        return 0;
+    }
+    return body_start + content_length;
+}
+
+bool HttpParser::KeepAlive(const HttpRequest& request) {
+    // Connection is a comma-separated list of tokens
+    bool close = false;
+    bool keep_alive = false;
+    for (const auto& token : Split(ToLower(request.GetHeader("connection")), ',')) {
+        std::string option = Trim(token);
+        if (option == "close") {
+            close = true;
+        } else if (option == "keep-alive") {
+            keep_alive = true;
+        }
+    }
+    
+    if (close) {
+        return false;
+    }
+    return request.version == "HTTP/1.1" || keep_alive;
+}
+
+bool HttpParser::PeekRequestLine(const std::string& data, HttpMethod& method, std::string& path) {
+    size_t line_end = data.find('\n');
+    if (line_end == std::string::npos) {
+        return false;
+    }
+    
+    // Same tokenizing as Parse: method, target, version separated by spaces
+    size_t method_end = data.find(' ');
+    if (method_end == 0 || method_end >= line_end) {
+        return false;
+    }
+    size_t target_begin = data.find_first_not_of(' ', method_end);
+    if (target_begin >= line_end) {
+        return false;
+    }
+    size_t target_end = data.find_first_of(" ?\r\n", target_begin);
+    
+    method = ParseMethod(data.substr(0, method_end));
+    path.assign(data, target_begin, target_end - target_begin);
+    return true;
+}
+
 HttpMethod HttpParser::ParseMethod(const std::string& method_str) {
     std::string upper = method_str;
     std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
@@ -57,6 +57,41 @@ HttpResponse& HttpResponse::SetBody(const std::vector<char>& body) {
     return *this;
 }
 
+HttpResponse& HttpResponse::SetFileBody(std::shared_ptr<FileBody> file) {
+    body_.clear();
+    SetContentLength(file ? file->Length() : 0);
+    file_body_ = std::move(file);
+    return *this;
+}
+
+HttpResponse& HttpResponse::SetSharedBody(std::shared_ptr<const std::string> body) {
+    body_.clear();
+    file_body_.reset();
+    SetContentLength(body ? body->size() : 0);
+    shared_body_ = std::move(body);
+    return *this;
+}
+
+HttpResponse& HttpResponse::SetEncodedBody(std::shared_ptr<const std::string> body, const std::string& coding) {
+    // Content-Length changes, so rendered headers are taken apart
+    if (rendered_headers_) {
+        std::vector<std::pair<std::string, std::string>> fields = HeaderFields();
+        rendered_headers_.reset();
+        headers_.clear();
+        for (auto& [key, value] : fields) {
+            headers_[key] = std::move(value);
+        }
+    }
+    
+    SetSharedBody(std::move(body));
+    SetHeader("Content-Encoding", coding);
+    auto etag = headers_.find("ETag");
+    if (etag != headers_.end() && etag->second.compare(0, 2, "W/") != 0) {
+        etag->second = "W/" + etag->second;
+    }
+    return *this;
+}
+
 HttpResponse& HttpResponse::Json(const std::string& json) {
     SetContentType("application/json");
     SetBody(json);
@@ -72,65 +107,133 @@ HttpResponse HttpResponse::FromFile(const std::string& file_path) {
         return BadRequest("Path is not a file");
     }
     
-    std::ifstream file(file_path, std::ios::binary);
-    if (!file.is_open()) {
+    std::shared_ptr<FileBody> file;
+    try {
+        file = FileBody::Open(file_path);
+    } catch (const std::runtime_error&) {
         return InternalError("Failed to open file");
     }
     
-    std::vector<char> buffer((std::istreambuf_iterator<char>(file)),
-                             std::istreambuf_iterator<char>());
-    
     HttpResponse response(HttpStatus::OK);
-    response.SetBody(buffer);
-    
-    // Set content type based on extension
-    std::string ext = std::filesystem::path(file_path).extension().string();
-    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    response.SetFileBody(std::move(file));
     
-    if (ext == ".html" || ext == ".htm") {
-        response.SetContentType("text/html");
-    } else if (ext == ".css") {
-        response.SetContentType("text/css");
-    } else if (ext == ".js") {
-        response.SetContentType("application/javascript");
-    } else if (ext == ".json") {
-        response.SetContentType("application/json");
-    } else if (ext == ".png") {
-        response.SetContentType("image/png");
-    } else if (ext == ".jpg" || ext == ".jpeg") {
-        response.SetContentType("image/jpeg");
-    } else if (ext == ".gif") {
-        response.SetContentType("image/gif");
-    } else if (ext == ".svg") {
-        response.SetContentType("image/svg+xml");
-    } else {
-        response.SetContentType("application/octet-stream");
-    }
+    response.SetContentType(ContentTypeFor(file_path));
     
     return response;
 }
 
+HttpResponse HttpResponse::Rendered(HttpStatus status, std::shared_ptr<const std::string> headers,
+                                    std::shared_ptr<const std::string> body) {
+    HttpResponse response(status);
+    response.headers_.erase("Server");
+    response.rendered_headers_ = std::move(headers);
+    response.shared_body_ = std::move(body);
+    return response;
+}
+
+const std::string& HttpResponse::ContentTypeFor(const std::string& file_path) {
+    static const std::unordered_map<std::string, std::string> types = {
+        {".html", "text/html"},
+        {".htm", "text/html"},
+        {".css", "text/css"},
+        {".js", "application/javascript"},
+        {".json", "application/json"},
+        {".png", "image/png"},
+        {".jpg", "image/jpeg"},
+        {".jpeg", "image/jpeg"},
+        {".gif", "image/gif"},
+        {".svg", "image/svg+xml"},
+    };
+    static const std::string fallback = "application/octet-stream";
+    
+    std::string ext = std::filesystem::path(file_path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    auto it = types.find(ext);
+    return it != types.end() ? it->second : fallback;
+}
+
 std::string HttpResponse::ToString() const {
-    std::ostringstream response;
+    std::string response = SerializeHeaders();
+    response += file_body_ ? file_body_->ReadAll() : GetBody();
+    return response;
+}
+
+std::string HttpResponse::SerializeHeaders() const {
+    std::string message = GetStatusMessage(status_);
+    std::string code = StatusToString(status_);
+    
+    size_t size = rendered_headers_ ? rendered_headers_->size() + 2
+                                    : 9 + code.size() + 1 + message.size() + 2 + 2;
+    for (const auto& [key, value] : headers_) {
+        size += key.size() + 2 + value.size() + 2;
+    }
+    
+    std::string headers;
+    headers.reserve(size);
     
-    // Status line
-    response << "HTTP/1.1 " << static_cast<int>(status_) << " "
-             << GetStatusMessage(status_) << "\r\n";
+    // Status line (already part of rendered headers)
+    if (rendered_headers_) {
+        headers.append(*rendered_headers_);
+    } else {
+        headers.append("HTTP/1.1 ").append(code).append(" ").append(message).append("\r\n");
+    }
     
     // Headers
     for (const auto& [key, value] : headers_) {
-        response << key << ": " << value << "\r\n";
+        headers.append(key).append(": ").append(value).append("\r\n");
     }
     
     // Empty line before body
-    response << "\r\n";
+    headers.append("\r\n");
+    return headers;
+}
+
+std::vector<std::pair<std::string, std::string>> HttpResponse::HeaderFields() const {
+    std::vector<std::pair<std::string, std::string>> fields;
     
-    // Body
-    if (!body_.empty()) {
-        response << body_;
+    // Rendered headers: "Name: value" lines after the status line
+    if (rendered_headers_) {
+        const std::string& rendered = *rendered_headers_;
+        size_t pos = rendered.find("\r\n");
+        while (pos != std::string::npos && pos + 2 < rendered.size()) {
+            size_t start = pos + 2;
+            pos = rendered.find("\r\n", start);
+            size_t end = pos == std::string::npos ? rendered.size() : pos;
+            size_t colon = rendered.find(':', start);
+            if (colon != std::string::npos && colon < end) {
+                size_t value = rendered.find_first_not_of(' ', colon + 1);
+                value = std::min(value, end);
+                fields.emplace_back(rendered.substr(start, colon - start), rendered.substr(value, end - value));
+            }
+        }
     }
     
-    return response.str();
+    for (const auto& [key, value] : headers_) {
+        fields.emplace_back(key, value);
+    }
+    return fields;
+}
+
+std::string HttpResponse::GetHeader(const std::string& name) const {
+    auto same_name = [&name](const std::string& key) {
+        return key.size() == name.size() &&
+               std::equal(key.begin(), key.end(), name.begin(), [](char a, char b) {
+                   return ::tolower(static_cast<unsigned char>(a)) == ::tolower(static_cast<unsigned char>(b));
+               });
+    };
+    for (const auto& [key, value] : headers_) {
+        if (same_name(key)) {
+            return value;
+        }
+    }
+    if (rendered_headers_) {
+        for (const auto& [key, value] : HeaderFields()) {
+            if (same_name(key)) {
+                return value;
+            }
+        }
+    }
+    return "";
 }
 
 std::string HttpResponse::StatusToString(HttpStatus status) const {
@@ -143,11 +246,13 @@ std::string HttpResponse::GetStatusMessage(HttpStatus status) const {
         case HttpStatus::CREATED: return "Created";
         case HttpStatus::NO_CONTENT: return "No Content";
         case HttpStatus::SWITCHING_PROTOCOLS: return "Switching Protocols";
+        case HttpStatus::NOT_MODIFIED: return "Not Modified";
         case HttpStatus::BAD_REQUEST: return "Bad Request";
         case HttpStatus::UNAUTHORIZED: return "Unauthorized";
         case HttpStatus::FORBIDDEN: return "Forbidden";
         case HttpStatus::NOT_FOUND: return "Not Found";
         case HttpStatus::METHOD_NOT_ALLOWED: return "Method Not Allowed";
+        case HttpStatus::PAYLOAD_TOO_LARGE: return "Payload Too Large";
         case HttpStatus::INTERNAL_SERVER_ERROR: return "Internal Server Error";
         case HttpStatus::NOT_IMPLEMENTED: return "Not Implemented";
         case HttpStatus::SERVICE_UNAVAILABLE: return "Service Unavailable";
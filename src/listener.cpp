@@ -0,0 +1,219 @@
+#include "listener.hpp"
+#include <stdexcept>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+namespace http {
+
+namespace {
+
+uint16_t ParsePort(const std::string& text, const std::string& spec) {
+    if (text.empty() || text.size() > 5 || text.find_first_not_of("0123456789") != std::string::npos) {
+        throw std::invalid_argument("Invalid port in listen endpoint: " + spec);
+    }
+    unsigned long port = std::stoul(text);
+    if (port > 65535) {
+        throw std::invalid_argument("Invalid port in listen endpoint: " + spec);
+    }
+    return static_cast<uint16_t>(port);
+}
+
+[[noreturn]] void Fail(int fd, const std::string& what, const ListenEndpoint& endpoint) {
+    std::string reason = strerror(errno);
+    close(fd);
+    throw std::runtime_error(what + " " + endpoint.ToString() + ": " + reason);
+}
+
+void SetOption(int fd, int level, int name, int value, const char* what, const ListenEndpoint& endpoint) {
+    if (setsockopt(fd, level, name, &value, sizeof(value)) < 0) {
+        Fail(fd, std::string("Failed to set ") + what + " on", endpoint);
+    }
+}
+
+} // namespace
+
+ListenEndpoint ListenEndpoint::Parse(const std::string& spec) {
+    ListenEndpoint endpoint;
+    if (spec.compare(0, 5, "unix:") == 0) {
+        endpoint.family = Family::Unix;
+        endpoint.address = spec.substr(5);
+        if (endpoint.address.empty() || endpoint.address.size() >= sizeof(sockaddr_un::sun_path)) {
+            throw std::invalid_argument("Invalid Unix socket path in listen endpoint: " + spec);
+        }
+        return endpoint;
+    }
+
+    size_t colon = spec.rfind(':');
+    if (colon == std::string::npos) {
+        throw std::invalid_argument("Listen endpoint needs a port: " + spec);
+    }
+    std::string host = spec.substr(0, colon);
+    if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+    } else if (host.find(':') != std::string::npos) {
+        throw std::invalid_argument("IPv6 listen endpoints need brackets: " + spec);
+    }
+    if (host.empty() || host == "*") {
+        host = "0.0.0.0";
+    }
+
+    endpoint = FromHostPort(host, ParsePort(spec.substr(colon + 1), spec));
+    return endpoint;
+}
+
+ListenEndpoint ListenEndpoint::FromHostPort(const std::string& host, uint16_t port) {
+    ListenEndpoint endpoint;
+    endpoint.family = host.find(':') != std::string::npos ? Family::IPv6 : Family::IPv4;
+    endpoint.address = host;
+    endpoint.port = port;
+
+    unsigned char probe[sizeof(struct in6_addr)];
+    int af = endpoint.family == Family::IPv6 ? AF_INET6 : AF_INET;
+    if (inet_pton(af, host.c_str(), probe) != 1) {
+        throw std::invalid_argument("Invalid listen address: " + host);
+    }
+    return endpoint;
+}
+
+std::string ListenEndpoint::ToString() const {
+    switch (family) {
+        case Family::Unix: return "unix:" + address;
+        case Family::IPv6: return "[" + address + "]:" + std::to_string(port);
+        default: return address + ":" + std::to_string(port);
+    }
+}
+
+std::vector<ListenEndpoint> ParseListenEndpoints(const std::string& list) {
+    std::vector<ListenEndpoint> endpoints;
+    size_t pos = 0;
+    while (pos <= list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+        size_t first = list.find_first_not_of(" \t", pos);
+        if (first != std::string::npos && first < end) {
+            size_t last = list.find_last_not_of(" \t", end - 1);
+            endpoints.push_back(ListenEndpoint::Parse(list.substr(first, last + 1 - first)));
+        }
+        pos = end + 1;
+    }
+    return endpoints;
+}
+
+int OpenListener(const ListenEndpoint& endpoint, const ListenOptions& options) {
+    int domain = AF_INET;
+    if (endpoint.family == ListenEndpoint::Family::IPv6) {
+        domain = AF_INET6;
+    } else if (endpoint.family == ListenEndpoint::Family::Unix) {
+        domain = AF_UNIX;
+    }
+
+#if defined(SOCK_NONBLOCK)
+    int fd = socket(domain, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+#else
+    int fd = socket(domain, SOCK_STREAM, 0);
+    if (fd >= 0) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+#endif
+    if (fd < 0) {
+        throw std::runtime_error("Failed to create socket for " + endpoint.ToString() + ": " + strerror(errno));
+    }
+
+    struct sockaddr_storage address{};
+    socklen_t address_len = 0;
+
+    if (endpoint.family == ListenEndpoint::Family::Unix) {
+        // Replace a socket left behind by an earlier run, but nothing else
+        struct stat info{};
+        if (lstat(endpoint.address.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) {
+            unlink(endpoint.address.c_str());
+        }
+
+        auto* local = reinterpret_cast<struct sockaddr_un*>(&address);
+        local->sun_family = AF_UNIX;
+        strncpy(local->sun_path, endpoint.address.c_str(), sizeof(local->sun_path) - 1);
+        address_len = sizeof(struct sockaddr_un);
+    } else {
+        SetOption(fd, SOL_SOCKET, SO_REUSEADDR, 1, "SO_REUSEADDR", endpoint);
+
+        // Let the kernel spread incoming connections across the reactors'
+        // listeners (FreeBSD needs the _LB variant for load balancing)
+        if (options.reuse_port) {
+#if defined(SO_REUSEPORT_LB)
+            SetOption(fd, SOL_SOCKET, SO_REUSEPORT_LB, 1, "SO_REUSEPORT_LB", endpoint);
+#else
+            SetOption(fd, SOL_SOCKET, SO_REUSEPORT, 1, "SO_REUSEPORT", endpoint);
+#endif
+        }
+
+        // Accepted sockets inherit these from the listener, which saves a
+        // setsockopt per connection
+        if (options.tcp_nodelay) {
+            SetOption(fd, IPPROTO_TCP, TCP_NODELAY, 1, "TCP_NODELAY", endpoint);
+        }
+#if defined(TCP_DEFER_ACCEPT)
+        if (options.defer_accept_seconds > 0) {
+            SetOption(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, options.defer_accept_seconds, "TCP_DEFER_ACCEPT", endpoint);
+        }
+#endif
+#if defined(TCP_FASTOPEN)
+        if (options.fastopen_queue > 0) {
+            SetOption(fd, IPPROTO_TCP, TCP_FASTOPEN, options.fastopen_queue, "TCP_FASTOPEN", endpoint);
+        }
+#endif
+
+        if (endpoint.family == ListenEndpoint::Family::IPv6) {
+            // "[::]" listens on IPv6 only; list an IPv4 endpoint as well for both
+            SetOption(fd, IPPROTO_IPV6, IPV6_V6ONLY, 1, "IPV6_V6ONLY", endpoint);
+            auto* inet6 = reinterpret_cast<struct sockaddr_in6*>(&address);
+            inet6->sin6_family = AF_INET6;
+            inet6->sin6_port = htons(endpoint.port);
+            inet_pton(AF_INET6, endpoint.address.c_str(), &inet6->sin6_addr);
+            address_len = sizeof(struct sockaddr_in6);
+        } else {
+            auto* inet = reinterpret_cast<struct sockaddr_in*>(&address);
+            inet->sin_family = AF_INET;
+            inet->sin_port = htons(endpoint.port);
+            inet_pton(AF_INET, endpoint.address.c_str(), &inet->sin_addr);
+            address_len = sizeof(struct sockaddr_in);
+        }
+    }
+
+    if (bind(fd, reinterpret_cast<struct sockaddr*>(&address), address_len) < 0) {
+        Fail(fd, "Failed to bind", endpoint);
+    }
+
+    if (listen(fd, options.backlog) < 0) {
+        Fail(fd, "Failed to listen on", endpoint);
+    }
+
+    return fd;
+}
+
+uint16_t LocalPort(int fd) {
+    struct sockaddr_storage bound{};
+    socklen_t bound_len = sizeof(bound);
+    if (getsockname(fd, reinterpret_cast<struct sockaddr*>(&bound), &bound_len) != 0) {
+        return 0;
+    }
+    if (bound.ss_family == AF_INET) {
+        return ntohs(reinterpret_cast<struct sockaddr_in*>(&bound)->sin_port);
+    }
+    if (bound.ss_family == AF_INET6) {
+        return ntohs(reinterpret_cast<struct sockaddr_in6*>(&bound)->sin6_port);
+    }
+    return 0;
+}
+
+} // namespace http
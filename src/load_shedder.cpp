@@ -0,0 +1,27 @@
+#include "load_shedder.hpp"
+
+namespace http {
+
+LoadShedder::LoadShedder(std::chrono::milliseconds target, std::chrono::milliseconds interval)
+    : target_(target), interval_(interval) {
+}
+
+void LoadShedder::Report(std::chrono::nanoseconds wait, bool queue_empty, Clock::time_point now) {
+    last_wait_us_.store(std::chrono::duration_cast<std::chrono::microseconds>(wait).count(),
+                        std::memory_order_relaxed);
+
+    if (target_.count() == 0 || wait < target_ || queue_empty) {
+        first_above_ = Clock::time_point{};
+        overloaded_.store(false, std::memory_order_relaxed);
+        return;
+    }
+
+    // Above target: tolerate it for one interval before calling it standing
+    if (first_above_ == Clock::time_point{}) {
+        first_above_ = now + interval_;
+    } else if (now >= first_above_) {
+        overloaded_.store(true, std::memory_order_relaxed);
+    }
+}
+
+} // namespace http
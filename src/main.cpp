@@ -4,6 +4,7 @@
 #include "metrics_storage.hpp"
 #include "alert_manager.hpp"
 #include "websocket.hpp"
+#include "cpu_topology.hpp"
 #include <iostream>
 #include <csignal>
 #include <atomic>
@@ -14,7 +15,6 @@
 #include <chrono>
 #include <iomanip>
 #include <unistd.h>
-#include <fcntl.h>
 
 using namespace http;
 
@@ -34,7 +34,10 @@ void SignalHandler(int signal) {
     }
 }
 
-void MetricsCollectionThread() {
+void MetricsCollectionThread(const std::string& thread_name) {
+    if (!thread_name.empty()) {
+        SetCurrentThreadName(thread_name);
+    }
     while (g_running) {
         if (g_collector && g_storage && g_alert_manager) {
             SystemMetrics metrics = g_collector->Collect();
@@ -590,13 +593,16 @@ std::string GetDashboardHTML() {
 }
 
 int main(int argc, char* argv[]) {
-    Config config;
+    Config config = Config::FromEnv();
     if (argc > 1) {
         config.port = static_cast<uint16_t>(std::stoi(argv[1]));
     }
     if (argc > 2) {
         config.thread_pool_size = std::stoul(argv[2]);
     }
+    if (argc > 3) {
+        config.reactor_count = std::stoul(argv[3]);
+    }
     
     signal(SIGINT, SignalHandler);
     signal(SIGTERM, SignalHandler);
@@ -627,21 +633,24 @@ int main(int argc, char* argv[]) {
         Server server(config);
         g_server = &server;
         
-        // Dashboard
-        server.Get("/", [](const HttpRequest& req) {
+        // Dashboard: built once and shared, so it is also compressed once
+        auto dashboard = std::make_shared<const std::string>(GetDashboardHTML());
+        server.Get("/", [dashboard](const HttpRequest& req) {
             HttpResponse response(HttpStatus::OK);
             response.SetContentType("text/html");
-            response.SetBody(GetDashboardHTML());
+            response.SetSharedBody(dashboard);
             return response;
         });
         
-        // API: Get latest metrics
+        // API: Get latest metrics (a copy under a short lock, so it is
+        // answered on the event loop thread)
         server.Get("/api/metrics/latest", [&storage](const HttpRequest& req) {
             SystemMetrics latest = storage.GetLatest();
             return JsonResponse(latest.ToJson());
-        });
+        }, RouteMode::Inline);
         
-        // API: Get metrics for time range
+        // API: Get metrics for time range (up to an hour of samples, so it
+        // runs on the bulk workers and cannot hold up the rest)
         server.Get("/api/metrics/range", [&storage](const HttpRequest& req) {
             auto now = std::chrono::system_clock::now();
             size_t seconds = 300; // Default 5 minutes
@@ -661,7 +670,7 @@ int main(int argc, char* argv[]) {
             json << "]";
             
             return JsonResponse(json.str());
-        });
+        }, RouteMode::Pool, TaskPriority::Bulk);
         
         // API: Get aggregated stats
         server.Get("/api/metrics/stats", [&storage](const HttpRequest& req) {
@@ -689,7 +698,49 @@ int main(int argc, char* argv[]) {
                  << "}";
             
             return JsonResponse(json.str());
-        });
+        }, RouteMode::Pool, TaskPriority::Bulk);
+        
+        // API: Event loop counters (busy-poll spin ratio, wait time, batch size)
+        server.Get("/api/server/loops", [&server](const HttpRequest& req) {
+            EventLoopStats stats = server.LoopStats();
+            
+            std::ostringstream json;
+            json << std::fixed << std::setprecision(3);
+            json << "{"
+                 << "\"reactors\":" << server.ReactorCount() << ","
+                 << "\"iterations\":" << stats.iterations << ","
+                 << "\"events\":" << stats.events << ","
+                 << "\"spin_polls\":" << stats.spin_polls << ","
+                 << "\"spin_hits\":" << stats.spin_hits << ","
+                 << "\"spin_hit_ratio\":" << stats.SpinHitRatio() << ","
+                 << "\"spin_ms\":" << stats.spin_ns / 1e6 << ","
+                 << "\"blocking_waits\":" << stats.blocking_waits << ","
+                 << "\"blocked_ms\":" << stats.blocked_ns / 1e6 << ","
+                 << "\"batch_size\":" << stats.batch_size
+                 << "}";
+            
+            return JsonResponse(json.str());
+        }, RouteMode::Pool, TaskPriority::Critical);
+        
+        // API: Admission control (connection cap, queue-delay load shedding).
+        // Server and alert status stay answerable under overload, on the
+        // reserved workers.
+        server.Get("/api/server/admission", [&server](const HttpRequest& req) {
+            AdmissionStats stats = server.Admission();
+            
+            std::ostringstream json;
+            json << "{"
+                 << "\"open_connections\":" << stats.open_connections << ","
+                 << "\"rejected_connections\":" << stats.rejected_connections << ","
+                 << "\"shed_requests\":" << stats.shed_requests << ","
+                 << "\"overloaded\":" << (stats.overloaded ? "true" : "false") << ","
+                 << "\"bulk_overloaded\":" << (stats.bulk_overloaded ? "true" : "false") << ","
+                 << "\"queue_wait_us\":" << stats.queue_wait.count() << ","
+                 << "\"workers\":" << stats.workers
+                 << "}";
+            
+            return JsonResponse(json.str());
+        }, RouteMode::Pool, TaskPriority::Critical);
         
         // API: Get active alerts
         server.Get("/api/alerts", [&alert_manager](const HttpRequest& req) {
@@ -704,53 +755,28 @@ int main(int argc, char* argv[]) {
             json << "]";
             
             return JsonResponse(json.str());
-        });
+        }, RouteMode::Pool, TaskPriority::Critical);
         
-        // WebSocket endpoint for real-time metrics
-        server.RegisterWebSocketHandler("/ws/metrics", [&storage](int client_fd, const std::string&) {
-            // Send metrics every second
-            std::thread([client_fd, &storage]() {
-                while (g_running) {
-                    // Check if connection is still valid
-                    if (fcntl(client_fd, F_GETFL) < 0) {
-                        break; // Connection closed
-                    }
-                    
-                    SystemMetrics latest = storage.GetLatest();
-                    
-                    // Check if we have valid data
-                    if (latest.memory_total == 0 && latest.cpu_percent == 0) {
-                        // No data collected yet, wait a bit
-                        std::this_thread::sleep_for(std::chrono::milliseconds(500));
-                        continue;
-                    }
-                    
-                    std::string json = latest.ToJson();
-                    auto frame = WebSocket::EncodeFrame(json, WebSocket::Opcode::Text);
-                    ssize_t sent = send(client_fd, frame.data(), frame.size(), 0);
-                    
-                    if (sent < 0) {
-                        // Error sending, connection probably closed
-                        break;
-                    }
-                    
-                    std::this_thread::sleep_for(std::chrono::seconds(1));
-                }
-                
-                // Clean up
-                if (fcntl(client_fd, F_GETFL) >= 0) {
-                    close(client_fd);
-                }
-            }).detach();
+        // WebSocket endpoint for real-time metrics, pushed once a second
+        server.PushWebSocketEvery("/ws/metrics", std::chrono::seconds(1), [&storage]() -> std::string {
+            SystemMetrics latest = storage.GetLatest();
+            
+            // No data collected yet
+            if (latest.memory_total == 0 && latest.cpu_percent == 0) {
+                return "";
+            }
+            
+            return latest.ToJson();
         });
         
         // Health check
         server.Get("/health", [](const HttpRequest& req) {
             return JsonResponse(R"({"status": "healthy", "service": "monitoring-server"})");
-        });
+        }, RouteMode::Inline);
         
         // Start metrics collection thread
-        std::thread metrics_thread(MetricsCollectionThread);
+        std::thread metrics_thread(MetricsCollectionThread,
+                                   config.thread_name_prefix.empty() ? "" : config.thread_name_prefix + "-metrics");
         metrics_thread.detach();
         
         std::cout << "🚀 System Monitoring Server starting on port " << config.port << "\n";
@@ -0,0 +1,40 @@
+#include "poller.hpp"
+
+namespace http {
+
+FilterChanges PlanFilterChanges(uint32_t old_interest, uint32_t new_interest) {
+    const uint32_t io_mask = kPollReadable | kPollWritable;
+    const uint32_t mode_mask = kPollEdge | kPollOneShot;
+
+    // Which filter a fired one-shot left behind is not known here
+    uint32_t registered = (old_interest == kPollOneShot) ? io_mask : (old_interest & io_mask);
+    bool mode_changed = ((old_interest ^ new_interest) & mode_mask) != 0;
+
+    FilterChanges changes;
+    changes.add = new_interest & io_mask;
+    if (!mode_changed) {
+        changes.add &= ~(old_interest & io_mask);
+    }
+    changes.remove = registered & ~new_interest;
+    return changes;
+}
+
+std::unique_ptr<Poller> Poller::Create(EventBackend backend) {
+#if defined(HTTP_HAVE_IO_URING)
+    if (backend == EventBackend::IoUring) {
+        if (auto uring = UringPoller::TryCreate()) {
+            return uring;
+        }
+    }
+#else
+    (void)backend;
+#endif
+
+#if defined(HTTP_POLLER_KQUEUE)
+    return std::make_unique<KqueuePoller>();
+#elif defined(HTTP_POLLER_EPOLL)
+    return std::make_unique<EpollPoller>();
+#endif
+}
+
+} // namespace http
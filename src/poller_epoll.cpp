@@ -0,0 +1,140 @@
+#include "poller.hpp"
+#include <stdexcept>
+#include <cstring>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+namespace http {
+
+namespace {
+
+uint32_t ToEpollEvents(uint32_t interest) {
+    uint32_t events = 0;
+    if (interest & kPollReadable) events |= EPOLLIN | EPOLLRDHUP;
+    if (interest & kPollWritable) events |= EPOLLOUT;
+    if (interest & kPollEdge) events |= EPOLLET;
+    if (interest & kPollOneShot) events |= EPOLLONESHOT;
+    return events;
+}
+
+} // namespace
+
+EpollPoller::EpollPoller() {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ == -1) {
+        throw std::runtime_error("Failed to create epoll instance");
+    }
+
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ == -1) {
+        close(epoll_fd_);
+        throw std::runtime_error("Failed to create wakeup eventfd");
+    }
+
+    struct epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.ptr = &wake_fd_;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event) == -1) {
+        close(wake_fd_);
+        close(epoll_fd_);
+        throw std::runtime_error("Failed to register wakeup eventfd");
+    }
+}
+
+EpollPoller::~EpollPoller() {
+    if (wake_fd_ >= 0) {
+        close(wake_fd_);
+    }
+    if (epoll_fd_ >= 0) {
+        close(epoll_fd_);
+    }
+}
+
+void EpollPoller::Update(int fd, uint32_t old_interest, uint32_t new_interest, void* udata) {
+    const uint32_t io_mask = kPollReadable | kPollWritable;
+
+    if (!(new_interest & io_mask)) {
+        // A fired one-shot fd stays in the set, disabled, until it is closed
+        // or registered again, so dropping it costs no syscall
+        if (old_interest & io_mask) {
+            // Fails harmlessly if the fd was already closed
+            epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+        }
+        return;
+    }
+
+    if (old_interest == new_interest) {
+        return;
+    }
+
+    struct epoll_event event{};
+    event.events = ToEpollEvents(new_interest);
+    event.data.ptr = udata;
+
+    // Re-arming a fired one-shot fd is a MOD
+    int op = (old_interest & (io_mask | kPollOneShot)) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    if (epoll_ctl(epoll_fd_, op, fd, &event) == 0) {
+        return;
+    }
+
+    // The kernel drops closed fds from the set on its own, so a reused fd
+    // number may look registered to us but not to epoll (and vice versa)
+    if (op == EPOLL_CTL_MOD && errno == ENOENT) {
+        op = EPOLL_CTL_ADD;
+    } else if (op == EPOLL_CTL_ADD && errno == EEXIST) {
+        op = EPOLL_CTL_MOD;
+    } else {
+        throw std::runtime_error("Failed to register epoll event: " + std::string(strerror(errno)));
+    }
+
+    if (epoll_ctl(epoll_fd_, op, fd, &event) == -1) {
+        throw std::runtime_error("Failed to register epoll event: " + std::string(strerror(errno)));
+    }
+}
+
+int EpollPoller::Poll(PollEvent* out, int max_events, int timeout_ms) {
+    if (native_events_.size() < static_cast<size_t>(max_events)) {
+        native_events_.resize(max_events);
+    }
+
+    int num_events = epoll_wait(epoll_fd_, native_events_.data(), max_events, timeout_ms);
+    if (num_events == -1) {
+        if (errno != EINTR) {
+            throw std::runtime_error("epoll_wait failed");
+        }
+        return -1;
+    }
+
+    int count = 0;
+    for (int i = 0; i < num_events; ++i) {
+        const struct epoll_event& event = native_events_[i];
+        if (event.data.ptr == &wake_fd_) {
+            uint64_t value;
+            while (read(wake_fd_, &value, sizeof(value)) > 0) {
+            }
+            continue;
+        }
+
+        uint32_t events = 0;
+        if (event.events & EPOLLIN) events |= kPollReadable;
+        if (event.events & EPOLLOUT) events |= kPollWritable;
+        if (event.events & (EPOLLHUP | EPOLLRDHUP)) events |= kPollHangup;
+        if (event.events & EPOLLERR) events |= kPollError;
+        out[count].fd = -1;
+        out[count].events = events;
+        out[count].udata = event.data.ptr;
+        ++count;
+    }
+
+    return count;
+}
+
+void EpollPoller::Wakeup() {
+    uint64_t one = 1;
+    // EAGAIN means the counter is saturated, which still wakes the poller
+    ssize_t written = write(wake_fd_, &one, sizeof(one));
+    (void)written;
+}
+
+} // namespace http
@@ -0,0 +1,143 @@
+#include "poller.hpp"
+#include <stdexcept>
+#include <errno.h>
+#include <unistd.h>
+
+namespace http {
+
+namespace {
+
+// EVFILT_USER identifiers live in their own namespace, apart from fds
+constexpr uintptr_t kWakeIdent = 0;
+
+} // namespace
+
+KqueuePoller::KqueuePoller() {
+    kqueue_fd_ = kqueue();
+    if (kqueue_fd_ == -1) {
+        throw std::runtime_error("Failed to create kqueue");
+    }
+
+    struct kevent change;
+    EV_SET(&change, kWakeIdent, EVFILT_USER, EV_ADD | EV_CLEAR, 0, 0, nullptr);
+    if (kevent(kqueue_fd_, &change, 1, nullptr, 0, nullptr) == -1) {
+        close(kqueue_fd_);
+        throw std::runtime_error("Failed to register wakeup event");
+    }
+}
+
+KqueuePoller::~KqueuePoller() {
+    if (kqueue_fd_ >= 0) {
+        close(kqueue_fd_);
+    }
+}
+
+void KqueuePoller::Update(int fd, uint32_t old_interest, uint32_t new_interest, void* udata) {
+    // EV_ADD on an existing filter updates it in place
+    FilterChanges plan = PlanFilterChanges(old_interest, new_interest);
+    uint16_t flags = EV_ADD | EV_ENABLE;
+    if (new_interest & kPollEdge) {
+        flags |= EV_CLEAR;
+    }
+    if (new_interest & kPollOneShot) {
+        flags |= EV_ONESHOT;
+    }
+
+    struct kevent change;
+    if (plan.add & kPollReadable) {
+        EV_SET(&change, fd, EVFILT_READ, flags, 0, 0, udata);
+        changes_.push_back(change);
+    } else if (plan.remove & kPollReadable) {
+        // A null udata marks a delete whose failure Poll() ignores
+        EV_SET(&change, fd, EVFILT_READ, EV_DELETE, 0, 0, nullptr);
+        changes_.push_back(change);
+    }
+
+    if (plan.add & kPollWritable) {
+        EV_SET(&change, fd, EVFILT_WRITE, flags, 0, 0, udata);
+        changes_.push_back(change);
+    } else if (plan.remove & kPollWritable) {
+        EV_SET(&change, fd, EVFILT_WRITE, EV_DELETE, 0, 0, nullptr);
+        changes_.push_back(change);
+    }
+}
+
+int KqueuePoller::Poll(PollEvent* out, int max_events, int timeout_ms) {
+    if (overflow_pos_ < overflow_.size()) {
+        int count = 0;
+        while (count < max_events && overflow_pos_ < overflow_.size()) {
+            out[count++] = overflow_[overflow_pos_++];
+        }
+        return count;
+    }
+    overflow_.clear();
+    overflow_pos_ = 0;
+
+    // Changelist errors take event slots, so leave room for one per change
+    size_t capacity = static_cast<size_t>(max_events) + changes_.size();
+    if (native_events_.size() < capacity) {
+        native_events_.resize(capacity);
+    }
+
+    struct timespec timeout;
+    struct timespec* timeout_ptr = nullptr;
+    if (timeout_ms >= 0) {
+        timeout.tv_sec = timeout_ms / 1000;
+        timeout.tv_nsec = static_cast<long>(timeout_ms % 1000) * 1000000L;
+        timeout_ptr = &timeout;
+    }
+
+    int num_events = kevent(kqueue_fd_, changes_.data(), static_cast<int>(changes_.size()),
+                            native_events_.data(), static_cast<int>(capacity), timeout_ptr);
+    if (num_events == -1) {
+        if (errno != EINTR) {
+            changes_.clear();
+            throw std::runtime_error("kevent failed");
+        }
+        // The changelist is applied before the wait is interrupted
+        changes_.clear();
+        return -1;
+    }
+    changes_.clear();
+
+    int count = 0;
+    for (int i = 0; i < num_events; ++i) {
+        const struct kevent& event = native_events_[i];
+        if (event.filter == EVFILT_USER) {
+            continue;  // Wakeup(); EV_CLEAR already reset it
+        }
+
+        PollEvent translated{};
+        translated.fd = static_cast<int>(event.ident);
+        translated.udata = event.udata;
+        if (event.flags & EV_ERROR) {
+            // A failed change: deletes of already-closed fds are expected,
+            // failed registrations go to their owner
+            if (event.udata == nullptr || event.data == 0) {
+                continue;
+            }
+            translated.events = kPollError;
+        } else {
+            translated.events = (event.filter == EVFILT_WRITE) ? kPollWritable : kPollReadable;
+            if (event.flags & EV_EOF) {
+                translated.events |= kPollHangup;
+            }
+        }
+
+        if (count < max_events) {
+            out[count++] = translated;
+        } else {
+            overflow_.push_back(translated);
+        }
+    }
+
+    return count;
+}
+
+void KqueuePoller::Wakeup() {
+    struct kevent change;
+    EV_SET(&change, kWakeIdent, EVFILT_USER, 0, NOTE_TRIGGER, 0, nullptr);
+    kevent(kqueue_fd_, &change, 1, nullptr, 0, nullptr);
+}
+
+} // namespace http
@@ -0,0 +1,537 @@
+#include "poller.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+
+namespace http {
+
+namespace {
+
+// user_data layout: [63..40] tag or poll generation, [39..32] kind, [31..0] fd
+enum RequestKind : uint64_t {
+    kPollRequest = 1,
+    kAcceptRequest = 2,
+    kReceiveRequest = 3,
+    kSendRequest = 4,
+    kCancelRequest = 5,
+    kWakeRequest = 6
+};
+
+constexpr uint32_t kTagMask = 0xFFFFFF;
+
+uint64_t EncodeUserData(RequestKind kind, int fd, uint32_t tag) {
+    return (static_cast<uint64_t>(tag & kTagMask) << 40) |
+           (static_cast<uint64_t>(kind) << 32) |
+           static_cast<uint32_t>(fd);
+}
+
+int UserDataFd(uint64_t user_data) {
+    return static_cast<int>(static_cast<uint32_t>(user_data));
+}
+
+RequestKind UserDataKind(uint64_t user_data) {
+    return static_cast<RequestKind>((user_data >> 32) & 0xFF);
+}
+
+uint32_t UserDataTag(uint64_t user_data) {
+    return static_cast<uint32_t>(user_data >> 40);
+}
+
+int SysSetup(unsigned entries, struct io_uring_params* params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int SysEnter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags,
+             const void* arg, size_t arg_size) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete,
+                                    flags, arg, arg_size));
+}
+
+int SysRegister(int ring_fd, unsigned opcode, const void* arg, unsigned nr_args) {
+    return static_cast<int>(syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args));
+}
+
+uint32_t ToPollMask(uint32_t interest) {
+    uint32_t mask = 0;
+    if (interest & kPollReadable) mask |= POLLIN | POLLRDHUP;
+    if (interest & kPollWritable) mask |= POLLOUT;
+    return mask;
+}
+
+} // namespace
+
+std::unique_ptr<UringPoller> UringPoller::TryCreate() {
+    std::unique_ptr<UringPoller> poller(new UringPoller());
+    if (!poller->Setup()) {
+        return nullptr;
+    }
+    return poller;
+}
+
+UringPoller::~UringPoller() {
+    // Closing the ring cancels everything still in flight
+    if (ring_fd_ >= 0) {
+        close(ring_fd_);
+    }
+    if (wake_fd_ >= 0) {
+        close(wake_fd_);
+    }
+    if (sqes_) {
+        munmap(sqes_, sqes_size_);
+    }
+    if (ring_) {
+        munmap(ring_, ring_size_);
+    }
+    if (buf_ring_) {
+        munmap(buf_ring_, buf_ring_size_);
+    }
+}
+
+bool UringPoller::Setup() {
+    struct io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+
+    ring_fd_ = SysSetup(kRingEntries, &params);
+    if (ring_fd_ < 0) {
+        return false;
+    }
+
+    // One mmap for both rings, timed waits, and no dropped completions
+    const uint32_t required = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_EXT_ARG | IORING_FEAT_NODROP;
+    if ((params.features & required) != required) {
+        return false;
+    }
+
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring_size_ = std::max(sq_size, cq_size);
+
+    void* ring = mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring_fd_, IORING_OFF_SQ_RING);
+    if (ring == MAP_FAILED) {
+        return false;
+    }
+    ring_ = ring;
+
+    sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring_fd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        return false;
+    }
+    sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+    char* base = static_cast<char*>(ring_);
+    sq_head_ = reinterpret_cast<unsigned*>(base + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(base + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned*>(base + params.sq_off.ring_mask);
+    sq_entries_ = params.sq_entries;
+    sq_local_tail_ = *sq_tail_;
+
+    // SQE slot i is always submitted through array index i
+    unsigned* sq_array = reinterpret_cast<unsigned*>(base + params.sq_off.array);
+    for (unsigned i = 0; i < sq_entries_; ++i) {
+        sq_array[i] = i;
+    }
+
+    cq_head_ = reinterpret_cast<unsigned*>(base + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(base + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(base + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(base + params.cq_off.cqes);
+
+    // Provided buffer ring: the kernel picks a buffer for each recv
+    buf_ring_size_ = kBufferCount * sizeof(struct io_uring_buf);
+    void* buf_ring = mmap(nullptr, buf_ring_size_, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf_ring == MAP_FAILED) {
+        return false;
+    }
+    buf_ring_ = static_cast<struct io_uring_buf_ring*>(buf_ring);
+
+    struct io_uring_buf_reg reg;
+    std::memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring_);
+    reg.ring_entries = kBufferCount;
+    reg.bgid = kBufferGroup;
+    if (SysRegister(ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        return false;
+    }
+
+    buffers_.resize(static_cast<size_t>(kBufferCount) * kBufferSize);
+    for (unsigned bid = 0; bid < kBufferCount; ++bid) {
+        buffers_to_recycle_.push_back(static_cast<uint16_t>(bid));
+    }
+    RecycleBuffers();
+
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ < 0) {
+        return false;
+    }
+    ArmWakeup();
+
+    return true;
+}
+
+struct io_uring_sqe* UringPoller::NextSqe() {
+    unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    if (sq_local_tail_ - head >= sq_entries_) {
+        // Ring full: hand what we have to the kernel first
+        Flush();
+        head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+        if (sq_local_tail_ - head >= sq_entries_) {
+            throw std::runtime_error("io_uring submission queue full");
+        }
+    }
+
+    struct io_uring_sqe* sqe = &sqes_[sq_local_tail_ & sq_mask_];
+    std::memset(sqe, 0, sizeof(*sqe));
+    ++sq_local_tail_;
+    ++sq_pending_;
+    return sqe;
+}
+
+int UringPoller::Enter(unsigned min_complete, int timeout_ms) {
+    __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+
+    unsigned flags = 0;
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec timeout;
+    const void* arg_ptr = nullptr;
+    size_t arg_size = 0;
+
+    if (min_complete > 0) {
+        flags |= IORING_ENTER_GETEVENTS;
+        if (timeout_ms >= 0) {
+            std::memset(&arg, 0, sizeof(arg));
+            timeout.tv_sec = timeout_ms / 1000;
+            timeout.tv_nsec = static_cast<long long>(timeout_ms % 1000) * 1000000LL;
+            arg.sigmask_sz = _NSIG / 8;
+            arg.ts = reinterpret_cast<uint64_t>(&timeout);
+            flags |= IORING_ENTER_EXT_ARG;
+            arg_ptr = &arg;
+            arg_size = sizeof(arg);
+        }
+    }
+
+    int submitted = SysEnter(ring_fd_, sq_pending_, min_complete, flags, arg_ptr, arg_size);
+    if (submitted >= 0) {
+        sq_pending_ -= std::min(sq_pending_, static_cast<unsigned>(submitted));
+        return 0;
+    }
+
+    int error = errno;
+    if (error == ETIME || error == EINTR || error == EAGAIN || error == EBUSY) {
+        return -error;
+    }
+    throw std::runtime_error("io_uring_enter failed: " + std::string(strerror(error)));
+}
+
+void UringPoller::Flush() {
+    if (sq_pending_ > 0) {
+        Enter(0, 0);
+    }
+}
+
+void UringPoller::RecycleBuffers() {
+    if (buffers_to_recycle_.empty()) {
+        return;
+    }
+
+    // Entries start at offset 0, overlapping the tail; index them directly
+    // since C++ compilers place the header's flexible bufs[] member at 8
+    struct io_uring_buf* bufs = reinterpret_cast<struct io_uring_buf*>(buf_ring_);
+    const unsigned mask = kBufferCount - 1;
+    for (uint16_t bid : buffers_to_recycle_) {
+        struct io_uring_buf* buf = &bufs[buf_tail_ & mask];
+        buf->addr = reinterpret_cast<uint64_t>(buffers_.data() + static_cast<size_t>(bid) * kBufferSize);
+        buf->len = kBufferSize;
+        buf->bid = bid;
+        ++buf_tail_;
+    }
+    buffers_to_recycle_.clear();
+
+    __atomic_store_n(&buf_ring_->tail, buf_tail_, __ATOMIC_RELEASE);
+}
+
+void UringPoller::ArmPoll(int fd, PollState& state) {
+    struct io_uring_sqe* sqe = NextSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = ToPollMask(state.interest);
+    // Level-triggered polls are one-shot and re-armed after each event;
+    // edge-triggered ones stay armed as multishot polls. kPollOneShot polls
+    // are not re-armed at all.
+    if (state.interest & kPollEdge) {
+        sqe->len = IORING_POLL_ADD_MULTI;
+    }
+    sqe->user_data = EncodeUserData(kPollRequest, fd, state.generation);
+    state.armed = true;
+}
+
+void UringPoller::ArmWakeup() {
+    struct io_uring_sqe* sqe = NextSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = wake_fd_;
+    sqe->poll32_events = POLLIN;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = EncodeUserData(kWakeRequest, wake_fd_, 0);
+    wake_armed_ = true;
+}
+
+void UringPoller::Wakeup() {
+    uint64_t one = 1;
+    // EAGAIN means the counter is saturated, which still wakes the poller
+    ssize_t written = write(wake_fd_, &one, sizeof(one));
+    (void)written;
+}
+
+UringPoller::PollState* UringPoller::FindPoll(int fd) {
+    if (fd < 0 || static_cast<size_t>(fd) >= polls_.size() || polls_[fd].interest == 0) {
+        return nullptr;
+    }
+    return &polls_[fd];
+}
+
+void UringPoller::Update(int fd, uint32_t /*old_interest*/, uint32_t new_interest, void* udata) {
+    const uint32_t io_mask = kPollReadable | kPollWritable;
+    PollState* state = FindPoll(fd);
+
+    if (state && state->interest == new_interest) {
+        return;
+    }
+
+    if (state && state->armed) {
+        struct io_uring_sqe* sqe = NextSqe();
+        sqe->opcode = IORING_OP_POLL_REMOVE;
+        sqe->fd = -1;
+        sqe->addr = EncodeUserData(kPollRequest, fd, state->generation);
+        sqe->user_data = EncodeUserData(kCancelRequest, fd, 0);
+        state->armed = false;
+    }
+
+    if (!(new_interest & io_mask)) {
+        if (state) {
+            *state = PollState();
+            // The pending poll pins the file; submit now so a close() by the
+            // caller actually releases the socket
+            Flush();
+        }
+        return;
+    }
+
+    if (!state) {
+        if (static_cast<size_t>(fd) >= polls_.size()) {
+            polls_.resize(std::max(static_cast<size_t>(fd) + 1, polls_.size() * 2));
+        }
+        state = &polls_[fd];
+    }
+
+    state->interest = new_interest;
+    state->udata = udata;
+    state->generation = next_poll_generation_;
+    next_poll_generation_ = (next_poll_generation_ + 1) & kTagMask;
+    if (next_poll_generation_ == 0) {
+        next_poll_generation_ = 1;
+    }
+    ArmPoll(fd, *state);
+}
+
+void UringPoller::StartAccept(int fd, uint32_t tag) {
+    struct io_uring_sqe* sqe = NextSqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = EncodeUserData(kAcceptRequest, fd, tag);
+}
+
+void UringPoller::StartReceive(int fd, uint32_t tag) {
+    struct io_uring_sqe* sqe = NextSqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = kBufferGroup;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->user_data = EncodeUserData(kReceiveRequest, fd, tag);
+}
+
+void UringPoller::StartSend(int fd, uint32_t tag, const struct iovec* chunks, int count, bool more) {
+    // A link chain must go to the kernel in a single submission
+    unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    if (sq_local_tail_ - head + static_cast<unsigned>(count) > sq_entries_) {
+        Flush();
+    }
+
+    for (int i = 0; i < count; ++i) {
+        struct io_uring_sqe* sqe = NextSqe();
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(chunks[i].iov_base);
+        sqe->len = static_cast<uint32_t>(chunks[i].iov_len);
+        sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+        if (i + 1 < count) {
+            sqe->flags = IOSQE_IO_LINK;
+        }
+        if (i + 1 < count || more) {
+            sqe->msg_flags |= MSG_MORE;
+        }
+        sqe->user_data = EncodeUserData(kSendRequest, fd, tag);
+    }
+}
+
+void UringPoller::Cancel(int fd) {
+    struct io_uring_sqe* sqe = NextSqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = fd;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+    sqe->user_data = EncodeUserData(kCancelRequest, fd, 0);
+
+    if (PollState* state = FindPoll(fd)) {
+        *state = PollState();
+    }
+    receives_to_restart_.erase(
+        std::remove_if(receives_to_restart_.begin(), receives_to_restart_.end(),
+                       [fd](const std::pair<int, uint32_t>& entry) { return entry.first == fd; }),
+        receives_to_restart_.end());
+
+    // Requests pin the file, so cancel before the caller closes the fd
+    Flush();
+}
+
+int UringPoller::Poll(PollEvent* out, int max_events, int timeout_ms) {
+    // Buffers handed out by the previous Poll() have been consumed by now
+    RecycleBuffers();
+
+    for (const auto& [fd, tag] : receives_to_restart_) {
+        StartReceive(fd, tag);
+    }
+    receives_to_restart_.clear();
+
+    for (int fd : polls_to_rearm_) {
+        PollState* state = FindPoll(fd);
+        if (state && !state->armed) {
+            ArmPoll(fd, *state);
+        }
+    }
+    polls_to_rearm_.clear();
+
+    if (!wake_armed_) {
+        ArmWakeup();
+    }
+
+    unsigned head = *cq_head_;
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    if (head == tail && timeout_ms != 0) {
+        if (Enter(1, timeout_ms) == -EINTR) {
+            return -1;
+        }
+    } else if (sq_pending_ > 0) {
+        Enter(0, 0);
+    }
+
+    tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    int num_events = 0;
+
+    while (head != tail && num_events < max_events) {
+        const struct io_uring_cqe& cqe = cqes_[head & cq_mask_];
+        ++head;
+
+        uint64_t user_data = cqe.user_data;
+        int fd = UserDataFd(user_data);
+        uint32_t tag = UserDataTag(user_data);
+        bool more = (cqe.flags & IORING_CQE_F_MORE) != 0;
+        PollEvent& event = out[num_events];
+
+        switch (UserDataKind(user_data)) {
+            case kPollRequest: {
+                PollState* state = FindPoll(fd);
+                if (!state || state->generation != tag) {
+                    break;  // Stale poll from an earlier registration
+                }
+                void* udata = state->udata;
+                if (state->interest & kPollOneShot) {
+                    // Fired: forget the registration until the caller re-arms it
+                    *state = PollState();
+                } else if (!more) {
+                    state->armed = false;
+                    polls_to_rearm_.push_back(fd);
+                }
+                if (cqe.res < 0) {
+                    break;
+                }
+
+                uint32_t revents = static_cast<uint32_t>(cqe.res);
+                uint32_t events = 0;
+                if (revents & POLLIN) events |= kPollReadable;
+                if (revents & POLLOUT) events |= kPollWritable;
+                if (revents & (POLLHUP | POLLRDHUP)) events |= kPollHangup;
+                if (revents & POLLERR) events |= kPollError;
+
+                event.fd = fd;
+                event.events = events;
+                event.udata = udata;
+                ++num_events;
+                break;
+            }
+
+            case kReceiveRequest:
+                if (cqe.res == -ENOBUFS) {
+                    // Ring ran dry; restart once buffers are recycled
+                    receives_to_restart_.emplace_back(fd, tag);
+                    break;
+                }
+                event.fd = fd;
+                event.events = kPollCompletion;
+                event.op = IoOp::Receive;
+                event.tag = tag;
+                event.result = cqe.res;
+                event.data = nullptr;
+                event.more = more;
+                if (cqe.flags & IORING_CQE_F_BUFFER) {
+                    uint16_t bid = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+                    event.data = buffers_.data() + static_cast<size_t>(bid) * kBufferSize;
+                    buffers_to_recycle_.push_back(bid);
+                }
+                ++num_events;
+                break;
+
+            case kAcceptRequest:
+            case kSendRequest:
+                event.fd = fd;
+                event.events = kPollCompletion;
+                event.op = (UserDataKind(user_data) == kAcceptRequest) ? IoOp::Accept : IoOp::Send;
+                event.tag = tag;
+                event.result = cqe.res;
+                event.data = nullptr;
+                event.more = more;
+                ++num_events;
+                break;
+
+            case kWakeRequest: {
+                uint64_t value;
+                while (read(wake_fd_, &value, sizeof(value)) > 0) {
+                }
+                if (!more) {
+                    wake_armed_ = false;
+                }
+                break;
+            }
+
+            default:
+                break;  // Cancel/remove acknowledgements
+        }
+    }
+
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    return num_events;
+}
+
+} // namespace http
@@ -7,49 +7,74 @@ namespace http {
 
 Router::Router() = default;
 
-void Router::Register(HttpMethod method, const std::string& path, RouteHandler handler) {
+void Router::Register(HttpMethod method, const std::string& path, RouteHandler handler, RouteMode mode,
+                      TaskPriority priority) {
     Route route;
     route.method = method;
     route.pattern = path;
     route.handler = std::move(handler);
+    route.mode = mode;
+    route.priority = priority;
     
     route.regex_pattern = std::regex(PathToRegex(path, route.param_names));
     
+    // Plain paths (the hot ones, like /health) skip the regex
+    if (path.find(':') == std::string::npos && path.find('*') == std::string::npos) {
+        route.literal = true;
+        std::istringstream stream(path);
+        std::string segment;
+        while (std::getline(stream, segment, '/')) {
+            if (!segment.empty()) {
+                route.literal_path += "/" + segment;
+            }
+        }
+        if (route.literal_path.empty()) {
+            route.literal_path = "/";
+        }
+    }
+    
+    has_inline_routes_ = has_inline_routes_ || mode == RouteMode::Inline;
+    has_priority_routes_ = has_priority_routes_ || (mode == RouteMode::Pool && priority != TaskPriority::Normal);
     routes_.push_back(std::move(route));
 }
 
-HttpResponse Router::HandleRequest(const HttpRequest& request) const {
+const Route* Router::Match(HttpMethod method, const std::string& path) const {
     for (const auto& route : routes_) {
-        if (route.method != request.method) {
+        if (route.method != method) {
             continue;
         }
         
-        std::smatch match;
-        if (std::regex_match(request.path, match, route.regex_pattern)) {
-            // Extract path parameters
-            HttpRequest modified_request = request;
-            for (size_t i = 0; i < route.param_names.size() && i + 1 < match.size(); ++i) {
-                modified_request.query_params[route.param_names[i]] = match[i + 1].str();
-            }
-            
-            return route.handler(modified_request);
+        if (route.literal ? route.literal_path == path : std::regex_match(path, route.regex_pattern)) {
+            return &route;
         }
     }
+    return nullptr;
+}
+
+HttpResponse Router::Invoke(const Route& route, const HttpRequest& request) const {
+    if (route.param_names.empty()) {
+        return route.handler(request);
+    }
     
-    // No route found
-    return NotFound("Route not found");
+    // Extract path parameters
+    HttpRequest modified_request = request;
+    for (auto& [name, value] : ExtractParams(route, request.path)) {
+        modified_request.query_params[name] = std::move(value);
+    }
+    return route.handler(modified_request);
 }
 
-bool Router::HasRoute(HttpMethod method, const std::string& path) const {
-    for (const auto& route : routes_) {
-        if (route.method == method) {
-            std::smatch match;
-            if (std::regex_match(path, match, route.regex_pattern)) {
-                return true;
-            }
-        }
+HttpResponse Router::HandleRequest(const HttpRequest& request) const {
+    const Route* route = Match(request.method, request.path);
+    if (!route) {
+        // No route found
+        return NotFound("Route not found");
     }
-    return false;
+    return Invoke(*route, request);
+}
+
+bool Router::HasRoute(HttpMethod method, const std::string& path) const {
+    return Match(method, path) != nullptr;
 }
 
 std::string Router::PathToRegex(const std::string& path, std::vector<std::string>& param_names) const {
@@ -72,6 +97,9 @@ std::string Router::PathToRegex(const std::string& path, std::vector<std::string
             std::string param_name = segment.substr(1);
             param_names.push_back(param_name);
             regex << "/([^/]+)";
+        } else if (segment == "*") {
+            // Wildcard: the rest of the path
+            regex << "/.*";
         } else {
             // Literal
             regex << "/" << segment;
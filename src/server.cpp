@@ -1,8 +1,10 @@
 #include "server.hpp"
-#include "connection.hpp"
 #include "http_parser.hpp"
 #include "http_response.hpp"
 #include "websocket.hpp"
+#include "static_cache.hpp"
+#include "listener.hpp"
+#include "cpu_topology.hpp"
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -17,16 +19,83 @@
 #include <cstring>
 #include <vector>
 #include <functional>
+#include <algorithm>
 
 namespace http {
 
+namespace {
+
+size_t ConfiguredReactors(const Config& config) {
+    if (config.reactor_count == 0) {
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+    return config.reactor_count;
+}
+
+ThreadPoolOptions PoolOptions(const Config& config, const std::vector<unsigned>& cpus) {
+    ThreadPoolOptions options;
+    options.scheduling = ParseScheduling(config.thread_pool_scheduling);
+    options.queue = ParseTaskQueue(config.thread_pool_queue);
+    options.queue_capacity = config.thread_pool_queue_capacity;
+    options.thread_name = config.thread_name_prefix.empty() ? "" : config.thread_name_prefix + "-wk";
+    options.cpus = cpus;
+    options.critical_threads = config.thread_pool_critical_threads;
+    options.bulk_threads = config.thread_pool_bulk_threads;
+    options.lane_capacity = config.thread_pool_lane_capacity;
+    options.max_threads = config.thread_pool_max_size;
+    options.grow_after = std::chrono::milliseconds(config.thread_pool_grow_after_ms);
+    options.idle_timeout = std::chrono::milliseconds(config.thread_pool_idle_timeout_ms);
+    return options;
+}
+
+#if defined(MSG_NOSIGNAL)
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = 0;
+#endif
+
+// HTTP/2 output handed to the loop per write; DATA frames beyond it wait
+// for the write to finish, so one large response cannot pile up unsent
+constexpr size_t kHttp2WriteBudget = 64 * 1024;
+
+} // namespace
+
 Server::Server(const Config& config)
     : config_(config),
-      event_loop_(std::make_unique<EventLoop>()),
-      thread_pool_(std::make_unique<ThreadPool>(config.thread_pool_size)),
+      load_shedder_(std::chrono::milliseconds(config.queue_delay_target_ms),
+                    std::chrono::milliseconds(config.queue_delay_interval_ms)),
+      bulk_shedder_(std::chrono::milliseconds(config.queue_delay_target_ms),
+                    std::chrono::milliseconds(config.queue_delay_interval_ms)),
+      cpu_plan_(PlanCpus(config)),
+      thread_pool_(std::make_unique<ThreadPool>(config.thread_pool_size, PoolOptions(config, cpu_plan_.workers))),
       logger_(config.log_file.empty() ? Logger{} : Logger{config.log_file}),
       running_(false),
-      server_fd_(-1) {
+      bound_port_(0) {
+    
+    EventBackend backend = ParseEventBackend(config.event_loop_backend);
+    reactors_.resize(ConfiguredReactors(config));
+    for (auto& reactor : reactors_) {
+        reactor.loop = std::make_unique<EventLoop>(backend);
+        reactor.loop->SetBusyPoll(std::chrono::microseconds(config.busy_poll_us));
+        reactor.loop->SetSendHighWaterMark(config.send_high_water_mark);
+    }
+    
+    thread_pool_->SetQueueDelayObserver([this](std::chrono::nanoseconds wait, bool queue_empty) {
+        load_shedder_.Report(wait, queue_empty);
+    });
+    thread_pool_->SetQueueDelayObserver([this](std::chrono::nanoseconds wait, bool queue_empty) {
+        bulk_shedder_.Report(wait, queue_empty);
+    }, TaskPriority::Bulk);
+    
+    HttpResponse overload(HttpStatus::SERVICE_UNAVAILABLE, "Service Unavailable");
+    overload.SetContentType("text/plain");
+    overload.SetHeader("Retry-After", std::to_string(config.retry_after_seconds));
+    overload_response_ = std::make_shared<const std::string>(overload.ToString());
+    
+    if (config.compression_level > 0) {
+        compressor_ = std::make_unique<ResponseCompressor>(config.compression_level, config.compression_min_size,
+                                                           config.compression_cache_bytes);
+    }
     
     if (config.enable_logging) {
         logger_.SetLevel(LogLevel::INFO);
@@ -37,26 +106,29 @@ Server::Server(const Config& config)
 
 Server::~Server() {
     Stop();
+    // Workers may still be running handlers that use the router, the
+    // compressor and the logger, which are destroyed before the pool
+    thread_pool_.reset();
 }
 
-void Server::Get(const std::string& path, RouteHandler handler) {
-    router_.Register(HttpMethod::GET, path, std::move(handler));
+void Server::Get(const std::string& path, RouteHandler handler, RouteMode mode, TaskPriority priority) {
+    router_.Register(HttpMethod::GET, path, std::move(handler), mode, priority);
 }
 
-void Server::Post(const std::string& path, RouteHandler handler) {
-    router_.Register(HttpMethod::POST, path, std::move(handler));
+void Server::Post(const std::string& path, RouteHandler handler, RouteMode mode, TaskPriority priority) {
+    router_.Register(HttpMethod::POST, path, std::move(handler), mode, priority);
 }
 
-void Server::Put(const std::string& path, RouteHandler handler) {
-    router_.Register(HttpMethod::PUT, path, std::move(handler));
+void Server::Put(const std::string& path, RouteHandler handler, RouteMode mode, TaskPriority priority) {
+    router_.Register(HttpMethod::PUT, path, std::move(handler), mode, priority);
 }
 
-void Server::Delete(const std::string& path, RouteHandler handler) {
-    router_.Register(HttpMethod::DELETE, path, std::move(handler));
+void Server::Delete(const std::string& path, RouteHandler handler, RouteMode mode, TaskPriority priority) {
+    router_.Register(HttpMethod::DELETE, path, std::move(handler), mode, priority);
 }
 
-void Server::Patch(const std::string& path, RouteHandler handler) {
-    router_.Register(HttpMethod::PATCH, path, std::move(handler));
+void Server::Patch(const std::string& path, RouteHandler handler, RouteMode mode, TaskPriority priority) {
+    router_.Register(HttpMethod::PATCH, path, std::move(handler), mode, priority);
 }
 
 void Server::ServeStatic(const std::string& path, const std::string& directory) {
@@ -65,328 +137,841 @@ void Server::ServeStatic(const std::string& path, const std::string& directory)
         return;
     }
     
-    Get(path + "/*", [directory, path](const HttpRequest& request) -> HttpResponse {
-        std::string request_path = request.path;
-        
-        // Remove the route prefix
-        if (request_path.find(path) == 0) {
-            request_path = request_path.substr(path.length());
+    // Path checks, the file read and the headers happen once per file; hits
+    // are served from memory until the file changes
+    auto cache = std::make_shared<StaticFileCache>(directory, config_.static_cache_bytes);
+    static_caches_.push_back(cache);
+    
+    Get(path + "/*", [cache, path](const HttpRequest& request) -> HttpResponse {
+        // Strip the route prefix and the leading slash
+        size_t start = request.path.compare(0, path.size(), path) == 0 ? path.size() : 0;
+        if (start < request.path.size() && request.path[start] == '/') {
+            ++start;
         }
+        return cache->Serve(request.path.substr(start), request.GetHeader("if-none-match"));
+    });
+}
+
+void Server::OpenListeners() {
+    // Linux and FreeBSD balance connections across SO_REUSEPORT listeners;
+    // elsewhere (macOS) the reactors share one listening socket instead
+#if defined(__linux__) || defined(SO_REUSEPORT_LB)
+    const bool per_reactor_listener = reactors_.size() > 1;
+#else
+    const bool per_reactor_listener = false;
+#endif
+    
+    std::vector<ListenEndpoint> endpoints = config_.listen.empty()
+        ? std::vector<ListenEndpoint>{ListenEndpoint::FromHostPort(config_.host, config_.port)}
+        : ParseListenEndpoints(config_.listen);
+    
+    ListenOptions options;
+    options.backlog = static_cast<int>(config_.listen_backlog);
+    options.tcp_nodelay = config_.tcp_nodelay;
+    options.defer_accept_seconds = static_cast<int>(config_.tcp_defer_accept_seconds);
+    options.fastopen_queue = static_cast<int>(config_.tcp_fastopen_queue);
+    
+    bound_port_ = 0;
+    listen_descriptions_.clear();
+    for (ListenEndpoint& endpoint : endpoints) {
+        // A Unix socket path can be bound only once, so every reactor
+        // shares one listener for it
+        const bool shared = !per_reactor_listener || !endpoint.IsTcp();
+        options.reuse_port = !shared;
         
-        // Remove leading slash
-        if (!request_path.empty() && request_path[0] == '/') {
-            request_path = request_path.substr(1);
+        for (size_t i = 0; i < reactors_.size(); ++i) {
+            int fd = (i > 0 && shared) ? dup(reactors_[0].listen_fds.back()) : OpenListener(endpoint, options);
+            if (fd < 0) {
+                throw std::runtime_error("Failed to share listening socket");
+            }
+            reactors_[i].listen_fds.push_back(fd);
+            
+            // Port 0 binds an ephemeral port; the other listeners must join it
+            if (i == 0 && endpoint.IsTcp() && endpoint.port == 0) {
+                endpoint.port = LocalPort(fd);
+            }
         }
         
-        // Build full file path
-        std::filesystem::path file_path = std::filesystem::path(directory) / request_path;
-        
-        // Security: prevent directory traversal
-        std::filesystem::path canonical_dir = std::filesystem::canonical(directory);
-        std::filesystem::path canonical_file;
-        
-        try {
-            canonical_file = std::filesystem::canonical(file_path);
-        } catch (...) {
-            return NotFound("File not found");
+        if (!endpoint.IsTcp()) {
+            unix_socket_paths_.push_back(endpoint.address);
+        } else if (bound_port_ == 0) {
+            bound_port_ = endpoint.port;
         }
-        
-        // Check if file is within the static directory
-        std::string dir_str = canonical_dir.string();
-        std::string file_str = canonical_file.string();
-        
-        if (file_str.find(dir_str) != 0) {
-            return Forbidden("Access denied");
+        listen_descriptions_ += (listen_descriptions_.empty() ? "" : ", ") + endpoint.ToString();
+    }
+}
+
+void Server::CloseListeners() {
+    for (auto& reactor : reactors_) {
+        for (int fd : reactor.listen_fds) {
+            reactor.loop->Unregister(fd);
+            close(fd);
         }
-        
-        return HttpResponse::FromFile(canonical_file.string());
-    });
+        reactor.listen_fds.clear();
+    }
+    for (const std::string& path : unix_socket_paths_) {
+        unlink(path.c_str());
+    }
+    unix_socket_paths_.clear();
 }
 
-void Server::Start() {
-    // Create socket
-    server_fd_ = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_fd_ < 0) {
-        throw std::runtime_error("Failed to create socket");
+void Server::CloseClients() {
+    // Only once the loops have exited; late worker responses find no ids
+    for (auto& reactor : reactors_) {
+        std::vector<ConnectionId> open;
+        reactor.connections.ForEach([&open](ConnectionId id, ClientEntry& /*client*/) {
+            open.push_back(id);
+        });
+        for (ConnectionId id : open) {
+            CloseClient(&reactor, id);
+        }
     }
-    
-    // Set socket options
-    int opt = 1;
-    if (setsockopt(server_fd_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
-        close(server_fd_);
-        throw std::runtime_error("Failed to set socket options");
+}
+
+Server::CpuPlan Server::PlanCpus(const Config& config) {
+    CpuPlan plan;
+    if (!config.pin_reactors && !config.pin_workers) {
+        return plan;
     }
-    
-    // Set non-blocking
-    int flags = fcntl(server_fd_, F_GETFL, 0);
-    fcntl(server_fd_, F_SETFL, flags | O_NONBLOCK);
-    
-    // Bind socket
-    struct sockaddr_in address{};
-    address.sin_family = AF_INET;
-    address.sin_addr.s_addr = inet_addr(config_.host.c_str());
-    address.sin_port = htons(config_.port);
-    
-    if (bind(server_fd_, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) < 0) {
-        close(server_fd_);
-        throw std::runtime_error("Failed to bind socket");
+
+    CpuTopology topology = CpuTopology::Discover();
+    std::vector<unsigned> defaults;
+    if (config.numa_node >= 0) {
+        defaults = topology.NodeCpus(static_cast<unsigned>(config.numa_node));
+        if (defaults.empty()) {
+            throw std::invalid_argument("No online CPUs on NUMA node " + std::to_string(config.numa_node));
+        }
     }
-    
-    // Listen
-    if (listen(server_fd_, static_cast<int>(config_.max_connections)) < 0) {
-        close(server_fd_);
-        throw std::runtime_error("Failed to listen on socket");
+    auto placement = [&topology, &defaults](const std::string& list) {
+        std::vector<unsigned> order = topology.PlacementOrder(list.empty() ? defaults : ParseCpuList(list));
+        if (order.empty()) {
+            throw std::invalid_argument("No online CPUs in CPU list: " + list);
+        }
+        return order;
+    };
+
+    const size_t reactor_count = ConfiguredReactors(config);
+    if (config.pin_reactors) {
+        std::vector<unsigned> order = placement(config.reactor_cpus);
+        for (size_t i = 0; i < reactor_count; ++i) {
+            plan.reactors.push_back(order[i % order.size()]);
+        }
+    }
+    if (config.pin_workers) {
+        std::vector<unsigned> order = placement(config.worker_cpus);
+        // Workers drawing on the reactors' CPUs start after the ones they took
+        const size_t skip = config.pin_reactors && config.worker_cpus == config.reactor_cpus ? reactor_count : 0;
+        // The pool's threads in the order it pins them: Normal workers, the
+        // Critical and Bulk lanes', then the elastic ones it may add
+        const size_t base = std::max<size_t>(1, config.thread_pool_size);
+        const size_t worker_count = base + config.thread_pool_critical_threads + config.thread_pool_bulk_threads +
+                                    (config.thread_pool_max_size > base ? config.thread_pool_max_size - base : 0);
+        for (size_t i = 0; i < worker_count; ++i) {
+            plan.workers.push_back(order[(skip + i) % order.size()]);
+        }
+    }
+    return plan;
+}
+
+void Server::Start() {
+    try {
+        OpenListeners();
+    } catch (...) {
+        CloseListeners();
+        throw;
     }
     
     running_ = true;
-    logger_.Info("Server starting on " + config_.host + ":" + std::to_string(config_.port));
-    
-    // Register server socket for incoming connections
-    event_loop_->RegisterRead(server_fd_, [this](int fd, EventType type) {
-        if (type == EventType::Read) {
-            // Accept multiple connections in a loop
-            while (true) {
-                struct sockaddr_in client_addr{};
-                socklen_t client_addr_len = sizeof(client_addr);
-                
-                int client_fd = accept(fd, reinterpret_cast<struct sockaddr*>(&client_addr), &client_addr_len);
-                if (client_fd < 0) {
-                    if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                        // No more connections to accept
-                        break;
-                    }
-                    // Error accepting, but continue
-                    break;
-                }
-                
-                // Set non-blocking
-                int flags = fcntl(client_fd, F_GETFL, 0);
-                fcntl(client_fd, F_SETFL, flags | O_NONBLOCK);
-                
-                // Register client connection for reading (only once)
-                event_loop_->RegisterRead(client_fd, [this](int client_fd, EventType /*type*/) {
-                    // Unregister immediately to prevent multiple triggers
-                    event_loop_->Unregister(client_fd);
-                    HandleConnection(client_fd);
-                });
+    logger_.Info("Server starting on " + listen_descriptions_ +
+                 " (" + EventLoopBackend() + ", " + std::to_string(reactors_.size()) + " reactor" +
+                 (reactors_.size() == 1 ? "" : "s") + ")");
+    
+    const auto request_timeout = std::chrono::milliseconds(
+        std::max<size_t>(1, config_.request_timeout_seconds) * 1000);
+    for (auto& reactor : reactors_) {
+        EventLoop* loop = reactor.loop.get();
+        
+        // Accept incoming connections on every endpoint (multishot accept
+        // on io_uring)
+        Reactor* owner = &reactor;
+        AcceptCallback on_accept = [this, owner, loop, request_timeout](int client_fd, const PeerAddress& peer) {
+            // Over the cap: a best-effort 503 on the fresh (empty) socket
+            // buffer, then hang up
+            if (open_connections_.load(std::memory_order_relaxed) >= config_.max_connections) {
+                rejected_connections_.fetch_add(1, std::memory_order_relaxed);
+                ssize_t sent = send(client_fd, overload_response_->data(), overload_response_->size(), kSendFlags);
+                (void)sent;
+                close(client_fd);
+                return;
             }
+            open_connections_.fetch_add(1, std::memory_order_relaxed);
+            
+            ConnectionId id = owner->connections.Open(client_fd, peer);
+            
+            // Drop connections that do not send a whole request in time
+            owner->connections.Find(id)->state.deadline = loop->RunAfter(request_timeout, [this, owner, id]() {
+                ExpireClient(owner, id);
+            });
+            
+            // Buffer requests on the loop as they arrive (multishot recv on
+            // io_uring); a worker only sees complete ones
+            loop->Receive(client_fd, [this, owner, id](int /*fd*/, const char* data, ssize_t size) {
+                OnRequestData(owner, id, data, size);
+            });
+        };
+        for (int listen_fd : reactor.listen_fds) {
+            loop->Accept(listen_fd, on_accept);
         }
-    });
+    }
     
-    // Start event loop in a separate thread
-    std::thread event_thread([this]() {
-        event_loop_->Run();
-    });
+    // Static caches drop changed files as the first reactor sees inotify events
+    for (const auto& cache : static_caches_) {
+        if (cache->WatchFd() >= 0) {
+            reactors_.front().loop->RegisterRead(cache->WatchFd(), [cache](int /*fd*/, EventType /*type*/) {
+                cache->OnWatchEvents();
+            });
+        }
+    }
     
-    event_thread.detach();
+    // Periodic WebSocket pushes share one timer per path on the first reactor
+    for (auto& push : websocket_pushes_) {
+        WebSocketPush* entry = &push;
+        reactors_.front().loop->RunEvery(entry->interval, [this, entry]() {
+            PushWebSocketFrames(*entry);
+        });
+    }
+    
+    // Start each event loop in its own thread
+    std::vector<std::thread> event_threads;
+    for (size_t i = 0; i < reactors_.size(); ++i) {
+        EventLoop* loop = reactors_[i].loop.get();
+        event_threads.emplace_back([this, loop, i]() {
+            if (!config_.thread_name_prefix.empty()) {
+                SetCurrentThreadName(config_.thread_name_prefix + "-io-" + std::to_string(i));
+            }
+            if (!cpu_plan_.reactors.empty() && !PinCurrentThread({cpu_plan_.reactors[i]})) {
+                logger_.Warn("Failed to pin reactor " + std::to_string(i) + " to CPU " +
+                             std::to_string(cpu_plan_.reactors[i]));
+            }
+            loop->Run();
+        });
+    }
     
     // Wait for stop signal
     while (running_) {
         std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
+    
+    // The loops own the listening sockets until they have exited. A loop
+    // whose thread only just started may have missed Stop(), so repeat it.
+    for (size_t i = 0; i < event_threads.size(); ++i) {
+        reactors_[i].loop->Stop();
+        event_threads[i].join();
+    }
+    CloseListeners();
+    CloseClients();
 }
 
 void Server::Stop() {
     if (!running_) return;
     
     running_ = false;
-    event_loop_->Stop();
-    
-    if (server_fd_ >= 0) {
-        close(server_fd_);
-        server_fd_ = -1;
+    for (auto& reactor : reactors_) {
+        reactor.loop->Stop();
     }
     
     logger_.Info("Server stopped");
 }
 
-void Server::HandleConnection(int client_fd) {
-    // Check if file descriptor is still valid
-    if (fcntl(client_fd, F_GETFL) < 0) {
-        // File descriptor is invalid, don't process
+EventLoopStats Server::LoopStats() const {
+    EventLoopStats total;
+    for (const auto& reactor : reactors_) {
+        EventLoopStats stats = reactor.loop->Stats();
+        total.iterations += stats.iterations;
+        total.events += stats.events;
+        total.spin_polls += stats.spin_polls;
+        total.spin_hits += stats.spin_hits;
+        total.blocking_waits += stats.blocking_waits;
+        total.spin_ns += stats.spin_ns;
+        total.blocked_ns += stats.blocked_ns;
+        total.batch_size = std::max(total.batch_size, stats.batch_size);
+    }
+    return total;
+}
+
+AdmissionStats Server::Admission() const {
+    AdmissionStats stats;
+    stats.open_connections = open_connections_.load(std::memory_order_relaxed);
+    stats.rejected_connections = rejected_connections_.load(std::memory_order_relaxed);
+    stats.shed_requests = shed_requests_.load(std::memory_order_relaxed);
+    stats.overloaded = load_shedder_.Overloaded();
+    stats.bulk_overloaded = bulk_shedder_.Overloaded();
+    stats.queue_wait = load_shedder_.LastWait();
+    stats.workers = thread_pool_->Size();
+    return stats;
+}
+
+void Server::OnRequestData(Reactor* reactor, ConnectionId id, const char* data, ssize_t size) {
+    ClientEntry* client = reactor->connections.Find(id);
+    if (!client) {
+        return;
+    }
+    ConnectionState& state = client->state;
+    
+    if (state.h2) {
+        if (size <= 0) {
+            state.read_closed = true;
+            FlushHttp2(reactor, id);
+            return;
+        }
+        state.input.append(data, static_cast<size_t>(size));
+        ReceiveHttp2(reactor, id);
+        return;
+    }
+    
+    if (size <= 0) {
+        // Requests already received are still answered
+        state.read_closed = true;
+        if (!state.busy) {
+            DispatchRequest(reactor, id);
+        }
+        return;
+    }
+    
+    if (state.closing) {
         return;
     }
     
-    thread_pool_->Enqueue([this, client_fd]() {
+    state.input.append(data, static_cast<size_t>(size));
+    
+    if (!state.busy) {
+        DispatchRequest(reactor, id);
+    } else if (state.input.size() > config_.max_request_size) {
+        // Pipelining further ahead than one maximal request is not worth
+        // buffering: finish the current response and hang up
+        state.closing = true;
+        state.input.clear();
+    }
+}
+
+void Server::DispatchRequest(Reactor* reactor, ConnectionId id) {
+    // An inline response is usually written before its handler returns, so
+    // pipelined requests are served by looping here rather than recursing
+    // through OnResponseSent
+    while (ClientEntry* client = reactor->connections.Find(id)) {
+        ConnectionState& state = client->state;
+        EventLoop* loop = reactor->loop.get();
+        
+        // h2c with prior knowledge: the connection opens with the HTTP/2 preface
+        if (config_.http2 && state.requests == 0 && Http2Session::MayBePreface(state.input)) {
+            if (state.input.size() >= Http2Session::kPreface.size()) {
+                StartHttp2(reactor, id, nullptr);
+            } else if (state.read_closed) {
+                CloseClient(reactor, id);
+            }
+            return;
+        }
+        
+        size_t request_end = 0;
         try {
-            // Check again in the thread
-            if (fcntl(client_fd, F_GETFL) < 0) {
-                return; // FD closed
+            request_end = HttpParser::FindRequestEnd(state.input);
+        } catch (const RequestFramingError& e) {
+            RejectRequest(reactor, id, e.status == 501
+                ? HttpResponse(HttpStatus::NOT_IMPLEMENTED, "Not Implemented")
+                : BadRequest(e.what()));
+            return;
+        } catch (const std::invalid_argument&) {
+            RejectRequest(reactor, id, BadRequest("Invalid Content-Length"));
+            return;
+        }
+        
+        if ((request_end == 0 ? state.input.size() : request_end) > config_.max_request_size) {
+            RejectRequest(reactor, id, HttpResponse(HttpStatus::PAYLOAD_TOO_LARGE, "Payload Too Large"));
+            return;
+        }
+        
+        if (request_end == 0) {
+            if (state.read_closed) {
+                CloseClient(reactor, id);
             }
-            
-            std::string request_data = ReadRequest(client_fd);
-            
-            if (!request_data.empty()) {
-                // Check if this is a WebSocket upgrade request
-                bool is_websocket = WebSocket::IsWebSocketRequest(request_data);
-                
-                // Check FD is still valid before processing
-                if (fcntl(client_fd, F_GETFL) >= 0) {
-                    ProcessRequest(client_fd, request_data);
-                    
-                    // If it's a WebSocket connection, don't close it - the handler will manage it
-                    if (is_websocket && websocket_connections_.count(client_fd) > 0) {
-                        // WebSocket connection - handler manages lifecycle
-                        return;
-                    }
+            return;
+        }
+        
+        // Inline routes are answered right here, without a thread hop; the
+        // others are posted to their priority's lane
+        const Route* inline_route = nullptr;
+        TaskPriority priority = TaskPriority::Normal;
+        if (router_.HasInlineRoutes() || router_.HasPriorityRoutes()) {
+            HttpMethod method;
+            std::string path;
+            if (HttpParser::PeekRequestLine(state.input, method, path)) {
+                const Route* route = router_.Match(method, path);
+                if (route && route->mode == RouteMode::Inline) {
+                    inline_route = route;
+                } else if (route) {
+                    priority = route->priority;
                 }
             }
-            
-            // Close connection (only if not WebSocket)
-            if (fcntl(client_fd, F_GETFL) >= 0 && websocket_connections_.count(client_fd) == 0) {
-                close(client_fd);
+        }
+        
+        // A standing worker queue means this request would wait past its
+        // usefulness; a cheap 503 lets the client back off instead. Critical
+        // requests have workers of their own and go ahead.
+        if (!inline_route && ShouldShed(priority)) {
+            shed_requests_.fetch_add(1, std::memory_order_relaxed);
+            ShedRequest(reactor, id);
+            return;
+        }
+        
+        loop->CancelTimer(state.deadline);
+        state.deadline = 0;
+        std::string request_data = state.input.substr(0, request_end);
+        state.input.erase(0, request_end);
+        state.busy = true;
+        ++state.requests;
+        
+        // Upgrade: h2c, answered as stream 1 once the connection has switched
+        if (config_.http2 && request_data.find("h2c") != std::string::npos) {
+            HttpRequest request = HttpParser::Parse(request_data);
+            if (Http2Session::IsUpgradeRequest(request) && StartHttp2(reactor, id, &request)) {
+                return;
+            }
+        }
+        
+        // WebSocket handlers and pushes write to the socket directly, so the
+        // connection leaves the loop and its table for the worker
+        if (!inline_route && WebSocket::IsWebSocketRequest(request_data)) {
+            int client_fd = client->fd;
+            // Queued before the connection is detached, so a full ring can
+            // still be answered with 503. The loop lets go of the fd before
+            // it polls again, so it never reads what the worker waits for.
+            if (!HandleWebSocketUpgrade(client_fd, std::move(request_data))) {
+                shed_requests_.fetch_add(1, std::memory_order_relaxed);
+                ShedRequest(reactor, id);
+                return;
             }
+            loop->Unregister(client_fd);
+            reactor->connections.Close(id);
+            open_connections_.fetch_sub(1, std::memory_order_relaxed);
+            return;
+        }
+        
+        const size_t max_requests = config_.max_requests_per_connection;
+        bool last_request = config_.keep_alive_timeout_seconds == 0 || state.read_closed ||
+                            (max_requests > 0 && state.requests >= max_requests);
+        
+        if (!inline_route) {
+            HandleConnection(reactor, id, std::move(request_data), client->peer, last_request, priority);
+            return;
+        }
+        
+        state.dispatching = true;
+        ProcessRequest(reactor, id, request_data, client->peer, last_request, inline_route);
+        
+        // The response may have closed the connection, or still be waiting
+        // for the socket to drain (OnResponseSent then carries on)
+        client = reactor->connections.Find(id);
+        if (!client) {
+            return;
+        }
+        client->state.dispatching = false;
+        if (client->state.busy) {
+            return;
+        }
+    }
+}
+
+void Server::OnResponseSent(Reactor* reactor, ConnectionId id) {
+    ClientEntry* client = reactor->connections.Find(id);
+    if (!client) {
+        return;
+    }
+    client->state.busy = false;
+    
+    // Idle keep-alive connections are dropped after the timeout
+    const auto idle_timeout = std::chrono::seconds(config_.keep_alive_timeout_seconds);
+    client->state.deadline = reactor->loop->RunAfter(idle_timeout, [this, reactor, id]() {
+        ExpireClient(reactor, id);
+    });
+    
+    // Serve the next pipelined request, if it has arrived (the dispatch loop
+    // does that itself when it wrote this response inline)
+    if (!client->state.dispatching) {
+        DispatchRequest(reactor, id);
+    }
+}
+
+void Server::RejectRequest(Reactor* reactor, ConnectionId id, HttpResponse response) {
+    ClientEntry* client = reactor->connections.Find(id);
+    if (!client) {
+        return;
+    }
+    reactor->loop->CancelTimer(client->state.deadline);
+    client->state.deadline = 0;
+    client->state.busy = true;
+    client->state.closing = true;
+    client->state.input.clear();
+    SendResponse(reactor, id, std::move(response));
+}
+
+void Server::ShedRequest(Reactor* reactor, ConnectionId id) {
+    ClientEntry* client = reactor->connections.Find(id);
+    if (!client) {
+        return;
+    }
+    reactor->loop->CancelTimer(client->state.deadline);
+    client->state.deadline = 0;
+    client->state.busy = true;
+    client->state.closing = true;
+    client->state.input.clear();
+    reactor->loop->Send(client->fd, std::string(), overload_response_, [this, reactor, id](int /*fd*/, ssize_t /*result*/) {
+        CloseClient(reactor, id);
+    });
+}
+
+void Server::ExpireClient(Reactor* reactor, ConnectionId id) {
+    // The timer has fired, so there is nothing left to cancel
+    if (ClientEntry* client = reactor->connections.Find(id)) {
+        client->state.deadline = 0;
+        CloseClient(reactor, id);
+    }
+}
+
+void Server::CloseClient(Reactor* reactor, ConnectionId id) {
+    ClientEntry* client = reactor->connections.Find(id);
+    if (!client) {
+        return;
+    }
+    int client_fd = client->fd;
+    if (client->state.deadline != 0) {
+        reactor->loop->CancelTimer(client->state.deadline);
+    }
+    reactor->connections.Close(id);
+    open_connections_.fetch_sub(1, std::memory_order_relaxed);
+    reactor->loop->Unregister(client_fd);
+    close(client_fd);
+}
+
+bool Server::ShouldShed(TaskPriority priority) const {
+    if (priority != TaskPriority::Normal && thread_pool_->HasLane(priority)) {
+        return priority == TaskPriority::Bulk && bulk_shedder_.Overloaded();
+    }
+    return load_shedder_.Overloaded();
+}
+
+void Server::HandleConnection(Reactor* reactor, ConnectionId id, std::string request_data,
+                              const PeerAddress& peer, bool last_request, TaskPriority priority) {
+    // The worker only computes the response; reading, writing and closing
+    // stay on the loop that owns the connection, which the worker names by
+    // id rather than by fd. Posted, not enqueued: nothing waits on a
+    // future, and the task fits inline, so queuing it allocates nothing.
+    // (Handing the response back with RunInLoop still allocates a
+    // std::function and an inbox node.)
+    bool queued = thread_pool_->TryPost([this, reactor, id, request_data = std::move(request_data),
+                                         peer, last_request]() {
+        try {
+            ProcessRequest(reactor, id, request_data, peer, last_request);
         } catch (const std::exception& e) {
             logger_.Error("Exception in HandleConnection: " + std::string(e.what()));
-            if (fcntl(client_fd, F_GETFL) >= 0 && websocket_connections_.count(client_fd) == 0) {
-                close(client_fd);
-            }
+            CloseConnection(reactor, id);
         } catch (...) {
             logger_.Error("Unknown exception in HandleConnection");
-            if (fcntl(client_fd, F_GETFL) >= 0 && websocket_connections_.count(client_fd) == 0) {
-                close(client_fd);
+            CloseConnection(reactor, id);
+        }
+    }, priority);
+    
+    // A full ring task queue: shed rather than block the loop
+    if (!queued) {
+        shed_requests_.fetch_add(1, std::memory_order_relaxed);
+        ShedRequest(reactor, id);
+    }
+}
+
+bool Server::HandleWebSocketUpgrade(int client_fd, std::string request_data) {
+    // The loop thread must not wait for a ring slot
+    return thread_pool_->TryPost([this, client_fd, request_data = std::move(request_data)]() {
+        try {
+            HandleWebSocket(client_fd, request_data);
+            
+            // WebSocket connections are managed by their handler
+            if (IsWebSocketConnection(client_fd)) {
+                return;
             }
+        } catch (const std::exception& e) {
+            logger_.Error("Exception in HandleWebSocket: " + std::string(e.what()));
+        } catch (...) {
+            logger_.Error("Unknown exception in HandleWebSocket");
         }
+        // No loop watches the fd any more
+        close(client_fd);
     });
 }
 
-std::string Server::ReadRequest(int client_fd) {
-    std::string request;
-    std::vector<char> buffer(config_.read_buffer_size);
-    
-    // For non-blocking sockets, we need to read in a loop with small delays
-    int attempts = 0;
-    const int max_attempts = 100; // Max 1 second of trying
+void Server::CloseConnection(Reactor* reactor, ConnectionId id) {
+    reactor->loop->RunInLoop([this, reactor, id]() {
+        CloseClient(reactor, id);
+    });
+}
+
+void Server::ProcessRequest(Reactor* reactor, ConnectionId id, const std::string& request_data,
+                            const PeerAddress& peer, bool last_request, const Route* route) {
+    try {
+        HttpRequest request = HttpParser::Parse(request_data);
+        
+        logger_.Info("[" + peer.Host() + "] " +
+                     HttpParser::MethodToString(request.method) + " " + request.path);
+        
+        HttpResponse response = route ? router_.Invoke(*route, request) : router_.HandleRequest(request);
+        if (compressor_) {
+            compressor_->Apply(request.GetHeader("accept-encoding"), response);
+        }
+        
+        SendResponse(reactor, id, std::move(response), !last_request && HttpParser::KeepAlive(request));
+    } catch (const std::exception& e) {
+        logger_.Error("Error processing request: " + std::string(e.what()));
+        SendResponse(reactor, id, InternalError("Internal Server Error"));
+    }
+}
+
+void Server::SendResponse(Reactor* reactor, ConnectionId id, HttpResponse response, bool keep_alive) {
+    if (keep_alive) {
+        // The next response on this connection is framed by Content-Length
+        response.SetHeader("Connection", "keep-alive");
+        response.SetHeader("Keep-Alive", "timeout=" + std::to_string(config_.keep_alive_timeout_seconds));
+        if (!response.GetFileBody() && !response.IsRendered() &&
+            response.GetStatus() != HttpStatus::NOT_MODIFIED) {
+            response.SetContentLength(response.GetBody().size());
+        }
+    }
     
-    while (attempts < max_attempts) {
-        ssize_t bytes_read = read(client_fd, buffer.data(), buffer.size() - 1);
+    // Queued on the owning loop, which writes as much as the socket takes,
+    // finishes on writability and then closes the connection or waits for
+    // the next request; a peer already holding send_high_water_mark unsent
+    // bytes is dropped instead. Headers and body go out as separate segments
+    // of one gather write, so the body is never copied. A connection closed
+    // in the meantime (its id no longer matches) gets nothing.
+    std::string head = response.SerializeHeaders();
+    std::string body = response.ReleaseBody();
+    std::shared_ptr<FileBody> file = response.GetFileBody();
+    std::shared_ptr<const std::string> shared_body = response.GetSharedBody();
+    reactor->loop->RunInLoop([this, reactor, id, keep_alive,
+                              head = std::move(head), body = std::move(body), file = std::move(file),
+                              shared_body = std::move(shared_body)]() mutable {
+        ClientEntry* client = reactor->connections.Find(id);
+        if (!client) {
+            return;
+        }
+        EventLoop* loop = reactor->loop.get();
+        const int client_fd = client->fd;
+        size_t total_bytes = head.size() + body.size() + (file ? file->Length() : 0) +
+                             (shared_body ? shared_body->size() : 0);
         
-        if (bytes_read < 0) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                // No data available right now, wait a bit
-                attempts++;
-                std::this_thread::sleep_for(std::chrono::milliseconds(10));
-                continue;
-            } else {
-                // Real error
-                throw std::runtime_error("Error reading from socket: " + std::string(strerror(errno)));
-            }
-        } else if (bytes_read == 0) {
-            // Connection closed
-            if (request.empty()) {
-                // Connection closed before any data
-                return "";
+        // With a pipelined request already buffered another response is on
+        // its way, so let this one's last segment wait to be coalesced
+        bool more = false;
+        if (keep_alive && !client->state.closing) {
+            try {
+                more = HttpParser::FindRequestEnd(client->state.input) > 0;
+            } catch (const std::invalid_argument&) {
+                // Answered with 400 right after this one
             }
-            break;
-        } else {
-            // Got data
-            buffer[bytes_read] = '\0';
-            request.append(buffer.data(), bytes_read);
-            attempts = 0; // Reset attempts on successful read
-            
-            // Check if we've received the full request
-            if (request.find("\r\n\r\n") != std::string::npos) {
-                // Check for Content-Length header
-                size_t content_length_pos = request.find("Content-Length:");
-                if (content_length_pos != std::string::npos) {
-                    size_t header_end = request.find("\r\n", content_length_pos);
-                    if (header_end != std::string::npos) {
-                        std::string content_length_str = request.substr(
-                            content_length_pos + 15,
-                            header_end - content_length_pos - 15
-                        );
-                        
-                        // Trim whitespace
-                        content_length_str.erase(0, content_length_str.find_first_not_of(" \t"));
-                        content_length_str.erase(content_length_str.find_last_not_of(" \t") + 1);
-                        
-                        if (!content_length_str.empty()) {
-                            try {
-                                size_t content_length = std::stoul(content_length_str);
-                                size_t body_start = request.find("\r\n\r\n") + 4;
-                                size_t body_received = request.length() - body_start;
-                                
-                                if (body_received < content_length) {
-                                    // Need to read more
-                                    continue;
-                                }
-                            } catch (...) {
-                                // Invalid content-length, assume we have everything
-                            }
-                        }
-                    }
+        }
+        
+        SendCallback on_sent = [this, reactor, id, keep_alive, total_bytes](int /*fd*/, ssize_t result) {
+            if (result < 0) {
+                logger_.Warn("Failed to send complete response (" + std::to_string(total_bytes) +
+                             " bytes): " + std::string(strerror(static_cast<int>(-result))));
+            } else if (keep_alive) {
+                ClientEntry* client = reactor->connections.Find(id);
+                if (client && !client->state.closing) {
+                    OnResponseSent(reactor, id);
+                    return;
                 }
-                // We have the full request
-                break;
             }
+            CloseClient(reactor, id);
+        };
+        
+        // File bodies (large static assets) are streamed with sendfile and
+        // cached ones are sent from the cache's copy
+        if (file) {
+            loop->SendFile(client_fd, std::move(head), std::move(file), std::move(on_sent), more);
+        } else if (shared_body) {
+            loop->Send(client_fd, std::move(head), std::move(shared_body), std::move(on_sent), more);
+        } else {
+            loop->Send(client_fd, std::move(head), std::move(body), std::move(on_sent), more);
         }
+    });
+}
+
+bool Server::StartHttp2(Reactor* reactor, ConnectionId id, const HttpRequest* upgrade) {
+    ClientEntry* client = reactor->connections.Find(id);
+    if (!client) {
+        return false;
+    }
+    ConnectionState& state = client->state;
+    
+    Http2Settings settings;
+    settings.max_concurrent_streams = static_cast<uint32_t>(config_.http2_max_concurrent_streams);
+    settings.max_resets = static_cast<uint32_t>(config_.http2_max_resets);
+    auto session = std::make_unique<Http2Session>(settings, config_.max_request_size);
+    if (upgrade) {
+        try {
+            session->StartUpgrade(*upgrade);
+        } catch (const std::invalid_argument& e) {
+            logger_.Warn(std::string(e.what()) + "; staying on HTTP/1.1");
+            return false;
+        }
+        // Ahead of the server preface the session queued
+        reactor->loop->Send(client->fd, "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n");
+    } else {
+        session->Start();
+    }
+    
+    reactor->loop->CancelTimer(state.deadline);
+    state.deadline = 0;
+    state.busy = false;
+    state.h2 = std::move(session);
+    
+    if (upgrade) {
+        DispatchStream(reactor, id, 1, *upgrade);
+    }
+    ReceiveHttp2(reactor, id);
+    return true;
+}
+
+void Server::ReceiveHttp2(Reactor* reactor, ConnectionId id) {
+    ClientEntry* client = reactor->connections.Find(id);
+    if (!client) {
+        return;
+    }
+    std::vector<Http2Request> requests = client->state.h2->Receive(client->state.input);
+    for (Http2Request& request : requests) {
+        DispatchStream(reactor, id, request.stream_id, std::move(request.request));
+    }
+    FlushHttp2(reactor, id);
+}
+
+void Server::DispatchStream(Reactor* reactor, ConnectionId id, uint32_t stream_id, HttpRequest request) {
+    ClientEntry* client = reactor->connections.Find(id);
+    if (!client) {
+        return;
     }
+    reactor->loop->CancelTimer(client->state.deadline);
+    client->state.deadline = 0;
+    ++client->state.requests;
     
-    if (attempts >= max_attempts && request.empty()) {
-        // Timeout waiting for data
-        return "";
+    const Route* route = router_.Match(request.method, request.path);
+    if (route && route->mode == RouteMode::Inline) {
+        RespondStream(reactor, id, stream_id, RouteStream(request, client->peer, route));
+        return;
     }
     
-    return request;
+    // Shed per stream: the connection and its other streams carry on. A
+    // full ring task queue sheds the same way.
+    auto shed = [&]() {
+        shed_requests_.fetch_add(1, std::memory_order_relaxed);
+        HttpResponse response(HttpStatus::SERVICE_UNAVAILABLE, "Service Unavailable");
+        response.SetHeader("Retry-After", std::to_string(config_.retry_after_seconds));
+        RespondStream(reactor, id, stream_id, std::move(response));
+    };
+    const TaskPriority priority = route ? route->priority : TaskPriority::Normal;
+    if (ShouldShed(priority)) {
+        shed();
+        return;
+    }
+    
+    bool queued = thread_pool_->TryPost([this, reactor, id, stream_id, request = std::move(request),
+                                         peer = client->peer, route]() {
+        HttpResponse response = RouteStream(request, peer, route);
+        reactor->loop->RunInLoop([this, reactor, id, stream_id, response = std::move(response)]() mutable {
+            RespondStream(reactor, id, stream_id, std::move(response));
+        });
+    }, priority);
+    if (!queued) {
+        shed();
+    }
 }
 
-void Server::ProcessRequest(int client_fd, const std::string& request_data) {
+HttpResponse Server::RouteStream(const HttpRequest& request, const PeerAddress& peer, const Route* route) {
     try {
-        // Check for WebSocket upgrade
-        if (WebSocket::IsWebSocketRequest(request_data)) {
-            HandleWebSocket(client_fd, request_data);
-            return;
-        }
-        
-        HttpRequest request = HttpParser::Parse(request_data);
-        
-        Connection conn(client_fd);
-        logger_.Info("[" + conn.GetRemoteAddress() + "] " +
-                     HttpParser::MethodToString(request.method) + " " + request.path);
+        logger_.Info("[" + peer.Host() + "] " +
+                     HttpParser::MethodToString(request.method) + " " + request.path + " (h2)");
         
-        HttpResponse response = router_.HandleRequest(request);
+        HttpResponse response = route ? router_.Invoke(*route, request) : router_.HandleRequest(request);
+        if (compressor_) {
+            compressor_->Apply(request.GetHeader("accept-encoding"), response);
+        }
         
-        SendResponse(client_fd, response);
+        // DATA frames are cut from memory, so read file bodies here, on the
+        // worker, rather than on the loop
+        if (std::shared_ptr<FileBody> file = response.GetFileBody()) {
+            std::string contents = file->ReadAll();
+            response.SetFileBody(nullptr);
+            response.SetBody(contents);
+        }
+        return response;
     } catch (const std::exception& e) {
         logger_.Error("Error processing request: " + std::string(e.what()));
-        HttpResponse error_response = InternalError("Internal Server Error");
-        SendResponse(client_fd, error_response);
+        return InternalError("Internal Server Error");
     }
 }
 
-void Server::SendResponse(int client_fd, const HttpResponse& response) {
-    std::string response_str = response.ToString();
-    ssize_t bytes_sent = 0;
-    size_t total_bytes = response_str.length();
-    
-    // Try to send all data, but don't block forever
-    int attempts = 0;
-    const int max_attempts = 100;
-    
-    while (bytes_sent < static_cast<ssize_t>(total_bytes) && attempts < max_attempts) {
-        ssize_t sent = write(client_fd, response_str.c_str() + bytes_sent, total_bytes - bytes_sent);
+void Server::RespondStream(Reactor* reactor, ConnectionId id, uint32_t stream_id, HttpResponse response) {
+    ClientEntry* client = reactor->connections.Find(id);
+    if (!client) {
+        return;
+    }
+    client->state.h2->Respond(stream_id, std::move(response));
+    FlushHttp2(reactor, id);
+}
+
+void Server::FlushHttp2(Reactor* reactor, ConnectionId id) {
+    // One write in flight at a time, each at most kHttp2WriteBudget; a send
+    // that completes synchronously leaves the next write to this loop
+    while (ClientEntry* client = reactor->connections.Find(id)) {
+        ConnectionState& state = client->state;
+        if (state.busy || state.dispatching) {
+            return;
+        }
+        Http2Session& session = *state.h2;
         
-        if (sent < 0) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                std::this_thread::sleep_for(std::chrono::milliseconds(10));
-                attempts++;
-                continue;
-            } else {
-                logger_.Error("Error writing to socket: " + std::string(strerror(errno)));
-                break;
+        std::string output = session.TakeOutput(kHttp2WriteBudget);
+        if (output.empty()) {
+            if (session.Finished() || (state.read_closed && session.ActiveStreams() == 0)) {
+                CloseClient(reactor, id);
+            } else if (session.ActiveStreams() == 0 && state.deadline == 0) {
+                // Idle connections are dropped after the keep-alive timeout
+                size_t idle_seconds = config_.keep_alive_timeout_seconds > 0 ? config_.keep_alive_timeout_seconds
+                                                                             : config_.request_timeout_seconds;
+                state.deadline = reactor->loop->RunAfter(std::chrono::seconds(idle_seconds), [this, reactor, id]() {
+                    ExpireClient(reactor, id);
+                });
             }
-        } else if (sent == 0) {
-            // Connection closed
-            logger_.Warn("Connection closed while writing response");
-            break;
+            return;
         }
         
-        bytes_sent += sent;
-        attempts = 0; // Reset attempts on successful write
-    }
-    
-    if (bytes_sent < static_cast<ssize_t>(total_bytes)) {
-        logger_.Warn("Failed to send complete response: " + std::to_string(bytes_sent) + "/" + std::to_string(total_bytes));
+        state.busy = true;
+        state.dispatching = true;
+        reactor->loop->Send(client->fd, std::move(output), [this, reactor, id](int /*fd*/, ssize_t result) {
+            ClientEntry* client = reactor->connections.Find(id);
+            if (!client) {
+                return;
+            }
+            if (result < 0) {
+                CloseClient(reactor, id);
+                return;
+            }
+            client->state.busy = false;
+            if (!client->state.dispatching) {
+                FlushHttp2(reactor, id);
+            }
+        });
+        
+        client = reactor->connections.Find(id);
+        if (!client) {
+            return;
+        }
+        client->state.dispatching = false;
     }
 }
 
@@ -394,26 +979,31 @@ void Server::HandleWebSocket(int client_fd, const std::string& request) {
     HttpRequest parsed = HttpParser::Parse(request);
     std::string path = parsed.path;
     
-    // Send handshake response
+    // Send handshake response; HandleWebSocketUpgrade closes the fd on failure
     std::string handshake = WebSocket::GenerateHandshakeResponse(request);
     if (handshake.empty()) {
-        close(client_fd);
         return;
     }
     
     // Send handshake directly (not through SendResponse)
-    send(client_fd, handshake.c_str(), handshake.length(), 0);
+    send(client_fd, handshake.c_str(), handshake.length(), kSendFlags);
+    
+    bool has_push = std::any_of(websocket_pushes_.begin(), websocket_pushes_.end(),
+                                [&path](const WebSocketPush& push) { return push.path == path; });
     
     // Mark as WebSocket connection
-    websocket_connections_[client_fd] = true;
+    {
+        std::lock_guard<std::mutex> lock(websocket_mutex_);
+        websocket_connections_[client_fd] = path;
+    }
     
     // Find and call handler
     auto it = websocket_handlers_.find(path);
     if (it != websocket_handlers_.end()) {
         it->second(client_fd, request);
-    } else {
-        // Default: keep connection open but do nothing
-        close(client_fd);
+    } else if (!has_push) {
+        // Nothing serves this path; HandleWebSocketUpgrade closes it
+        std::lock_guard<std::mutex> lock(websocket_mutex_);
         websocket_connections_.erase(client_fd);
     }
 }
@@ -422,4 +1012,45 @@ void Server::RegisterWebSocketHandler(const std::string& path, std::function<voi
     websocket_handlers_[path] = handler;
 }
 
+void Server::PushWebSocketEvery(const std::string& path, std::chrono::milliseconds interval,
+                                std::function<std::string()> producer) {
+    if (running_) {
+        throw std::logic_error("PushWebSocketEvery must be called before Start()");
+    }
+    websocket_pushes_.push_back(WebSocketPush{path, interval, std::move(producer)});
+}
+
+bool Server::IsWebSocketConnection(int client_fd) {
+    std::lock_guard<std::mutex> lock(websocket_mutex_);
+    return websocket_connections_.count(client_fd) > 0;
+}
+
+void Server::PushWebSocketFrames(const WebSocketPush& push) {
+    std::string payload = push.producer();
+    if (payload.empty()) {
+        return;
+    }
+    std::vector<uint8_t> frame = WebSocket::EncodeFrame(payload, WebSocket::Opcode::Text);
+    
+    std::lock_guard<std::mutex> lock(websocket_mutex_);
+    for (auto it = websocket_connections_.begin(); it != websocket_connections_.end();) {
+        if (it->second != push.path) {
+            ++it;
+            continue;
+        }
+        
+        ssize_t sent = send(it->first, frame.data(), frame.size(), kSendFlags);
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // Slow client: skip this frame rather than block the loop
+            ++it;
+        } else if (sent != static_cast<ssize_t>(frame.size())) {
+            // Closed, or a partial frame that would corrupt the stream
+            close(it->first);
+            it = websocket_connections_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
 } // namespace http
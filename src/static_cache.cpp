@@ -0,0 +1,336 @@
+#include "static_cache.hpp"
+#include "file_body.hpp"
+#include <stdexcept>
+#include <system_error>
+#include <cstdio>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#if defined(__linux__)
+#include <sys/inotify.h>
+#endif
+
+namespace http {
+
+namespace {
+
+#if defined(__linux__)
+constexpr uint32_t kWatchMask = IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB | IN_CREATE | IN_DELETE |
+                                IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+#endif
+
+int64_t ModifiedNs(const struct stat& info) {
+#if defined(__APPLE__)
+    return static_cast<int64_t>(info.st_mtimespec.tv_sec) * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+    return static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+}
+
+std::string MakeETag(size_t size, int64_t mtime_ns) {
+    char etag[48];
+    snprintf(etag, sizeof(etag), "\"%zx-%llx\"", size, static_cast<unsigned long long>(mtime_ns));
+    return etag;
+}
+
+// If-None-Match holds "*" or a comma-separated list of (possibly weak) tags
+bool MatchesETag(const std::string& if_none_match, const std::string& etag) {
+    size_t pos = 0;
+    while (pos < if_none_match.size()) {
+        size_t end = if_none_match.find(',', pos);
+        if (end == std::string::npos) {
+            end = if_none_match.size();
+        }
+        size_t first = if_none_match.find_first_not_of(" \t", pos);
+        size_t last = if_none_match.find_last_not_of(" \t", end - 1);
+        if (first != std::string::npos && first < end && last >= first) {
+            if (if_none_match.compare(first, 2, "W/") == 0) {
+                first += 2;
+            }
+            size_t length = last + 1 - first;
+            if ((length == 1 && if_none_match[first] == '*') ||
+                if_none_match.compare(first, length, etag) == 0) {
+                return true;
+            }
+        }
+        pos = end + 1;
+    }
+    return false;
+}
+
+HttpResponse NotModified(const std::string& etag) {
+    HttpResponse response(HttpStatus::NOT_MODIFIED);
+    response.SetHeader("ETag", etag);
+    return response;
+}
+
+std::string RenderHeaders(const std::string& content_type, size_t length, const std::string& etag) {
+    std::string headers;
+    headers.reserve(128 + content_type.size() + etag.size());
+    headers.append("HTTP/1.1 200 OK\r\n")
+           .append("Server: HighPerformanceServer/1.0\r\n")
+           .append("Content-Type: ").append(content_type).append("\r\n")
+           .append("Content-Length: ").append(std::to_string(length)).append("\r\n")
+           .append("ETag: ").append(etag).append("\r\n");
+    return headers;
+}
+
+} // namespace
+
+StaticFileCache::StaticFileCache(const std::string& directory, size_t capacity_bytes)
+    : directory_(std::filesystem::canonical(directory)),
+      directory_prefix_(directory_.string() + "/"),
+      capacity_bytes_(capacity_bytes),
+      max_entry_bytes_(capacity_bytes / 8) {
+#if defined(__linux__)
+    if (capacity_bytes_ > 0) {
+        watch_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        // Out of watches (or inotify instances): fall back to stat checks
+        if (watch_fd_ >= 0 && !WatchTree(directory_.string())) {
+            CloseWatch();
+        }
+    }
+#endif
+}
+
+StaticFileCache::~StaticFileCache() {
+    CloseWatch();
+}
+
+void StaticFileCache::CloseWatch() {
+    if (watch_fd_ >= 0) {
+        close(watch_fd_);
+        watch_fd_ = -1;
+    }
+    watched_dirs_.clear();
+}
+
+bool StaticFileCache::WatchTree(const std::string& directory) {
+#if defined(__linux__)
+    int wd = inotify_add_watch(watch_fd_, directory.c_str(), kWatchMask | IN_ONLYDIR);
+    if (wd < 0) {
+        // Removed again before we got to it
+        return errno == ENOENT || errno == ENOTDIR;
+    }
+    watched_dirs_[wd] = directory;
+
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec)) {
+        if (it->is_directory(ec) && !it->is_symlink(ec) && !WatchTree(it->path().string())) {
+            return false;
+        }
+    }
+    return true;
+#else
+    (void)directory;
+    return false;
+#endif
+}
+
+void StaticFileCache::OnWatchEvents() {
+#if defined(__linux__)
+    alignas(struct inotify_event) char buffer[4096];
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (watch_fd_ >= 0) {
+        ssize_t length = read(watch_fd_, buffer, sizeof(buffer));
+        if (length < 0 && errno == EINTR) {
+            continue;
+        }
+        if (length <= 0) {
+            return;
+        }
+
+        for (ssize_t pos = 0; pos < length;) {
+            const auto* event = reinterpret_cast<const struct inotify_event*>(buffer + pos);
+            pos += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                // Events were lost
+                Invalidate(directory_.string(), true);
+                continue;
+            }
+
+            auto dir = watched_dirs_.find(event->wd);
+            if (dir == watched_dirs_.end()) {
+                continue;
+            }
+            if (event->mask & IN_IGNORED) {
+                watched_dirs_.erase(dir);
+                continue;
+            }
+            if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+                Invalidate(dir->second, true);
+                continue;
+            }
+            if (event->len == 0) {
+                continue;
+            }
+
+            std::string path = dir->second + "/" + event->name;
+            bool is_directory = (event->mask & IN_ISDIR) != 0;
+            if (is_directory && (event->mask & (IN_CREATE | IN_MOVED_TO)) && !WatchTree(path)) {
+                // Cannot see into the new directory: stop caching on trust
+                Invalidate(directory_.string(), true);
+                CloseWatch();
+                return;
+            }
+            Invalidate(path, is_directory);
+        }
+    }
+#endif
+}
+
+void StaticFileCache::Invalidate(const std::string& path, bool directory) {
+    ++generation_;
+
+    // Invalidation is rare next to lookups, so a scan beats a second index
+    const std::string prefix = path + "/";
+    for (auto it = entries_.begin(); it != entries_.end();) {
+        const Entry& entry = *it->second;
+        bool stale = entry.canonical_path == path || entry.request_file == path ||
+                     (directory && (entry.canonical_path.compare(0, prefix.size(), prefix) == 0 ||
+                                    entry.request_file.compare(0, prefix.size(), prefix) == 0));
+        if (stale) {
+            auto next = std::next(it);
+            Erase(it);
+            it = next;
+        } else {
+            ++it;
+        }
+    }
+}
+
+HttpResponse StaticFileCache::Serve(const std::string& relative_path, const std::string& if_none_match) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(relative_path);
+        if (it != entries_.end()) {
+            if (watch_fd_ >= 0 || StillCurrent(*it->second)) {
+                lru_.splice(lru_.begin(), lru_, it->second);
+                const Entry& entry = *it->second;
+                if (!if_none_match.empty() && MatchesETag(if_none_match, entry.etag)) {
+                    return NotModified(entry.etag);
+                }
+                return HttpResponse::Rendered(HttpStatus::OK, entry.headers, entry.body);
+            }
+            Erase(it);
+        }
+    }
+    return Load(relative_path, if_none_match);
+}
+
+bool StaticFileCache::StillCurrent(const Entry& entry) const {
+    struct stat info{};
+    return stat(entry.request_file.c_str(), &info) == 0 &&
+           static_cast<size_t>(info.st_size) == entry.size && ModifiedNs(info) == entry.mtime_ns;
+}
+
+HttpResponse StaticFileCache::Load(const std::string& relative_path, const std::string& if_none_match) {
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        generation = generation_;
+    }
+
+    // Security: prevent directory traversal
+    std::filesystem::path request_file = (directory_ / relative_path).lexically_normal();
+    std::error_code ec;
+    std::filesystem::path canonical = std::filesystem::canonical(request_file, ec);
+    if (ec) {
+        return NotFound("File not found");
+    }
+    std::string canonical_path = canonical.string();
+    if (canonical_path.compare(0, directory_prefix_.size(), directory_prefix_) != 0) {
+        return Forbidden("Access denied");
+    }
+    if (!std::filesystem::is_regular_file(canonical, ec)) {
+        return BadRequest("Path is not a file");
+    }
+
+    std::shared_ptr<FileBody> file;
+    struct stat info{};
+    try {
+        file = FileBody::Open(canonical_path);
+    } catch (const std::runtime_error&) {
+        return InternalError("Failed to open file");
+    }
+    if (fstat(file->Fd(), &info) != 0) {
+        return InternalError("Failed to open file");
+    }
+
+    Entry entry;
+    entry.key = relative_path;
+    entry.canonical_path = std::move(canonical_path);
+    entry.request_file = request_file.string();
+    entry.size = file->Length();
+    entry.mtime_ns = ModifiedNs(info);
+    entry.etag = MakeETag(entry.size, entry.mtime_ns);
+    const std::string& content_type = HttpResponse::ContentTypeFor(entry.canonical_path);
+
+    if (!if_none_match.empty() && MatchesETag(if_none_match, entry.etag)) {
+        return NotModified(entry.etag);
+    }
+
+    // Too large to cache: stream it with sendfile
+    if (entry.size > max_entry_bytes_ || capacity_bytes_ == 0) {
+        HttpResponse response(HttpStatus::OK);
+        response.SetFileBody(std::move(file));
+        response.SetContentType(content_type);
+        response.SetHeader("ETag", entry.etag);
+        return response;
+    }
+
+    try {
+        entry.body = std::make_shared<const std::string>(file->ReadAll());
+    } catch (const std::runtime_error&) {
+        return InternalError("Failed to read file");
+    }
+    entry.size = entry.body->size();
+    entry.headers = std::make_shared<const std::string>(RenderHeaders(content_type, entry.size, entry.etag));
+
+    HttpResponse response = HttpResponse::Rendered(HttpStatus::OK, entry.headers, entry.body);
+    Insert(std::move(entry), generation);
+    return response;
+}
+
+void StaticFileCache::Insert(Entry entry, uint64_t generation) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // The file may have changed while it was read
+    if (generation != generation_ || entries_.count(entry.key) > 0) {
+        return;
+    }
+
+    while (!lru_.empty() && cached_bytes_ + entry.size > capacity_bytes_) {
+        Erase(entries_.find(lru_.back().key));
+    }
+
+    cached_bytes_ += entry.size;
+    lru_.push_front(std::move(entry));
+    entries_[lru_.front().key] = lru_.begin();
+}
+
+void StaticFileCache::Erase(std::unordered_map<std::string, EntryList::iterator>::iterator it) {
+    cached_bytes_ -= it->second->size;
+    lru_.erase(it->second);
+    entries_.erase(it);
+}
+
+size_t StaticFileCache::Entries() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+size_t StaticFileCache::CachedBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return cached_bytes_;
+}
+
+void StaticFileCache::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++generation_;
+    lru_.clear();
+    entries_.clear();
+    cached_bytes_ = 0;
+}
+
+} // namespace http
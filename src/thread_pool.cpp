@@ -1,15 +1,95 @@
 #include "thread_pool.hpp"
+#include "cpu_topology.hpp"
+#include <algorithm>
 #include <stdexcept>
 
 namespace http {
 
-ThreadPool::ThreadPool(size_t num_threads) : stop_(false) {
+namespace {
+
+// Most injector tasks one worker moves to its deque at a time
+constexpr size_t kMaxInjectorBatch = 32;
+
+// Spare work-stealing nodes a worker keeps before handing half to the
+// shared list, and the most that list holds
+constexpr size_t kMaxWorkerNodes = 2 * kMaxInjectorBatch;
+constexpr size_t kMaxSharedNodes = 1024;
+
+// The stealing worker running on this thread, if any
+struct CurrentWorker {
+    const ThreadPool* pool = nullptr;
+    size_t index = 0;
+};
+thread_local CurrentWorker current_worker;
+
+} // namespace
+
+Scheduling ParseScheduling(const std::string& name) {
+    if (name.empty() || name == "shared") return Scheduling::SharedQueue;
+    if (name == "work_stealing" || name == "stealing") return Scheduling::WorkStealing;
+    throw std::invalid_argument("Unknown thread pool scheduling: " + name);
+}
+
+TaskQueue ParseTaskQueue(const std::string& name) {
+    if (name.empty() || name == "locked") return TaskQueue::Locked;
+    if (name == "ring") return TaskQueue::Ring;
+    throw std::invalid_argument("Unknown thread pool queue: " + name);
+}
+
+ThreadPool::ThreadPool(size_t num_threads, const ThreadPoolOptions& options)
+    : scheduling_(options.scheduling), thread_name_(options.thread_name), cpus_(options.cpus), stop_(false),
+      max_threads_(options.max_threads), grow_after_(options.grow_after), idle_timeout_(options.idle_timeout) {
     if (num_threads == 0) {
         num_threads = 1;
     }
+    if (scheduling_ == Scheduling::WorkStealing) {
+        if (options.queue == TaskQueue::Ring) {
+            throw std::invalid_argument("A ring task queue needs shared queue scheduling");
+        }
+        if (max_threads_ > num_threads) {
+            throw std::invalid_argument("Elastic thread pool sizing needs shared queue scheduling");
+        }
+    }
+    
+    StartLane(critical_lane_, options.critical_threads, options.lane_capacity, "c", num_threads);
+    StartLane(bulk_lane_, options.bulk_threads, options.lane_capacity, "b", num_threads + lane_threads_);
+    
+    if (options.queue == TaskQueue::Ring) {
+        ring_ = std::make_unique<BoundedMpmcQueue<QueuedTask>>(options.queue_capacity);
+        for (size_t i = 0; i < num_threads; ++i) {
+            threads_.emplace_back([this, i]() {
+                PrepareThread(std::to_string(i), i);
+                RingWorkerThread();
+            });
+        }
+        return;
+    }
+    
+    if (scheduling_ == Scheduling::WorkStealing) {
+        free_nodes_.reserve(kMaxSharedNodes);
+        for (size_t i = 0; i < num_threads; ++i) {
+            workers_.push_back(std::make_unique<Worker>());
+            workers_.back()->rng = 0x9e3779b97f4a7c15ull * (i + 1);
+            workers_.back()->free_nodes.reserve(kMaxWorkerNodes + 1);
+            // Enough for a full batch from the injector from the start
+            for (size_t n = 0; n < kMaxInjectorBatch; ++n) {
+                workers_.back()->free_nodes.push_back(std::make_unique<QueuedTask>());
+            }
+        }
+        for (size_t i = 0; i < num_threads; ++i) {
+            threads_.emplace_back([this, i]() {
+                PrepareThread(std::to_string(i), i);
+                StealingWorkerThread(i);
+            });
+        }
+        return;
+    }
     
     for (size_t i = 0; i < num_threads; ++i) {
-        threads_.emplace_back(&ThreadPool::WorkerThread, this);
+        threads_.emplace_back([this, i]() {
+            PrepareThread(std::to_string(i), i);
+            WorkerThread();
+        });
     }
 }
 
@@ -19,39 +99,458 @@ ThreadPool::~ThreadPool() {
         stop_ = true;
     }
     condition_.notify_all();
+    for (Lane* lane : {critical_lane_.get(), bulk_lane_.get()}) {
+        if (lane) {
+            // Taken once stop_ is set, so no lane worker misses it
+            { std::lock_guard<std::mutex> lock(lane->mutex); }
+            lane->ready.notify_all();
+            lane->space.notify_all();
+        }
+    }
     
     for (std::thread& thread : threads_) {
         if (thread.joinable()) {
             thread.join();
         }
     }
+    // No worker adds one once stop_ is set
+    for (std::thread& thread : added_threads_) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    for (Lane* lane : {critical_lane_.get(), bulk_lane_.get()}) {
+        if (lane) {
+            for (std::thread& thread : lane->threads) {
+                thread.join();
+            }
+        }
+    }
 }
 
 size_t ThreadPool::PendingTasks() const {
+    size_t pending = 0;
+    for (const Lane* lane : {critical_lane_.get(), bulk_lane_.get()}) {
+        if (lane) {
+            std::lock_guard<std::mutex> lock(lane->mutex);
+            pending += lane->tasks.Size();
+        }
+    }
+    if (scheduling_ == Scheduling::WorkStealing || ring_) {
+        return pending + static_cast<size_t>(std::max<int64_t>(0, pending_.load(std::memory_order_relaxed)));
+    }
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    return pending + tasks_.Size();
+}
+
+void ThreadPool::SetQueueDelayObserver(QueueDelayObserver observer, TaskPriority lane) {
+    if (lane != TaskPriority::Normal) {
+        if (Lane* target = LaneFor(lane)) {
+            std::lock_guard<std::mutex> lock(target->mutex);
+            target->delay_observer = std::move(observer);
+        }
+        return;
+    }
     std::lock_guard<std::mutex> lock(queue_mutex_);
-    return tasks_.size();
+    delay_observer_ = std::move(observer);
 }
 
-void ThreadPool::WorkerThread() {
+bool ThreadPool::HasLane(TaskPriority priority) const {
+    return priority == TaskPriority::Normal || LaneFor(priority) != nullptr;
+}
+
+ThreadPool::Lane* ThreadPool::LaneFor(TaskPriority priority) const {
+    switch (priority) {
+        case TaskPriority::Critical: return critical_lane_.get();
+        case TaskPriority::Bulk: return bulk_lane_.get();
+        default: return nullptr;
+    }
+}
+
+bool ThreadPool::Submit(QueuedTask task, bool wait_for_space, TaskPriority priority) {
+    if (Lane* lane = LaneFor(priority)) {
+        {
+            std::unique_lock<std::mutex> lock(lane->mutex);
+            if (!stop_ && lane->tasks.Size() >= lane->capacity) {
+                if (!wait_for_space) {
+                    return false;
+                }
+                lane->space.wait(lock, [this, lane] {
+                    return stop_ || lane->tasks.Size() < lane->capacity;
+                });
+            }
+            if (stop_) {
+                throw std::runtime_error("Enqueue on stopped ThreadPool");
+            }
+            lane->tasks.Push(std::move(task));
+        }
+        lane->ready.notify_one();
+        return true;
+    }
+    
+    // Counted before it is pushed, like a worker's own submissions below; a
+    // worker that sees the count but not yet the task looks again
+    if (ring_) {
+        if (stop_.load(std::memory_order_relaxed)) {
+            throw std::runtime_error("Enqueue on stopped ThreadPool");
+        }
+        pending_.fetch_add(1, std::memory_order_seq_cst);
+        while (!ring_->TryPush(std::move(task))) {
+            if (!wait_for_space) {
+                pending_.fetch_sub(1, std::memory_order_relaxed);
+                return false;
+            }
+            std::this_thread::yield();
+        }
+        if (sleepers_.load(std::memory_order_seq_cst) > 0) {
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            condition_.notify_one();
+        }
+        return true;
+    }
+    
+    if (scheduling_ == Scheduling::SharedQueue) {
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            if (stop_) {
+                throw std::runtime_error("Enqueue on stopped ThreadPool");
+            }
+            tasks_.Push(std::move(task));
+        }
+        condition_.notify_one();
+        return true;
+    }
+    
+    // A worker's own submissions go on its deque, lock-free. Counting the
+    // task before it is visible and reading sleepers_ after (both seq_cst)
+    // pairs with a parking worker counting itself before checking pending_,
+    // so one of the two sees the other.
+    if (current_worker.pool == this && !stop_.load(std::memory_order_relaxed)) {
+        pending_.fetch_add(1, std::memory_order_seq_cst);
+        Worker& worker = *workers_[current_worker.index];
+        QueuedTask* node = AcquireNode(worker);
+        *node = std::move(task);
+        worker.deque.Push(node);
+        if (sleepers_.load(std::memory_order_seq_cst) > 0) {
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            condition_.notify_one();
+        }
+        return true;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        if (stop_) {
+            throw std::runtime_error("Enqueue on stopped ThreadPool");
+        }
+        injector_.Push(std::move(task));
+        injector_size_.store(injector_.Size(), std::memory_order_relaxed);
+        pending_.fetch_add(1, std::memory_order_seq_cst);
+    }
+    if (sleepers_.load(std::memory_order_seq_cst) > 0) {
+        condition_.notify_one();
+    }
+    return true;
+}
+
+void ThreadPool::PrepareThread(const std::string& suffix, size_t cpu_index) {
+    if (!thread_name_.empty()) {
+        SetCurrentThreadName(thread_name_ + "-" + suffix);
+    }
+    if (!cpus_.empty()) {
+        PinCurrentThread({cpus_[cpu_index % cpus_.size()]});
+    }
+}
+
+void ThreadPool::StartLane(std::unique_ptr<Lane>& lane, size_t threads, size_t capacity, const std::string& tag,
+                           size_t first_cpu) {
+    if (threads == 0) {
+        return;
+    }
+    lane = std::make_unique<Lane>();
+    lane->capacity = std::max<size_t>(1, capacity);
+    lane_threads_ += threads;
+    for (size_t i = 0; i < threads; ++i) {
+        Lane* target = lane.get();
+        target->threads.emplace_back([this, target, tag, i, first_cpu]() {
+            PrepareThread(tag + std::to_string(i), first_cpu + i);
+            LaneWorkerThread(*target);
+        });
+    }
+}
+
+void ThreadPool::LaneWorkerThread(Lane& lane) {
+    while (true) {
+        InlineTask task;
+        {
+            std::unique_lock<std::mutex> lock(lane.mutex);
+            lane.ready.wait(lock, [this, &lane] {
+                return stop_ || !lane.tasks.Empty();
+            });
+            if (stop_ && lane.tasks.Empty()) {
+                return;
+            }
+            QueuedTask next = lane.tasks.Pop();
+            task = std::move(next.run);
+            if (lane.delay_observer) {
+                auto wait = std::chrono::steady_clock::now() - next.enqueued;
+                lane.delay_observer(std::chrono::duration_cast<std::chrono::nanoseconds>(wait), lane.tasks.Empty());
+            }
+        }
+        lane.space.notify_one();
+        task();
+    }
+}
+
+bool ThreadPool::ShouldGrow(std::chrono::steady_clock::duration wait) const {
+    return wait > grow_after_ && Size() < max_threads_;
+}
+
+void ThreadPool::AddWorker() {
+    if (stop_ || Size() >= max_threads_) {
+        return;
+    }
+    size_t slot = added_threads_.size();
+    if (!retired_slots_.empty()) {
+        slot = retired_slots_.back();
+        retired_slots_.pop_back();
+        added_threads_[slot].join();
+    } else {
+        added_threads_.emplace_back();
+    }
+    
+    // The new worker waits for queue_mutex_, held here, before it looks for
+    // tasks or retires
+    added_workers_.fetch_add(1, std::memory_order_relaxed);
+    added_threads_[slot] = std::thread([this, slot]() {
+        const size_t index = threads_.size() + slot;
+        PrepareThread(std::to_string(index), index + lane_threads_);
+        if (ring_) {
+            RingWorkerThread(true);
+        } else {
+            WorkerThread(true);
+        }
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        added_workers_.fetch_sub(1, std::memory_order_relaxed);
+        retired_slots_.push_back(slot);
+    });
+}
+
+void ThreadPool::WorkerThread(bool elastic) {
+    auto ready = [this] {
+        return stop_ || !tasks_.Empty();
+    };
     while (true) {
-        std::function<void()> task;
+        InlineTask task;
         
         {
             std::unique_lock<std::mutex> lock(queue_mutex_);
-            condition_.wait(lock, [this] {
-                return stop_ || !tasks_.empty();
-            });
+            if (!elastic) {
+                condition_.wait(lock, ready);
+            } else if (!condition_.wait_for(lock, idle_timeout_, ready)) {
+                return;
+            }
             
-            if (stop_ && tasks_.empty()) {
+            if (stop_ && tasks_.Empty()) {
                 return;
             }
             
-            task = std::move(tasks_.front());
-            tasks_.pop();
+            QueuedTask next = tasks_.Pop();
+            task = std::move(next.run);
+            if (delay_observer_ || max_threads_ > 0) {
+                auto wait = std::chrono::steady_clock::now() - next.enqueued;
+                if (delay_observer_) {
+                    delay_observer_(std::chrono::duration_cast<std::chrono::nanoseconds>(wait), tasks_.Empty());
+                }
+                if (ShouldGrow(wait)) {
+                    AddWorker();
+                }
+            }
         }
         
         task();
     }
 }
 
+void ThreadPool::StealingWorkerThread(size_t index) {
+    current_worker.pool = this;
+    current_worker.index = index;
+    
+    QueuedTask task;
+    while (true) {
+        if (FindTask(index, task)) {
+            bool queue_empty = pending_.fetch_sub(1, std::memory_order_relaxed) == 1;
+            if (delay_observer_) {
+                ReportDelay(task, queue_empty);
+            }
+            InlineTask run = std::move(task.run);
+            run();
+            continue;
+        }
+        
+        if (!WaitForTasks(false)) {
+            return;
+        }
+    }
+}
+
+void ThreadPool::RingWorkerThread(bool elastic) {
+    QueuedTask task;
+    while (true) {
+        if (ring_->TryPop(task)) {
+            bool queue_empty = pending_.fetch_sub(1, std::memory_order_relaxed) == 1;
+            if (delay_observer_) {
+                ReportDelay(task, queue_empty);
+            }
+            if (max_threads_ > 0 && ShouldGrow(std::chrono::steady_clock::now() - task.enqueued)) {
+                std::lock_guard<std::mutex> lock(queue_mutex_);
+                AddWorker();
+            }
+            InlineTask run = std::move(task.run);
+            run();
+            continue;
+        }
+        
+        if (!WaitForTasks(elastic)) {
+            return;
+        }
+    }
+}
+
+bool ThreadPool::WaitForTasks(bool elastic) {
+    // Nothing found. While pending_ says a task is still out there (being
+    // pushed, or a steal lost a race) look again; otherwise park.
+    std::unique_lock<std::mutex> lock(queue_mutex_);
+    sleepers_.fetch_add(1, std::memory_order_seq_cst);
+    auto ready = [this] {
+        return stop_ || pending_.load(std::memory_order_seq_cst) > 0;
+    };
+    bool woken = true;
+    if (!elastic) {
+        condition_.wait(lock, ready);
+    } else {
+        woken = condition_.wait_for(lock, idle_timeout_, ready);
+    }
+    sleepers_.fetch_sub(1, std::memory_order_relaxed);
+    if (!woken || (stop_ && pending_.load(std::memory_order_seq_cst) <= 0)) {
+        return false;
+    }
+    lock.unlock();
+    std::this_thread::yield();
+    return true;
+}
+
+bool ThreadPool::FindTask(size_t index, QueuedTask& out) {
+    Worker& self = *workers_[index];
+    QueuedTask* node = nullptr;
+    if (self.deque.Pop(node)) {
+        out = std::move(*node);
+        ReleaseNode(self, node);
+        return true;
+    }
+    
+    // Take the injector's oldest task to run now, plus a share of the rest
+    // for the deque, where idle workers can steal them
+    if (injector_size_.load(std::memory_order_relaxed) > 0) {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        if (!injector_.Empty()) {
+            out = injector_.Pop();
+            size_t share = std::min(kMaxInjectorBatch, injector_.Size() / workers_.size());
+            while (self.free_nodes.size() < share && !free_nodes_.empty()) {
+                self.free_nodes.push_back(std::move(free_nodes_.back()));
+                free_nodes_.pop_back();
+            }
+            // Only into spare nodes, so draining the injector never
+            // allocates (thieves may be holding the rest); what stays
+            // behind goes with the next worker's batch
+            share = std::min(share, self.free_nodes.size());
+            for (size_t i = 0; i < share; ++i) {
+                node = AcquireNode(self);
+                *node = injector_.Pop();
+                self.deque.Push(node);
+            }
+            injector_size_.store(injector_.Size(), std::memory_order_relaxed);
+            return true;
+        }
+    }
+    
+    // Steal, starting from a random victim (xorshift)
+    const size_t count = workers_.size();
+    self.rng ^= self.rng << 13;
+    self.rng ^= self.rng >> 7;
+    self.rng ^= self.rng << 17;
+    size_t start = static_cast<size_t>(self.rng % count);
+    for (size_t i = 0; i < count; ++i) {
+        size_t victim = (start + i) % count;
+        if (victim != index && workers_[victim]->deque.Steal(node)) {
+            out = std::move(*node);
+            ReleaseNode(self, node);
+            return true;
+        }
+    }
+    return false;
+}
+
+ThreadPool::QueuedTask* ThreadPool::AcquireNode(Worker& worker) {
+    if (worker.free_nodes.empty()) {
+        return new QueuedTask();
+    }
+    QueuedTask* node = worker.free_nodes.back().release();
+    worker.free_nodes.pop_back();
+    return node;
+}
+
+void ThreadPool::ReleaseNode(Worker& worker, QueuedTask* node) {
+    worker.free_nodes.emplace_back(node);
+    if (worker.free_nodes.size() <= kMaxWorkerNodes) {
+        return;
+    }
+    
+    // Thieves collect the nodes of the tasks they steal; pass half on, for
+    // whichever worker next fills its deque from the injector
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    while (worker.free_nodes.size() > kMaxWorkerNodes / 2) {
+        if (free_nodes_.size() < kMaxSharedNodes) {
+            free_nodes_.push_back(std::move(worker.free_nodes.back()));
+        }
+        worker.free_nodes.pop_back();
+    }
+}
+
+void ThreadPool::TaskBuffer::Push(QueuedTask task) {
+    if (count_ == slots_.size()) {
+        std::vector<QueuedTask> grown(std::max<size_t>(16, slots_.size() * 2));
+        for (size_t i = 0; i < count_; ++i) {
+            grown[i] = std::move(slots_[(head_ + i) % slots_.size()]);
+        }
+        slots_ = std::move(grown);
+        head_ = 0;
+    }
+    slots_[(head_ + count_) % slots_.size()] = std::move(task);
+    ++count_;
+}
+
+ThreadPool::QueuedTask ThreadPool::TaskBuffer::Pop() {
+    QueuedTask task = std::move(slots_[head_]);
+    head_ = (head_ + 1) % slots_.size();
+    --count_;
+    return task;
+}
+
+void ThreadPool::ReportDelay(const QueuedTask& task, bool queue_empty) {
+    // Serialized without a lock; a report that the queue drained must not be
+    // lost (it ends load shedding), so that one waits its turn
+    if (reporting_.test_and_set(std::memory_order_acquire)) {
+        if (!queue_empty) {
+            return;
+        }
+        while (reporting_.test_and_set(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+    }
+    auto wait = std::chrono::steady_clock::now() - task.enqueued;
+    delay_observer_(std::chrono::duration_cast<std::chrono::nanoseconds>(wait), queue_empty);
+    reporting_.clear(std::memory_order_release);
+}
+
 } // namespace http
@@ -0,0 +1,238 @@
+#include "timer_wheel.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace http {
+
+namespace {
+
+constexpr uint32_t kIndexMask = 0xFFFFFFFFu;
+
+} // namespace
+
+TimerWheel::TimerWheel(uint64_t now_ms)
+    : heads_(static_cast<size_t>(kLevels) * kSlots, kNone),
+      free_head_(kNone),
+      now_(now_ms),
+      size_(0),
+      level_counts_{} {
+}
+
+uint32_t TimerWheel::Allocate() {
+    if (free_head_ != kNone) {
+        uint32_t index = free_head_;
+        free_head_ = timers_[index].next;
+        return index;
+    }
+
+    if (timers_.size() >= kIndexMask) {
+        throw std::runtime_error("Too many timers");
+    }
+    timers_.emplace_back();
+    timers_.back().generation = 1;
+    return static_cast<uint32_t>(timers_.size() - 1);
+}
+
+void TimerWheel::Release(uint32_t index) {
+    Timer& timer = timers_[index];
+    timer.callback = nullptr;
+    timer.bucket = kFree;
+    timer.cancelled = false;
+    timer.prev = kNone;
+    timer.next = free_head_;
+    // Invalidate outstanding ids for this record
+    if (++timer.generation == 0) {
+        timer.generation = 1;
+    }
+    free_head_ = index;
+}
+
+void TimerWheel::Link(uint32_t index) {
+    Timer& timer = timers_[index];
+    uint64_t delta = timer.expires > now_ ? timer.expires - now_ : 0;
+    uint64_t expires = timer.expires;
+
+    int level = 0;
+    while (level < kLevels - 1 && delta >= (uint64_t{1} << (kSlotBits * (level + 1)))) {
+        ++level;
+    }
+    if (level == kLevels - 1 && delta >= (uint64_t{1} << (kSlotBits * kLevels))) {
+        // Beyond the wheel's range: park in the furthest slot and cascade again
+        expires = now_ + (uint64_t{1} << (kSlotBits * kLevels)) - 1;
+    }
+
+    uint32_t slot = static_cast<uint32_t>(expires >> (kSlotBits * level)) & kSlotMask;
+    uint16_t bucket = static_cast<uint16_t>(static_cast<uint32_t>(level) * kSlots + slot);
+
+    timer.bucket = bucket;
+    timer.prev = kNone;
+    timer.next = heads_[bucket];
+    if (timer.next != kNone) {
+        timers_[timer.next].prev = index;
+    }
+    heads_[bucket] = index;
+    ++level_counts_[level];
+}
+
+void TimerWheel::Unlink(uint32_t index) {
+    Timer& timer = timers_[index];
+    if (timer.prev != kNone) {
+        timers_[timer.prev].next = timer.next;
+    } else {
+        heads_[timer.bucket] = timer.next;
+    }
+    if (timer.next != kNone) {
+        timers_[timer.next].prev = timer.prev;
+    }
+    --level_counts_[timer.bucket / kSlots];
+    timer.prev = kNone;
+    timer.next = kNone;
+}
+
+TimerId TimerWheel::Schedule(uint64_t expires_ms, uint64_t interval_ms, TimerCallback callback) {
+    if (!callback) {
+        throw std::invalid_argument("Timer callback is empty");
+    }
+
+    uint32_t index = Allocate();
+    Timer& timer = timers_[index];
+    // The current tick has already been processed
+    timer.expires = std::max(expires_ms, now_ + 1);
+    timer.interval = interval_ms;
+    timer.callback = std::move(callback);
+    timer.cancelled = false;
+    Link(index);
+    ++size_;
+
+    return (static_cast<uint64_t>(timer.generation) << 32) | index;
+}
+
+bool TimerWheel::Cancel(TimerId id) {
+    uint32_t index = static_cast<uint32_t>(id & kIndexMask);
+    uint32_t generation = static_cast<uint32_t>(id >> 32);
+    if (index >= timers_.size()) {
+        return false;
+    }
+
+    Timer& timer = timers_[index];
+    if (timer.generation != generation || timer.bucket == kFree) {
+        return false;
+    }
+
+    if (timer.bucket == kFiring) {
+        // Released once the running callback returns
+        if (timer.cancelled) {
+            return false;
+        }
+        timer.cancelled = true;
+        return timer.interval != 0;
+    }
+
+    Unlink(index);
+    Release(index);
+    --size_;
+    return true;
+}
+
+void TimerWheel::Cascade(int level) {
+    uint32_t slot = static_cast<uint32_t>(now_ >> (kSlotBits * level)) & kSlotMask;
+    uint32_t bucket = static_cast<uint32_t>(level) * kSlots + slot;
+
+    uint32_t index = heads_[bucket];
+    heads_[bucket] = kNone;
+    while (index != kNone) {
+        uint32_t next = timers_[index].next;
+        --level_counts_[level];
+        Link(index);
+        index = next;
+    }
+}
+
+size_t TimerWheel::FireSlot(uint32_t slot) {
+    size_t fired = 0;
+
+    // Callbacks may schedule or cancel timers; anything they add lands in a
+    // later slot, so this terminates
+    while (heads_[slot] != kNone) {
+        uint32_t index = heads_[slot];
+        Unlink(index);
+        timers_[index].bucket = kFiring;
+        TimerCallback callback = std::move(timers_[index].callback);
+
+        ++fired;
+        callback();
+
+        // The slab may have grown during the callback
+        Timer& timer = timers_[index];
+        if (timer.interval > 0 && !timer.cancelled) {
+            timer.callback = std::move(callback);
+            timer.expires = std::max(timer.expires + timer.interval, now_ + 1);
+            Link(index);
+        } else {
+            Release(index);
+            --size_;
+        }
+    }
+
+    return fired;
+}
+
+size_t TimerWheel::Advance(uint64_t now_ms) {
+    size_t fired = 0;
+
+    while (now_ < now_ms) {
+        if (size_ == 0) {
+            now_ = now_ms;
+            break;
+        }
+
+        if (level_counts_[0] == 0) {
+            // Nothing can fire before the next cascade point
+            uint64_t boundary = (now_ | kSlotMask) + 1;
+            if (boundary > now_ms) {
+                now_ = now_ms;
+                break;
+            }
+            now_ = boundary - 1;
+        }
+
+        ++now_;
+        if ((now_ & kSlotMask) == 0) {
+            // Pull the next range of each upper level down a level
+            for (int level = 1; level < kLevels; ++level) {
+                Cascade(level);
+                if (((now_ >> (kSlotBits * level)) & kSlotMask) != 0) {
+                    break;
+                }
+            }
+        }
+
+        fired += FireSlot(static_cast<uint32_t>(now_ & kSlotMask));
+    }
+
+    return fired;
+}
+
+int64_t TimerWheel::NextTimeoutMs(uint64_t now_ms) const {
+    if (size_ == 0) {
+        return -1;
+    }
+
+    uint64_t due = UINT64_MAX;
+    if (level_counts_[0] > 0) {
+        for (uint64_t tick = now_ + 1; tick < now_ + kSlots; ++tick) {
+            if (heads_[tick & kSlotMask] != kNone) {
+                due = tick;
+                break;
+            }
+        }
+    }
+    if (size_ > level_counts_[0]) {
+        // Upper-level timers are due no earlier than the next cascade
+        due = std::min(due, (now_ | kSlotMask) + 1);
+    }
+
+    return due > now_ms ? static_cast<int64_t>(due - now_ms) : 0;
+}
+
+} // namespace http
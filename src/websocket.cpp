@@ -120,8 +120,10 @@ std::string WebSocket::Base64Encode(const std::string& input) {
     const char base64_chars[] = 
         "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
     
+    // Only the low bits of val are used; unsigned, its high bits wrap away
     std::string result;
-    int val = 0, valb = -6;
+    unsigned int val = 0;
+    int valb = -6;
     
     for (unsigned char c : input) {
         val = (val << 8) + c;
@@ -0,0 +1,170 @@
+#include <gtest/gtest.h>
+#include "compression.hpp"
+#include <zlib.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+using namespace http;
+
+namespace {
+
+// Inflates a gzip or zlib stream (windowBits 15 + 32 detects either)
+std::string Inflate(const std::string& data) {
+    z_stream stream{};
+    EXPECT_EQ(inflateInit2(&stream, 15 + 32), Z_OK);
+    std::string out;
+    char buffer[4096];
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    int result = Z_OK;
+    while (result == Z_OK) {
+        stream.next_out = reinterpret_cast<Bytef*>(buffer);
+        stream.avail_out = sizeof(buffer);
+        result = inflate(&stream, Z_NO_FLUSH);
+        out.append(buffer, sizeof(buffer) - stream.avail_out);
+    }
+    inflateEnd(&stream);
+    EXPECT_EQ(result, Z_STREAM_END);
+    return out;
+}
+
+std::string MetricsJson(size_t samples) {
+    std::string json = "[";
+    for (size_t i = 0; i < samples; ++i) {
+        json += (i ? "," : "") + std::string("{\"timestamp\":") + std::to_string(1700000000 + i) +
+                ",\"cpu_usage\":12.5,\"memory_usage\":48.25,\"disk_usage\":71.0}";
+    }
+    return json + "]";
+}
+
+} // namespace
+
+TEST(CompressionTest, NegotiatesByQValue) {
+    EXPECT_EQ(NegotiateCoding(""), ContentCoding::Identity);
+    EXPECT_EQ(NegotiateCoding("br"), ContentCoding::Identity);
+    EXPECT_EQ(NegotiateCoding("gzip, deflate, br"), ContentCoding::Gzip);
+    EXPECT_EQ(NegotiateCoding("deflate"), ContentCoding::Deflate);
+    EXPECT_EQ(NegotiateCoding("gzip;q=0.5, deflate"), ContentCoding::Deflate);
+    EXPECT_EQ(NegotiateCoding("GZIP ; Q=0.8"), ContentCoding::Gzip);
+    EXPECT_EQ(NegotiateCoding("*"), ContentCoding::Gzip);
+    EXPECT_EQ(NegotiateCoding("*;q=0.3, gzip;q=0"), ContentCoding::Deflate);
+    EXPECT_EQ(NegotiateCoding("gzip;q=0, deflate;q=0"), ContentCoding::Identity);
+    EXPECT_EQ(NegotiateCoding("identity, *;q=0"), ContentCoding::Identity);
+}
+
+TEST(CompressionTest, GzipAndDeflateRoundTrip) {
+    std::string json = MetricsJson(3600);
+
+    std::string gzip = Compress(json, ContentCoding::Gzip, 6);
+    ASSERT_GE(gzip.size(), 2u);
+    EXPECT_EQ(static_cast<uint8_t>(gzip[0]), 0x1f);     // gzip magic
+    EXPECT_EQ(static_cast<uint8_t>(gzip[1]), 0x8b);
+    EXPECT_LT(gzip.size(), json.size() / 10);
+    EXPECT_EQ(Inflate(gzip), json);
+
+    std::string deflate = Compress(json, ContentCoding::Deflate, 1);
+    EXPECT_EQ(static_cast<uint8_t>(deflate[0]) & 0x0f, 8);   // zlib header: method 8 (deflate)
+    EXPECT_EQ(Inflate(deflate), json);
+
+    EXPECT_EQ(Compress("", ContentCoding::Gzip, 9).empty(), false);
+    EXPECT_EQ(Inflate(Compress("", ContentCoding::Gzip, 9)), "");
+    EXPECT_THROW(ResponseCompressor(10, 0, 0), std::invalid_argument);
+}
+
+TEST(CompressionTest, CompressesOnlyEligibleResponses) {
+    ResponseCompressor compressor(6, 256, 0);
+    std::string json = MetricsJson(100);
+
+    HttpResponse response = JsonResponse(json);
+    compressor.Apply("gzip, deflate", response);
+    EXPECT_EQ(response.GetHeader("content-encoding"), "gzip");
+    EXPECT_EQ(response.GetHeader("Vary"), "Accept-Encoding");
+    EXPECT_EQ(response.GetHeader("Content-Length"), std::to_string(response.GetBody().size()));
+    EXPECT_EQ(Inflate(response.GetBody()), json);
+
+    // Not accepted: unchanged, but caches learn it varies
+    HttpResponse plain = JsonResponse(json);
+    compressor.Apply("", plain);
+    EXPECT_EQ(plain.GetHeader("Content-Encoding"), "");
+    EXPECT_EQ(plain.GetHeader("Vary"), "Accept-Encoding");
+    EXPECT_EQ(plain.GetBody(), json);
+
+    // Too small, not text, no body, or encoded already
+    HttpResponse small = JsonResponse("{\"ok\":true}");
+    HttpResponse image = Ok(json);
+    image.SetContentType("image/png");
+    HttpResponse not_modified(HttpStatus::NOT_MODIFIED);
+    HttpResponse encoded = JsonResponse(json);
+    encoded.SetHeader("Content-Encoding", "br");
+    for (HttpResponse* skipped : {&small, &image, &not_modified, &encoded}) {
+        std::string before = skipped->SerializeHeaders();
+        compressor.Apply("gzip", *skipped);
+        EXPECT_EQ(skipped->SerializeHeaders(), before);
+    }
+    EXPECT_EQ(compressor.GetStats().compressed, 1u);
+}
+
+TEST(CompressionTest, SharedBodiesAreCompressedOnce) {
+    ResponseCompressor compressor(6, 0, 1024 * 1024);
+    auto page = std::make_shared<const std::string>(std::string(4096, 'a') + "<html></html>");
+    auto headers = std::make_shared<const std::string>(
+        "HTTP/1.1 200 OK\r\nServer: HighPerformanceServer/1.0\r\nContent-Type: text/html\r\n"
+        "Content-Length: 4109\r\nETag: \"1000-abc\"\r\n");
+
+    HttpResponse first = HttpResponse::Rendered(HttpStatus::OK, headers, page);
+    compressor.Apply("gzip", first);
+    HttpResponse second = HttpResponse::Rendered(HttpStatus::OK, headers, page);
+    compressor.Apply("gzip", second);
+    HttpResponse other_coding = HttpResponse::Rendered(HttpStatus::OK, headers, page);
+    compressor.Apply("deflate", other_coding);
+
+    ASSERT_NE(second.GetSharedBody(), nullptr);
+    EXPECT_EQ(first.GetSharedBody(), second.GetSharedBody());
+    EXPECT_NE(first.GetSharedBody(), other_coding.GetSharedBody());
+    EXPECT_EQ(Inflate(second.GetBody()), *page);
+    EXPECT_EQ(compressor.GetStats().compressed, 3u);
+    EXPECT_EQ(compressor.GetStats().cache_hits, 1u);
+
+    // The rendered headers were rebuilt: one Content-Length, the new one,
+    // and a weak ETag for the encoded bytes
+    std::string serialized = second.SerializeHeaders();
+    EXPECT_EQ(serialized.find("Content-Length"), serialized.rfind("Content-Length"));
+    EXPECT_EQ(second.GetHeader("Content-Length"), std::to_string(second.GetBody().size()));
+    EXPECT_EQ(second.GetHeader("ETag"), "W/\"1000-abc\"");
+    EXPECT_EQ(second.GetHeader("Content-Type"), "text/html");
+    EXPECT_EQ(serialized.compare(0, 15, "HTTP/1.1 200 OK"), 0);
+
+    EXPECT_GT(compressor.CachedBytes(), first.GetBody().size() + other_coding.GetBody().size());
+}
+
+TEST(CompressionTest, ReleasedBodiesLeaveTheCache) {
+    auto shared_text = [](char fill) {
+        HttpResponse response(HttpStatus::OK);
+        response.SetContentType("text/plain");
+        response.SetSharedBody(std::make_shared<const std::string>(std::string(8192, fill)));
+        return response;
+    };
+
+    // Room for about one encoded body at a time
+    ResponseCompressor compressor(6, 0, 200);
+    HttpResponse first = shared_text('a');
+    compressor.Apply("gzip", first);
+    size_t one = compressor.CachedBytes();
+    EXPECT_GT(one, 0u);
+    EXPECT_LE(one, 200u);
+
+    // Still held: a second body is compressed but not cached
+    HttpResponse second = shared_text('b');
+    compressor.Apply("gzip", second);
+    EXPECT_EQ(compressor.CachedBytes(), one);
+
+    // Released: its entry makes way
+    first = HttpResponse();
+    HttpResponse third = shared_text('c');
+    HttpResponse again = third;
+    compressor.Apply("gzip", third);
+    EXPECT_EQ(compressor.CachedBytes(), one);
+    compressor.Apply("gzip", again);
+    EXPECT_EQ(compressor.GetStats().cache_hits, 1u);
+}
@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+#include "connection_table.hpp"
+#include <string>
+#include <vector>
+
+using namespace http;
+
+namespace {
+
+struct TestState {
+    std::string input;
+    int requests = 0;
+};
+
+} // namespace
+
+TEST(ConnectionTableTest, OpenFindClose) {
+    ConnectionTable<TestState> table;
+    PeerAddress peer;
+
+    ConnectionId first = table.Open(7, peer);
+    ConnectionId second = table.Open(8, peer);
+    EXPECT_NE(first, 0u);
+    EXPECT_NE(first, second);
+    EXPECT_EQ(table.Size(), 2u);
+
+    auto* entry = table.Find(first);
+    ASSERT_NE(entry, nullptr);
+    EXPECT_EQ(entry->fd, 7);
+    entry->state.input = "GET /";
+
+    EXPECT_TRUE(table.Close(first));
+    EXPECT_FALSE(table.Close(first));
+    EXPECT_EQ(table.Find(first), nullptr);
+    EXPECT_EQ(table.Size(), 1u);
+    ASSERT_NE(table.Find(second), nullptr);
+    EXPECT_EQ(table.Find(second)->fd, 8);
+}
+
+TEST(ConnectionTableTest, ReusedSlotGetsNewGenerationAndFreshState) {
+    ConnectionTable<TestState> table;
+    PeerAddress peer;
+
+    ConnectionId old_id = table.Open(5, peer);
+    table.Find(old_id)->state.requests = 3;
+    table.Close(old_id);
+
+    // Same slot and even the same fd number, but a different connection
+    ConnectionId new_id = table.Open(5, peer);
+    EXPECT_NE(new_id, old_id);
+    EXPECT_EQ(table.Find(old_id), nullptr);
+    ASSERT_NE(table.Find(new_id), nullptr);
+    EXPECT_EQ(table.Find(new_id)->state.requests, 0);
+}
+
+TEST(ConnectionTableTest, ForEachVisitsOpenConnections) {
+    ConnectionTable<TestState> table;
+    PeerAddress peer;
+    ConnectionId a = table.Open(1, peer);
+    ConnectionId b = table.Open(2, peer);
+    ConnectionId c = table.Open(3, peer);
+    table.Close(b);
+
+    std::vector<ConnectionId> seen;
+    table.ForEach([&seen](ConnectionId id, ConnectionTable<TestState>::Entry& /*entry*/) {
+        seen.push_back(id);
+    });
+    EXPECT_EQ(seen, (std::vector<ConnectionId>{a, c}));
+    EXPECT_EQ(table.Find(0), nullptr);
+}
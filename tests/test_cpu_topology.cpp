@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+#include "cpu_topology.hpp"
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+using namespace http;
+
+class CpuTopologyTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ASSERT_NE(mkdtemp(directory_), nullptr);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(directory_);
+    }
+
+    void WriteFile(const std::filesystem::path& path, const std::string& contents) {
+        std::filesystem::create_directories(path.parent_path());
+        std::ofstream file(path);
+        file << contents;
+    }
+
+    void AddCpu(unsigned id, unsigned core, unsigned package, unsigned node) {
+        std::filesystem::path cpu = std::filesystem::path(directory_) / ("cpu" + std::to_string(id));
+        WriteFile(cpu / "topology" / "core_id", std::to_string(core) + "\n");
+        WriteFile(cpu / "topology" / "physical_package_id", std::to_string(package) + "\n");
+        std::filesystem::create_directories(cpu / ("node" + std::to_string(node)));
+    }
+
+    char directory_[32] = "/tmp/cpu_topology_XXXXXX";
+};
+
+TEST(CpuListTest, ParsesRangesAndSingles) {
+    EXPECT_EQ(ParseCpuList("0-3,8, 10-11\n"), (std::vector<unsigned>{0, 1, 2, 3, 8, 10, 11}));
+    EXPECT_EQ(ParseCpuList("5"), (std::vector<unsigned>{5}));
+    EXPECT_EQ(ParseCpuList("3,1,3"), (std::vector<unsigned>{1, 3}));
+    EXPECT_TRUE(ParseCpuList("").empty());
+    EXPECT_TRUE(ParseCpuList("\n").empty());
+
+    EXPECT_THROW(ParseCpuList("3-1"), std::invalid_argument);
+    EXPECT_THROW(ParseCpuList("a"), std::invalid_argument);
+    EXPECT_THROW(ParseCpuList("1-"), std::invalid_argument);
+    EXPECT_THROW(ParseCpuList("1,,2"), std::invalid_argument);
+}
+
+TEST_F(CpuTopologyTest, DiscoversNodesAndPlacesCoresBeforeSiblings) {
+    // Two sockets, one node each, enumerated alternately; CPUs 0 and 2 are
+    // hyperthreads of one core, as are 4 and 6 (and 1/3, 5/7 on node 1).
+    // CPU 8 exists but is offline.
+    WriteFile(std::filesystem::path(directory_) / "online", "0-7\n");
+    for (unsigned id = 0; id < 8; ++id) {
+        AddCpu(id, id / 4, id % 2, id % 2);
+    }
+    AddCpu(8, 2, 0, 0);
+
+    CpuTopology topology = CpuTopology::Discover(directory_);
+    ASSERT_EQ(topology.Cpus().size(), 8u);
+    EXPECT_EQ(topology.NodeCount(), 2u);
+    EXPECT_EQ(topology.NodeCpus(0), (std::vector<unsigned>{0, 2, 4, 6}));
+    EXPECT_EQ(topology.NodeCpus(1), (std::vector<unsigned>{1, 3, 5, 7}));
+    EXPECT_TRUE(topology.NodeCpus(2).empty());
+
+    // Node by node, one hyperthread per core first
+    EXPECT_EQ(topology.PlacementOrder(), (std::vector<unsigned>{0, 4, 2, 6, 1, 5, 3, 7}));
+    EXPECT_EQ(topology.PlacementOrder({7, 6, 5, 4, 8}), (std::vector<unsigned>{4, 6, 5, 7}));
+    EXPECT_EQ(topology.PlacementOrder({2, 6}), (std::vector<unsigned>{2, 6}));
+}
+
+TEST_F(CpuTopologyTest, FallsBackWithoutSysfs) {
+    CpuTopology topology = CpuTopology::Discover(std::string(directory_) + "/missing");
+    unsigned expected = std::max(1u, std::thread::hardware_concurrency());
+    ASSERT_EQ(topology.Cpus().size(), expected);
+    EXPECT_EQ(topology.NodeCount(), 1u);
+    EXPECT_EQ(topology.PlacementOrder().front(), 0u);
+}
+
+#if defined(__linux__)
+TEST(ThreadPlacementTest, NamesAndPinsTheCallingThread) {
+    cpu_set_t allowed;
+    ASSERT_EQ(sched_getaffinity(0, sizeof(allowed), &allowed), 0);
+    unsigned target = 0;
+    while (!CPU_ISSET(target, &allowed)) {
+        ++target;
+    }
+
+    char name[16] = {};
+    int cpu = -1;
+    bool pinned = false;
+    std::thread thread([&]() {
+        SetCurrentThreadName("monitord-wk-123456");
+        pthread_getname_np(pthread_self(), name, sizeof(name));
+        pinned = PinCurrentThread({target});
+        cpu = sched_getcpu();
+    });
+    thread.join();
+
+    EXPECT_STREQ(name, "monitord-wk-123");
+    ASSERT_TRUE(pinned);
+    EXPECT_EQ(cpu, static_cast<int>(target));
+    EXPECT_FALSE(PinCurrentThread({}));
+}
+#endif
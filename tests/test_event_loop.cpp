@@ -0,0 +1,882 @@
+#include <gtest/gtest.h>
+#include "event_loop.hpp"
+#include "poller.hpp"
+#include <stdexcept>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <map>
+#include <atomic>
+#include <errno.h>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+using namespace http;
+
+class EventLoopTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ASSERT_EQ(pipe(pipe_a_), 0);
+        ASSERT_EQ(pipe(pipe_b_), 0);
+    }
+
+    void TearDown() override {
+        close(pipe_a_[0]);
+        close(pipe_a_[1]);
+        close(pipe_b_[0]);
+        close(pipe_b_[1]);
+    }
+
+    int pipe_a_[2];
+    int pipe_b_[2];
+};
+
+TEST_F(EventLoopTest, BackendName) {
+    EventLoop loop;
+    std::string name = loop.BackendName();
+    EXPECT_TRUE(name == "kqueue" || name == "epoll");
+}
+
+TEST_F(EventLoopTest, LevelTriggeredReadFiresUntilDrained) {
+    EventLoop loop;
+    int calls = 0;
+
+    loop.RegisterRead(pipe_a_[0], [&](int fd, EventType type) {
+        EXPECT_EQ(fd, pipe_a_[0]);
+        EXPECT_EQ(type, EventType::Read);
+        if (++calls == 3) {
+            loop.Stop();
+        }
+    });
+
+    ASSERT_EQ(write(pipe_a_[1], "x", 1), 1);
+    loop.Run();
+
+    EXPECT_EQ(calls, 3);
+}
+
+TEST_F(EventLoopTest, EdgeTriggeredReadFiresOncePerChange) {
+    EventLoop loop;
+    int edge_calls = 0;
+    int level_calls = 0;
+
+    loop.RegisterRead(pipe_a_[0], [&](int, EventType) {
+        ++edge_calls;
+    }, TriggerMode::Edge);
+
+    // Level-triggered fd used as a ticker to drive a few loop iterations
+    loop.RegisterRead(pipe_b_[0], [&](int, EventType) {
+        if (++level_calls == 5) {
+            loop.Stop();
+        }
+    });
+
+    ASSERT_EQ(write(pipe_a_[1], "x", 1), 1);
+    ASSERT_EQ(write(pipe_b_[1], "x", 1), 1);
+    loop.Run();
+
+    EXPECT_EQ(edge_calls, 1);
+    EXPECT_EQ(level_calls, 5);
+}
+
+TEST_F(EventLoopTest, OneShotFiresOnceUntilRearmed) {
+    EventLoop loop;
+    int reads = 0;
+    int ticks = 0;
+
+    loop.RegisterRead(pipe_a_[0], [&](int, EventType) {
+        ++reads;   // Never drained, so a level-triggered read would refire
+    }, TriggerMode::OneShot);
+    ASSERT_EQ(write(pipe_a_[1], "x", 1), 1);
+
+    TimerId ticker = 0;
+    ticker = loop.RunEvery(std::chrono::milliseconds(5), [&]() {
+        ++ticks;
+        if (ticks == 4) {
+            EXPECT_EQ(reads, 1);
+            loop.Rearm(pipe_a_[0]);
+        } else if (ticks == 8) {
+            loop.CancelTimer(ticker);
+            loop.Stop();
+        }
+    });
+    loop.Run();
+
+    EXPECT_EQ(reads, 2);
+    loop.Unregister(pipe_a_[0]);
+}
+
+TEST_F(EventLoopTest, OneShotCanBeReregistered) {
+    EventLoop loop;
+    int first = 0;
+    int second = 0;
+
+    loop.RegisterRead(pipe_a_[0], [&](int fd, EventType) {
+        ++first;
+        loop.Unregister(fd);
+        loop.RegisterRead(fd, [&](int fd, EventType) {
+            char c;
+            EXPECT_EQ(read(fd, &c, 1), 1);
+            ++second;
+            loop.Unregister(fd);
+            loop.Stop();
+        }, TriggerMode::OneShot);
+    }, TriggerMode::OneShot);
+
+    ASSERT_EQ(write(pipe_a_[1], "x", 1), 1);
+    loop.Run();
+
+    EXPECT_EQ(first, 1);
+    EXPECT_EQ(second, 1);
+}
+
+TEST_F(EventLoopTest, UnregisterStopsCallbacks) {
+    EventLoop loop;
+    int unregistered_calls = 0;
+    int ticker_calls = 0;
+
+    loop.RegisterRead(pipe_a_[0], [&](int, EventType) {
+        ++unregistered_calls;
+    });
+    loop.Unregister(pipe_a_[0]);
+
+    loop.RegisterRead(pipe_b_[0], [&](int, EventType) {
+        if (++ticker_calls == 3) {
+            loop.Stop();
+        }
+    });
+
+    ASSERT_EQ(write(pipe_a_[1], "x", 1), 1);
+    ASSERT_EQ(write(pipe_b_[1], "x", 1), 1);
+    loop.Run();
+
+    EXPECT_EQ(unregistered_calls, 0);
+}
+
+TEST_F(EventLoopTest, ReregisterFromOwnCallback) {
+    EventLoop loop;
+    std::vector<std::string> seen;
+    const std::string first_label = "first handler";
+
+    // Unregistering and re-registering the same fd must not disturb the
+    // closure that is still running
+    loop.RegisterRead(pipe_a_[0], [&loop, &seen, first_label](int fd, EventType) {
+        loop.Unregister(fd);
+        loop.RegisterRead(fd, [&loop, &seen](int fd, EventType) {
+            char c;
+            EXPECT_EQ(read(fd, &c, 1), 1);
+            seen.push_back("second handler");
+            loop.Unregister(fd);
+            loop.Stop();
+        });
+        seen.push_back(first_label);
+    });
+
+    // Unregistering another fd from a callback drops its pending event
+    int stale_calls = 0;
+    loop.RegisterRead(pipe_b_[0], [&](int, EventType) {
+        ++stale_calls;
+        loop.Unregister(pipe_a_[0]);
+        loop.Unregister(pipe_b_[0]);
+        loop.Stop();
+    });
+    loop.Unregister(pipe_b_[0]);
+
+    ASSERT_EQ(write(pipe_a_[1], "x", 1), 1);
+    loop.Run();
+
+    EXPECT_EQ(seen, (std::vector<std::string>{"first handler", "second handler"}));
+    EXPECT_EQ(stale_calls, 0);
+}
+
+TEST_F(EventLoopTest, WriteReadiness) {
+    EventLoop loop;
+    bool writable = false;
+
+    loop.RegisterWrite(pipe_a_[1], [&](int fd, EventType type) {
+        EXPECT_EQ(fd, pipe_a_[1]);
+        EXPECT_EQ(type, EventType::Write);
+        writable = true;
+        loop.Stop();
+    });
+
+    loop.Run();
+    loop.Unregister(pipe_a_[1]);
+
+    EXPECT_TRUE(writable);
+}
+
+TEST_F(EventLoopTest, RunAfterFiresOnce) {
+    EventLoop loop;
+    int fired = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    loop.RunAfter(std::chrono::milliseconds(20), [&]() {
+        ++fired;
+        loop.Stop();
+    });
+    loop.Run();
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_EQ(fired, 1);
+    EXPECT_GE(elapsed, std::chrono::milliseconds(20));
+    EXPECT_EQ(loop.TimerCount(), 0u);
+}
+
+TEST_F(EventLoopTest, RunEveryRepeatsUntilCancelled) {
+    EventLoop loop;
+    int ticks = 0;
+    TimerId ticker = 0;
+
+    ticker = loop.RunEvery(std::chrono::milliseconds(5), [&]() {
+        if (++ticks == 3) {
+            loop.CancelTimer(ticker);
+            loop.RunAfter(std::chrono::milliseconds(20), [&]() { loop.Stop(); });
+        }
+    });
+    loop.Run();
+
+    EXPECT_EQ(ticks, 3);
+}
+
+TEST_F(EventLoopTest, CancelledTimerDoesNotFire) {
+    EventLoop loop;
+    bool fired = false;
+
+    TimerId id = loop.RunAfter(std::chrono::milliseconds(5), [&]() { fired = true; });
+    EXPECT_TRUE(loop.CancelTimer(id));
+    loop.RunAfter(std::chrono::milliseconds(20), [&]() { loop.Stop(); });
+    loop.Run();
+
+    EXPECT_FALSE(fired);
+}
+
+TEST_F(EventLoopTest, RunInLoopRunsInlineOnLoopThread) {
+    EventLoop loop;
+    std::vector<int> order;
+
+    EXPECT_FALSE(loop.IsInLoopThread());
+    loop.Post([&]() {
+        EXPECT_TRUE(loop.IsInLoopThread());
+        loop.Post([&]() {
+            order.push_back(3);
+            loop.Stop();
+        });
+        loop.RunInLoop([&]() { order.push_back(1); });
+        order.push_back(2);
+    });
+    loop.Run();
+
+    EXPECT_EQ(order, (std::vector<int>{1, 2, 3}));
+    EXPECT_FALSE(loop.IsInLoopThread());
+}
+
+TEST_F(EventLoopTest, BusyPollSpinsBeforeBlocking) {
+    EventLoop loop;
+    loop.SetBusyPoll(std::chrono::milliseconds(50));
+    int reads = 0;
+
+    loop.RegisterRead(pipe_a_[0], [&](int fd, EventType) {
+        char c;
+        EXPECT_EQ(read(fd, &c, 1), 1);
+        ++reads;
+        loop.Stop();
+    });
+    // Becomes readable while the next wait is spinning
+    std::thread writer([this]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        EXPECT_EQ(write(pipe_a_[1], "x", 1), 1);
+    });
+    loop.Run();
+    writer.join();
+
+    EventLoopStats stats = loop.Stats();
+    EXPECT_EQ(reads, 1);
+    EXPECT_GE(stats.spin_polls, 1u);
+    EXPECT_GE(stats.spin_hits, 1u);
+    EXPECT_GT(stats.SpinHitRatio(), 0.0);
+    EXPECT_GT(stats.spin_ns, 0u);
+    EXPECT_GE(stats.events, 1u);
+    loop.Unregister(pipe_a_[0]);
+}
+
+TEST_F(EventLoopTest, BlockingWaitsWithoutBusyPoll) {
+    EventLoop loop;
+    loop.RunAfter(std::chrono::milliseconds(10), [&]() { loop.Stop(); });
+    loop.Run();
+
+    EventLoopStats stats = loop.Stats();
+    EXPECT_EQ(stats.spin_polls, 0u);
+    EXPECT_GE(stats.blocking_waits, 1u);
+    EXPECT_GT(stats.blocked_ns, 0u);
+}
+
+TEST_F(EventLoopTest, BatchSizeGrowsWhenFull) {
+    EventLoop loop;
+    constexpr int kPipes = 150;
+    std::vector<std::pair<int, int>> pipes;
+    int reads = 0;
+
+    size_t initial = loop.Stats().batch_size;
+    for (int i = 0; i < kPipes; ++i) {
+        int fds[2];
+        ASSERT_EQ(pipe(fds), 0);
+        pipes.emplace_back(fds[0], fds[1]);
+        ASSERT_EQ(write(fds[1], "x", 1), 1);
+        // Level-triggered and never drained: every wait sees all of them
+        loop.RegisterRead(fds[0], [&](int, EventType) { ++reads; });
+    }
+
+    loop.RunAfter(std::chrono::milliseconds(20), [&]() { loop.Stop(); });
+    loop.Run();
+
+    EXPECT_GT(loop.Stats().batch_size, initial);
+    EXPECT_GE(loop.Stats().batch_size, static_cast<size_t>(kPipes));
+    EXPECT_GT(reads, kPipes);
+
+    for (auto& [read_fd, write_fd] : pipes) {
+        loop.Unregister(read_fd);
+        close(read_fd);
+        close(write_fd);
+    }
+}
+
+namespace {
+
+// Returns one readiness event per Poll() and holds the rest, as kqueue does
+// with events beyond max_events; each keeps the udata its fd had when it
+// was made ready
+class HoldingPoller final : public Poller {
+public:
+    void Update(int fd, uint32_t, uint32_t new_interest, void* udata) override {
+        udata_[fd] = new_interest != 0 ? udata : nullptr;
+    }
+    int Poll(PollEvent* out, int, int) override {
+        if (held_.empty()) {
+            return 0;
+        }
+        out[0] = held_.front();
+        held_.pop_front();
+        return 1;
+    }
+    const char* Name() const override { return "holding"; }
+    void Wakeup() override {}
+    bool HasPendingEvents() const override { return !held_.empty(); }
+
+    void Ready(int fd) {
+        PollEvent event{};
+        event.fd = -1;
+        event.events = kPollReadable;
+        event.udata = udata_.at(fd);
+        held_.push_back(event);
+    }
+
+private:
+    std::map<int, void*> udata_;
+    std::deque<PollEvent> held_;
+};
+
+// Keeps one registration per filter, planned as the kqueue backend plans
+// its changes, and disarms only the filter that fires, as kqueue does
+class FilterPoller final : public Poller {
+public:
+    void Update(int fd, uint32_t old_interest, uint32_t new_interest, void* udata) override {
+        FilterChanges plan = PlanFilterChanges(old_interest, new_interest);
+        for (uint32_t filter : {kPollReadable, kPollWritable}) {
+            if (plan.add & filter) {
+                filters_[fd][filter] = Filter{udata, (new_interest & kPollOneShot) != 0};
+            } else if (plan.remove & filter) {
+                filters_[fd].erase(filter);
+            }
+        }
+    }
+    int Poll(PollEvent* out, int, int) override {
+        if (ready_.empty()) {
+            return 0;
+        }
+        auto [fd, filter] = ready_.front();
+        ready_.pop_front();
+        auto it = filters_[fd].find(filter);
+        if (it == filters_[fd].end()) {
+            return 0;
+        }
+        out[0] = PollEvent{};
+        out[0].fd = -1;
+        out[0].events = filter;
+        out[0].udata = it->second.udata;
+        if (it->second.one_shot) {
+            filters_[fd].erase(it);
+        }
+        return 1;
+    }
+    const char* Name() const override { return "filter"; }
+    void Wakeup() override {}
+
+    void Ready(int fd, uint32_t filter) { ready_.emplace_back(fd, filter); }
+    // Filters still registered for fd, each holding the udata it was given
+    uint32_t Registered(int fd) const {
+        uint32_t registered = 0;
+        if (auto it = filters_.find(fd); it != filters_.end()) {
+            for (const auto& entry : it->second) {
+                registered |= entry.first;
+            }
+        }
+        return registered;
+    }
+
+private:
+    struct Filter {
+        void* udata;
+        bool one_shot;
+    };
+    std::map<int, std::map<uint32_t, Filter>> filters_;
+    std::deque<std::pair<int, uint32_t>> ready_;
+};
+
+} // namespace
+
+TEST(EventLoopPollerTest, FiredOneShotLeavesNoFilterBehind) {
+    auto owned = std::make_unique<FilterPoller>();
+    FilterPoller* poller = owned.get();
+    EventLoop loop(std::move(owned));
+
+    // Both directions one-shot; only one fires on each fd
+    int reads = 0;
+    int writes = 0;
+    for (int fd : {20, 21}) {
+        loop.RegisterRead(fd, [&](int, EventType) { ++reads; }, TriggerMode::OneShot);
+        loop.RegisterWrite(fd, [&](int, EventType) { ++writes; }, TriggerMode::OneShot);
+    }
+    poller->Ready(20, kPollReadable);
+    poller->Ready(21, kPollWritable);
+    loop.RunAfter(std::chrono::milliseconds(5), [&]() { loop.Stop(); });
+    loop.Run();
+    EXPECT_EQ(reads, 1);
+    EXPECT_EQ(writes, 1);
+    EXPECT_EQ(poller->Registered(20), static_cast<uint32_t>(kPollWritable));
+
+    // The filter that did not fire must not outlive the registration, or
+    // its udata would name a recycled record
+    loop.Unregister(20);
+    EXPECT_EQ(poller->Registered(20), 0u);
+
+    // Re-registering one direction drops the other
+    loop.RegisterWrite(21, [&](int, EventType) { ++writes; }, TriggerMode::OneShot);
+    EXPECT_EQ(poller->Registered(21), static_cast<uint32_t>(kPollWritable));
+    loop.Unregister(21);
+    EXPECT_EQ(poller->Registered(21), 0u);
+}
+
+TEST(EventLoopPollerTest, HeldEventsNeverReachARecycledRecord) {
+    auto owned = std::make_unique<HoldingPoller>();
+    HoldingPoller* poller = owned.get();
+    EventLoop loop(std::move(owned));
+
+    // Fds are only names here: nothing reaches the kernel
+    std::vector<std::string> calls;
+    int a_calls = 0;
+    loop.RegisterRead(10, [&](int, EventType) {
+        calls.push_back("a");
+        if (++a_calls == 1) {
+            loop.Unregister(11);
+        } else {
+            loop.RegisterRead(12, [&](int, EventType) { calls.push_back("c"); });
+        }
+    });
+    loop.RegisterRead(11, [&](int, EventType) { calls.push_back("b"); });
+
+    // 11's event is still held when 10's first callback retires its record
+    // and when the second registers 12
+    poller->Ready(10);
+    poller->Ready(10);
+    poller->Ready(11);
+
+    loop.RunAfter(std::chrono::milliseconds(5), [&]() { loop.Stop(); });
+    loop.Run();
+
+    EXPECT_EQ(calls, (std::vector<std::string>{"a", "a"}));
+    EXPECT_FALSE(poller->HasPendingEvents());
+}
+
+TEST(EventBackendTest, ParseEventBackend) {
+    EXPECT_EQ(ParseEventBackend("auto"), EventBackend::Default);
+    EXPECT_EQ(ParseEventBackend(""), EventBackend::Default);
+    EXPECT_EQ(ParseEventBackend("epoll"), EventBackend::Epoll);
+    EXPECT_EQ(ParseEventBackend("kqueue"), EventBackend::Kqueue);
+    EXPECT_EQ(ParseEventBackend("io_uring"), EventBackend::IoUring);
+    EXPECT_THROW(ParseEventBackend("select"), std::invalid_argument);
+}
+
+// Completion-style I/O runs on every backend; io_uring falls back to the
+// readiness backend when the kernel does not support it
+class EventLoopIoTest : public ::testing::TestWithParam<EventBackend> {
+protected:
+    void SetUp() override {
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets_), 0);
+        fcntl(sockets_[0], F_SETFL, fcntl(sockets_[0], F_GETFL, 0) | O_NONBLOCK);
+    }
+
+    void TearDown() override {
+        close(sockets_[0]);
+        close(sockets_[1]);
+    }
+
+    int sockets_[2];
+};
+
+TEST_P(EventLoopIoTest, AcceptDeliversClients) {
+    EventLoop loop(GetParam());
+
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_GE(listen_fd, 0);
+    struct sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(bind(listen_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)), 0);
+    ASSERT_EQ(listen(listen_fd, 16), 0);
+    socklen_t addr_len = sizeof(addr);
+    ASSERT_EQ(getsockname(listen_fd, reinterpret_cast<struct sockaddr*>(&addr), &addr_len), 0);
+    fcntl(listen_fd, F_SETFL, fcntl(listen_fd, F_GETFL, 0) | O_NONBLOCK);
+
+    constexpr int kClients = 3;
+    int clients[kClients];
+    for (int i = 0; i < kClients; ++i) {
+        clients[i] = socket(AF_INET, SOCK_STREAM, 0);
+        ASSERT_EQ(connect(clients[i], reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)), 0);
+    }
+
+    std::vector<int> accepted;
+    std::vector<std::string> peers;
+    loop.Accept(listen_fd, [&](int client_fd, const PeerAddress& peer) {
+        accepted.push_back(client_fd);
+        peers.push_back(peer.Host());
+        if (accepted.size() == kClients) {
+            loop.Stop();
+        }
+    });
+    loop.Run();
+    loop.Unregister(listen_fd);
+
+    ASSERT_EQ(accepted.size(), static_cast<size_t>(kClients));
+    for (int fd : accepted) {
+        EXPECT_TRUE(fcntl(fd, F_GETFL, 0) & O_NONBLOCK);
+        close(fd);
+    }
+    for (const std::string& peer : peers) {
+        EXPECT_EQ(peer, "127.0.0.1");
+    }
+    for (int fd : clients) {
+        close(fd);
+    }
+    close(listen_fd);
+}
+
+TEST_P(EventLoopIoTest, ReceiveDeliversDataThenClose) {
+    EventLoop loop(GetParam());
+    std::string received;
+    bool closed = false;
+
+    loop.Receive(sockets_[0], [&](int fd, const char* data, ssize_t size) {
+        EXPECT_EQ(fd, sockets_[0]);
+        if (size > 0) {
+            received.append(data, static_cast<size_t>(size));
+        } else {
+            closed = (size == 0);
+            loop.Stop();
+        }
+    });
+
+    ASSERT_EQ(write(sockets_[1], "hello ", 6), 6);
+    ASSERT_EQ(write(sockets_[1], "world", 5), 5);
+    shutdown(sockets_[1], SHUT_WR);
+    loop.Run();
+    loop.Unregister(sockets_[0]);
+
+    EXPECT_EQ(received, "hello world");
+    EXPECT_TRUE(closed);
+}
+
+TEST_P(EventLoopIoTest, ReceiveStopsAfterReadError) {
+    EventLoop loop(GetParam());
+
+    // A listening socket with a connection waiting stays readable, but
+    // reading it fails every time
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_GE(listen_fd, 0);
+    struct sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(bind(listen_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)), 0);
+    ASSERT_EQ(listen(listen_fd, 16), 0);
+    socklen_t addr_len = sizeof(addr);
+    ASSERT_EQ(getsockname(listen_fd, reinterpret_cast<struct sockaddr*>(&addr), &addr_len), 0);
+    fcntl(listen_fd, F_SETFL, fcntl(listen_fd, F_GETFL, 0) | O_NONBLOCK);
+    int client = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_EQ(connect(client, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)), 0);
+
+    std::vector<ssize_t> results;
+    loop.Receive(listen_fd, [&](int, const char*, ssize_t size) {
+        results.push_back(size);
+    });
+    loop.RunAfter(std::chrono::milliseconds(20), [&]() { loop.Stop(); });
+    loop.Run();
+    loop.Unregister(listen_fd);
+    close(client);
+    close(listen_fd);
+
+    ASSERT_EQ(results.size(), 1u);
+    EXPECT_LT(results[0], 0);
+}
+
+TEST_P(EventLoopIoTest, SendDeliversEveryByteInOrder) {
+    EventLoop loop(GetParam());
+
+    // Larger than the socket buffer so sends have to wait for the reader
+    const std::string first(1 << 20, 'a');
+    const std::string second(1 << 19, 'b');
+    std::string peer_data;
+    std::thread reader([&]() {
+        char buffer[65536];
+        ssize_t n;
+        while ((n = read(sockets_[1], buffer, sizeof(buffer))) > 0) {
+            peer_data.append(buffer, static_cast<size_t>(n));
+        }
+    });
+
+    // Sent from the loop: a reader fast enough to take everything at once
+    // would otherwise have Stop() run before Run(), which then never returns
+    ssize_t first_result = 0;
+    ssize_t second_result = 0;
+    loop.Post([&]() {
+        loop.Send(sockets_[0], first, [&](int, ssize_t result) {
+            first_result = result;
+        });
+        loop.Send(sockets_[0], second, [&](int, ssize_t result) {
+            second_result = result;
+            loop.Stop();
+        });
+    });
+    loop.Run();
+    loop.Unregister(sockets_[0]);
+    shutdown(sockets_[0], SHUT_WR);
+    reader.join();
+
+    EXPECT_EQ(first_result, static_cast<ssize_t>(first.size()));
+    EXPECT_EQ(second_result, static_cast<ssize_t>(second.size()));
+    EXPECT_EQ(peer_data, first + second);
+}
+
+TEST_P(EventLoopIoTest, GatherSendsKeepHeadAndBodyInOrder) {
+    EventLoop loop(GetParam());
+
+    // The large body forces partial writes that end mid-segment
+    const std::string body(1 << 20, 'b');
+    std::string peer_data;
+    std::thread reader([&]() {
+        char buffer[65536];
+        ssize_t n;
+        while ((n = read(sockets_[1], buffer, sizeof(buffer))) > 0) {
+            peer_data.append(buffer, static_cast<size_t>(n));
+        }
+    });
+
+    // Queued from the loop, so that sends finishing at once cannot stop it
+    // before it runs
+    std::vector<ssize_t> results;
+    auto record = [&](int, ssize_t result) {
+        results.push_back(result);
+    };
+    loop.Post([&]() {
+        loop.Send(sockets_[0], "head1|", body, record, true);
+        loop.Send(sockets_[0], "head2|", "", record, true);
+        loop.Send(sockets_[0], "", "body3|", record);
+        loop.Send(sockets_[0], "plain4", [&](int, ssize_t result) {
+            results.push_back(result);
+            loop.Stop();
+        });
+    });
+    loop.Run();
+    loop.Unregister(sockets_[0]);
+    shutdown(sockets_[0], SHUT_WR);
+    reader.join();
+
+    EXPECT_EQ(results, (std::vector<ssize_t>{static_cast<ssize_t>(6 + body.size()), 6, 6, 6}));
+    EXPECT_EQ(peer_data, "head1|" + body + "head2|body3|plain4");
+}
+
+TEST_P(EventLoopIoTest, SendFileStreamsFileAfterHead) {
+    EventLoop loop(GetParam());
+
+    // Larger than the socket buffer so sendfile has to wait for the reader
+    char path[] = "/tmp/event_loop_sendfile_XXXXXX";
+    int file_fd = mkstemp(path);
+    ASSERT_GE(file_fd, 0);
+    std::string contents;
+    for (int i = 0; contents.size() < (2u << 20); ++i) {
+        contents += std::to_string(i) + ",";
+    }
+    ASSERT_EQ(write(file_fd, contents.data(), contents.size()), static_cast<ssize_t>(contents.size()));
+    close(file_fd);
+    std::shared_ptr<FileBody> file = FileBody::Open(path);
+    unlink(path);
+
+    std::string peer_data;
+    std::thread reader([&]() {
+        char buffer[65536];
+        ssize_t n;
+        while ((n = read(sockets_[1], buffer, sizeof(buffer))) > 0) {
+            peer_data.append(buffer, static_cast<size_t>(n));
+        }
+    });
+
+    // Started by the loop, or a file sent in full before Run() would have
+    // already called Stop()
+    std::vector<ssize_t> results;
+    loop.Post([&]() {
+        loop.SendFile(sockets_[0], "head|", file, [&](int, ssize_t result) {
+            results.push_back(result);
+        });
+        loop.Send(sockets_[0], "|tail", [&](int, ssize_t result) {
+            results.push_back(result);
+            loop.Stop();
+        });
+    });
+    loop.Run();
+    loop.Unregister(sockets_[0]);
+    shutdown(sockets_[0], SHUT_WR);
+    reader.join();
+
+    EXPECT_EQ(results, (std::vector<ssize_t>{static_cast<ssize_t>(5 + contents.size()), 5}));
+    EXPECT_EQ(peer_data, "head|" + contents + "|tail");
+}
+
+TEST_P(EventLoopIoTest, SendRefusedAboveHighWaterMark) {
+    EventLoop loop(GetParam());
+    loop.SetSendHighWaterMark(64 * 1024);
+
+    // Nobody reads yet, so most of this stays queued; it is still accepted
+    // because the queue was empty
+    const std::string large(1 << 20, 'a');
+    ssize_t large_result = 0;
+    loop.Send(sockets_[0], large, [&](int, ssize_t result) {
+        large_result = result;
+        loop.Stop();
+    });
+    EXPECT_GT(loop.PendingSendBytes(sockets_[0]), 64u * 1024);
+
+    ssize_t refused_result = 0;
+    loop.Send(sockets_[0], "more", [&](int, ssize_t result) {
+        refused_result = result;
+    });
+    EXPECT_EQ(refused_result, -ENOBUFS);
+
+    std::string peer_data;
+    std::thread reader([&]() {
+        char buffer[65536];
+        ssize_t n;
+        while ((n = read(sockets_[1], buffer, sizeof(buffer))) > 0) {
+            peer_data.append(buffer, static_cast<size_t>(n));
+        }
+    });
+    loop.Run();
+    EXPECT_EQ(loop.PendingSendBytes(sockets_[0]), 0u);
+    loop.Unregister(sockets_[0]);
+    shutdown(sockets_[0], SHUT_WR);
+    reader.join();
+
+    EXPECT_EQ(large_result, static_cast<ssize_t>(large.size()));
+    EXPECT_EQ(peer_data, large);
+}
+
+TEST_P(EventLoopIoTest, PostWakesBlockedLoop) {
+    EventLoop loop(GetParam());
+    std::atomic<bool> ran{false};
+
+    std::thread loop_thread([&loop]() { loop.Run(); });
+    // No timers or fds registered: the loop sleeps until woken
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    auto start = std::chrono::steady_clock::now();
+    loop.Post([&ran]() { ran = true; });
+    while (!ran && std::chrono::steady_clock::now() - start < std::chrono::seconds(5)) {
+        std::this_thread::yield();
+    }
+    EXPECT_TRUE(ran);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+
+    start = std::chrono::steady_clock::now();
+    loop.Stop();
+    loop_thread.join();
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+}
+
+TEST_P(EventLoopIoTest, PostFromManyThreadsKeepsPerThreadOrder) {
+    EventLoop loop(GetParam());
+    constexpr int kProducers = 4;
+    constexpr int kTasksPerProducer = 2000;
+    std::vector<int> last_seen(kProducers, -1);
+    int total = 0;
+    bool in_order = true;
+
+    std::thread loop_thread([&loop]() { loop.Run(); });
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; ++p) {
+        producers.emplace_back([&, p]() {
+            for (int i = 0; i < kTasksPerProducer; ++i) {
+                loop.Post([&, p, i]() {
+                    // Runs on the loop thread only, so no locking needed
+                    in_order = in_order && (last_seen[p] == i - 1);
+                    last_seen[p] = i;
+                    if (++total == kProducers * kTasksPerProducer) {
+                        loop.Stop();
+                    }
+                });
+            }
+        });
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    loop_thread.join();
+
+    EXPECT_EQ(total, kProducers * kTasksPerProducer);
+    EXPECT_TRUE(in_order);
+}
+
+TEST_P(EventLoopIoTest, PostedSendRunsOnLoopThread) {
+    EventLoop loop(GetParam());
+    std::atomic<bool> sent{false};
+
+    std::thread loop_thread([&loop]() { loop.Run(); });
+    std::thread worker([&]() {
+        int fd = sockets_[0];
+        loop.Post([&loop, &sent, fd]() {
+            loop.Send(fd, "from worker", [&loop, &sent](int fd, ssize_t result) {
+                EXPECT_EQ(result, 11);
+                sent = true;
+                loop.Unregister(fd);
+                loop.Stop();
+            });
+        });
+    });
+    worker.join();
+
+    char buffer[32] = {};
+    ssize_t n = read(sockets_[1], buffer, sizeof(buffer));
+    loop_thread.join();
+
+    EXPECT_TRUE(sent);
+    EXPECT_EQ(std::string(buffer, n > 0 ? static_cast<size_t>(n) : 0), "from worker");
+}
+
+INSTANTIATE_TEST_SUITE_P(Backends, EventLoopIoTest,
+                         ::testing::Values(EventBackend::Default, EventBackend::IoUring),
+                         [](const ::testing::TestParamInfo<EventBackend>& info) {
+                             return info.param == EventBackend::IoUring ? "IoUring" : "Default";
+                         });
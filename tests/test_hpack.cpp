@@ -0,0 +1,149 @@
+#include <gtest/gtest.h>
+#include "hpack.hpp"
+#include <stdexcept>
+#include <string>
+
+using namespace http;
+
+namespace {
+
+std::string FromHex(const std::string& hex) {
+    std::string bytes;
+    for (size_t i = 0; i + 1 < hex.size(); i += 2) {
+        bytes.push_back(static_cast<char>(std::stoi(hex.substr(i, 2), nullptr, 16)));
+    }
+    return bytes;
+}
+
+std::string ToHex(const std::string& bytes) {
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+    for (unsigned char c : bytes) {
+        hex.push_back(digits[c >> 4]);
+        hex.push_back(digits[c & 0xf]);
+    }
+    return hex;
+}
+
+} // namespace
+
+// RFC 7541 C.1
+TEST(HpackTest, IntegerEncoding) {
+    std::string out;
+    HpackEncoder::EncodeInteger(10, 5, 0, out);
+    EXPECT_EQ(ToHex(out), "0a");
+
+    out.clear();
+    HpackEncoder::EncodeInteger(1337, 5, 0, out);
+    EXPECT_EQ(ToHex(out), "1f9a0a");
+
+    out.clear();
+    HpackEncoder::EncodeInteger(42, 8, 0, out);
+    EXPECT_EQ(ToHex(out), "2a");
+}
+
+// RFC 7541 C.4 and C.6 string literals
+TEST(HpackTest, HuffmanMatchesRfcExamples) {
+    const std::pair<std::string, std::string> examples[] = {
+        {"www.example.com", "f1e3c2e5f23a6ba0ab90f4ff"},
+        {"no-cache", "a8eb10649cbf"},
+        {"custom-value", "25a849e95bb8e8b4bf"},
+        {"302", "6402"},
+        {"Mon, 21 Oct 2013 20:13:21 GMT", "d07abe941054d444a8200595040b8166e082a62d1bff"},
+        {"https://www.example.com", "9d29ad171863c78f0b97c8e9ae82ae43d3"},
+    };
+    for (const auto& [text, hex] : examples) {
+        std::string encoded;
+        HpackHuffman::Encode(text, encoded);
+        EXPECT_EQ(ToHex(encoded), hex);
+        EXPECT_EQ(HpackHuffman::EncodedLength(text), encoded.size());
+        EXPECT_EQ(HpackHuffman::Decode(encoded.data(), encoded.size()), text);
+    }
+
+    // Every byte value survives a round trip
+    std::string all;
+    for (int c = 0; c < 256; ++c) {
+        all.push_back(static_cast<char>(c));
+    }
+    std::string encoded;
+    HpackHuffman::Encode(all, encoded);
+    EXPECT_EQ(HpackHuffman::Decode(encoded.data(), encoded.size()), all);
+
+    // Padding must be a prefix of EOS (ones), shorter than a byte
+    std::string bad = FromHex("f1e3c2e5f23a6ba0ab90f4fe");
+    EXPECT_THROW(HpackHuffman::Decode(bad.data(), bad.size()), std::invalid_argument);
+}
+
+// RFC 7541 C.4: three requests with Huffman coding, sharing a dynamic table
+TEST(HpackTest, DecodesRfcRequestSequence) {
+    HpackDecoder decoder;
+
+    HeaderList first = decoder.Decode(FromHex("828684418cf1e3c2e5f23a6ba0ab90f4ff"));
+    EXPECT_EQ(first, (HeaderList{{":method", "GET"}, {":scheme", "http"}, {":path", "/"},
+                                 {":authority", "www.example.com"}}));
+    EXPECT_EQ(decoder.Table().Size(), 57u);
+
+    HeaderList second = decoder.Decode(FromHex("828684be5886a8eb10649cbf"));
+    EXPECT_EQ(second, (HeaderList{{":method", "GET"}, {":scheme", "http"}, {":path", "/"},
+                                  {":authority", "www.example.com"}, {"cache-control", "no-cache"}}));
+    EXPECT_EQ(decoder.Table().Size(), 110u);
+
+    HeaderList third = decoder.Decode(FromHex("828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf"));
+    EXPECT_EQ(third, (HeaderList{{":method", "GET"}, {":scheme", "https"}, {":path", "/index.html"},
+                                 {":authority", "www.example.com"}, {"custom-key", "custom-value"}}));
+    EXPECT_EQ(decoder.Table().Size(), 164u);
+    EXPECT_EQ(decoder.Table().At(0), (HeaderField{"custom-key", "custom-value"}));
+
+    EXPECT_THROW(decoder.Decode(FromHex("ff")), std::invalid_argument);     // Truncated integer
+    EXPECT_THROW(decoder.Decode(FromHex("c5")), std::invalid_argument);     // Index past the table
+}
+
+TEST(HpackTest, DecoderCapsTheDecodedHeaderList) {
+    // One 4000-byte entry, then a hundred one-byte references to it
+    std::string block = "\x40";
+    HpackEncoder::EncodeInteger(1, 7, 0, block);
+    block += "x";
+    HpackEncoder::EncodeInteger(4000, 7, 0, block);
+    block += std::string(4000, 'v');
+    block += std::string(100, '\xbe');
+
+    HpackDecoder unlimited;
+    EXPECT_EQ(unlimited.Decode(block).size(), 101u);
+
+    HpackDecoder decoder(4096, 16384);
+    EXPECT_THROW(decoder.Decode(block), std::invalid_argument);
+    HpackDecoder fits(4096, 4 * (1 + 4000 + 32));
+    EXPECT_EQ(fits.Decode(block.substr(0, block.size() - 97)).size(), 4u);
+}
+
+TEST(HpackTest, EncoderReusesTableForRepeatedHeaders) {
+    HpackEncoder encoder;
+    HpackDecoder decoder;
+    HeaderList headers = {
+        {":status", "200"},
+        {"content-type", "application/json"},
+        {"server", "HighPerformanceServer/1.0"},
+        {"content-length", "42"},
+    };
+
+    std::string first;
+    encoder.Encode(headers, first);
+    EXPECT_EQ(decoder.Decode(first), headers);
+
+    // Second time round everything but the length is a one-byte index (the
+    // length is a literal with an indexed name: two bytes plus the value)
+    headers[3].second = "7";
+    std::string second;
+    encoder.Encode(headers, second);
+    EXPECT_EQ(decoder.Decode(second), headers);
+    EXPECT_LT(second.size(), first.size() / 3);
+    EXPECT_EQ(second.size(), 3u + 4u);
+
+    // A smaller table from the peer is announced and honored
+    encoder.SetMaxTableSize(0);
+    std::string third;
+    encoder.Encode(headers, third);
+    EXPECT_EQ(static_cast<uint8_t>(third[0]), 0x20);
+    EXPECT_EQ(decoder.Decode(third), headers);
+    EXPECT_EQ(decoder.Table().Count(), 0u);
+}
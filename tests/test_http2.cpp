@@ -0,0 +1,335 @@
+#include <gtest/gtest.h>
+#include "http2.hpp"
+#include <string>
+#include <vector>
+
+using namespace http;
+
+namespace {
+
+struct Frame {
+    uint8_t type;
+    uint8_t flags;
+    uint32_t stream_id;
+    std::string payload;
+};
+
+std::string MakeFrame(uint8_t type, uint8_t flags, uint32_t stream_id, const std::string& payload) {
+    std::string frame;
+    frame.push_back(static_cast<char>(payload.size() >> 16));
+    frame.push_back(static_cast<char>(payload.size() >> 8));
+    frame.push_back(static_cast<char>(payload.size()));
+    frame.push_back(static_cast<char>(type));
+    frame.push_back(static_cast<char>(flags));
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        frame.push_back(static_cast<char>(stream_id >> shift));
+    }
+    return frame + payload;
+}
+
+std::string Setting(uint16_t id, uint32_t value) {
+    std::string entry;
+    entry.push_back(static_cast<char>(id >> 8));
+    entry.push_back(static_cast<char>(id));
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        entry.push_back(static_cast<char>(value >> shift));
+    }
+    return entry;
+}
+
+std::string WindowUpdate(uint32_t stream_id, uint32_t increment) {
+    return MakeFrame(0x8, 0, stream_id, Setting(0, increment).substr(2));
+}
+
+std::string Get(HpackEncoder& encoder, uint32_t stream_id, const std::string& path) {
+    std::string block;
+    encoder.Encode({{":method", "GET"}, {":scheme", "http"}, {":path", path}, {":authority", "localhost"}}, block);
+    return MakeFrame(0x1, 0x4 | 0x1, stream_id, block);
+}
+
+std::vector<Frame> ParseFrames(const std::string& data) {
+    std::vector<Frame> frames;
+    size_t pos = 0;
+    while (data.size() - pos >= 9) {
+        const auto* h = reinterpret_cast<const uint8_t*>(data.data() + pos);
+        size_t length = (static_cast<size_t>(h[0]) << 16) | (h[1] << 8) | h[2];
+        uint32_t stream_id = ((h[5] & 0x7fu) << 24) | (h[6] << 16) | (h[7] << 8) | h[8];
+        frames.push_back(Frame{h[3], h[4], stream_id, data.substr(pos + 9, length)});
+        pos += 9 + length;
+    }
+    return frames;
+}
+
+// A session past the preface and SETTINGS exchange
+std::string Open(Http2Session& session, const std::string& settings = "") {
+    session.Start();
+    std::string input = Http2Session::kPreface + MakeFrame(0x4, 0, 0, settings);
+    EXPECT_TRUE(session.Receive(input).empty());
+    EXPECT_TRUE(input.empty());
+    return session.TakeOutput(1 << 20);
+}
+
+} // namespace
+
+TEST(Http2Test, RecognizesPrefaceAndUpgrade) {
+    EXPECT_TRUE(Http2Session::MayBePreface("PRI * HTTP/2.0\r\n"));
+    EXPECT_TRUE(Http2Session::MayBePreface(Http2Session::kPreface + "more"));
+    EXPECT_FALSE(Http2Session::MayBePreface("POST / HTTP/1.1\r\n"));
+    EXPECT_FALSE(Http2Session::MayBePreface(""));
+
+    HttpRequest upgrade = HttpParser::Parse(
+        "GET / HTTP/1.1\r\nHost: a\r\nConnection: Upgrade, HTTP2-Settings\r\n"
+        "Upgrade: websocket, h2c\r\nHTTP2-Settings: AAMAAABkAARAAAAA\r\n\r\n");
+    EXPECT_TRUE(Http2Session::IsUpgradeRequest(upgrade));
+    upgrade.headers.erase("http2-settings");
+    EXPECT_FALSE(Http2Session::IsUpgradeRequest(upgrade));
+}
+
+TEST(Http2Test, MultiplexesStreamsWithCompressedHeaders) {
+    Http2Session session(Http2Settings{}, 1024);
+    std::vector<Frame> opening = ParseFrames(Open(session));
+    ASSERT_EQ(opening.size(), 2u);
+    EXPECT_EQ(opening[0].type, 0x4);    // Server SETTINGS
+    EXPECT_EQ(opening[1].type, 0x4);    // ACK of ours
+    EXPECT_EQ(opening[1].flags, 0x1);
+
+    HpackEncoder client;
+    std::string input = Get(client, 1, "/api/metrics/latest");
+    input += Get(client, 3, "/api/alerts?limit=5");     // Encoded second: shares the table
+    std::vector<Http2Request> requests = session.Receive(input);
+    ASSERT_EQ(requests.size(), 2u);
+    EXPECT_EQ(requests[0].stream_id, 1u);
+    EXPECT_EQ(requests[0].request.path, "/api/metrics/latest");
+    EXPECT_EQ(requests[0].request.GetHeader("host"), "localhost");
+    EXPECT_EQ(requests[1].request.path, "/api/alerts");
+    EXPECT_EQ(requests[1].request.query_params["limit"], "5");
+    EXPECT_EQ(session.ActiveStreams(), 2u);
+
+    // Answered out of order; the second response's headers shrink to indexes
+    session.Respond(3, JsonResponse("[]"));
+    uint64_t first_headers = session.HeaderBytesSent();
+    session.Respond(1, JsonResponse("{\"cpu\": 1}"));
+    uint64_t second_headers = session.HeaderBytesSent() - first_headers;
+    EXPECT_LT(second_headers, first_headers / 2);
+
+    HpackDecoder decoder;
+    std::vector<Frame> frames = ParseFrames(session.TakeOutput(1 << 20));
+    std::vector<std::string> bodies(4);
+    for (const Frame& frame : frames) {
+        if (frame.type == 0x1) {
+            HeaderList headers = decoder.Decode(frame.payload);
+            EXPECT_EQ(headers[0], (HeaderField{":status", "200"}));
+            for (const auto& [name, value] : headers) {
+                EXPECT_NE(name, "connection");
+            }
+        } else if (frame.type == 0x0) {
+            bodies[frame.stream_id] += frame.payload;
+            EXPECT_EQ(frame.flags & 0x1, 0x1);
+        }
+    }
+    EXPECT_EQ(bodies[3], "[]");
+    EXPECT_EQ(bodies[1], "{\"cpu\": 1}");
+    EXPECT_EQ(session.ActiveStreams(), 0u);
+}
+
+TEST(Http2Test, DataWaitsForFlowControlWindow) {
+    Http2Session session(Http2Settings{}, 1024);
+    Open(session, Setting(0x4, 10));     // INITIAL_WINDOW_SIZE = 10
+
+    HpackEncoder client;
+    std::string input = Get(client, 1, "/big");
+    ASSERT_EQ(session.Receive(input).size(), 1u);
+    session.Respond(1, Ok(std::string(25, 'x')));
+
+    auto data_bytes = [](const std::string& output) {
+        size_t bytes = 0;
+        for (const Frame& frame : ParseFrames(output)) {
+            if (frame.type == 0x0) {
+                bytes += frame.payload.size();
+            }
+        }
+        return bytes;
+    };
+    EXPECT_EQ(data_bytes(session.TakeOutput(1 << 20)), 10u);
+    EXPECT_EQ(data_bytes(session.TakeOutput(1 << 20)), 0u);
+
+    input = WindowUpdate(1, 100);
+    session.Receive(input);
+    EXPECT_EQ(data_bytes(session.TakeOutput(1 << 20)), 15u);
+    EXPECT_EQ(session.ActiveStreams(), 0u);
+}
+
+TEST(Http2Test, AnswersPingAndRejectsProtocolErrors) {
+    Http2Session session(Http2Settings{}, 1024);
+    Open(session);
+
+    std::string input = MakeFrame(0x6, 0, 0, "12345678");
+    session.Receive(input);
+    std::vector<Frame> frames = ParseFrames(session.TakeOutput(1 << 20));
+    ASSERT_EQ(frames.size(), 1u);
+    EXPECT_EQ(frames[0].type, 0x6);
+    EXPECT_EQ(frames[0].flags, 0x1);
+    EXPECT_EQ(frames[0].payload, "12345678");
+
+    // Even stream ids belong to the server
+    HpackEncoder client;
+    input = Get(client, 2, "/");
+    EXPECT_TRUE(session.Receive(input).empty());
+    frames = ParseFrames(session.TakeOutput(1 << 20));
+    ASSERT_EQ(frames.size(), 1u);
+    EXPECT_EQ(frames[0].type, 0x7);     // GOAWAY
+    EXPECT_TRUE(session.Finished());
+
+    Http2Session garbage(Http2Settings{}, 1024);
+    input = "GET / HTTP/1.1\r\n\r\n";
+    garbage.Receive(input);
+    frames = ParseFrames(garbage.TakeOutput(1 << 20));
+    ASSERT_FALSE(frames.empty());
+    EXPECT_EQ(frames.back().type, 0x7);
+    EXPECT_TRUE(garbage.Finished());
+}
+
+TEST(Http2Test, UpgradedRequestBecomesStreamOne) {
+    HttpRequest upgrade = HttpParser::Parse(
+        "GET /health HTTP/1.1\r\nHost: a\r\nConnection: Upgrade, HTTP2-Settings\r\n"
+        "Upgrade: h2c\r\nHTTP2-Settings: AAMAAABkAARAAAAA\r\n\r\n");
+    Http2Session session(Http2Settings{}, 1024);
+    session.StartUpgrade(upgrade);
+    EXPECT_EQ(session.ActiveStreams(), 1u);
+
+    session.Respond(1, Ok("healthy"));
+    std::vector<Frame> frames = ParseFrames(session.TakeOutput(1 << 20));
+    ASSERT_EQ(frames.size(), 3u);
+    EXPECT_EQ(frames[0].type, 0x4);
+    EXPECT_EQ(frames[1].type, 0x1);
+    EXPECT_EQ(frames[1].stream_id, 1u);
+    EXPECT_EQ(frames[2].payload, "healthy");
+
+    upgrade.headers["http2-settings"] = "AAMA";     // Not a whole setting
+    Http2Session bad(Http2Settings{}, 1024);
+    EXPECT_THROW(bad.StartUpgrade(upgrade), std::invalid_argument);
+}
+
+TEST(Http2Test, ResetStreamsCountUntilAnsweredAndTooManyEndTheConnection) {
+    Http2Settings settings;
+    settings.max_concurrent_streams = 2;
+    settings.max_resets = 3;
+    Http2Session session(settings, 1024);
+    Open(session);
+    std::string cancel = Setting(0, static_cast<uint32_t>(Http2Error::CANCEL)).substr(2);
+
+    HpackEncoder client;
+    std::string input = Get(client, 1, "/slow");
+    input += Get(client, 3, "/slow");
+    ASSERT_EQ(session.Receive(input).size(), 2u);
+
+    // Reset while their requests are still being handled: they hold their
+    // slots, so a third stream is refused
+    input = MakeFrame(0x3, 0, 1, cancel) + MakeFrame(0x3, 0, 3, cancel) + Get(client, 5, "/slow");
+    EXPECT_TRUE(session.Receive(input).empty());
+    std::vector<Frame> frames = ParseFrames(session.TakeOutput(1 << 20));
+    ASSERT_EQ(frames.size(), 1u);
+    EXPECT_EQ(frames[0].type, 0x3);
+    EXPECT_EQ(frames[0].stream_id, 5u);
+    EXPECT_EQ(frames[0].payload, Setting(0, static_cast<uint32_t>(Http2Error::REFUSED_STREAM)).substr(2));
+
+    // Their responses are dropped and free the slots
+    session.Respond(1, Ok("late"));
+    EXPECT_TRUE(session.TakeOutput(1 << 20).empty());
+    input = Get(client, 7, "/slow");
+    EXPECT_EQ(session.Receive(input).size(), 1u);
+
+    // The fourth reset passes max_resets
+    input = MakeFrame(0x3, 0, 7, cancel) + MakeFrame(0x3, 0, 7, cancel);
+    EXPECT_TRUE(session.Receive(input).empty());
+    frames = ParseFrames(session.TakeOutput(1 << 20));
+    ASSERT_EQ(frames.size(), 1u);
+    EXPECT_EQ(frames[0].type, 0x7);
+    EXPECT_EQ(frames[0].payload.substr(4, 4), Setting(0, static_cast<uint32_t>(Http2Error::ENHANCE_YOUR_CALM)).substr(2));
+    EXPECT_TRUE(session.Finished());
+}
+
+TEST(Http2Test, DataBeyondTheAdvertisedWindowIsAFlowControlError) {
+    Http2Settings settings;
+    settings.initial_window_size = 100;
+    Http2Session session(settings, 1024);
+    Open(session);
+    std::string input = MakeFrame(0x4, 0x1, 0, "");     // The client ACKs our SETTINGS
+    session.Receive(input);
+
+    HpackEncoder client;
+    std::string block;
+    client.Encode({{":method", "POST"}, {":scheme", "http"}, {":path", "/upload"}}, block);
+    input = MakeFrame(0x1, 0x4, 1, block) + MakeFrame(0x0, 0x1, 1, std::string(101, 'a'));
+    EXPECT_TRUE(session.Receive(input).empty());
+    std::vector<Frame> frames = ParseFrames(session.TakeOutput(1 << 20));
+    ASSERT_EQ(frames.size(), 1u);
+    EXPECT_EQ(frames[0].type, 0x3);
+    EXPECT_EQ(frames[0].stream_id, 1u);
+    EXPECT_EQ(frames[0].payload, Setting(0, static_cast<uint32_t>(Http2Error::FLOW_CONTROL_ERROR)).substr(2));
+
+    // Past the connection window the whole connection fails
+    settings.max_frame_size = 1 << 17;
+    Http2Session large_frames(settings, 1024);
+    Open(large_frames);
+    input = MakeFrame(0x1, 0x4, 1, block) + MakeFrame(0x0, 0, 1, std::string(65536, 'c'));
+    EXPECT_TRUE(large_frames.Receive(input).empty());
+    frames = ParseFrames(large_frames.TakeOutput(1 << 20));
+    ASSERT_EQ(frames.size(), 1u);
+    EXPECT_EQ(frames[0].type, 0x7);
+    EXPECT_EQ(frames[0].payload.substr(4, 4), Setting(0, static_cast<uint32_t>(Http2Error::FLOW_CONTROL_ERROR)).substr(2));
+}
+
+TEST(Http2Test, HeaderBlockExpandingPastTheListLimitIsACompressionError) {
+    Http2Settings settings;
+    settings.max_header_list_size = 16384;
+    Http2Session session(settings, 1 << 20);
+    std::vector<Frame> opening = ParseFrames(Open(session));
+    ASSERT_FALSE(opening.empty());
+    EXPECT_NE(opening[0].payload.find(Setting(0x6, 16384)), std::string::npos);
+
+    // About 4 KB in the table, then a thousand one-byte references to it
+    std::string block;
+    HpackEncoder client;
+    client.Encode({{":method", "GET"}, {":scheme", "http"}, {":path", "/"}}, block);
+    block += "\x40";
+    HpackEncoder::EncodeInteger(1, 7, 0, block);
+    block += "x";
+    HpackEncoder::EncodeInteger(4000, 7, 0, block);
+    block += std::string(4000, 'v') + std::string(1000, '\xbe');
+
+    std::string input = MakeFrame(0x1, 0x4 | 0x1, 1, block);
+    EXPECT_TRUE(session.Receive(input).empty());
+    std::vector<Frame> frames = ParseFrames(session.TakeOutput(1 << 20));
+    ASSERT_EQ(frames.size(), 1u);
+    EXPECT_EQ(frames[0].type, 0x7);
+    EXPECT_EQ(frames[0].payload.substr(4, 4), Setting(0, static_cast<uint32_t>(Http2Error::COMPRESSION_ERROR)).substr(2));
+    EXPECT_TRUE(session.Finished());
+}
+
+TEST(Http2Test, PingsNobodyReadsEndTheConnection) {
+    Http2Settings settings;
+    settings.max_output = 1024;
+    Http2Session session(settings, 1 << 20);
+    Open(session);
+
+    // Each PING queues a 17-byte ACK; the output is never taken
+    std::string ping = MakeFrame(0x6, 0, 0, std::string(8, 'p'));
+    for (int i = 0; i < 60; ++i) {
+        std::string input = ping;
+        session.Receive(input);
+    }
+    EXPECT_FALSE(session.Finished());
+
+    std::string input;
+    for (int i = 0; i < 10; ++i) {
+        input += ping;
+    }
+    session.Receive(input);
+    EXPECT_TRUE(input.empty());
+    std::vector<Frame> frames = ParseFrames(session.TakeOutput(1 << 20));
+    ASSERT_EQ(frames.size(), 1u);
+    EXPECT_EQ(frames[0].type, 0x7);
+    EXPECT_EQ(frames[0].payload.substr(4, 4), Setting(0, static_cast<uint32_t>(Http2Error::ENHANCE_YOUR_CALM)).substr(2));
+    EXPECT_TRUE(session.Finished());
+}
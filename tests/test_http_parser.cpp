@@ -65,3 +65,92 @@ TEST(HttpParserTest, MethodToString) {
     EXPECT_EQ(HttpParser::MethodToString(HttpMethod::PUT), "PUT");
     EXPECT_EQ(HttpParser::MethodToString(HttpMethod::DELETE), "DELETE");
 }
+
+TEST(HttpParserTest, FindRequestEndWaitsForHeaders) {
+    EXPECT_EQ(HttpParser::FindRequestEnd(""), 0u);
+    EXPECT_EQ(HttpParser::FindRequestEnd("GET / HTTP/1.1\r\nHost: localhost\r\n"), 0u);
+    
+    std::string request = "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    EXPECT_EQ(HttpParser::FindRequestEnd(request), request.size());
+    
+    // Bytes of a following request are not part of this one
+    EXPECT_EQ(HttpParser::FindRequestEnd(request + "GET /next"), request.size());
+}
+
+TEST(HttpParserTest, FindRequestEndWaitsForBody) {
+    std::string headers =
+        "POST /api/data HTTP/1.1\r\n"
+        "content-LENGTH: 5\r\n"
+        "\r\n";
+    
+    EXPECT_EQ(HttpParser::FindRequestEnd(headers), 0u);
+    EXPECT_EQ(HttpParser::FindRequestEnd(headers + "abc"), 0u);
+    EXPECT_EQ(HttpParser::FindRequestEnd(headers + "abcde"), headers.size() + 5);
+    EXPECT_EQ(HttpParser::FindRequestEnd(headers + "abcdefgh"), headers.size() + 5);
+}
+
+TEST(HttpParserTest, FindRequestEndRejectsInvalidContentLength) {
+    EXPECT_THROW(HttpParser::FindRequestEnd("POST / HTTP/1.1\r\nContent-Length: -1\r\n\r\n"),
+                 std::invalid_argument);
+    EXPECT_THROW(HttpParser::FindRequestEnd("POST / HTTP/1.1\r\nContent-Length: 12abc\r\n\r\n"),
+                 std::invalid_argument);
+    EXPECT_THROW(HttpParser::FindRequestEnd("POST / HTTP/1.1\r\nContent-Length:\r\n\r\n"),
+                 std::invalid_argument);
+}
+
+TEST(HttpParserTest, FindRequestEndRejectsConflictingContentLength) {
+    EXPECT_THROW(HttpParser::FindRequestEnd("POST / HTTP/1.1\r\nContent-Length: 0\r\nContent-Length: 5\r\n\r\nhello"),
+                 RequestFramingError);
+    EXPECT_THROW(HttpParser::FindRequestEnd("POST / HTTP/1.1\r\nContent-Length: 5, 5\r\n\r\nhello"),
+                 RequestFramingError);
+    
+    // Repeats that agree frame the request as one would
+    std::string request = "POST / HTTP/1.1\r\nContent-Length: 5\r\ncontent-length: 05\r\n\r\nhello";
+    EXPECT_EQ(HttpParser::FindRequestEnd(request + "GET /"), request.size());
+    EXPECT_EQ(HttpParser::Parse(request).body, "hello");
+}
+
+TEST(HttpParserTest, FindRequestEndRejectsTransferEncoding) {
+    auto status_of = [](const std::string& data) {
+        try {
+            HttpParser::FindRequestEnd(data);
+        } catch (const RequestFramingError& e) {
+            return e.status;
+        }
+        return 0;
+    };
+    EXPECT_EQ(status_of("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhello\r\n0\r\n\r\n"), 501);
+    EXPECT_EQ(status_of("POST / HTTP/1.1\r\ntransfer-ENCODING: gzip\r\n\r\n"), 501);
+    EXPECT_EQ(status_of("POST / HTTP/1.1\r\nContent-Length: 3\r\nTransfer-Encoding: chunked\r\n\r\n0\r\n\r\n"), 400);
+    EXPECT_EQ(status_of("POST / HTTP/1.1\r\nX-Transfer-Encoding: chunked\r\n\r\n"), 0);
+}
+
+TEST(HttpParserTest, KeepAliveFollowsVersionAndConnectionHeader) {
+    HttpRequest req = HttpParser::Parse("GET / HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    EXPECT_TRUE(HttpParser::KeepAlive(req));
+    
+    req = HttpParser::Parse("GET / HTTP/1.1\r\nConnection: Close\r\n\r\n");
+    EXPECT_FALSE(HttpParser::KeepAlive(req));
+    
+    req = HttpParser::Parse("GET / HTTP/1.0\r\n\r\n");
+    EXPECT_FALSE(HttpParser::KeepAlive(req));
+    
+    req = HttpParser::Parse("GET / HTTP/1.0\r\nConnection: keep-alive\r\n\r\n");
+    EXPECT_TRUE(HttpParser::KeepAlive(req));
+}
+
+TEST(HttpParserTest, PeekRequestLine) {
+    HttpMethod method = HttpMethod::UNKNOWN;
+    std::string path;
+    
+    EXPECT_TRUE(HttpParser::PeekRequestLine("GET /api/metrics/latest?x=1 HTTP/1.1\r\nHost: a\r\n\r\n", method, path));
+    EXPECT_EQ(method, HttpMethod::GET);
+    EXPECT_EQ(path, "/api/metrics/latest");
+    
+    EXPECT_TRUE(HttpParser::PeekRequestLine("POST /health HTTP/1.1\r\n", method, path));
+    EXPECT_EQ(method, HttpMethod::POST);
+    EXPECT_EQ(path, "/health");
+    
+    EXPECT_FALSE(HttpParser::PeekRequestLine("GET /health HTTP/1.1", method, path));
+    EXPECT_FALSE(HttpParser::PeekRequestLine("GET\r\n", method, path));
+}
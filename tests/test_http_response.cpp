@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
 #include "http_response.hpp"
+#include <cstdlib>
+#include <unistd.h>
 
 using namespace http;
 
@@ -55,3 +57,37 @@ TEST(HttpResponseTest, JsonResponseHelper) {
     std::string str = response.ToString();
     EXPECT_NE(str.find("Content-Type: application/json"), std::string::npos);
 }
+
+TEST(HttpResponseTest, HeadersAndBodySerializeSeparately) {
+    HttpResponse response = JsonResponse(R"({"status": "ok"})");
+    std::string whole = response.ToString();
+    
+    std::string headers = response.SerializeHeaders();
+    EXPECT_EQ(headers.compare(0, 17, "HTTP/1.1 200 OK\r\n"), 0);
+    EXPECT_EQ(headers.substr(headers.size() - 4), "\r\n\r\n");
+    
+    std::string body = response.ReleaseBody();
+    EXPECT_EQ(headers + body, whole);
+    EXPECT_TRUE(response.GetBody().empty());
+}
+
+TEST(HttpResponseTest, FromFileKeepsFileBody) {
+    char path[] = "/tmp/http_response_XXXXXX.html";
+    int fd = mkstemps(path, 5);
+    ASSERT_GE(fd, 0);
+    const std::string contents = "<h1>static</h1>";
+    ASSERT_EQ(write(fd, contents.data(), contents.size()), static_cast<ssize_t>(contents.size()));
+    close(fd);
+    
+    HttpResponse response = HttpResponse::FromFile(path);
+    unlink(path);
+    
+    ASSERT_NE(response.GetFileBody(), nullptr);
+    EXPECT_EQ(response.GetFileBody()->Length(), contents.size());
+    EXPECT_TRUE(response.GetBody().empty());
+    
+    std::string str = response.ToString();
+    EXPECT_NE(str.find("Content-Length: 15"), std::string::npos);
+    EXPECT_NE(str.find("Content-Type: text/html"), std::string::npos);
+    EXPECT_EQ(str.substr(str.size() - contents.size()), contents);
+}
@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+#include "inline_task.hpp"
+#include <array>
+#include <memory>
+#include <string>
+#include <utility>
+
+using namespace http;
+
+TEST(InlineTaskTest, StoresSmallCallablesInline) {
+    InlineTask empty;
+    EXPECT_FALSE(empty);
+
+    int calls = 0;
+    std::string text = "request";
+    InlineTask task([&calls, text]() { calls += static_cast<int>(text.size()); });
+    EXPECT_TRUE(task);
+    EXPECT_TRUE(task.StoredInline());
+    task();
+    task();
+    EXPECT_EQ(calls, 14);
+
+    // Moves carry the callable and leave the source empty
+    InlineTask moved(std::move(task));
+    EXPECT_FALSE(task);
+    moved();
+    EXPECT_EQ(calls, 21);
+    task = std::move(moved);
+    EXPECT_FALSE(moved);
+    task();
+    EXPECT_EQ(calls, 28);
+}
+
+TEST(InlineTaskTest, HoldsMoveOnlyCaptures) {
+    auto value = std::make_unique<int>(5);
+    int seen = 0;
+    InlineTask task([&seen, value = std::move(value)]() { seen = *value; });
+    EXPECT_TRUE(task.StoredInline());
+    InlineTask other = std::move(task);
+    other();
+    EXPECT_EQ(seen, 5);
+}
+
+TEST(InlineTaskTest, LargeCallablesGoToTheHeap) {
+    std::array<char, InlineTask::kCapacity + 1> big{};
+    big[0] = 'x';
+    char seen = 0;
+    InlineTask task([&seen, big]() { seen = big[0]; });
+    EXPECT_FALSE(task.StoredInline());
+    InlineTask moved = std::move(task);
+    moved();
+    EXPECT_EQ(seen, 'x');
+}
+
+TEST(InlineTaskTest, DestroysCapturesOnce) {
+    auto tracker = std::make_shared<int>(0);
+    {
+        InlineTask first([tracker]() {});
+        EXPECT_EQ(tracker.use_count(), 2);
+        InlineTask second = std::move(first);
+        EXPECT_EQ(tracker.use_count(), 2);
+
+        // Assigning over a task releases what it held
+        second = InlineTask([]() {});
+        EXPECT_EQ(tracker.use_count(), 1);
+
+        std::array<char, InlineTask::kCapacity> padding{};
+        InlineTask heap([tracker, padding]() {});
+        EXPECT_FALSE(heap.StoredInline());
+        EXPECT_EQ(tracker.use_count(), 2);
+        heap.Reset();
+        EXPECT_FALSE(heap);
+    }
+    EXPECT_EQ(tracker.use_count(), 1);
+}
@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+#include "listener.hpp"
+#include <stdexcept>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+using namespace http;
+
+TEST(ListenerTest, ParsesEndpoints) {
+    std::vector<ListenEndpoint> endpoints =
+        ParseListenEndpoints("0.0.0.0:8080, [::1]:9090,unix:/run/monitord.sock, *:81");
+    ASSERT_EQ(endpoints.size(), 4u);
+
+    EXPECT_EQ(endpoints[0].family, ListenEndpoint::Family::IPv4);
+    EXPECT_EQ(endpoints[0].address, "0.0.0.0");
+    EXPECT_EQ(endpoints[0].port, 8080);
+
+    EXPECT_EQ(endpoints[1].family, ListenEndpoint::Family::IPv6);
+    EXPECT_EQ(endpoints[1].address, "::1");
+    EXPECT_EQ(endpoints[1].ToString(), "[::1]:9090");
+
+    EXPECT_EQ(endpoints[2].family, ListenEndpoint::Family::Unix);
+    EXPECT_EQ(endpoints[2].address, "/run/monitord.sock");
+    EXPECT_FALSE(endpoints[2].IsTcp());
+
+    EXPECT_EQ(endpoints[3].address, "0.0.0.0");
+    EXPECT_EQ(endpoints[3].port, 81);
+
+    EXPECT_EQ(ListenEndpoint::FromHostPort("::", 80).family, ListenEndpoint::Family::IPv6);
+}
+
+TEST(ListenerTest, RejectsMalformedEndpoints) {
+    EXPECT_THROW(ListenEndpoint::Parse("8080"), std::invalid_argument);
+    EXPECT_THROW(ListenEndpoint::Parse("0.0.0.0:http"), std::invalid_argument);
+    EXPECT_THROW(ListenEndpoint::Parse("0.0.0.0:70000"), std::invalid_argument);
+    EXPECT_THROW(ListenEndpoint::Parse("::1:80"), std::invalid_argument);
+    EXPECT_THROW(ListenEndpoint::Parse("localhost:80"), std::invalid_argument);
+    EXPECT_THROW(ListenEndpoint::Parse("unix:"), std::invalid_argument);
+}
+
+TEST(ListenerTest, OpensNonBlockingTcpListenerWithOptions) {
+    ListenOptions options;
+    options.tcp_nodelay = true;
+    int fd = OpenListener(ListenEndpoint::Parse("127.0.0.1:0"), options);
+    ASSERT_GE(fd, 0);
+
+    EXPECT_NE(LocalPort(fd), 0);
+    EXPECT_TRUE(fcntl(fd, F_GETFL, 0) & O_NONBLOCK);
+    EXPECT_TRUE(fcntl(fd, F_GETFD, 0) & FD_CLOEXEC);
+    int nodelay = 0;
+    socklen_t length = sizeof(nodelay);
+    ASSERT_EQ(getsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, &length), 0);
+    EXPECT_NE(nodelay, 0);
+    close(fd);
+}
+
+TEST(ListenerTest, OpensIpv6Listener) {
+    int probe = socket(AF_INET6, SOCK_STREAM, 0);
+    if (probe < 0) {
+        GTEST_SKIP() << "No IPv6 support";
+    }
+    close(probe);
+
+    int fd = -1;
+    try {
+        fd = OpenListener(ListenEndpoint::Parse("[::1]:0"), ListenOptions{});
+    } catch (const std::runtime_error& e) {
+        GTEST_SKIP() << e.what();
+    }
+    EXPECT_NE(LocalPort(fd), 0);
+    close(fd);
+}
+
+TEST(ListenerTest, UnixListenerReplacesStaleSocket) {
+    char directory[] = "/tmp/listener_XXXXXX";
+    ASSERT_NE(mkdtemp(directory), nullptr);
+    const std::string path = std::string(directory) + "/agent.sock";
+    ListenEndpoint endpoint = ListenEndpoint::Parse("unix:" + path);
+
+    // A previous run's socket file is still there
+    int first = OpenListener(endpoint, ListenOptions{});
+    close(first);
+    struct stat info{};
+    ASSERT_EQ(stat(path.c_str(), &info), 0);
+
+    int fd = OpenListener(endpoint, ListenOptions{});
+    ASSERT_GE(fd, 0);
+    EXPECT_EQ(LocalPort(fd), 0);
+
+    int client = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    snprintf(address.sun_path, sizeof(address.sun_path), "%s", path.c_str());
+    EXPECT_EQ(connect(client, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)), 0);
+
+    close(client);
+    close(fd);
+    unlink(path.c_str());
+    rmdir(directory);
+}
@@ -0,0 +1,45 @@
+#include <gtest/gtest.h>
+#include "load_shedder.hpp"
+
+using namespace http;
+using namespace std::chrono_literals;
+
+TEST(LoadShedderTest, StandingDelayTriggersAfterInterval) {
+    LoadShedder shedder(10ms, 100ms);
+    auto start = LoadShedder::Clock::now();
+
+    shedder.Report(20ms, false, start);
+    EXPECT_FALSE(shedder.Overloaded());
+    shedder.Report(20ms, false, start + 50ms);
+    EXPECT_FALSE(shedder.Overloaded());
+    shedder.Report(20ms, false, start + 100ms);
+    EXPECT_TRUE(shedder.Overloaded());
+    EXPECT_EQ(shedder.LastWait(), 20000us);
+
+    // One task that waited less than target ends it
+    shedder.Report(1ms, false, start + 110ms);
+    EXPECT_FALSE(shedder.Overloaded());
+}
+
+TEST(LoadShedderTest, BurstThatDrainsIsNotShed) {
+    LoadShedder shedder(10ms, 100ms);
+    auto start = LoadShedder::Clock::now();
+
+    shedder.Report(30ms, false, start);
+    shedder.Report(5ms, false, start + 60ms);
+    shedder.Report(30ms, false, start + 120ms);
+    EXPECT_FALSE(shedder.Overloaded());
+
+    // An empty queue resets too, however long its last task waited
+    shedder.Report(30ms, false, start + 300ms);
+    shedder.Report(30ms, true, start + 400ms);
+    EXPECT_FALSE(shedder.Overloaded());
+}
+
+TEST(LoadShedderTest, ZeroTargetDisables) {
+    LoadShedder shedder(0ms, 100ms);
+    auto start = LoadShedder::Clock::now();
+    shedder.Report(1s, false, start);
+    shedder.Report(1s, false, start + 1s);
+    EXPECT_FALSE(shedder.Overloaded());
+}
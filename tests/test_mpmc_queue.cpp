@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+#include "mpmc_queue.hpp"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace http;
+
+TEST(BoundedMpmcQueueTest, FifoUntilFull) {
+    BoundedMpmcQueue<int> queue(3);
+    EXPECT_EQ(queue.Capacity(), 4u);
+
+    int value = 0;
+    EXPECT_FALSE(queue.TryPop(value));
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_TRUE(queue.TryPush(int(i)));
+    }
+    int rejected = 99;
+    EXPECT_FALSE(queue.TryPush(std::move(rejected)));
+    EXPECT_EQ(rejected, 99);
+    EXPECT_EQ(queue.Size(), 4u);
+
+    // Wraps around the ring as slots free up
+    for (int round = 0; round < 3; ++round) {
+        ASSERT_TRUE(queue.TryPop(value));
+        EXPECT_EQ(value, round);
+        EXPECT_TRUE(queue.TryPush(int(4 + round)));
+    }
+    for (int i = 3; i < 7; ++i) {
+        ASSERT_TRUE(queue.TryPop(value));
+        EXPECT_EQ(value, i);
+    }
+    EXPECT_FALSE(queue.TryPop(value));
+    EXPECT_EQ(queue.Size(), 0u);
+}
+
+TEST(BoundedMpmcQueueTest, PoppedSlotsReleaseTheirValues) {
+    auto tracker = std::make_shared<int>(0);
+    {
+        BoundedMpmcQueue<std::shared_ptr<int>> queue(4);
+        queue.TryPush(std::shared_ptr<int>(tracker));
+        queue.TryPush(std::shared_ptr<int>(tracker));
+        EXPECT_EQ(tracker.use_count(), 3);
+
+        std::shared_ptr<int> popped;
+        ASSERT_TRUE(queue.TryPop(popped));
+        popped.reset();
+        EXPECT_EQ(tracker.use_count(), 2);
+    }
+    EXPECT_EQ(tracker.use_count(), 1);
+}
+
+TEST(BoundedMpmcQueueTest, EveryValueTakenExactlyOnce) {
+    BoundedMpmcQueue<int> queue(64);
+    constexpr int kProducers = 4;
+    constexpr int kConsumers = 4;
+    constexpr int kPerProducer = 50000;
+
+    std::vector<std::atomic<int>> seen(kProducers * kPerProducer);
+    std::atomic<int> taken{0};
+    std::vector<std::thread> threads;
+    for (int p = 0; p < kProducers; ++p) {
+        threads.emplace_back([&queue, p]() {
+            for (int i = 0; i < kPerProducer; ++i) {
+                int value = p * kPerProducer + i;
+                while (!queue.TryPush(std::move(value))) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (int c = 0; c < kConsumers; ++c) {
+        threads.emplace_back([&]() {
+            int value = 0;
+            while (taken.load() < kProducers * kPerProducer) {
+                if (queue.TryPop(value)) {
+                    seen[value]++;
+                    taken++;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (const auto& count : seen) {
+        ASSERT_EQ(count.load(), 1);
+    }
+}
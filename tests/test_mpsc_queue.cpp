@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+#include "mpsc_queue.hpp"
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace http;
+
+TEST(MpscQueueTest, PopsInFifoOrder) {
+    MpscQueue<int> queue;
+    int value = 0;
+
+    EXPECT_TRUE(queue.Empty());
+    EXPECT_FALSE(queue.TryPop(value));
+
+    for (int i = 0; i < 5; ++i) {
+        queue.Push(i);
+    }
+    EXPECT_FALSE(queue.Empty());
+
+    for (int i = 0; i < 5; ++i) {
+        ASSERT_TRUE(queue.TryPop(value));
+        EXPECT_EQ(value, i);
+    }
+    EXPECT_FALSE(queue.TryPop(value));
+    EXPECT_TRUE(queue.Empty());
+
+    // Usable again after draining past the stub node
+    queue.Push(42);
+    ASSERT_TRUE(queue.TryPop(value));
+    EXPECT_EQ(value, 42);
+}
+
+TEST(MpscQueueTest, DestructorReleasesPendingElements) {
+    auto tracker = std::make_shared<int>(0);
+    {
+        MpscQueue<std::shared_ptr<int>> queue;
+        queue.Push(tracker);
+        queue.Push(tracker);
+        EXPECT_EQ(tracker.use_count(), 3);
+    }
+    EXPECT_EQ(tracker.use_count(), 1);
+}
+
+TEST(MpscQueueTest, ConcurrentProducers) {
+    MpscQueue<int> queue;
+    constexpr int kProducers = 4;
+    constexpr int kPerProducer = 20000;
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; ++p) {
+        producers.emplace_back([&queue, p]() {
+            for (int i = 0; i < kPerProducer; ++i) {
+                queue.Push(p * kPerProducer + i);
+            }
+        });
+    }
+
+    // Consume concurrently; each producer's values must arrive in order
+    std::vector<int> last(kProducers, -1);
+    int received = 0;
+    int value = 0;
+    while (received < kProducers * kPerProducer) {
+        if (!queue.TryPop(value)) {
+            std::this_thread::yield();
+            continue;
+        }
+        int producer = value / kPerProducer;
+        EXPECT_GT(value, last[producer]);
+        last[producer] = value;
+        ++received;
+    }
+
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    EXPECT_FALSE(queue.TryPop(value));
+}
@@ -81,3 +81,43 @@ TEST(RouterTest, HasRoute) {
     EXPECT_FALSE(router.HasRoute(HttpMethod::POST, "/test"));
     EXPECT_FALSE(router.HasRoute(HttpMethod::GET, "/other"));
 }
+
+TEST(RouterTest, WildcardMatchesRestOfPath) {
+    Router router;
+    
+    router.Register(HttpMethod::GET, "/static/*", [](const HttpRequest& /*req*/) {
+        return Ok("");
+    });
+    
+    EXPECT_TRUE(router.HasRoute(HttpMethod::GET, "/static/app.js"));
+    EXPECT_TRUE(router.HasRoute(HttpMethod::GET, "/static/css/site.css"));
+    EXPECT_FALSE(router.HasRoute(HttpMethod::GET, "/staticfile"));
+}
+
+TEST(RouterTest, MatchReportsRouteMode) {
+    Router router;
+    EXPECT_FALSE(router.HasInlineRoutes());
+    
+    router.Register(HttpMethod::GET, "/health", [](const HttpRequest& /*req*/) {
+        return Ok("healthy");
+    }, RouteMode::Inline);
+    router.Register(HttpMethod::GET, "/api/users/:id", [](const HttpRequest& req) {
+        return Ok(req.query_params.at("id"));
+    });
+    EXPECT_TRUE(router.HasInlineRoutes());
+    
+    const Route* health = router.Match(HttpMethod::GET, "/health");
+    ASSERT_NE(health, nullptr);
+    EXPECT_EQ(health->mode, RouteMode::Inline);
+    EXPECT_EQ(router.Match(HttpMethod::GET, "/health/extra"), nullptr);
+    EXPECT_EQ(router.Match(HttpMethod::POST, "/health"), nullptr);
+    
+    const Route* user = router.Match(HttpMethod::GET, "/api/users/7");
+    ASSERT_NE(user, nullptr);
+    EXPECT_EQ(user->mode, RouteMode::Pool);
+    
+    HttpRequest req;
+    req.method = HttpMethod::GET;
+    req.path = "/api/users/7";
+    EXPECT_EQ(router.Invoke(*user, req).GetBody(), "7");
+}
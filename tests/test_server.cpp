@@ -5,8 +5,14 @@
 #include <chrono>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <sys/un.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <atomic>
 
 using namespace http;
 
@@ -51,3 +57,1098 @@ TEST(ServerTest, ServerConfiguration) {
     
     EXPECT_FALSE(server.IsRunning());
 }
+
+TEST(ServerTest, MultiReactorServesRequests) {
+    Config config;
+    config.host = "127.0.0.1";
+    config.port = 0;
+    config.reactor_count = 3;
+    config.enable_logging = false;
+    
+    Server server(config);
+    EXPECT_EQ(server.ReactorCount(), 3u);
+    
+    server.Get("/ping", [](const HttpRequest& /*req*/) {
+        return Ok("pong");
+    });
+    
+    std::thread server_thread([&server]() {
+        server.Start();
+    });
+    
+    for (int i = 0; i < 100 && server.Port() == 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_NE(server.Port(), 0);
+    
+    int ok_responses = 0;
+    for (int i = 0; i < 12 && server.Port() != 0; ++i) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(server.Port());
+        inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+        std::string request = "GET /ping HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+        if (connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            send(fd, request.c_str(), request.size(), 0) <= 0) {
+            close(fd);
+            continue;
+        }
+        
+        std::string response;
+        char buffer[1024];
+        ssize_t n;
+        while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+            response.append(buffer, static_cast<size_t>(n));
+        }
+        close(fd);
+        
+        if (response.find("200 OK") != std::string::npos && response.find("pong") != std::string::npos) {
+            ++ok_responses;
+        }
+    }
+    
+    // Stop() is a no-op until Start() has bound the listeners
+    while (!server.IsRunning()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    server.Stop();
+    server_thread.join();
+    
+    EXPECT_EQ(ok_responses, 12);
+}
+
+namespace {
+
+int ConnectTo(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct timeval timeout{5, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    struct sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    if (connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void WaitUntilRunning(const Server& server) {
+    while (!server.IsRunning()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+} // namespace
+
+TEST(ServerTest, IdleConnectionClosedAfterRequestTimeout) {
+    Config config;
+    config.host = "127.0.0.1";
+    config.port = 0;
+    config.request_timeout_seconds = 1;
+    config.enable_logging = false;
+    
+    Server server(config);
+    std::thread server_thread([&server]() {
+        server.Start();
+    });
+    WaitUntilRunning(server);
+    
+    int fd = ConnectTo(server.Port());
+    EXPECT_GE(fd, 0);
+    
+    auto start = std::chrono::steady_clock::now();
+    char byte;
+    ssize_t received = fd >= 0 ? recv(fd, &byte, 1, 0) : -1;
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    if (fd >= 0) {
+        close(fd);
+    }
+    
+    server.Stop();
+    server_thread.join();
+    
+    EXPECT_EQ(received, 0);
+    EXPECT_GE(elapsed, std::chrono::milliseconds(900));
+    EXPECT_LT(elapsed, std::chrono::seconds(5));
+}
+
+TEST(ServerTest, PushesWebSocketFramesPeriodically) {
+    Config config;
+    config.host = "127.0.0.1";
+    config.port = 0;
+    config.enable_logging = false;
+    
+    Server server(config);
+    server.PushWebSocketEvery("/ws/ticks", std::chrono::milliseconds(20), []() {
+        return std::string("tick");
+    });
+    
+    std::thread server_thread([&server]() {
+        server.Start();
+    });
+    WaitUntilRunning(server);
+    
+    int fd = ConnectTo(server.Port());
+    EXPECT_GE(fd, 0);
+    
+    std::string received;
+    if (fd >= 0) {
+        std::string request =
+            "GET /ws/ticks HTTP/1.1\r\n"
+            "Host: localhost\r\n"
+            "Upgrade: websocket\r\n"
+            "Connection: Upgrade\r\n"
+            "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+            "Sec-WebSocket-Version: 13\r\n"
+            "\r\n";
+        send(fd, request.c_str(), request.size(), 0);
+        
+        // Handshake followed by at least two text frames
+        char buffer[1024];
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        size_t ticks = 0;
+        while (ticks < 2 && std::chrono::steady_clock::now() < deadline) {
+            ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+            if (n <= 0) {
+                break;
+            }
+            received.append(buffer, static_cast<size_t>(n));
+            ticks = 0;
+            for (size_t pos = received.find("tick"); pos != std::string::npos; pos = received.find("tick", pos + 1)) {
+                ++ticks;
+            }
+        }
+        close(fd);
+    }
+    
+    server.Stop();
+    server_thread.join();
+    
+    EXPECT_NE(received.find("101 Switching Protocols"), std::string::npos);
+    EXPECT_NE(received.find("\x81\x04tick"), std::string::npos);
+}
+
+TEST(ServerTest, AssemblesRequestSentInPieces) {
+    Config config;
+    config.host = "127.0.0.1";
+    config.port = 0;
+    config.enable_logging = false;
+    
+    Server server(config);
+    server.Post("/echo", [](const HttpRequest& req) {
+        return Ok(req.body);
+    });
+    
+    std::thread server_thread([&server]() {
+        server.Start();
+    });
+    WaitUntilRunning(server);
+    
+    int fd = ConnectTo(server.Port());
+    EXPECT_GE(fd, 0);
+    
+    std::string response;
+    if (fd >= 0) {
+        // Headers split mid-line, then the body well after them
+        const char* pieces[] = {
+            "POST /echo HTTP/1.1\r\nHo",
+            "st: localhost\r\nConnection: close\r\nContent-Length: 11\r\n\r\n",
+            "hello ",
+            "world",
+        };
+        for (const char* piece : pieces) {
+            send(fd, piece, strlen(piece), 0);
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        
+        char buffer[1024];
+        ssize_t n;
+        while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+            response.append(buffer, static_cast<size_t>(n));
+        }
+        close(fd);
+    }
+    
+    server.Stop();
+    server_thread.join();
+    
+    EXPECT_NE(response.find("200 OK"), std::string::npos);
+    EXPECT_NE(response.find("\r\n\r\nhello world"), std::string::npos);
+}
+
+TEST(ServerTest, RejectsOversizedRequest) {
+    Config config;
+    config.host = "127.0.0.1";
+    config.port = 0;
+    config.max_request_size = 1024;
+    config.enable_logging = false;
+    
+    Server server(config);
+    std::thread server_thread([&server]() {
+        server.Start();
+    });
+    WaitUntilRunning(server);
+    
+    int fd = ConnectTo(server.Port());
+    EXPECT_GE(fd, 0);
+    
+    std::string response;
+    if (fd >= 0) {
+        std::string request = "POST /upload HTTP/1.1\r\nContent-Length: 4096\r\n\r\n" + std::string(4096, 'x');
+        send(fd, request.c_str(), request.size(), 0);
+        
+        char buffer[1024];
+        ssize_t n;
+        while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+            response.append(buffer, static_cast<size_t>(n));
+        }
+        close(fd);
+    }
+    
+    server.Stop();
+    server_thread.join();
+    
+    EXPECT_NE(response.find("413 Payload Too Large"), std::string::npos);
+}
+
+TEST(ServerTest, RejectsTransferEncodingAndCloses) {
+    Config config;
+    config.host = "127.0.0.1";
+    config.port = 0;
+    config.enable_logging = false;
+    
+    Server server(config);
+    std::atomic<int> smuggled{0};
+    server.Get("/admin", [&smuggled](const HttpRequest&) {
+        smuggled++;
+        return Ok("admin");
+    });
+    server.Post("/upload", [](const HttpRequest&) {
+        return Ok("uploaded");
+    });
+    std::thread server_thread([&server]() {
+        server.Start();
+    });
+    WaitUntilRunning(server);
+    
+    // The chunked body hides a second request; reading on after the
+    // headers would serve it
+    const std::string hidden = "GET /admin HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    auto exchange = [&server](const std::string& request) {
+        std::string response;
+        int fd = ConnectTo(server.Port());
+        EXPECT_GE(fd, 0);
+        if (fd >= 0) {
+            send(fd, request.c_str(), request.size(), 0);
+            char buffer[1024];
+            ssize_t n;
+            while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+                response.append(buffer, static_cast<size_t>(n));
+            }
+            close(fd);
+        }
+        return response;
+    };
+    std::string chunked = exchange("POST /upload HTTP/1.1\r\nHost: localhost\r\nTransfer-Encoding: chunked\r\n\r\n"
+                                   "0\r\n\r\n" + hidden);
+    std::string both = exchange("POST /upload HTTP/1.1\r\nHost: localhost\r\nContent-Length: 5\r\n"
+                                "Transfer-Encoding: chunked\r\n\r\n0\r\n\r\n" + hidden);
+    
+    server.Stop();
+    server_thread.join();
+    
+    EXPECT_EQ(chunked.rfind("HTTP/1.1 501", 0), 0u) << chunked;
+    EXPECT_EQ(both.rfind("HTTP/1.1 400", 0), 0u) << both;
+    EXPECT_EQ(chunked.find("HTTP/1.1", 1), std::string::npos);
+    EXPECT_EQ(both.find("HTTP/1.1", 1), std::string::npos);
+    EXPECT_EQ(smuggled.load(), 0);
+}
+
+TEST(ServerTest, ConflictingContentLengthIsNotPipelined) {
+    Config config;
+    config.host = "127.0.0.1";
+    config.port = 0;
+    config.enable_logging = false;
+    
+    Server server(config);
+    std::atomic<int> smuggled{0};
+    server.Get("/admin", [&smuggled](const HttpRequest&) {
+        smuggled++;
+        return Ok("admin");
+    });
+    server.Post("/upload", [](const HttpRequest& req) {
+        return Ok("body=" + req.body);
+    });
+    std::thread server_thread([&server]() {
+        server.Start();
+    });
+    WaitUntilRunning(server);
+    
+    auto exchange = [&server](const std::string& requests) {
+        std::string response;
+        int fd = ConnectTo(server.Port());
+        EXPECT_GE(fd, 0);
+        if (fd >= 0) {
+            send(fd, requests.c_str(), requests.size(), 0);
+            shutdown(fd, SHUT_WR);
+            char buffer[1024];
+            ssize_t n;
+            while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+                response.append(buffer, static_cast<size_t>(n));
+            }
+            close(fd);
+        }
+        return response;
+    };
+    // Framed by the first length, the second request is /admin; by the
+    // second, it is the body. Either reading is wrong: the request is refused.
+    const std::string hidden = "GET /admin HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    std::string conflicting = exchange("POST /upload HTTP/1.1\r\nHost: localhost\r\nContent-Length: 0\r\n"
+                                       "Content-Length: " + std::to_string(hidden.size()) + "\r\n\r\n" + hidden);
+    // Agreeing repeats frame the body once, and the next request after it
+    std::string agreeing = exchange("POST /upload HTTP/1.1\r\nHost: localhost\r\nContent-Length: 3\r\n"
+                                    "Content-Length: 3\r\n\r\nabcPOST /upload HTTP/1.1\r\nHost: localhost\r\n"
+                                    "Content-Length: 2\r\nConnection: close\r\n\r\nxy");
+    
+    server.Stop();
+    server_thread.join();
+    
+    EXPECT_EQ(conflicting.rfind("HTTP/1.1 400", 0), 0u) << conflicting;
+    EXPECT_EQ(conflicting.find("HTTP/1.1", 1), std::string::npos);
+    EXPECT_EQ(smuggled.load(), 0);
+    
+    size_t first = agreeing.find("body=abc");
+    ASSERT_NE(first, std::string::npos) << agreeing;
+    EXPECT_NE(agreeing.find("body=xy", first), std::string::npos) << agreeing;
+}
+
+TEST(ServerTest, KeepAliveServesPipelinedRequestsInOrder) {
+    Config config;
+    config.host = "127.0.0.1";
+    config.port = 0;
+    config.max_requests_per_connection = 3;
+    config.enable_logging = false;
+    
+    Server server(config);
+    server.Get("/echo", [](const HttpRequest& req) {
+        return Ok("n=" + req.query_params.at("n"));
+    });
+    
+    std::thread server_thread([&server]() {
+        server.Start();
+    });
+    WaitUntilRunning(server);
+    
+    int fd = ConnectTo(server.Port());
+    EXPECT_GE(fd, 0);
+    
+    std::string response;
+    if (fd >= 0) {
+        // All three in one write; the third reaches the per-connection limit
+        std::string requests;
+        for (int i = 1; i <= 3; ++i) {
+            requests += "GET /echo?n=" + std::to_string(i) + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+        }
+        send(fd, requests.c_str(), requests.size(), 0);
+        
+        char buffer[1024];
+        ssize_t n;
+        while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+            response.append(buffer, static_cast<size_t>(n));
+        }
+        close(fd);
+    }
+    
+    server.Stop();
+    server_thread.join();
+    
+    size_t first = response.find("n=1");
+    size_t second = response.find("n=2");
+    size_t third = response.find("n=3");
+    ASSERT_NE(first, std::string::npos);
+    ASSERT_NE(second, std::string::npos);
+    ASSERT_NE(third, std::string::npos);
+    EXPECT_LT(first, second);
+    EXPECT_LT(second, third);
+    EXPECT_NE(response.substr(0, first).find("Connection: keep-alive"), std::string::npos);
+    EXPECT_NE(response.substr(second).find("Connection: close"), std::string::npos);
+}
+
+TEST(ServerTest, IdleKeepAliveConnectionClosed) {
+    Config config;
+    config.host = "127.0.0.1";
+    config.port = 0;
+    config.keep_alive_timeout_seconds = 1;
+    config.enable_logging = false;
+    
+    Server server(config);
+    server.Get("/ping", [](const HttpRequest& /*req*/) {
+        return Ok("pong");
+    });
+    
+    std::thread server_thread([&server]() {
+        server.Start();
+    });
+    WaitUntilRunning(server);
+    
+    int fd = ConnectTo(server.Port());
+    EXPECT_GE(fd, 0);
+    
+    std::string response;
+    std::chrono::steady_clock::duration idle{};
+    if (fd >= 0) {
+        std::string request = "GET /ping HTTP/1.1\r\nHost: localhost\r\n\r\n";
+        send(fd, request.c_str(), request.size(), 0);
+        
+        // The connection stays open after the response until it idles out
+        char buffer[1024];
+        ssize_t n;
+        std::chrono::steady_clock::time_point answered{};
+        while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+            response.append(buffer, static_cast<size_t>(n));
+            answered = std::chrono::steady_clock::now();
+        }
+        idle = std::chrono::steady_clock::now() - answered;
+        close(fd);
+    }
+    
+    server.Stop();
+    server_thread.join();
+    
+    EXPECT_NE(response.find("pong"), std::string::npos);
+    EXPECT_NE(response.find("Connection: keep-alive"), std::string::npos);
+    EXPECT_GE(idle, std::chrono::milliseconds(900));
+    EXPECT_LT(idle, std::chrono::seconds(5));
+}
+
+TEST(ServerTest, ServesStaticFiles) {
+    char directory[] = "/tmp/server_static_XXXXXX";
+    ASSERT_NE(mkdtemp(directory), nullptr);
+    const std::string path = std::string(directory) + "/app.js";
+    const std::string contents(300000, 'j');
+    {
+        FILE* file = fopen(path.c_str(), "wb");
+        ASSERT_NE(file, nullptr);
+        fwrite(contents.data(), 1, contents.size(), file);
+        fclose(file);
+    }
+    
+    Config config;
+    config.host = "127.0.0.1";
+    config.port = 0;
+    config.enable_logging = false;
+    
+    Server server(config);
+    server.ServeStatic("/static", directory);
+    
+    std::thread server_thread([&server]() {
+        server.Start();
+    });
+    WaitUntilRunning(server);
+    
+    int fd = ConnectTo(server.Port());
+    EXPECT_GE(fd, 0);
+    
+    std::string response;
+    if (fd >= 0) {
+        std::string request = "GET /static/app.js HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+        send(fd, request.c_str(), request.size(), 0);
+        
+        char buffer[65536];
+        ssize_t n;
+        while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+            response.append(buffer, static_cast<size_t>(n));
+        }
+        close(fd);
+    }
+    
+    server.Stop();
+    server_thread.join();
+    unlink(path.c_str());
+    rmdir(directory);
+    
+    EXPECT_NE(response.find("200 OK"), std::string::npos);
+    EXPECT_NE(response.find("Content-Type: application/javascript"), std::string::npos);
+    size_t body = response.find("\r\n\r\n");
+    ASSERT_NE(body, std::string::npos);
+    EXPECT_EQ(response.substr(body + 4), contents);
+}
+
+TEST(ServerTest, RefusesConnectionsOverCap) {
+    Config config;
+    config.host = "127.0.0.1";
+    config.port = 0;
+    config.max_connections = 1;
+    config.retry_after_seconds = 7;
+    config.enable_logging = false;
+    
+    Server server(config);
+    
+    std::thread server_thread([&server]() {
+        server.Start();
+    });
+    WaitUntilRunning(server);
+    
+    // The first connection holds the only slot
+    int first = ConnectTo(server.Port());
+    EXPECT_GE(first, 0);
+    for (int i = 0; i < 100 && server.Admission().open_connections == 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(server.Admission().open_connections, 1u);
+    
+    std::string response;
+    int second = ConnectTo(server.Port());
+    EXPECT_GE(second, 0);
+    if (second >= 0) {
+        char buffer[1024];
+        ssize_t n;
+        while ((n = recv(second, buffer, sizeof(buffer), 0)) > 0) {
+            response.append(buffer, static_cast<size_t>(n));
+        }
+        close(second);
+    }
+    AdmissionStats stats = server.Admission();
+    if (first >= 0) {
+        close(first);
+    }
+    
+    server.Stop();
+    server_thread.join();
+    
+    EXPECT_NE(response.find("503 Service Unavailable"), std::string::npos);
+    EXPECT_NE(response.find("Retry-After: 7"), std::string::npos);
+    EXPECT_EQ(stats.rejected_connections, 1u);
+    EXPECT_EQ(stats.open_connections, 1u);
+}
+
+TEST(ServerTest, ShedsRequestsWhileWorkerQueueStands) {
+    Config config;
+    config.host = "127.0.0.1";
+    config.port = 0;
+    config.thread_pool_size = 1;
+    config.queue_delay_target_ms = 5;
+    config.queue_delay_interval_ms = 10;
+    config.enable_logging = false;
+    
+    Server server(config);
+    server.Get("/slow", [](const HttpRequest& /*req*/) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        return Ok("done");
+    });
+    
+    std::thread server_thread([&server]() {
+        server.Start();
+    });
+    WaitUntilRunning(server);
+    
+    // Ten requests queue behind one worker; by the time the late one
+    // arrives they have been waiting well past the target
+    const std::string request = "GET /slow HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+    std::vector<int> queued;
+    for (int i = 0; i < 10; ++i) {
+        int fd = ConnectTo(server.Port());
+        if (fd >= 0) {
+            send(fd, request.c_str(), request.size(), 0);
+            queued.push_back(fd);
+        }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(120));
+    
+    std::string response;
+    int late = ConnectTo(server.Port());
+    EXPECT_GE(late, 0);
+    if (late >= 0) {
+        send(late, request.c_str(), request.size(), 0);
+        char buffer[1024];
+        ssize_t n;
+        while ((n = recv(late, buffer, sizeof(buffer), 0)) > 0) {
+            response.append(buffer, static_cast<size_t>(n));
+        }
+        close(late);
+    }
+    for (int fd : queued) {
+        close(fd);
+    }
+    AdmissionStats stats = server.Admission();
+    
+    server.Stop();
+    server_thread.join();
+    
+    EXPECT_NE(response.find("503 Service Unavailable"), std::string::npos);
+    EXPECT_NE(response.find("Retry-After: 1"), std::string::npos);
+    EXPECT_GE(stats.shed_requests, 1u);
+}
+
+TEST(ServerTest, ShedsRequestsWhenRingQueueIsFull) {
+    Config config;
+    config.host = "127.0.0.1";
+    config.port = 0;
+    config.thread_pool_size = 1;
+    config.thread_pool_scheduling = "shared";
+    config.thread_pool_queue = "ring";
+    config.thread_pool_queue_capacity = 2;
+    config.queue_delay_target_ms = 0;
+    config.enable_logging = false;
+    
+    Server server(config);
+    server.Get("/slow", [](const HttpRequest& /*req*/) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        return Ok("done");
+    });
+    
+    std::thread server_thread([&server]() {
+        server.Start();
+    });
+    WaitUntilRunning(server);
+    
+    // One request on the worker and two in the ring fill it
+    const std::string request = "GET /slow HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+    std::vector<int> queued;
+    for (int i = 0; i < 3; ++i) {
+        int fd = ConnectTo(server.Port());
+        if (fd >= 0) {
+            send(fd, request.c_str(), request.size(), 0);
+            queued.push_back(fd);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    
+    std::string response;
+    auto start = std::chrono::steady_clock::now();
+    int late = ConnectTo(server.Port());
+    EXPECT_GE(late, 0);
+    if (late >= 0) {
+        send(late, request.c_str(), request.size(), 0);
+        char buffer[1024];
+        ssize_t n;
+        while ((n = recv(late, buffer, sizeof(buffer), 0)) > 0) {
+            response.append(buffer, static_cast<size_t>(n));
+        }
+        close(late);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    for (int fd : queued) {
+        close(fd);
+    }
+    AdmissionStats stats = server.Admission();
+    
+    server.Stop();
+    server_thread.join();
+    
+    EXPECT_NE(response.find("503 Service Unavailable"), std::string::npos);
+    EXPECT_LT(elapsed, std::chrono::milliseconds(150));
+    EXPECT_EQ(stats.shed_requests, 1u);
+}
+
+TEST(ServerTest, ShedsWebSocketUpgradeWhenRingQueueIsFull) {
+    Config config;
+    config.host = "127.0.0.1";
+    config.port = 0;
+    config.thread_pool_size = 1;
+    config.thread_pool_scheduling = "shared";
+    config.thread_pool_queue = "ring";
+    config.thread_pool_queue_capacity = 2;
+    config.queue_delay_target_ms = 0;
+    config.enable_logging = false;
+    
+    Server server(config);
+    server.Get("/slow", [](const HttpRequest& /*req*/) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        return Ok("done");
+    });
+    server.PushWebSocketEvery("/ws/ticks", std::chrono::milliseconds(20), []() {
+        return std::string("tick");
+    });
+    
+    std::thread server_thread([&server]() {
+        server.Start();
+    });
+    WaitUntilRunning(server);
+    
+    const std::string request = "GET /slow HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+    std::vector<int> queued;
+    for (int i = 0; i < 3; ++i) {
+        int fd = ConnectTo(server.Port());
+        if (fd >= 0) {
+            send(fd, request.c_str(), request.size(), 0);
+            queued.push_back(fd);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    
+    // The upgrade is answered by the loop at once rather than waiting on
+    // the ring, which would stall the loop behind the slow requests
+    std::string response;
+    auto start = std::chrono::steady_clock::now();
+    int late = ConnectTo(server.Port());
+    EXPECT_GE(late, 0);
+    if (late >= 0) {
+        std::string upgrade =
+            "GET /ws/ticks HTTP/1.1\r\n"
+            "Host: localhost\r\n"
+            "Upgrade: websocket\r\n"
+            "Connection: Upgrade\r\n"
+            "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+            "Sec-WebSocket-Version: 13\r\n"
+            "\r\n";
+        send(late, upgrade.c_str(), upgrade.size(), 0);
+        char buffer[1024];
+        ssize_t n;
+        while ((n = recv(late, buffer, sizeof(buffer), 0)) > 0) {
+            response.append(buffer, static_cast<size_t>(n));
+        }
+        close(late);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    for (int fd : queued) {
+        close(fd);
+    }
+    AdmissionStats stats = server.Admission();
+    
+    server.Stop();
+    server_thread.join();
+    
+    EXPECT_NE(response.find("503 Service Unavailable"), std::string::npos) << response;
+    EXPECT_LT(elapsed, std::chrono::milliseconds(150));
+    EXPECT_EQ(stats.shed_requests, 1u);
+}
+
+TEST(ServerTest, InlineRoutesBypassBusyWorkers) {
+    Config config;
+    config.host = "127.0.0.1";
+    config.port = 0;
+    config.thread_pool_size = 1;
+    config.enable_logging = false;
+    
+    Server server(config);
+    server.Get("/slow", [](const HttpRequest& /*req*/) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        return Ok("done");
+    });
+    server.Get("/health", [](const HttpRequest& /*req*/) {
+        return Ok("healthy");
+    }, RouteMode::Inline);
+    
+    std::thread server_thread([&server]() {
+        server.Start();
+    });
+    WaitUntilRunning(server);
+    
+    // Occupy the only worker
+    int slow = ConnectTo(server.Port());
+    EXPECT_GE(slow, 0);
+    const std::string slow_request = "GET /slow HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+    if (slow >= 0) {
+        send(slow, slow_request.c_str(), slow_request.size(), 0);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    
+    // Three pipelined health checks, answered by the loop in the meantime
+    std::string pipelined;
+    for (int i = 0; i < 3; ++i) {
+        pipelined += std::string("GET /health HTTP/1.1\r\nHost: localhost\r\n") +
+                     (i == 2 ? "Connection: close\r\n" : "") + "\r\n";
+    }
+    std::string response;
+    auto start = std::chrono::steady_clock::now();
+    int fd = ConnectTo(server.Port());
+    EXPECT_GE(fd, 0);
+    if (fd >= 0) {
+        send(fd, pipelined.c_str(), pipelined.size(), 0);
+        char buffer[1024];
+        ssize_t n;
+        while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+            response.append(buffer, static_cast<size_t>(n));
+        }
+        close(fd);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    if (slow >= 0) {
+        close(slow);
+    }
+    
+    server.Stop();
+    server_thread.join();
+    
+    size_t answers = 0;
+    for (size_t pos = response.find("healthy"); pos != std::string::npos; pos = response.find("healthy", pos + 1)) {
+        ++answers;
+    }
+    EXPECT_EQ(answers, 3u);
+    EXPECT_LT(elapsed, std::chrono::milliseconds(400));
+}
+
+TEST(ServerTest, ServesOverTcpAndUnixSocket) {
+    char directory[] = "/tmp/server_unix_XXXXXX";
+    ASSERT_NE(mkdtemp(directory), nullptr);
+    const std::string path = std::string(directory) + "/monitord.sock";
+    
+    Config config;
+    config.listen = "127.0.0.1:0,unix:" + path;
+    config.reactor_count = 2;
+    config.enable_logging = false;
+    
+    Server server(config);
+    server.Get("/ping", [](const HttpRequest& /*req*/) {
+        return Ok("pong");
+    });
+    
+    std::thread server_thread([&server]() {
+        server.Start();
+    });
+    WaitUntilRunning(server);
+    
+    const std::string request = "GET /ping HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+    auto exchange = [&request](int fd) {
+        std::string response;
+        send(fd, request.c_str(), request.size(), 0);
+        char buffer[1024];
+        ssize_t n;
+        while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+            response.append(buffer, static_cast<size_t>(n));
+        }
+        close(fd);
+        return response;
+    };
+    
+    std::string tcp_response;
+    int tcp = ConnectTo(server.Port());
+    EXPECT_GE(tcp, 0);
+    if (tcp >= 0) {
+        tcp_response = exchange(tcp);
+    }
+    
+    std::string unix_response;
+    int local = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    snprintf(address.sun_path, sizeof(address.sun_path), "%s", path.c_str());
+    EXPECT_EQ(connect(local, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)), 0);
+    unix_response = exchange(local);
+    
+    server.Stop();
+    server_thread.join();
+    
+    EXPECT_NE(tcp_response.find("pong"), std::string::npos);
+    EXPECT_NE(unix_response.find("pong"), std::string::npos);
+    // The socket file goes away with the server
+    EXPECT_NE(access(path.c_str(), F_OK), 0);
+    rmdir(directory);
+}
+
+TEST(ServerTest, MultiplexesHttp2Streams) {
+    Config config;
+    config.host = "127.0.0.1";
+    config.port = 0;
+    config.thread_pool_size = 2;
+    config.enable_logging = false;
+    
+    Server server(config);
+    server.Get("/slow", [](const HttpRequest& /*req*/) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        return Ok("slow");
+    });
+    server.Get("/health", [](const HttpRequest& /*req*/) {
+        return Ok("healthy");
+    }, RouteMode::Inline);
+    
+    std::thread server_thread([&server]() {
+        server.Start();
+    });
+    WaitUntilRunning(server);
+    
+    auto frame = [](uint8_t type, uint8_t flags, uint32_t stream_id, const std::string& payload) {
+        std::string out;
+        out.push_back(static_cast<char>(payload.size() >> 16));
+        out.push_back(static_cast<char>(payload.size() >> 8));
+        out.push_back(static_cast<char>(payload.size()));
+        out.push_back(static_cast<char>(type));
+        out.push_back(static_cast<char>(flags));
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            out.push_back(static_cast<char>(stream_id >> shift));
+        }
+        return out + payload;
+    };
+    
+    // Prior knowledge: preface, empty SETTINGS, then two requests at once
+    HpackEncoder encoder;
+    std::string request = Http2Session::kPreface + frame(0x4, 0, 0, "");
+    for (const auto& [stream_id, path] : {std::make_pair(1u, "/slow"), std::make_pair(3u, "/health")}) {
+        std::string block;
+        encoder.Encode({{":method", "GET"}, {":scheme", "http"}, {":path", path}, {":authority", "localhost"}}, block);
+        request += frame(0x1, 0x4 | 0x1, stream_id, block);
+    }
+    
+    HpackDecoder decoder;
+    std::vector<uint32_t> finished;
+    std::string bodies[4];
+    std::string statuses[4];
+    int fd = ConnectTo(server.Port());
+    EXPECT_GE(fd, 0);
+    if (fd >= 0) {
+        send(fd, request.c_str(), request.size(), 0);
+        std::string input;
+        char buffer[4096];
+        ssize_t n;
+        while (finished.size() < 2 && (n = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+            input.append(buffer, static_cast<size_t>(n));
+            while (input.size() >= 9) {
+                const auto* h = reinterpret_cast<const uint8_t*>(input.data());
+                size_t length = (static_cast<size_t>(h[0]) << 16) | (h[1] << 8) | h[2];
+                if (input.size() < 9 + length) {
+                    break;
+                }
+                uint32_t stream_id = h[8];
+                std::string payload = input.substr(9, length);
+                if (h[3] == 0x1 && stream_id < 4) {
+                    statuses[stream_id] = decoder.Decode(payload)[0].second;
+                } else if (h[3] == 0x0 && stream_id < 4) {
+                    bodies[stream_id] += payload;
+                    if (h[4] & 0x1) {
+                        finished.push_back(stream_id);
+                    }
+                }
+                input.erase(0, 9 + length);
+            }
+        }
+        close(fd);
+    }
+    
+    server.Stop();
+    server_thread.join();
+    
+    // The health check is not held up behind the slow stream
+    ASSERT_EQ(finished.size(), 2u);
+    EXPECT_EQ(finished[0], 3u);
+    EXPECT_EQ(statuses[1], "200");
+    EXPECT_EQ(statuses[3], "200");
+    EXPECT_EQ(bodies[1], "slow");
+    EXPECT_EQ(bodies[3], "healthy");
+}
+
+TEST(ServerTest, CompressesResponsesForClientsThatAcceptIt) {
+    Config config;
+    config.host = "127.0.0.1";
+    config.port = 0;
+    config.enable_logging = false;
+    
+    std::string json = "[";
+    for (int i = 0; i < 500; ++i) {
+        json += (i ? "," : "") + std::string("{\"cpu_usage\":12.5,\"memory_usage\":48.25}");
+    }
+    json += "]";
+    
+    Server server(config);
+    server.Get("/range", [&json](const HttpRequest& /*req*/) {
+        return JsonResponse(json);
+    });
+    
+    std::thread server_thread([&server]() {
+        server.Start();
+    });
+    WaitUntilRunning(server);
+    
+    auto fetch = [&server](const std::string& accept_encoding) {
+        std::string request = "GET /range HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n" +
+                              (accept_encoding.empty() ? "" : "Accept-Encoding: " + accept_encoding + "\r\n") + "\r\n";
+        std::string response;
+        int fd = ConnectTo(server.Port());
+        EXPECT_GE(fd, 0);
+        if (fd >= 0) {
+            send(fd, request.c_str(), request.size(), 0);
+            char buffer[4096];
+            ssize_t n;
+            while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+                response.append(buffer, static_cast<size_t>(n));
+            }
+            close(fd);
+        }
+        return response;
+    };
+    std::string compressed = fetch("gzip, deflate, br");
+    std::string plain = fetch("");
+    
+    server.Stop();
+    server_thread.join();
+    
+    EXPECT_NE(compressed.find("Content-Encoding: gzip"), std::string::npos);
+    EXPECT_NE(compressed.find("Vary: Accept-Encoding"), std::string::npos);
+    size_t body = compressed.find("\r\n\r\n");
+    ASSERT_NE(body, std::string::npos);
+    EXPECT_EQ(compressed.compare(body + 4, 2, "\x1f\x8b"), 0);
+    EXPECT_LT(compressed.size() - body - 4, json.size() / 4);
+    
+    EXPECT_EQ(plain.find("Content-Encoding"), std::string::npos);
+    EXPECT_EQ(plain.substr(plain.find("\r\n\r\n") + 4), json);
+}
+
+TEST(ServerTest, CriticalRoutesSkipBusyWorkers) {
+    Config config;
+    config.host = "127.0.0.1";
+    config.port = 0;
+    config.thread_pool_size = 1;
+    config.thread_pool_critical_threads = 1;
+    config.thread_pool_bulk_threads = 1;
+    config.enable_logging = false;
+    
+    Server server(config);
+    server.Get("/slow", [](const HttpRequest& /*req*/) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        return Ok("done");
+    });
+    server.Get("/report", [](const HttpRequest& /*req*/) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        return Ok("done");
+    }, RouteMode::Pool, TaskPriority::Bulk);
+    server.Get("/status", [](const HttpRequest& /*req*/) {
+        return Ok("up");
+    }, RouteMode::Pool, TaskPriority::Critical);
+    
+    std::thread server_thread([&server]() {
+        server.Start();
+    });
+    WaitUntilRunning(server);
+    
+    // The Normal worker is busy with one request and has another queued;
+    // the bulk worker is busy too
+    std::vector<int> busy;
+    for (const char* path : {"/slow", "/slow", "/report"}) {
+        int fd = ConnectTo(server.Port());
+        if (fd >= 0) {
+            std::string request = std::string("GET ") + path + " HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+            send(fd, request.c_str(), request.size(), 0);
+            busy.push_back(fd);
+        }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    
+    std::string response;
+    auto start = std::chrono::steady_clock::now();
+    int fd = ConnectTo(server.Port());
+    EXPECT_GE(fd, 0);
+    if (fd >= 0) {
+        const std::string request = "GET /status HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+        send(fd, request.c_str(), request.size(), 0);
+        char buffer[1024];
+        ssize_t n;
+        while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+            response.append(buffer, static_cast<size_t>(n));
+        }
+        close(fd);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    for (int open : busy) {
+        close(open);
+    }
+    
+    server.Stop();
+    server_thread.join();
+    
+    EXPECT_NE(response.find("200 OK"), std::string::npos);
+    EXPECT_NE(response.find("up"), std::string::npos);
+    EXPECT_LT(elapsed, std::chrono::milliseconds(150));
+}
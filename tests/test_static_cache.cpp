@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+#include "static_cache.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace http;
+
+class StaticFileCacheTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ASSERT_NE(mkdtemp(directory_), nullptr);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(directory_);
+    }
+
+    void WriteFile(const std::string& name, const std::string& contents) {
+        FILE* file = fopen((std::string(directory_) + "/" + name).c_str(), "wb");
+        ASSERT_NE(file, nullptr);
+        fwrite(contents.data(), 1, contents.size(), file);
+        fclose(file);
+    }
+
+    static std::string HeaderValue(const HttpResponse& response, const std::string& name) {
+        std::string headers = response.SerializeHeaders();
+        size_t start = headers.find(name + ": ");
+        if (start == std::string::npos) {
+            return "";
+        }
+        start += name.size() + 2;
+        return headers.substr(start, headers.find("\r\n", start) - start);
+    }
+
+    char directory_[32] = "/tmp/static_cache_XXXXXX";
+};
+
+TEST_F(StaticFileCacheTest, HitSharesRenderedHeadersAndBody) {
+    WriteFile("site.css", "body { color: red; }");
+    StaticFileCache cache(directory_, 1024 * 1024);
+
+    HttpResponse first = cache.Serve("site.css");
+    HttpResponse second = cache.Serve("site.css");
+
+    EXPECT_EQ(first.GetStatus(), HttpStatus::OK);
+    ASSERT_NE(first.GetSharedBody(), nullptr);
+    EXPECT_EQ(first.GetSharedBody(), second.GetSharedBody());
+    EXPECT_EQ(second.GetBody(), "body { color: red; }");
+    EXPECT_EQ(HeaderValue(second, "Content-Type"), "text/css");
+    EXPECT_EQ(HeaderValue(second, "Content-Length"), "20");
+    EXPECT_FALSE(HeaderValue(second, "ETag").empty());
+    EXPECT_EQ(cache.Entries(), 1u);
+    EXPECT_EQ(cache.CachedBytes(), 20u);
+}
+
+TEST_F(StaticFileCacheTest, MatchingETagGetsNotModified) {
+    WriteFile("index.html", "<html></html>");
+    StaticFileCache cache(directory_, 1024 * 1024);
+
+    std::string etag = HeaderValue(cache.Serve("index.html"), "ETag");
+    ASSERT_FALSE(etag.empty());
+
+    HttpResponse cached = cache.Serve("index.html", "\"other\", " + etag);
+    EXPECT_EQ(cached.GetStatus(), HttpStatus::NOT_MODIFIED);
+    EXPECT_TRUE(cached.GetBody().empty());
+    EXPECT_EQ(HeaderValue(cached, "ETag"), etag);
+
+    EXPECT_EQ(cache.Serve("index.html", "\"other\"").GetStatus(), HttpStatus::OK);
+}
+
+TEST_F(StaticFileCacheTest, ChangedFileIsServedAfresh) {
+    WriteFile("data.json", "{}");
+    StaticFileCache cache(directory_, 1024 * 1024);
+    EXPECT_EQ(cache.Serve("data.json").GetBody(), "{}");
+
+    WriteFile("data.json", "{\"changed\": true}");
+    if (cache.WatchFd() >= 0) {
+        cache.OnWatchEvents();
+        EXPECT_EQ(cache.Entries(), 0u);
+    }
+
+    EXPECT_EQ(cache.Serve("data.json").GetBody(), "{\"changed\": true}");
+}
+
+TEST_F(StaticFileCacheTest, RejectsPathsOutsideDirectory) {
+    WriteFile("secret.txt", "secret");
+    ASSERT_EQ(mkdir((std::string(directory_) + "/public").c_str(), 0755), 0);
+    StaticFileCache cache(std::string(directory_) + "/public", 1024 * 1024);
+
+    EXPECT_EQ(cache.Serve("../secret.txt").GetStatus(), HttpStatus::FORBIDDEN);
+    EXPECT_EQ(cache.Serve("missing.txt").GetStatus(), HttpStatus::NOT_FOUND);
+    EXPECT_EQ(cache.Entries(), 0u);
+}
+
+TEST_F(StaticFileCacheTest, EvictsLeastRecentlyUsedAndStreamsLargeFiles) {
+    // 160 bytes hold eight 20-byte files; larger files are not cached
+    StaticFileCache cache(directory_, 160);
+    for (char name = 'a'; name <= 'i'; ++name) {
+        WriteFile(std::string(1, name), std::string(20, name));
+    }
+    WriteFile("large", std::string(21, 'x'));
+
+    std::shared_ptr<const std::string> a = cache.Serve("a").GetSharedBody();
+    std::shared_ptr<const std::string> b = cache.Serve("b").GetSharedBody();
+    for (char name = 'c'; name <= 'h'; ++name) {
+        cache.Serve(std::string(1, name));
+    }
+    cache.Serve("a");
+    cache.Serve("i");
+
+    EXPECT_EQ(cache.Entries(), 8u);
+    EXPECT_EQ(cache.CachedBytes(), 160u);
+    EXPECT_EQ(cache.Serve("a").GetSharedBody(), a);
+    EXPECT_NE(cache.Serve("b").GetSharedBody(), b);
+
+    HttpResponse large = cache.Serve("large");
+    ASSERT_NE(large.GetFileBody(), nullptr);
+    EXPECT_EQ(large.GetFileBody()->Length(), 21u);
+    EXPECT_EQ(cache.Entries(), 8u);
+}
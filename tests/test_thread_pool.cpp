@@ -3,9 +3,51 @@
 #include <thread>
 #include <chrono>
 #include <atomic>
+#include <mutex>
+#include <vector>
+#include <set>
+#include <array>
+#include <memory>
+#include <string>
+#include <cstdlib>
+#include <new>
+#include <algorithm>
+#include <utility>
+#include <future>
+#include <pthread.h>
+#if defined(__linux__)
+#include <sched.h>
+#endif
 
 using namespace http;
 
+// Counts operator new calls while counting is on, to check that posting
+// tasks does not allocate
+namespace {
+std::atomic<bool> counting_allocations{false};
+std::atomic<size_t> allocations{0};
+} // namespace
+
+// Out of line, like the deletes below, so the compiler does not pair the
+// malloc() and free() inside them with new and delete expressions
+__attribute__((noinline)) void* operator new(size_t size) {
+    if (counting_allocations.load(std::memory_order_relaxed)) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, size_t /*size*/) noexcept {
+    std::free(p);
+}
+
 TEST(ThreadPoolTest, ExecuteTask) {
     ThreadPool pool(2);
     
@@ -81,3 +123,515 @@ TEST(ThreadPoolTest, ConcurrentExecution) {
     EXPECT_GT(max_concurrent.load(), 1);
     EXPECT_LE(max_concurrent.load(), 4);
 }
+
+TEST(ThreadPoolTest, ReportsQueueDelay) {
+    ThreadPool pool(1);
+    
+    std::mutex mutex;
+    std::vector<std::chrono::nanoseconds> waits;
+    std::vector<bool> empties;
+    pool.SetQueueDelayObserver([&](std::chrono::nanoseconds wait, bool queue_empty) {
+        std::lock_guard<std::mutex> lock(mutex);
+        waits.push_back(wait);
+        empties.push_back(queue_empty);
+    });
+    
+    // The second task queues behind the first for about 20ms
+    auto first = pool.Enqueue([]() { std::this_thread::sleep_for(std::chrono::milliseconds(20)); });
+    auto second = pool.Enqueue([]() {});
+    first.get();
+    second.get();
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    ASSERT_EQ(waits.size(), 2u);
+    EXPECT_GE(waits[1], std::chrono::milliseconds(15));
+    EXPECT_TRUE(empties[1]);
+}
+
+TEST(ThreadPoolTest, WorkStealingRunsExternalAndNestedTasks) {
+    ThreadPool pool(4, ThreadPoolOptions{Scheduling::WorkStealing});
+    EXPECT_EQ(pool.GetScheduling(), Scheduling::WorkStealing);
+    
+    // Submitted from outside (the injector) and from the workers themselves
+    // (their own deques)
+    std::atomic<int> counter{0};
+    std::vector<std::future<void>> futures;
+    std::mutex nested_mutex;
+    std::vector<std::future<void>> nested;
+    for (int i = 0; i < 1000; ++i) {
+        futures.push_back(pool.Enqueue([&]() {
+            counter++;
+            auto inner = pool.Enqueue([&counter]() { counter++; });
+            std::lock_guard<std::mutex> lock(nested_mutex);
+            nested.push_back(std::move(inner));
+        }));
+    }
+    for (auto& future : futures) {
+        future.get();
+    }
+    {
+        std::lock_guard<std::mutex> lock(nested_mutex);
+        for (auto& future : nested) {
+            future.get();
+        }
+    }
+    
+    EXPECT_EQ(counter.load(), 2000);
+    EXPECT_EQ(pool.PendingTasks(), 0u);
+    EXPECT_EQ(pool.Enqueue([]() { return 7; }).get(), 7);
+}
+
+TEST(ThreadPoolTest, WorkStealingSpreadsOneWorkersTasks) {
+    ThreadPool pool(4, ThreadPoolOptions{Scheduling::WorkStealing});
+    
+    // One task fans out onto its worker's deque; idle workers steal them
+    std::mutex mutex;
+    std::set<std::thread::id> ran_on;
+    std::vector<std::future<void>> children;
+    pool.Enqueue([&]() {
+        for (int i = 0; i < 16; ++i) {
+            children.push_back(pool.Enqueue([&]() {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                std::lock_guard<std::mutex> lock(mutex);
+                ran_on.insert(std::this_thread::get_id());
+            }));
+        }
+    }).get();
+    
+    auto start = std::chrono::steady_clock::now();
+    for (auto& child : children) {
+        child.get();
+    }
+    EXPECT_GT(ran_on.size(), 1u);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(150));
+}
+
+TEST(ThreadPoolTest, WorkStealingReportsQueueDelay) {
+    ThreadPool pool(1, ThreadPoolOptions{Scheduling::WorkStealing});
+    
+    std::mutex mutex;
+    std::vector<std::chrono::nanoseconds> waits;
+    std::vector<bool> empties;
+    pool.SetQueueDelayObserver([&](std::chrono::nanoseconds wait, bool queue_empty) {
+        std::lock_guard<std::mutex> lock(mutex);
+        waits.push_back(wait);
+        empties.push_back(queue_empty);
+    });
+    
+    auto first = pool.Enqueue([]() { std::this_thread::sleep_for(std::chrono::milliseconds(20)); });
+    auto second = pool.Enqueue([]() {});
+    first.get();
+    second.get();
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    ASSERT_EQ(waits.size(), 2u);
+    EXPECT_GE(waits[1], std::chrono::milliseconds(15));
+    EXPECT_TRUE(empties[1]);
+    EXPECT_THROW(ParseScheduling("fifo"), std::invalid_argument);
+    EXPECT_EQ(ParseScheduling("work_stealing"), Scheduling::WorkStealing);
+}
+
+TEST(ThreadPoolTest, RingQueueRunsTasks) {
+    ThreadPool pool(4, ThreadPoolOptions{Scheduling::SharedQueue, TaskQueue::Ring, 64});
+    EXPECT_EQ(pool.GetTaskQueue(), TaskQueue::Ring);
+    
+    // Far more tasks than slots: Enqueue waits for room
+    std::atomic<int> counter{0};
+    std::vector<std::future<void>> futures;
+    for (int i = 0; i < 1000; ++i) {
+        futures.push_back(pool.Enqueue([&counter]() { counter++; }));
+    }
+    for (auto& future : futures) {
+        future.get();
+    }
+    
+    EXPECT_EQ(counter.load(), 1000);
+    EXPECT_EQ(pool.PendingTasks(), 0u);
+    EXPECT_EQ(pool.Enqueue([]() { return std::string("ring"); }).get(), "ring");
+}
+
+TEST(ThreadPoolTest, RingTryEnqueueFailsWhenFull) {
+    ThreadPool pool(1, ThreadPoolOptions{Scheduling::SharedQueue, TaskQueue::Ring, 2});
+    
+    // Hold the only worker so queued tasks stay in the ring
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::promise<void> started;
+    auto blocker = pool.Enqueue([&started, released]() {
+        started.set_value();
+        released.wait();
+    });
+    started.get_future().wait();
+    
+    auto first = pool.TryEnqueue([]() { return 1; });
+    auto second = pool.TryEnqueue([]() { return 2; });
+    ASSERT_TRUE(first.has_value());
+    ASSERT_TRUE(second.has_value());
+    EXPECT_EQ(pool.PendingTasks(), 2u);
+    
+    bool ran = false;
+    EXPECT_FALSE(pool.TryEnqueue([&ran]() { ran = true; }).has_value());
+    EXPECT_EQ(pool.PendingTasks(), 2u);
+    
+    release.set_value();
+    blocker.get();
+    EXPECT_EQ(first->get(), 1);
+    EXPECT_EQ(second->get(), 2);
+    EXPECT_FALSE(ran);
+    
+    // The locked queue is unbounded: TryEnqueue always succeeds
+    ThreadPool locked(1);
+    auto queued = locked.TryEnqueue([]() { return 3; });
+    ASSERT_TRUE(queued.has_value());
+    EXPECT_EQ(queued->get(), 3);
+}
+
+TEST(ThreadPoolTest, RingReportsQueueDelay) {
+    ThreadPool pool(1, ThreadPoolOptions{Scheduling::SharedQueue, TaskQueue::Ring, 16});
+    
+    std::mutex mutex;
+    std::vector<std::chrono::nanoseconds> waits;
+    std::vector<bool> empties;
+    pool.SetQueueDelayObserver([&](std::chrono::nanoseconds wait, bool queue_empty) {
+        std::lock_guard<std::mutex> lock(mutex);
+        waits.push_back(wait);
+        empties.push_back(queue_empty);
+    });
+    
+    auto first = pool.Enqueue([]() { std::this_thread::sleep_for(std::chrono::milliseconds(20)); });
+    auto second = pool.Enqueue([]() {});
+    first.get();
+    second.get();
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    ASSERT_EQ(waits.size(), 2u);
+    EXPECT_GE(waits[1], std::chrono::milliseconds(15));
+    EXPECT_TRUE(empties[1]);
+    
+    EXPECT_EQ(ParseTaskQueue("ring"), TaskQueue::Ring);
+    EXPECT_THROW(ParseTaskQueue("lockfree"), std::invalid_argument);
+    EXPECT_THROW(ThreadPool(2, ThreadPoolOptions{Scheduling::WorkStealing, TaskQueue::Ring, 16}),
+                 std::invalid_argument);
+}
+
+TEST(ThreadPoolTest, PostRunsMoveOnlyTasks) {
+    for (ThreadPoolOptions options : {ThreadPoolOptions{},
+                                      ThreadPoolOptions{Scheduling::WorkStealing},
+                                      ThreadPoolOptions{Scheduling::SharedQueue, TaskQueue::Ring, 64}}) {
+        ThreadPool pool(4, options);
+        std::atomic<int> sum{0};
+        for (int i = 0; i < 1000; ++i) {
+            auto value = std::make_unique<int>(i);
+            pool.Post([&sum, value = std::move(value)]() { sum += *value; });
+        }
+        
+        // Posted tasks run before the pool is destroyed
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (sum.load() != 499500 && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::yield();
+        }
+        EXPECT_EQ(sum.load(), 499500);
+        EXPECT_TRUE(pool.TryPost([]() {}));
+    }
+}
+
+TEST(ThreadPoolTest, PostDoesNotAllocateOnceWarm) {
+    for (ThreadPoolOptions options : {ThreadPoolOptions{},
+                                      ThreadPoolOptions{Scheduling::WorkStealing},
+                                      ThreadPoolOptions{Scheduling::SharedQueue, TaskQueue::Ring, 1024}}) {
+        ThreadPool pool(4, options);
+        std::atomic<int> done{0};
+        // About the size of a request's capture
+        std::array<char, 64> request{};
+        std::array<char, 128> address{};
+        auto post_batch = [&]() {
+            done = 0;
+            for (int i = 0; i < 500; ++i) {
+                pool.Post([&done, request, address]() { done++; });
+            }
+            while (done.load() < 500) {
+                std::this_thread::yield();
+            }
+        };
+        
+        // Warm up with every worker held, so the queue grows to the whole
+        // batch
+        std::atomic<bool> hold{true};
+        for (size_t i = 0; i < pool.Size(); ++i) {
+            pool.Post([&hold]() {
+                while (hold.load()) {
+                    std::this_thread::yield();
+                }
+            });
+        }
+        for (int i = 0; i < 500; ++i) {
+            pool.Post([&done, request, address]() { done++; });
+        }
+        hold = false;
+        while (done.load() < 500) {
+            std::this_thread::yield();
+        }
+        
+        allocations = 0;
+        counting_allocations = true;
+        post_batch();
+        counting_allocations = false;
+        EXPECT_EQ(allocations.load(), 0u);
+    }
+}
+
+TEST(ThreadPoolTest, TryPostFailsWhenRingIsFull) {
+    ThreadPool pool(1, ThreadPoolOptions{Scheduling::SharedQueue, TaskQueue::Ring, 2});
+    
+    std::atomic<bool> release{false};
+    std::atomic<bool> started{false};
+    pool.Post([&]() {
+        started = true;
+        while (!release.load()) {
+            std::this_thread::yield();
+        }
+    });
+    while (!started.load()) {
+        std::this_thread::yield();
+    }
+    
+    std::atomic<int> ran{0};
+    EXPECT_TRUE(pool.TryPost([&ran]() { ran++; }));
+    EXPECT_TRUE(pool.TryPost([&ran]() { ran++; }));
+    auto tracker = std::make_shared<int>(0);
+    EXPECT_FALSE(pool.TryPost([&ran, tracker]() { ran += 100; }));
+    EXPECT_EQ(tracker.use_count(), 1);
+    
+    release = true;
+    while (ran.load() < 2) {
+        std::this_thread::yield();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_EQ(ran.load(), 2);
+}
+
+TEST(ThreadPoolTest, PriorityLanesHaveWorkersOfTheirOwn) {
+    ThreadPoolOptions options;
+    options.critical_threads = 1;
+    options.bulk_threads = 1;
+    ThreadPool pool(2, options);
+    
+    // Every Normal worker and the bulk worker are held
+    std::atomic<bool> hold{true};
+    std::atomic<int> held{0};
+    auto block = [&hold, &held]() {
+        held++;
+        while (hold.load()) {
+            std::this_thread::yield();
+        }
+    };
+    pool.Post(block);
+    pool.Post(block);
+    pool.Post(block, TaskPriority::Bulk);
+    while (held.load() < 3) {
+        std::this_thread::yield();
+    }
+    
+    std::atomic<int> normal{0};
+    std::atomic<int> bulk{0};
+    std::atomic<int> critical{0};
+    pool.Post([&normal]() { normal++; });
+    pool.Post([&bulk]() { bulk++; }, TaskPriority::Bulk);
+    EXPECT_TRUE(pool.TryPost([&critical]() { critical++; }, TaskPriority::Critical));
+    
+    // Critical work runs on its reserved worker while the rest waits
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (critical.load() == 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(critical.load(), 1);
+    EXPECT_EQ(normal.load(), 0);
+    EXPECT_EQ(bulk.load(), 0);
+    EXPECT_EQ(pool.PendingTasks(), 2u);
+    
+    hold = false;
+    while ((normal.load() == 0 || bulk.load() == 0) && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(normal.load(), 1);
+    EXPECT_EQ(bulk.load(), 1);
+}
+
+TEST(ThreadPoolTest, FullBulkLaneRefusesTryPost) {
+    ThreadPoolOptions options;
+    options.bulk_threads = 1;
+    options.lane_capacity = 2;
+    ThreadPool pool(1, options);
+    
+    std::atomic<int> waits{0};
+    pool.SetQueueDelayObserver([&waits](std::chrono::nanoseconds, bool) { waits++; }, TaskPriority::Bulk);
+    
+    std::atomic<bool> hold{true};
+    std::atomic<bool> held{false};
+    pool.Post([&hold, &held]() {
+        held = true;
+        while (hold.load()) {
+            std::this_thread::yield();
+        }
+    }, TaskPriority::Bulk);
+    while (!held.load()) {
+        std::this_thread::yield();
+    }
+    
+    // The lane queues two tasks; the third is refused and dropped
+    std::atomic<int> ran{0};
+    auto tracker = std::make_shared<int>(0);
+    EXPECT_TRUE(pool.TryPost([&ran]() { ran++; }, TaskPriority::Bulk));
+    EXPECT_TRUE(pool.TryPost([&ran]() { ran++; }, TaskPriority::Bulk));
+    EXPECT_FALSE(pool.TryPost([&ran, tracker]() { ran++; }, TaskPriority::Bulk));
+    EXPECT_EQ(tracker.use_count(), 1);
+    
+    // Normal work is not held up by the full lane
+    EXPECT_TRUE(pool.TryPost([&ran]() { ran += 10; }));
+    
+    hold = false;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (ran.load() < 12 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(ran.load(), 12);
+    EXPECT_EQ(waits.load(), 3);
+}
+
+TEST(ThreadPoolTest, PrioritiesWithoutLanesRunAsNormal) {
+    ThreadPool pool(2);
+    std::atomic<int> ran{0};
+    pool.Post([&ran]() { ran++; }, TaskPriority::Critical);
+    pool.Post([&ran]() { ran++; }, TaskPriority::Bulk);
+    
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (ran.load() < 2 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(ran.load(), 2);
+}
+
+TEST(ThreadPoolTest, ElasticPoolGrowsUnderDelayAndShrinksWhenIdle) {
+    for (TaskQueue queue : {TaskQueue::Locked, TaskQueue::Ring}) {
+        ThreadPoolOptions options;
+        options.queue = queue;
+        options.queue_capacity = 64;
+        options.max_threads = 4;
+        options.grow_after = std::chrono::milliseconds(1);
+        options.idle_timeout = std::chrono::milliseconds(100);
+        ThreadPool pool(1, options);
+        EXPECT_EQ(pool.Size(), 1u);
+        
+        // Tasks queue behind slow ones, so their waits add workers
+        std::atomic<int> done{0};
+        for (int i = 0; i < 16; ++i) {
+            pool.Post([&done]() {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                done++;
+            });
+        }
+        size_t largest = 1;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (done.load() < 16 && std::chrono::steady_clock::now() < deadline) {
+            largest = std::max(largest, pool.Size());
+            std::this_thread::yield();
+        }
+        EXPECT_EQ(done.load(), 16);
+        EXPECT_GT(largest, 1u);
+        EXPECT_LE(largest, 4u);
+        
+        // Added workers retire once idle
+        while (pool.Size() > 1 && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        EXPECT_EQ(pool.Size(), 1u);
+        
+        // And come back for the next burst
+        done = 0;
+        for (int i = 0; i < 8; ++i) {
+            pool.Post([&done]() {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                done++;
+            });
+        }
+        while (done.load() < 8 && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::yield();
+        }
+        EXPECT_EQ(done.load(), 8);
+    }
+    
+    ThreadPoolOptions stealing;
+    stealing.scheduling = Scheduling::WorkStealing;
+    stealing.max_threads = 8;
+    EXPECT_THROW(ThreadPool(2, stealing), std::invalid_argument);
+}
+
+#if defined(__linux__)
+TEST(ThreadPoolTest, NamesAndPinsWorkers) {
+    cpu_set_t allowed;
+    ASSERT_EQ(sched_getaffinity(0, sizeof(allowed), &allowed), 0);
+    unsigned target = 0;
+    while (!CPU_ISSET(target, &allowed)) {
+        ++target;
+    }
+    
+    for (Scheduling scheduling : {Scheduling::SharedQueue, Scheduling::WorkStealing}) {
+        ThreadPoolOptions options;
+        options.scheduling = scheduling;
+        options.thread_name = "pool";
+        options.cpus = {target};
+        ThreadPool pool(2, options);
+        
+        std::set<std::string> names;
+        for (int i = 0; i < 20; ++i) {
+            auto placement = pool.Enqueue([]() {
+                char name[16] = {};
+                pthread_getname_np(pthread_self(), name, sizeof(name));
+                return std::make_pair(std::string(name), sched_getcpu());
+            }).get();
+            names.insert(placement.first);
+            EXPECT_EQ(placement.second, static_cast<int>(target));
+        }
+        for (const std::string& name : names) {
+            EXPECT_TRUE(name == "pool-0" || name == "pool-1") << name;
+        }
+    }
+}
+
+TEST(ThreadPoolTest, PinsLaneWorkersAfterTheNormalOnes) {
+    cpu_set_t allowed;
+    ASSERT_EQ(sched_getaffinity(0, sizeof(allowed), &allowed), 0);
+    std::vector<unsigned> usable;
+    for (unsigned cpu = 0; cpu < CPU_SETSIZE && usable.size() < 3; ++cpu) {
+        if (CPU_ISSET(cpu, &allowed)) {
+            usable.push_back(cpu);
+        }
+    }
+    // Distinct CPUs where there are three to test on
+    std::vector<unsigned> cpus;
+    for (size_t i = 0; i < 3; ++i) {
+        cpus.push_back(usable[i % usable.size()]);
+    }
+    
+    ThreadPoolOptions options;
+    options.thread_name = "pool";
+    options.cpus = cpus;
+    options.critical_threads = 1;
+    options.bulk_threads = 1;
+    ThreadPool pool(1, options);
+    
+    auto placement = [&pool](TaskPriority priority) {
+        std::promise<std::pair<std::string, int>> result;
+        std::future<std::pair<std::string, int>> placed = result.get_future();
+        pool.Post([&result]() {
+            char name[16] = {};
+            pthread_getname_np(pthread_self(), name, sizeof(name));
+            result.set_value(std::make_pair(std::string(name), sched_getcpu()));
+        }, priority);
+        return placed.get();
+    };
+    EXPECT_EQ(placement(TaskPriority::Normal), std::make_pair(std::string("pool-0"), static_cast<int>(cpus[0])));
+    EXPECT_EQ(placement(TaskPriority::Critical), std::make_pair(std::string("pool-c0"), static_cast<int>(cpus[1])));
+    EXPECT_EQ(placement(TaskPriority::Bulk), std::make_pair(std::string("pool-b0"), static_cast<int>(cpus[2])));
+}
+#endif
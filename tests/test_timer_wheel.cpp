@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+#include "timer_wheel.hpp"
+#include <vector>
+
+using namespace http;
+
+TEST(TimerWheelTest, FiresAtExpiry) {
+    TimerWheel wheel(0);
+    int fired = 0;
+
+    wheel.Schedule(10, 0, [&fired]() { ++fired; });
+    EXPECT_EQ(wheel.Size(), 1u);
+
+    wheel.Advance(9);
+    EXPECT_EQ(fired, 0);
+
+    EXPECT_EQ(wheel.Advance(10), 1u);
+    EXPECT_EQ(fired, 1);
+    EXPECT_EQ(wheel.Size(), 0u);
+}
+
+TEST(TimerWheelTest, PastExpiryFiresOnNextAdvance) {
+    TimerWheel wheel(100);
+    int fired = 0;
+
+    wheel.Schedule(50, 0, [&fired]() { ++fired; });
+    wheel.Advance(101);
+
+    EXPECT_EQ(fired, 1);
+}
+
+TEST(TimerWheelTest, CancelPreventsFiring) {
+    TimerWheel wheel(0);
+    int fired = 0;
+
+    TimerId id = wheel.Schedule(5, 0, [&fired]() { ++fired; });
+    EXPECT_TRUE(wheel.Cancel(id));
+    EXPECT_FALSE(wheel.Cancel(id));
+
+    wheel.Advance(100);
+    EXPECT_EQ(fired, 0);
+    EXPECT_EQ(wheel.Size(), 0u);
+}
+
+TEST(TimerWheelTest, StaleIdDoesNotCancelReusedRecord) {
+    TimerWheel wheel(0);
+    int fired = 0;
+
+    TimerId first = wheel.Schedule(5, 0, []() {});
+    wheel.Advance(5);
+
+    // Reuses the freed slab record
+    wheel.Schedule(10, 0, [&fired]() { ++fired; });
+    EXPECT_FALSE(wheel.Cancel(first));
+
+    wheel.Advance(10);
+    EXPECT_EQ(fired, 1);
+}
+
+TEST(TimerWheelTest, FiresInOrderAcrossLevels) {
+    TimerWheel wheel(0);
+    std::vector<uint64_t> order;
+
+    // Spread over every level, including past the 2^32 ms range
+    const std::vector<uint64_t> expiries = {
+        3, 255, 256, 1000, 70000, 20000000, (uint64_t{1} << 32) + 5
+    };
+    for (auto it = expiries.rbegin(); it != expiries.rend(); ++it) {
+        uint64_t expires = *it;
+        wheel.Schedule(expires, 0, [&order, &wheel, expires]() {
+            EXPECT_EQ(wheel.Now(), expires);
+            order.push_back(expires);
+        });
+    }
+
+    wheel.Advance((uint64_t{1} << 32) + 10);
+    EXPECT_EQ(order, expiries);
+}
+
+TEST(TimerWheelTest, PeriodicTimerRepeatsUntilCancelled) {
+    TimerWheel wheel(0);
+    int fired = 0;
+    TimerId id = 0;
+
+    id = wheel.Schedule(10, 10, [&]() {
+        if (++fired == 3) {
+            EXPECT_TRUE(wheel.Cancel(id));
+        }
+    });
+
+    wheel.Advance(1000);
+    EXPECT_EQ(fired, 3);
+    EXPECT_EQ(wheel.Size(), 0u);
+}
+
+TEST(TimerWheelTest, CallbackCanScheduleAndCancel) {
+    TimerWheel wheel(0);
+    int chained = 0;
+    int cancelled = 0;
+
+    TimerId victim = wheel.Schedule(20, 0, [&cancelled]() { ++cancelled; });
+    wheel.Schedule(10, 0, [&]() {
+        EXPECT_TRUE(wheel.Cancel(victim));
+        wheel.Schedule(wheel.Now() + 5, 0, [&chained]() { ++chained; });
+    });
+
+    wheel.Advance(100);
+    EXPECT_EQ(chained, 1);
+    EXPECT_EQ(cancelled, 0);
+}
+
+TEST(TimerWheelTest, NextTimeout) {
+    TimerWheel wheel(0);
+    EXPECT_EQ(wheel.NextTimeoutMs(0), -1);
+
+    wheel.Schedule(40, 0, []() {});
+    EXPECT_EQ(wheel.NextTimeoutMs(0), 40);
+    EXPECT_EQ(wheel.NextTimeoutMs(15), 25);
+
+    // Far timers report no later than their cascade point
+    TimerWheel far(0);
+    far.Schedule(5000, 0, []() {});
+    int64_t timeout = far.NextTimeoutMs(0);
+    EXPECT_GT(timeout, 0);
+    EXPECT_LE(timeout, 5000);
+}
+
+TEST(TimerWheelTest, ManyTimers) {
+    TimerWheel wheel(0);
+    constexpr int kTimers = 50000;
+    int fired = 0;
+
+    std::vector<TimerId> ids;
+    ids.reserve(kTimers);
+    for (int i = 0; i < kTimers; ++i) {
+        ids.push_back(wheel.Schedule(1 + static_cast<uint64_t>(i % 30000), 0, [&fired]() { ++fired; }));
+    }
+    for (int i = 0; i < kTimers; i += 2) {
+        wheel.Cancel(ids[i]);
+    }
+
+    wheel.Advance(30000);
+    EXPECT_EQ(fired, kTimers / 2);
+    EXPECT_EQ(wheel.Size(), 0u);
+}
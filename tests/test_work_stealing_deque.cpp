@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+#include "work_stealing_deque.hpp"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace http;
+
+TEST(WorkStealingDequeTest, OwnerPopsNewestThievesTakeOldest) {
+    WorkStealingDeque<int> deque(4);
+    int value = 0;
+
+    EXPECT_FALSE(deque.Pop(value));
+    EXPECT_FALSE(deque.Steal(value));
+
+    for (int i = 0; i < 5; ++i) {
+        deque.Push(i);
+    }
+    EXPECT_EQ(deque.Size(), 5u);
+
+    ASSERT_TRUE(deque.Steal(value));
+    EXPECT_EQ(value, 0);
+    ASSERT_TRUE(deque.Pop(value));
+    EXPECT_EQ(value, 4);
+    ASSERT_TRUE(deque.Steal(value));
+    EXPECT_EQ(value, 1);
+    ASSERT_TRUE(deque.Pop(value));
+    EXPECT_EQ(value, 3);
+    ASSERT_TRUE(deque.Pop(value));
+    EXPECT_EQ(value, 2);
+    EXPECT_FALSE(deque.Pop(value));
+    EXPECT_FALSE(deque.Steal(value));
+    EXPECT_EQ(deque.Size(), 0u);
+}
+
+TEST(WorkStealingDequeTest, GrowsPastInitialCapacity) {
+    WorkStealingDeque<int> deque(2);
+    for (int i = 0; i < 1000; ++i) {
+        deque.Push(i);
+    }
+    EXPECT_GE(deque.Capacity(), 1000u);
+
+    int value = 0;
+    for (int i = 999; i >= 0; --i) {
+        ASSERT_TRUE(deque.Pop(value));
+        EXPECT_EQ(value, i);
+    }
+}
+
+TEST(WorkStealingDequeTest, EveryValueTakenExactlyOnce) {
+    constexpr int kValues = 200000;
+    constexpr int kThieves = 3;
+    WorkStealingDeque<int> deque(64);
+    std::vector<std::atomic<int>> taken(kValues);
+    std::atomic<int> total{0};
+    std::atomic<bool> done{false};
+
+    std::vector<std::thread> thieves;
+    for (int t = 0; t < kThieves; ++t) {
+        thieves.emplace_back([&]() {
+            int value = 0;
+            while (!done.load() || deque.Size() > 0) {
+                if (deque.Steal(value)) {
+                    taken[value].fetch_add(1);
+                    total.fetch_add(1);
+                }
+            }
+        });
+    }
+
+    // The owner pushes (growing the array under the thieves) and pops
+    int value = 0;
+    for (int i = 0; i < kValues; ++i) {
+        deque.Push(i);
+        if (i % 3 == 0 && deque.Pop(value)) {
+            taken[value].fetch_add(1);
+            total.fetch_add(1);
+        }
+    }
+    while (deque.Pop(value)) {
+        taken[value].fetch_add(1);
+        total.fetch_add(1);
+    }
+    done = true;
+    for (auto& thief : thieves) {
+        thief.join();
+    }
+
+    EXPECT_EQ(total.load(), kValues);
+    for (int i = 0; i < kValues; ++i) {
+        ASSERT_EQ(taken[i].load(), 1) << "value " << i;
+    }
+}